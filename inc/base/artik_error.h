@@ -195,6 +195,11 @@ typedef int artik_error;
  */
 #define E_IN_PROGRESS			(-16)
 
+/*!
+ *  \brief The requested item does not exist
+ */
+#define E_NOT_FOUND			(-17)
+
 /*!
  *  \brief Error message definition
  *
@@ -246,7 +251,8 @@ static const artik_error_msg_string error_msg_strings[] = {
 	{E_SECURITY_DIGEST_MISMATCH, "Computed digest mismatch"},
 	{E_SECURITY_SIGNATURE_MISMATCH, "Signature mismatch"},
 	{E_SECURITY_SIGNING_TIME_ROLLBACK, "Signing time rollback error"},
-	{E_IN_PROGRESS, "Operation in progress"}
+	{E_IN_PROGRESS, "Operation in progress"},
+	{E_NOT_FOUND, "Not found"}
 };
 
 static const char *error_msg_null = "null";
@@ -47,6 +47,110 @@ enum watch_io {
 	/**< invalid request. the file descriptor is not open */
 };
 
+/*!
+ * \brief Maximum number of worker contexts
+ */
+#define ARTIK_LOOP_MAX_WORKERS		16
+
+/*!
+ * \brief Let the loop pick a worker context
+ *
+ * File descriptor watches are placed by hashing the file descriptor,
+ * other sources are distributed round robin among the workers.
+ */
+#define ARTIK_LOOP_AFFINITY_ANY		(-1)
+
+/*!
+ * \brief Place the source in the main context run by \ref run
+ */
+#define ARTIK_LOOP_AFFINITY_MAIN	(-2)
+
+/*!
+ * \brief Maximum number of tags tracked by the loop statistics
+ */
+#define ARTIK_LOOP_STATS_MAX_TAGS	16
+
+/*!
+ * \brief Maximum length of a loop statistics tag
+ */
+#define ARTIK_LOOP_STATS_TAG_LEN	24
+
+/*!
+ * \brief Number of buckets of the loop statistics histograms
+ *
+ * Bucket 0 counts durations below 2 microseconds, bucket N counts
+ * durations between 2^N and 2^(N+1) microseconds, the last bucket
+ * counts everything above.
+ */
+#define ARTIK_LOOP_STATS_BUCKETS	16
+
+/*!
+ * \brief Kinds of sources tracked by the loop statistics
+ */
+typedef enum {
+	ARTIK_LOOP_SOURCE_TIMER = 0,	/**< timeouts and periodics */
+	ARTIK_LOOP_SOURCE_FD_WATCH,	/**< file descriptor watches */
+	ARTIK_LOOP_SOURCE_IDLE,		/**< idle callbacks */
+	ARTIK_LOOP_SOURCE_POST,		/**< posted callbacks */
+	ARTIK_LOOP_SOURCE_TYPES
+} artik_loop_source_type;
+
+/*!
+ * \brief Dispatch statistics of the sources registered by one module
+ */
+typedef struct {
+	/*!
+	 * \brief Name of the library which registered the sources, e.g.
+	 *        "mqtt" for libartik-sdk-mqtt, "app" for the executable
+	 */
+	char tag[ARTIK_LOOP_STATS_TAG_LEN];
+	/*!
+	 * \brief Number of callbacks run, per source type
+	 */
+	unsigned int dispatched[ARTIK_LOOP_SOURCE_TYPES];
+	/*!
+	 * \brief Total and maximum callback run time in microseconds
+	 */
+	unsigned long long run_time_us;
+	unsigned int max_run_time_us;
+	/*!
+	 * \brief Total and maximum dispatch latency in microseconds
+	 *
+	 * The latency is the delay between the time a timer expired or a
+	 * callback was posted and the time its callback started. For
+	 * watches and idles it is measured from the start of the loop
+	 * iteration.
+	 */
+	unsigned long long latency_us;
+	unsigned int max_latency_us;
+	/*!
+	 * \brief Histograms of the run time and latency
+	 */
+	unsigned int run_time_hist[ARTIK_LOOP_STATS_BUCKETS];
+	unsigned int latency_hist[ARTIK_LOOP_STATS_BUCKETS];
+} artik_loop_tag_stats;
+
+/*!
+ * \brief Snapshot of the loop statistics
+ */
+typedef struct {
+	/*!
+	 * \brief True if the statistics are being collected
+	 */
+	bool enabled;
+	/*!
+	 * \brief Sources currently registered or queued, per source type
+	 *
+	 * This is maintained even when the statistics are disabled.
+	 */
+	unsigned int pending[ARTIK_LOOP_SOURCE_TYPES];
+	/*!
+	 * \brief Number of valid entries in \ref tags
+	 */
+	unsigned int num_tags;
+	artik_loop_tag_stats tags[ARTIK_LOOP_STATS_MAX_TAGS];
+} artik_loop_stats;
+
 /*!
  * \brief     This callback function gets triggered after timeout
  * \param[in] user_data The user data passed from the register callback function
@@ -208,6 +312,147 @@ typedef struct {
 	 * \return    S_OK on success, error code otherwise
 	 */
 	artik_error(*remove_idle_callback)(int idle_id);
+	/*!
+	 * \brief     Start worker contexts
+	 *
+	 * Start \p num_workers threads, each running its own context.
+	 * Sources registered with the *_on functions are dispatched by
+	 * these threads, in parallel with the main loop. Sources added
+	 * with the other functions keep running in the main context.
+	 *
+	 * \param[in] num_workers Number of worker contexts, up to
+	 *            \ref ARTIK_LOOP_MAX_WORKERS
+	 *
+	 * \return    S_OK on success, E_BUSY if workers are already
+	 *            running, error code otherwise
+	 */
+	artik_error(*start_workers)(unsigned int num_workers);
+	/*!
+	 * \brief     Stop worker contexts
+	 *
+	 * Join the worker threads and remove the sources still attached to
+	 * their contexts.
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*stop_workers)(void);
+	/*!
+	 * \brief     Same as \ref add_timeout_callback on a worker context
+	 *
+	 * \param[in] affinity Index of the worker context, or one of
+	 *            \ref ARTIK_LOOP_AFFINITY_ANY and
+	 *            \ref ARTIK_LOOP_AFFINITY_MAIN. Indexes are taken
+	 *            modulo the number of workers. Without running workers,
+	 *            the source is added to the main context.
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*add_timeout_callback_on)(int affinity, int *timeout_id,
+			unsigned int msec, timeout_callback func,
+			void *user_data);
+	/*!
+	 * \brief     Same as \ref add_periodic_callback on a worker context
+	 *
+	 * \param[in] affinity See \ref add_timeout_callback_on
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*add_periodic_callback_on)(int affinity, int *periodic_id,
+			unsigned int msec, periodic_callback func,
+			void *user_data);
+	/*!
+	 * \brief     Same as \ref add_fd_watch on a worker context
+	 *
+	 * \param[in] affinity See \ref add_timeout_callback_on. With
+	 *            \ref ARTIK_LOOP_AFFINITY_ANY the worker is selected by
+	 *            hashing \p fd.
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*add_fd_watch_on)(int affinity, int fd, enum watch_io io,
+			watch_callback func, void *user_data, int *watch_id);
+	/*!
+	 * \brief     Same as \ref add_idle_callback on a worker context
+	 *
+	 * \param[in] affinity See \ref add_timeout_callback_on
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*add_idle_callback_on)(int affinity, int *idle_id,
+			idle_callback func, void *user_data);
+	/*!
+	 * \brief     Run a function once in a context
+	 *
+	 * This function can be called from any thread. The callback is
+	 * run from the selected context on its next iteration. Callbacks
+	 * posted to the same context run in the order they were posted.
+	 * Unlike \ref add_idle_callback, no source is created for each
+	 * call, which makes it suitable for forwarding events from other
+	 * threads.
+	 *
+	 * \param[in] affinity See \ref add_timeout_callback_on
+	 * \param[in] func The callback function to run
+	 * \param[in] user_data The user data to be passed to the callback
+	 *            function
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*post_callback)(int affinity, timeout_callback func,
+			void *user_data);
+	/*!
+	 * \brief     Set the slack allowed on timer expirations
+	 *
+	 * Expiration times of the timeouts and periodic callbacks added
+	 * afterwards are rounded up to a multiple of the slack, so that
+	 * timers expiring close to each other are run from the same
+	 * wakeup. A slack of 1 or 0 disables coalescing, which is the
+	 * default.
+	 *
+	 * \param[in] msec Slack in milliseconds
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*set_timer_slack)(unsigned int msec);
+	/*!
+	 * \brief     Enable or disable the loop statistics
+	 *
+	 * When enabled, the run time and dispatch latency of every callback
+	 * of the timers, watches, idles and posted callbacks registered
+	 * afterwards are recorded, grouped by the library which registered
+	 * them. Enabling resets the statistics. The cost is two clock
+	 * readings and a short lock per callback.
+	 *
+	 * \param[in] enable True to start collecting, false to stop
+	 * \param[in] dump_signum If not 0, signal on which the statistics
+	 *            are written to the log from the main context, e.g.
+	 *            SIGUSR1
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*enable_stats)(bool enable, int dump_signum);
+	/*!
+	 * \brief     Get a snapshot of the loop statistics
+	 *
+	 * \param[out] stats Filled with the current statistics
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*get_stats)(artik_loop_stats *stats);
+	/*!
+	 * \brief     Tag the next registration of the calling thread
+	 *
+	 *  Statistics are tagged with the library registering a source.
+	 *  Modules sharing a library call this right before adding a
+	 *  timer, fd watch, idle or post callback so that it is recorded
+	 *  under their own tag, e.g. "http" or "websocket". The tag only
+	 *  applies to the next registration made by the calling thread.
+	 *
+	 * \param[in] tag Tag name, truncated to ARTIK_LOOP_STATS_TAG_LEN - 1
+	 *            characters. NULL goes back to the library name.
+	 *
+	 * \return    S_OK on success, error code otherwise
+	 */
+	artik_error(*set_stats_tag)(const char *tag);
 } artik_loop_module;
 
 extern const artik_loop_module loop_module;
@@ -150,6 +150,30 @@ extern "C" {
 		char *object;
 	} artik_api_module;
 
+	/*!
+	 *  \brief Loading state of a module
+	 */
+	typedef struct {
+		/*!
+		 *  \brief Module name string
+		 */
+		char name[MAX_MODULE_NAME];
+		/*!
+		 *  \brief True if the module is currently loaded
+		 */
+		bool loaded;
+		/*!
+		 *  \brief True if the module was loaded by
+		 *         \ref artik_preload_modules
+		 */
+		bool preloaded;
+		/*!
+		 *  \brief Time spent loading the module the last time it
+		 *         was loaded, in microseconds
+		 */
+		unsigned int load_time_us;
+	} artik_module_load_info;
+
 	/*!
 	 *  \brief Get API version
 	 *
@@ -181,6 +205,36 @@ extern "C" {
 	 */
 	artik_error artik_release_api_module(const artik_module_ops module);
 
+	/*!
+	 *  \brief Load all the modules available for the platform
+	 *
+	 *  Modules are otherwise loaded the first time they are requested.
+	 *  Preloading moves the cost of loading the libraries and resolving
+	 *  their symbols to the time this function is called. Modules are
+	 *  loaded from several threads and stay loaded until the process
+	 *  exits.
+	 *
+	 *  Setting the ARTIK_PRELOAD_MODULES environment variable to a value
+	 *  other than "0" has the same effect on the first module request.
+	 *
+	 *  \return S_OK if all the modules were loaded, E_NOT_SUPPORTED if
+	 *          some of them could not be loaded.
+	 */
+	artik_error artik_preload_modules(void);
+
+	/*!
+	 *  \brief Get the loading state of the modules of the platform
+	 *
+	 *  \param[out] info Array filled up by the function, one entry per
+	 *              module.
+	 *  \param[in,out] num Number of entries of the array on input,
+	 *              number of entries filled up on output.
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error artik_get_modules_load_info(artik_module_load_info *info,
+						int *num);
+
 	/*!
 	 *  \brief Get platform ID
 	 *
@@ -58,6 +58,19 @@ extern "C" {
  */
 typedef void *artik_security_handle;
 
+/*!
+ *  \brief SSL credentials handle type
+ *
+ *  Handle type referencing the parsed root CA store, client
+ *  certificate and private key built from an SSL configuration.
+ *  Handles are shared between all the users of identical
+ *  configurations.
+ */
+typedef void *artik_ssl_credentials_handle;
+
+/* Defined in artik_ssl.h */
+struct artik_ssl_config;
+
 /*!
  *  \brief Certificate type
  *
@@ -1264,6 +1277,47 @@ typedef struct {
 	 *  \return S_OK on success, error code otherwise
 	 */
 	artik_error(*unload_openssl_engine)(void);
+	/*!
+	 *  \brief Get the SSL credentials matching an SSL configuration
+	 *
+	 *  Credentials are cached by content: configurations carrying the
+	 *  same certificates, keys, secure element key and verification
+	 *  mode share the same parsed objects, which are only built once.
+	 *  Changing any of these bytes selects a different entry. The
+	 *  openssl engine is kept loaded as long as credentials relying
+	 *  on a secure element key are referenced.
+	 *
+	 *  \param[in] ssl_config SSL configuration to build the
+	 *             credentials from
+	 *  \param[out] handle Reference to the credentials, to be released
+	 *              with \ref put_ssl_credentials
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error(*get_ssl_credentials)(
+			const struct artik_ssl_config *ssl_config,
+			artik_ssl_credentials_handle *handle);
+	/*!
+	 *  \brief Install SSL credentials into an OpenSSL context
+	 *
+	 *  The root CA store, client certificate and private key are shared
+	 *  with the context, not copied.
+	 *
+	 *  \param[in] handle Handle returned by \ref get_ssl_credentials
+	 *  \param[in] ssl_ctx Pointer to the SSL_CTX to configure
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error(*apply_ssl_credentials)(artik_ssl_credentials_handle handle,
+			void *ssl_ctx);
+	/*!
+	 *  \brief Release a reference on SSL credentials
+	 *
+	 *  \param[in] handle Handle returned by \ref get_ssl_credentials
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error(*put_ssl_credentials)(artik_ssl_credentials_handle handle);
 } artik_security_module;
 
 extern const artik_security_module security_module;
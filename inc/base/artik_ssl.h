@@ -100,7 +100,7 @@ typedef struct {
  *  Structure containing SSL configuration
  *  for secure requests
  */
-typedef struct {
+typedef struct artik_ssl_config {
 	/*!
 	 *  \brief If non-null the secure element is used as private key when the server
 	 *         request a 'Certificate Verify'
@@ -26,6 +26,18 @@ extern "C" {
 #include <stdint.h>
 
 #include "artik_error.h"
+#include "artik_types.h"
+
+/*!
+ * \brief Maximum nesting depth of the documents handled by the JSON
+ *        tokenizer
+ */
+#define ARTIK_JSON_MAX_DEPTH	32
+
+/*!
+ * \brief Maximum length of the path of a JSON value
+ */
+#define ARTIK_JSON_PATH_MAX	256
 
 /*!
  * \brief The \ref artik_uri_info represents an URI.
@@ -41,6 +53,64 @@ typedef struct {
 	char *path; /**< The URI path */
 } artik_uri_info;
 
+/*!
+ * \brief Types of the tokens returned by the JSON tokenizer
+ */
+typedef enum {
+	ARTIK_JSON_NONE = 0,
+	ARTIK_JSON_OBJECT_START, /**< '{', value points to it */
+	ARTIK_JSON_OBJECT_END, /**< '}', value points to it */
+	ARTIK_JSON_ARRAY_START, /**< '[', value points to it */
+	ARTIK_JSON_ARRAY_END, /**< ']', value points to it */
+	ARTIK_JSON_KEY, /**< Name of an object member, without quotes */
+	ARTIK_JSON_STRING, /**< String value, without quotes */
+	ARTIK_JSON_NUMBER,
+	ARTIK_JSON_TRUE,
+	ARTIK_JSON_FALSE,
+	ARTIK_JSON_NULL,
+	ARTIK_JSON_END /**< The document is complete */
+} artik_json_type;
+
+/*!
+ * \brief Token returned by the JSON tokenizer
+ *
+ * The value is not copied: it points into the data fed to the
+ * tokenizer, or into its scratch buffer for the values split between
+ * two chunks. It is not NUL terminated and the escape sequences of the
+ * strings are not decoded, see \ref json_copy_string.
+ */
+typedef struct {
+	artik_json_type type; /**< Type of the token */
+	const char *value; /**< Text of the token */
+	unsigned int len; /**< Length in bytes of the text */
+	unsigned int depth; /**< Number of containers enclosing the token */
+} artik_json_token;
+
+/*!
+ * \brief State of a JSON tokenizer
+ *
+ * Allocated by the caller and initialized with \ref json_init. The
+ * fields are private to the tokenizer.
+ */
+typedef struct {
+	const char *data;
+	unsigned int len;
+	unsigned int pos;
+	bool last;
+	char *scratch;
+	unsigned int scratch_size;
+	unsigned int scratch_len;
+	int lex;
+	int escape;
+	artik_error error;
+	unsigned int depth;
+	uint8_t state[ARTIK_JSON_MAX_DEPTH + 1];
+	unsigned int index[ARTIK_JSON_MAX_DEPTH + 1];
+	uint16_t path_len[ARTIK_JSON_MAX_DEPTH + 1];
+	char path[ARTIK_JSON_PATH_MAX];
+	unsigned int cur_path_len;
+} artik_json_tokenizer;
+
 /*! \struct artik_utils_module
  *
  * \brief Utils module operation
@@ -66,6 +136,105 @@ typedef struct {
 	 * \return S_OK on success, otherwise a negative error value.
 	 */
 	artik_error(*free_uri_info)(artik_uri_info * uri_info);
+	/**
+	 * Initialize a pull JSON tokenizer.
+	 *
+	 * The tokenizer does not allocate memory. The document is fed in
+	 * chunks with \ref json_feed, e.g. from an HTTP stream callback,
+	 * and tokens are pulled with \ref json_next.
+	 *
+	 * \param[out] tokenizer Tokenizer to initialize.
+	 * \param[in] scratch Buffer receiving the strings and numbers
+	 *            split between two chunks, can be NULL if the whole
+	 *            document is fed at once.
+	 * \param[in] scratch_size Size in bytes of \a scratch.
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*json_init)(artik_json_tokenizer *tokenizer, char *scratch,
+			unsigned int scratch_size);
+	/**
+	 * Feed the next chunk of the document.
+	 *
+	 * The chunk must remain valid until \ref json_next returns
+	 * E_TRY_AGAIN. Tokens returned from the chunk point into it.
+	 *
+	 * \param[in] tokenizer Tokenizer to feed.
+	 * \param[in] data Chunk of the document, NULL to signal the end
+	 *            of the document.
+	 * \param[in] len Length in bytes of \a data.
+	 * \return S_OK on success, E_BUSY if the previous chunk is not
+	 *         consumed yet, otherwise a negative error value.
+	 */
+	artik_error(*json_feed)(artik_json_tokenizer *tokenizer,
+			const char *data, unsigned int len);
+	/**
+	 * Get the next token of the document.
+	 *
+	 * \param[in] tokenizer Tokenizer to read from.
+	 * \param[out] token Token filled up by the function, of type
+	 *             ARTIK_JSON_END once the document is complete
+	 *             and the end of the input has been fed. Only
+	 *             whitespace may follow the root value.
+	 * \return S_OK on success, E_TRY_AGAIN if the chunk is consumed
+	 *         and the next one must be fed, E_INVALID_VALUE if the
+	 *         document is malformed, E_OVERFLOW if it exceeds the
+	 *         nesting, path or scratch buffer limits.
+	 */
+	artik_error(*json_next)(artik_json_tokenizer *tokenizer,
+			artik_json_token *token);
+	/**
+	 * Get the path of the last token returned by \ref json_next.
+	 *
+	 * Paths are made of the member names separated by dots and of
+	 * the array indexes in brackets, e.g. "data[3].id". The path of
+	 * the root value is the empty string.
+	 *
+	 * \param[in] tokenizer Tokenizer to query.
+	 * \return NUL terminated path, valid until the next token.
+	 */
+	const char *(*json_get_path)(artik_json_tokenizer *tokenizer);
+	/**
+	 * Check whether the path of the last token returned by
+	 * \ref json_next matches a pattern.
+	 *
+	 * Patterns are paths where "[*]" matches any array index and a
+	 * "*" member name matches any member, e.g. "data[*].id".
+	 *
+	 * \param[in] tokenizer Tokenizer to query.
+	 * \param[in] pattern Pattern to match.
+	 * \return true if the path matches.
+	 */
+	bool (*json_path_match)(artik_json_tokenizer *tokenizer,
+			const char *pattern);
+	/**
+	 * Find a value in a complete JSON document.
+	 *
+	 * Objects and arrays are returned with the text spanning their
+	 * whole content.
+	 *
+	 * \param[in] json JSON document.
+	 * \param[in] len Length in bytes of \a json.
+	 * \param[in] pattern Pattern of the path of the value, see
+	 *            \ref json_path_match.
+	 * \param[out] token Token filled up with the first matching
+	 *             value.
+	 * \return S_OK on success, E_NOT_FOUND if no value matches,
+	 *         otherwise a negative error value.
+	 */
+	artik_error(*json_find)(const char *json, unsigned int len,
+			const char *pattern, artik_json_token *token);
+	/**
+	 * Copy the text of a token as a NUL terminated string, decoding
+	 * the escape sequences of strings and keys.
+	 *
+	 * \param[in] token Token to copy.
+	 * \param[out] dst Buffer receiving the string.
+	 * \param[in] size Size in bytes of \a dst.
+	 * \return S_OK on success, E_OVERFLOW if \a dst is too small,
+	 *         otherwise a negative error value.
+	 */
+	artik_error(*json_copy_string)(const artik_json_token *token,
+			char *dst, unsigned int size);
 } artik_utils_module;
 
 extern const artik_utils_module utils_module;
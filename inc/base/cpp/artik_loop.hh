@@ -61,6 +61,22 @@ class Loop {
   artik_error add_idle_callback(int *idle_id, idle_callback func,
       void *user_data);
   artik_error remove_idle_callback(int idle_id);
+  artik_error start_workers(unsigned int num_workers);
+  artik_error stop_workers(void);
+  artik_error add_timeout_callback_on(int affinity, int *timeout_id,
+      unsigned int msec, timeout_callback func, void *user_data);
+  artik_error add_periodic_callback_on(int affinity, int *periodic_id,
+      unsigned int msec, periodic_callback func, void *user_data);
+  artik_error add_fd_watch_on(int affinity, int fd, enum watch_io io,
+      watch_callback func, void *user_data, int *watch_id);
+  artik_error add_idle_callback_on(int affinity, int *idle_id,
+      idle_callback func, void *user_data);
+  artik_error post_callback(int affinity, timeout_callback func,
+      void *user_data);
+  artik_error set_timer_slack(unsigned int msec);
+  artik_error enable_stats(bool enable, int dump_signum);
+  artik_error get_stats(artik_loop_stats *stats);
+  artik_error set_stats_tag(const char *tag);
 };
 
 }  // namespace artik
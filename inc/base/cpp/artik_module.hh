@@ -39,6 +39,8 @@ class Module {
   ~Module();
 
   artik_error get_api_version(artik_api_version * version);
+  artik_error preload_modules(void);
+  artik_error get_modules_load_info(artik_module_load_info *info, int *num);
   int get_platform(void);
   artik_error get_platform_name(char *name);
   artik_error get_available_modules(artik_api_module **modules,
@@ -25,6 +25,7 @@ extern "C" {
 
 #include "artik_error.h"
 #include "artik_types.h"
+#include "artik_utils.h"
 #include "artik_http.h"
 #include "artik_websocket.h"
 
@@ -65,6 +66,239 @@ extern "C" {
 typedef void (*artik_cloud_callback)(artik_error result,
 				char *response, void *user_data);
 
+/*!
+ *  \brief JSON value callback prototype
+ *
+ *  \param[in] token Value matching the requested pattern. Its text
+ *             is only valid during the call. Objects and arrays
+ *             are reported by their start token.
+ *  \param[in] path Path of the value in the response
+ *  \param[in] user_data The user data passed from the callback
+ *             function
+ *  \return 1 to continue receiving values, 0 to stop the request
+ */
+typedef int (*artik_cloud_json_callback)(const artik_json_token *token,
+				const char *path, void *user_data);
+
+/*!
+ *  \brief Device listing callback prototype
+ *
+ *  Called for each device in order, then once with a NULL device
+ *  when the listing is complete or failed.
+ *
+ *  \param[in] result S_OK for a device or a complete listing, error
+ *             code of the failed request otherwise
+ *  \param[in] device JSON object describing the device, not NUL
+ *             terminated and only valid during the call. NULL for
+ *             the last call.
+ *  \param[in] len Length in bytes of the device object
+ *  \param[in] user_data The user data passed from the callback
+ *             function
+ *  \return 1 to continue receiving devices, 0 to stop the listing.
+ *          Ignored for the last call.
+ */
+typedef int (*artik_cloud_device_callback)(artik_error result,
+				const char *device, unsigned int len,
+				void *user_data);
+
+/*!
+ *  \brief Handle of a batching message sender
+ */
+typedef void *artik_cloud_batch_handle;
+
+/*!
+ *  \brief How the messages of a batch are sent to the Cloud
+ */
+typedef enum {
+	/*!
+	 *  \brief One request per batch, carrying a JSON array of
+	 *         the messages
+	 */
+	ARTIK_CLOUD_BATCH_BULK,
+	/*!
+	 *  \brief One request per message, all the requests of a
+	 *         batch being issued at once over pooled connections
+	 */
+	ARTIK_CLOUD_BATCH_BURST
+} artik_cloud_batch_mode;
+
+/*!
+ *  \brief Batch completion callback prototype
+ *
+ *  Called once messages leave the sender, either accepted by
+ *  the Cloud or given up after the last retry.
+ *
+ *  \param[in] result S_OK if the messages were accepted, error
+ *             code of the last attempt otherwise
+ *  \param[in] device_id ID of the source device of the messages
+ *  \param[in] num_messages Number of messages concerned
+ *  \param[in] user_data The user data passed in the batch
+ *             configuration
+ */
+typedef void (*artik_cloud_batch_callback)(artik_error result,
+				const char *device_id,
+				unsigned int num_messages, void *user_data);
+
+/*!
+ *  \brief Configuration of a batching message sender
+ *
+ *  Fields left to 0 take a default value.
+ */
+typedef struct {
+	/*!
+	 *  \brief Base URL of the Cloud REST API, e.g.
+	 *         "http://127.0.0.1:8080/v1.1" to target a local
+	 *         server. NULL for the Artik Cloud.
+	 */
+	const char *base_url;
+	/*!
+	 *  \brief Authorization token used when none is passed
+	 *         along with the message
+	 */
+	const char *access_token;
+	/*!
+	 *  \brief How the batches are sent
+	 */
+	artik_cloud_batch_mode mode;
+	/*!
+	 *  \brief Number of messages of a device triggering a flush
+	 *         (default 100)
+	 */
+	unsigned int max_messages;
+	/*!
+	 *  \brief Size in bytes of the messages of a device
+	 *         triggering a flush (default 64 KiB)
+	 */
+	unsigned int max_bytes;
+	/*!
+	 *  \brief Time in milliseconds after which a message is
+	 *         flushed (default 1000)
+	 */
+	unsigned int max_age_ms;
+	/*!
+	 *  \brief Maximum number of messages of a device waiting or
+	 *         being sent, 0 for unlimited
+	 */
+	unsigned int max_pending;
+	/*!
+	 *  \brief Number of retries of a failed batch (default 5)
+	 */
+	unsigned int max_retries;
+	/*!
+	 *  \brief Delay in milliseconds before the first retry,
+	 *         doubled on each attempt (default 500)
+	 */
+	unsigned int retry_min_ms;
+	/*!
+	 *  \brief Maximum delay in milliseconds between two
+	 *         attempts (default 30000)
+	 */
+	unsigned int retry_max_ms;
+	/*!
+	 *  \brief Function called when messages leave the sender,
+	 *         can be NULL
+	 */
+	artik_cloud_batch_callback callback;
+	/*!
+	 *  \brief Pointer to user data passed to the callback
+	 */
+	void *user_data;
+	/*!
+	 *  \brief SSL configuration to use when targeting https
+	 *         urls, must remain valid until the sender is
+	 *         destroyed. Can be NULL.
+	 */
+	artik_ssl_config *ssl;
+} artik_cloud_batch_config;
+
+/*!
+ *  \brief Statistics of a batching message sender
+ */
+typedef struct {
+	/*!
+	 *  \brief Number of messages accepted by the sender
+	 */
+	unsigned long queued;
+	/*!
+	 *  \brief Number of messages accepted by the Cloud
+	 */
+	unsigned long sent;
+	/*!
+	 *  \brief Number of messages given up after the last retry
+	 */
+	unsigned long failed;
+	/*!
+	 *  \brief Number of messages refused because too many were
+	 *         pending for their device
+	 */
+	unsigned long rejected;
+	/*!
+	 *  \brief Number of HTTP requests issued
+	 */
+	unsigned long requests;
+	/*!
+	 *  \brief Number of batches retried
+	 */
+	unsigned long retries;
+	/*!
+	 *  \brief Number of messages waiting or being sent
+	 */
+	unsigned int pending;
+} artik_cloud_batch_stats;
+
+/*!
+ *  \brief Handle of a Cloud session
+ */
+typedef void *artik_cloud_session_handle;
+
+/*!
+ *  \brief Configuration of a Cloud session
+ */
+typedef struct {
+	/*!
+	 *  \brief Base URL of the Cloud REST API, e.g.
+	 *         "http://127.0.0.1:8080/v1.1" to target a local
+	 *         server. NULL for the Artik Cloud.
+	 */
+	const char *base_url;
+	/*!
+	 *  \brief Authorization token sent along with the requests
+	 */
+	const char *access_token;
+	/*!
+	 *  \brief SSL configuration to use when targeting https
+	 *         urls, must remain valid until the session is
+	 *         destroyed. Can be NULL.
+	 */
+	artik_ssl_config *ssl;
+} artik_cloud_session_config;
+
+/*!
+ *  \brief Handle of a device listing
+ */
+typedef void *artik_cloud_device_iterator;
+
+/*!
+ *  \brief Configuration of a device listing
+ *
+ *  Fields left to 0 take a default value.
+ */
+typedef struct {
+	/*!
+	 *  \brief Number of devices requested per page (default 100)
+	 */
+	unsigned int page_size;
+	/*!
+	 *  \brief Number of pages fetched ahead of the one being
+	 *         delivered (default 1)
+	 */
+	unsigned int prefetch;
+	/*!
+	 *  \brief Include the properties of the devices
+	 */
+	bool include_properties;
+} artik_cloud_device_iterator_config;
+
 /*! \struct artik_cloud_module
  *
  *  \brief Cloud module operations
@@ -908,6 +1142,294 @@ typedef struct {
 	 *  \return S_OK on success, error code otherwise
 	 */
 	artik_error (*websocket_close_stream)(artik_websocket_handle handle);
+
+	/*!
+	 *  \brief Create a sender batching the messages of many devices
+	 *
+	 *  Messages are queued per device and flushed when their
+	 *  number, size or age reaches the configured limits. Failed
+	 *  batches are retried with an exponential backoff. Requests
+	 *  are asynchronous and require the loop to run.
+	 *
+	 *  \param[out] handle Handle of the created sender
+	 *  \param[in] config Configuration of the sender, copied by
+	 *             the function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*batch_create)(artik_cloud_batch_handle *handle,
+					const artik_cloud_batch_config *config);
+	/*!
+	 *  \brief Queue a message to send to the Cloud
+	 *
+	 *  \param[in] handle Handle of the sender
+	 *  \param[in] access_token Authorization token of the device,
+	 *             NULL to use the one of the configuration
+	 *  \param[in] device_id ID of the source device from which
+	 *             the message is sent
+	 *  \param[in] message Content of the message to send in a
+	 *             JSON formatted string
+	 *
+	 *  \return S_OK on success, E_BUSY if too many messages are
+	 *          pending for the device, error code otherwise
+	 */
+	artik_error (*batch_send_message)(artik_cloud_batch_handle handle,
+					const char *access_token,
+					const char *device_id,
+					const char *message);
+	/*!
+	 *  \brief Send the queued messages of all the devices now
+	 *
+	 *  \param[in] handle Handle of the sender
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*batch_flush)(artik_cloud_batch_handle handle);
+	/*!
+	 *  \brief Get the statistics of a sender
+	 *
+	 *  \param[in] handle Handle of the sender
+	 *  \param[out] stats Statistics filled up by the function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*batch_get_stats)(artik_cloud_batch_handle handle,
+					artik_cloud_batch_stats *stats);
+	/*!
+	 *  \brief Destroy a sender
+	 *
+	 *  Messages not sent yet are dropped and the callback is not
+	 *  called anymore. Requests already issued complete in the
+	 *  background.
+	 *
+	 *  \param[in] handle Handle of the sender
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*batch_destroy)(artik_cloud_batch_handle handle);
+	/*!
+	 *  \brief Create a session issuing requests on behalf of a
+	 *         user or device
+	 *
+	 *  The authorization header and the URL prefix are built
+	 *  once for all the requests of the session, which are
+	 *  performed over the pooled connections of the HTTP module.
+	 *
+	 *  \param[out] handle Handle of the created session
+	 *  \param[in] config Configuration of the session, copied by
+	 *             the function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_create)(artik_cloud_session_handle *handle,
+				const artik_cloud_session_config *config);
+	/*!
+	 *  \brief Replace the authorization token of a session
+	 *
+	 *  Must not be called while a synchronous request of the
+	 *  session is running in another thread.
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] access_token New authorization token
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_set_token)(artik_cloud_session_handle handle,
+					const char *access_token);
+	/*!
+	 *  \brief Perform a request on the Cloud API
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] method HTTP method of the request
+	 *  \param[in] path Path of the resource relative to the base
+	 *             URL, e.g. "users/self"
+	 *  \param[in] body JSON formatted body of the request, can be
+	 *             NULL
+	 *  \param[out] response Pointer to a string allocated and
+	 *              filled up by the function with the
+	 *              response JSON data returned by the Cloud. It
+	 *              should be freed by the calling
+	 *              function after use.
+	 *
+	 *  \return S_OK on success, E_HTTP_ERROR if the Cloud
+	 *          returned an error status, error code otherwise
+	 */
+	artik_error (*session_request)(artik_cloud_session_handle handle,
+					artik_http_method method,
+					const char *path,
+					const char *body,
+					char **response);
+	/*!
+	 *  \brief Perform a request on the Cloud API asynchronously
+	 *
+	 *  Any number of requests can be in flight at once, their
+	 *  callbacks are called from the loop as the responses come
+	 *  in.
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] method HTTP method of the request
+	 *  \param[in] path Path of the resource relative to the base
+	 *             URL, e.g. "users/self"
+	 *  \param[in] body JSON formatted body of the request, can be
+	 *             NULL
+	 *  \param[in] callback Function called upon receiving response
+	 *             returned by the server
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_request_async)(
+					artik_cloud_session_handle handle,
+					artik_http_method method,
+					const char *path,
+					const char *body,
+					artik_cloud_callback callback,
+					void *user_data);
+	/*!
+	 *  \brief Send a message to the Cloud within a session
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] device_id ID of the source device from which
+	 *             the message is sent
+	 *  \param[in] message Content of the message to send in a
+	 *             JSON formatted string
+	 *  \param[out] response Pointer to a string allocated and
+	 *              filled up by the function with the
+	 *              response JSON data returned by the Cloud. It
+	 *              should be freed by the calling
+	 *              function after use.
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_send_message)(artik_cloud_session_handle handle,
+					const char *device_id,
+					const char *message,
+					char **response);
+	/*!
+	 *  \brief Send a message to the Cloud within a session
+	 *         asynchronously
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] device_id ID of the source device from which
+	 *             the message is sent
+	 *  \param[in] message Content of the message to send in a
+	 *             JSON formatted string
+	 *  \param[in] callback Function called upon receiving response
+	 *             returned by the server
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_send_message_async)(
+					artik_cloud_session_handle handle,
+					const char *device_id,
+					const char *message,
+					artik_cloud_callback callback,
+					void *user_data);
+	/*!
+	 *  \brief Destroy a session
+	 *
+	 *  Requests in flight are not delivered anymore, their callback
+	 *  is called from the loop with E_INTERRUPTED and a NULL
+	 *  response once they complete.
+	 *
+	 *  \param[in] handle Handle of the session
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_destroy)(artik_cloud_session_handle handle);
+	/*!
+	 *  \brief Perform a GET request on the Cloud API, extracting
+	 *         values from the response as it is received
+	 *
+	 *  The response is tokenized chunk by chunk and never held in
+	 *  memory as a whole. Strings and numbers split between two
+	 *  chunks must fit in 512 bytes.
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] path Path of the resource relative to the base
+	 *             URL, e.g. "users/self"
+	 *  \param[in] pattern Pattern of the paths of the values to
+	 *             extract, e.g. "data.devices[*].id", see
+	 *             \ref artik_utils_module
+	 *  \param[in] callback Function called for each matching value
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback function
+	 *
+	 *  \return S_OK on success, E_HTTP_ERROR if the Cloud
+	 *          returned an error status, E_INVALID_VALUE if the
+	 *          response is not valid JSON, error code otherwise
+	 */
+	artik_error (*session_get_json)(artik_cloud_session_handle handle,
+					const char *path,
+					const char *pattern,
+					artik_cloud_json_callback callback,
+					void *user_data);
+	/*!
+	 *  \brief Perform a GET request on the Cloud API asynchronously,
+	 *         extracting values from the response as it is received
+	 *
+	 *  \param[in] handle Handle of the session
+	 *  \param[in] path Path of the resource relative to the base
+	 *             URL, e.g. "users/self"
+	 *  \param[in] pattern Pattern of the paths of the values to
+	 *             extract, e.g. "data.devices[*].id"
+	 *  \param[in] callback Function called from the loop for each
+	 *             matching value
+	 *  \param[in] done_callback Function called once the request
+	 *             completes, with a NULL response
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback functions
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*session_get_json_async)(
+					artik_cloud_session_handle handle,
+					const char *path,
+					const char *pattern,
+					artik_cloud_json_callback callback,
+					artik_cloud_callback done_callback,
+					void *user_data);
+	/*!
+	 *  \brief List the devices of a user one at a time
+	 *
+	 *  Pages of devices are requested through the session, the next
+	 *  ones being fetched while the current one is delivered. At
+	 *  most 1 + prefetch pages are held in memory whatever the
+	 *  number of devices. Devices are delivered from the loop.
+	 *
+	 *  \param[out] iterator Handle of the created listing
+	 *  \param[in] session Session issuing the requests, must
+	 *             outlive the listing
+	 *  \param[in] user_id ID of the user owning the devices
+	 *  \param[in] config Configuration of the listing, can be NULL
+	 *  \param[in] callback Function called for each device
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*device_iterator_create)(
+					artik_cloud_device_iterator *iterator,
+					artik_cloud_session_handle session,
+					const char *user_id,
+				const artik_cloud_device_iterator_config *config,
+					artik_cloud_device_callback callback,
+					void *user_data);
+	/*!
+	 *  \brief Destroy a device listing
+	 *
+	 *  The callback is not called anymore, pages being fetched are
+	 *  dropped when they come in. Can be called from the callback.
+	 *
+	 *  \param[in] iterator Handle of the listing
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*device_iterator_destroy)(
+					artik_cloud_device_iterator iterator);
 } artik_cloud_module;
 
 extern const artik_cloud_module cloud_module;
@@ -109,6 +109,117 @@ typedef int (*artik_http_stream_callback)(char *data,
 typedef void (*artik_http_response_callback)(artik_error result, int status,
 				char *response, void *user_data);
 
+/*!
+ *  \brief HTTP request methods
+ */
+typedef enum {
+	ARTIK_HTTP_GET,
+	ARTIK_HTTP_POST,
+	ARTIK_HTTP_PUT,
+	ARTIK_HTTP_DELETE
+} artik_http_method;
+
+/*!
+ *  \brief HTTP response buffer
+ *
+ *  Structure receiving the body returned by the server
+ *  along with its length, so that binary bodies can be
+ *  received.
+ */
+typedef struct {
+	/*!
+	 *  \brief Buffer holding the response body
+	 *
+	 *  If set by the caller along with \ref size, the body is
+	 *  written directly in this buffer. Otherwise a buffer is
+	 *  allocated by the function and should be freed by the
+	 *  calling function after use.
+	 */
+	char *data;
+	/*!
+	 *  \brief Length in bytes of the response body
+	 */
+	unsigned int len;
+	/*!
+	 *  \brief Size in bytes of the buffer provided by the caller,
+	 *         0 to let the function allocate it
+	 */
+	unsigned int size;
+} artik_http_response;
+
+/*!
+ *  \brief Response with length callback prototype
+ *
+ *  \param[in] result Error returned by
+ *             the http process, S_OK on success, error code otherwise
+ *  \param[in] status Status filled up by
+ *	       the function with the server's response status
+ *  \param[in] response Buffer allocated and filled up by the function
+ *             with the response body returned by the server. It
+ *             should be freed by the callback after use.
+ *  \param[in] len Length in bytes of the response body
+ *  \param[in] user_data The user data passed from the callback
+ *             function
+ */
+typedef void (*artik_http_response_len_callback)(artik_error result,
+				int status, char *response, unsigned int len,
+				void *user_data);
+
+/*!
+ *  \brief HTTP connection pool configuration
+ *
+ *  Requests are performed on handles pooled per scheme,
+ *  host, port and SSL configuration, so that DNS lookups,
+ *  connections and TLS sessions are reused across requests
+ *  targeting the same server.
+ */
+typedef struct {
+	/*!
+	 *  \brief Maximum number of idle handles kept in each pool
+	 */
+	unsigned int max_idle_handles;
+	/*!
+	 *  \brief Maximum number of pools, least recently used idle
+	 *         pools are evicted beyond this limit
+	 */
+	unsigned int max_pools;
+	/*!
+	 *  \brief Time in milliseconds after which an unused handle
+	 *         or pool is evicted
+	 */
+	unsigned int idle_timeout_ms;
+} artik_http_pool_config;
+
+/*!
+ *  \brief HTTP connection pool statistics
+ */
+typedef struct {
+	/*!
+	 *  \brief Number of requests served by a pooled handle
+	 */
+	unsigned long hits;
+	/*!
+	 *  \brief Number of requests that required a new handle
+	 */
+	unsigned long misses;
+	/*!
+	 *  \brief Number of handles evicted from the pools
+	 */
+	unsigned long evictions;
+	/*!
+	 *  \brief Current number of pools
+	 */
+	unsigned int pools;
+	/*!
+	 *  \brief Current number of idle handles across all pools
+	 */
+	unsigned int idle_handles;
+	/*!
+	 *  \brief Current number of handles used by pending requests
+	 */
+	unsigned int busy_handles;
+} artik_http_pool_stats;
+
 /*! \struct artik_http_module
  *
  *  \brief HTTP module operations
@@ -348,7 +459,79 @@ typedef struct {
 				artik_http_response_callback callback,
 				void *user_data,
 				artik_ssl_config *ssl);
-
+	/*!
+	 *  \brief Change the configuration of the connection pools
+	 *
+	 *  \param[in] config New pool configuration. Limits are
+	 *             applied on the next pool operation.
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*set_pool_config)(const artik_http_pool_config *config);
+	/*!
+	 *  \brief Get usage statistics of the connection pools
+	 *
+	 *  \param[out] stats Statistics filled up by the function
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*get_pool_stats)(artik_http_pool_stats *stats);
+	/*!
+	 *  \brief Perform a request with binary safe body and response
+	 *
+	 *  The response buffer grows geometrically and is presized from
+	 *  the Content-Length returned by the server, up to 256KB, so a
+	 *  bogus length cannot reserve more memory than what is actually
+	 *  received. When the caller
+	 *  provides its own buffer, the body is received in place and
+	 *  E_OVERFLOW is returned if it does not fit.
+	 *
+	 *  \param[in] method HTTP method of the request
+	 *  \param[in] url URL to request
+	 *  \param[in] headers Pointer to the structure object
+	 *             containing the HTTP headers to send
+	 *  \param[in] body Body data to send along the request, can be NULL
+	 *  \param[in] body_len Length in bytes of the body data
+	 *  \param[in,out] response Buffer receiving the response body
+	 *  \param[out] status Pointer to the status filled up by
+	 *              the function with the server's
+	 *              response status
+	 *  \param[in] ssl SSL configuration to use when targeting
+	 *             https urls. Can be NULL.
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*request)(artik_http_method method, const char *url,
+				artik_http_headers *headers,
+				const char *body, unsigned int body_len,
+				artik_http_response *response, int *status,
+				artik_ssl_config *ssl);
+	/*!
+	 *  \brief Perform a request with binary safe body and response
+	 *         asynchronously
+	 *
+	 *  \param[in] method HTTP method of the request
+	 *  \param[in] url URL to request
+	 *  \param[in] headers Pointer to the structure object
+	 *             containing the HTTP headers to send
+	 *  \param[in] body Body data to send along the request, can be NULL
+	 *  \param[in] body_len Length in bytes of the body data
+	 *  \param[in] callback Function called upon receiving response
+	 *             returned by the server
+	 *  \param[in] user_data Pointer to user data that will be
+	 *             passed as a parameter to the callback function
+	 *  \param[in] ssl SSL configuration to use when targeting
+	 *             https urls. Can be NULL.
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error (*request_async)(artik_http_method method,
+				const char *url,
+				artik_http_headers *headers,
+				const char *body, unsigned int body_len,
+				artik_http_response_len_callback callback,
+				void *user_data,
+				artik_ssl_config *ssl);
 } artik_http_module;
 
 extern const artik_http_module http_module;
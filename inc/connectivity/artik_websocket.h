@@ -94,8 +94,31 @@ typedef struct {
 	 *  significantly smaller than ping_period.
 	 */
 	unsigned int pong_timeout;
+	/*!
+	 *  \brief send_high_watermark is the maximum number of bytes of
+	 *  messages waiting to be sent. A write that would go over it fails
+	 *  with E_BUSY, and can be retried once the queue has drained. A
+	 *  message is always accepted on an empty queue, even if larger. If
+	 *  this value is set to 0, the queue is not limited.
+	 */
+	unsigned int send_high_watermark;
 } artik_websocket_config;
 
+/*!
+ *  \brief Websocket send queue statistics
+ *
+ *  Counters of the messages written to a websocket and
+ *  not sent yet
+ */
+typedef struct {
+	unsigned int pending_messages; /**< messages waiting to be sent */
+	unsigned int pending_bytes; /**< bytes waiting to be sent */
+	unsigned int peak_messages; /**< highest number of pending messages */
+	unsigned int peak_bytes; /**< highest number of pending bytes */
+	unsigned int sent_messages; /**< messages handed to the socket */
+	unsigned int rejected_messages; /**< writes failed with E_BUSY */
+} artik_websocket_queue_stats;
+
 /*!
  *  \brief Websocket callback type
  *
@@ -104,6 +127,36 @@ typedef struct {
 typedef void (*artik_websocket_callback)(void *user_data,
 					void *result);
 
+/*!
+ *  \brief Websocket received message
+ *
+ *  Complete message, reassembled from its fragments
+ */
+typedef struct {
+	/*!
+	 *  \brief Content of the message, followed by a NUL byte. It belongs
+	 *  to the callback and must be released with free().
+	 */
+	unsigned char *data;
+	/*!
+	 *  \brief Length in bytes of the message, without the NUL byte
+	 */
+	unsigned int len;
+	/*!
+	 *  \brief True for binary messages, false for text messages
+	 */
+	bool binary;
+} artik_websocket_message;
+
+/*!
+ *  \brief Websocket message callback type
+ *
+ *  Callback prototype for the functions receiving websocket messages
+ *  with their length and type
+ */
+typedef void (*artik_websocket_message_callback)(void *user_data,
+					artik_websocket_message *message);
+
 /*! \struct artik_websocket_module
  *
  *  \brief Websocket module operations
@@ -141,11 +194,14 @@ typedef struct {
 	/*!
 	 *  \brief Send a string through stream
 	 *
+	 *  The message is queued and sent when the socket is writable.
+	 *
 	 *  \param[in] handle Handle value obtained from
 	 *             websocket_request function
 	 *  \param[in] message String that you want to send
 	 *
-	 *  \return S_OK on success, error code otherwise
+	 *  \return S_OK on success, E_BUSY if the send queue is over its
+	 *          high watermark, error code otherwise
 	 */
 	artik_error(*websocket_write_stream) (
 					artik_websocket_handle
@@ -174,6 +230,10 @@ typedef struct {
 	/*!
 	 *  \brief Set a callback function handling data received
 	 *
+	 *  The callback gets each message as a NUL terminated string,
+	 *  which must be released with free(). It replaces the callback
+	 *  set by \ref websocket_set_message_callback.
+	 *
 	 *  \param[in] handle Handle value obtained from websocket_request
 	 *             function
 	 *  \param[in] callback \ref artik_websocket_callback type function
@@ -207,6 +267,61 @@ typedef struct {
 	 */
 	artik_error(*websocket_release) (artik_websocket_handle
 						  handle);
+	/*!
+	 *  \brief Send binary data through stream
+	 *
+	 *  The data is copied and queued, it is sent as a single binary
+	 *  message when the socket is writable.
+	 *
+	 *  \param[in] handle Handle value obtained from
+	 *             websocket_request function
+	 *  \param[in] data Data that you want to send
+	 *  \param[in] len Length in bytes of the data
+	 *
+	 *  \return S_OK on success, E_BUSY if the send queue is over its
+	 *          high watermark, error code otherwise
+	 */
+	artik_error(*websocket_write_binary_stream) (
+					artik_websocket_handle handle,
+					const unsigned char *data,
+					unsigned int len
+					);
+	/*!
+	 *  \brief Get the statistics of the send queue
+	 *
+	 *  \param[in] handle Handle value obtained from
+	 *             websocket_request function
+	 *  \param[out] stats Filled with the current counters
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error(*websocket_get_queue_stats) (
+					artik_websocket_handle handle,
+					artik_websocket_queue_stats *stats
+					);
+	/*!
+	 *  \brief Set a callback function handling messages received
+	 *
+	 *  Unlike \ref websocket_set_receive_callback, the callback gets
+	 *  the length and the type of the messages, so it can handle binary
+	 *  content. It replaces the callback set by
+	 *  \ref websocket_set_receive_callback.
+	 *
+	 *  \param[in] handle Handle value obtained from websocket_request
+	 *             function
+	 *  \param[in] callback \ref artik_websocket_message_callback type
+	 *             function pointer of a callback to be called upon
+	 *             message reception
+	 *  \param[in] user_data Pointer of a data that you want to pass
+	 *             into callback
+	 *
+	 *  \return S_OK on success, error code otherwise
+	 */
+	artik_error(*websocket_set_message_callback) (
+					artik_websocket_handle handle,
+					artik_websocket_message_callback callback,
+					void *user_data
+					);
 } artik_websocket_module;
 
 extern const artik_websocket_module websocket_module;
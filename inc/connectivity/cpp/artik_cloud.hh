@@ -39,6 +39,9 @@ class Cloud {
   artik_cloud_module *m_module;
   char *m_token;
   artik_websocket_handle m_ws_handle;
+  artik_cloud_batch_handle m_batch_handle;
+  artik_cloud_session_handle m_session_handle;
+  artik_cloud_device_iterator m_device_iterator;
 
  public:
   explicit Cloud(const char* token);
@@ -136,6 +139,31 @@ class Cloud {
   artik_error websocket_set_receive_callback(artik_websocket_callback callback,
       void *user_data);
   artik_error websocket_close_stream();
+  artik_error batch_create(const artik_cloud_batch_config *config);
+  artik_error batch_send_message(const char *device_id, const char *message);
+  artik_error batch_flush();
+  artik_error batch_get_stats(artik_cloud_batch_stats *stats);
+  artik_error batch_destroy();
+  artik_error session_create(const char *base_url, artik_ssl_config *ssl);
+  artik_error session_request(artik_http_method method, const char *path,
+      const char *body, char **response);
+  artik_error session_request_async(artik_http_method method,
+      const char *path, const char *body, artik_cloud_callback callback,
+      void *user_data);
+  artik_error session_send_message(const char *device_id,
+      const char *message, char **response);
+  artik_error session_send_message_async(const char *device_id,
+      const char *message, artik_cloud_callback callback, void *user_data);
+  artik_error session_destroy();
+  artik_error session_get_json(const char *path, const char *pattern,
+      artik_cloud_json_callback callback, void *user_data);
+  artik_error session_get_json_async(const char *path, const char *pattern,
+      artik_cloud_json_callback callback, artik_cloud_callback done_callback,
+      void *user_data);
+  artik_error device_iterator_create(const char *user_id,
+      const artik_cloud_device_iterator_config *config,
+      artik_cloud_device_callback callback, void *user_data);
+  artik_error device_iterator_destroy();
 };
 
 }  // namespace artik
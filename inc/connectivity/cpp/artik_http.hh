@@ -69,6 +69,15 @@ class Http {
   artik_error del_async(const char *url, artik_http_headers *headers,
       artik_http_response_callback callback, void *user_data,
       artik_ssl_config *ssl);
+  artik_error set_pool_config(const artik_http_pool_config *config);
+  artik_error get_pool_stats(artik_http_pool_stats *stats);
+  artik_error request(artik_http_method method, const char *url,
+      artik_http_headers *headers, const char *body, unsigned int body_len,
+      artik_http_response *response, int *status, artik_ssl_config *ssl);
+  artik_error request_async(artik_http_method method, const char *url,
+      artik_http_headers *headers, const char *body, unsigned int body_len,
+      artik_http_response_len_callback callback, void *user_data,
+      artik_ssl_config *ssl);
 };
 
 }  // namespace artik
@@ -45,7 +45,8 @@ class Websocket {
 
  public:
   Websocket(const char* uri, unsigned int ping_period,
-    unsigned int pong_timeout, artik_ssl_config *ssl_config);
+    unsigned int pong_timeout, artik_ssl_config *ssl_config,
+    unsigned int send_high_watermark = 0);
   ~Websocket();
 
   artik_error request();
@@ -53,10 +54,14 @@ class Websocket {
   artik_error set_connection_callback(artik_websocket_callback callback,
       void *user_data);
   artik_error write_stream(char* message);
+  artik_error write_binary_stream(const unsigned char* data, unsigned int len);
   artik_error set_receive_callback(artik_websocket_callback callback,
       void *user_data);
+  artik_error set_message_callback(artik_websocket_message_callback callback,
+      void *user_data);
   artik_error close_stream();
   artik_error release();
+  artik_error get_queue_stats(artik_websocket_queue_stats *stats);
 
  private:
   // Disable copy constructor and assignement operator
@@ -65,6 +65,117 @@ typedef struct {
 	bool retain; /**< message retain flag */
 } artik_mqtt_msg;
 
+/*!
+ *  \brief MQTT client statistics
+ *
+ *  Structure containing the counters collected
+ *  while servicing the socket of a client
+ */
+typedef struct {
+	unsigned int wakeups; /**< read wakeups of the client socket */
+	unsigned int packets_read; /**< packets read from the broker */
+	unsigned int max_packets_per_wakeup; /**< largest burst in one wakeup */
+	unsigned int write_wakeups; /**< wakeups to flush pending output */
+} artik_mqtt_stats;
+
+/*!
+ *  \brief Policy applied when the offline queue is full
+ */
+typedef enum {
+	/*!
+	 * Discard the oldest queued messages to make room
+	 */
+	ARTIK_MQTT_DROP_OLDEST = 0,
+	/*!
+	 * Discard the message being published
+	 */
+	ARTIK_MQTT_DROP_NEWEST,
+	/*!
+	 * Discard the oldest queued messages, unless the message being
+	 * published is QoS 0 and the oldest one is QoS 1 or 2, in which
+	 * case the new message is discarded. Only the oldest message is
+	 * considered, QoS 0 messages queued after a QoS 1 or 2 one are
+	 * not evicted first.
+	 */
+	ARTIK_MQTT_DROP_OLDEST_UNLESS_QOS0
+} artik_mqtt_drop_policy;
+
+/*!
+ *  \brief MQTT offline queue configuration
+ *
+ *  Structure containing the elements for configuring the queue
+ *  holding the messages published while the client is not connected
+ */
+typedef struct {
+	const char *path; /**< file backing the queue, created if needed */
+	unsigned int max_bytes; /**< size of the storage area in bytes */
+	unsigned int max_messages; /**< message count limit, 0 for none */
+	artik_mqtt_drop_policy drop_policy; /**< policy when full */
+	unsigned int replay_rate; /**< messages/s on reconnect, 0 for no limit */
+} artik_mqtt_queue_config;
+
+/*!
+ *  \brief MQTT offline queue statistics
+ */
+typedef struct {
+	unsigned int messages; /**< messages currently queued */
+	unsigned int bytes; /**< bytes currently used in the storage area */
+	unsigned int capacity; /**< size of the storage area in bytes */
+	unsigned int queued; /**< messages queued since enabled */
+	unsigned int replayed; /**< messages replayed since enabled */
+	unsigned int dropped; /**< messages dropped by the policy */
+} artik_mqtt_queue_stats;
+
+/*!
+ *  \brief How the messages accumulated by a batch are sent
+ */
+typedef enum {
+	/*!
+	 * One PUBLISH per message, all sent back to back on flush
+	 */
+	ARTIK_MQTT_BATCH_PIPELINE = 0,
+	/*!
+	 * A single PUBLISH whose payload is the concatenation of the
+	 * messages, each one prefixed by its length as a 32-bit big
+	 * endian integer
+	 */
+	ARTIK_MQTT_BATCH_PACKED,
+	/*!
+	 * A single PUBLISH carrying the latest message, the previous
+	 * ones are discarded
+	 */
+	ARTIK_MQTT_BATCH_LATEST
+} artik_mqtt_batch_mode;
+
+/*!
+ *  \brief MQTT publish batch configuration
+ *
+ *  A batch is flushed when the first limit is reached.
+ *  At least one of them must be set.
+ */
+typedef struct {
+	artik_mqtt_batch_mode mode; /**< how the batch is sent */
+	unsigned int window; /**< max time in ms a message is held, 0 for none */
+	unsigned int max_messages; /**< message count limit, 0 for none */
+	unsigned int max_bytes; /**< payload bytes limit, 0 for none */
+	int qos; /**< qos of the published messages */
+	bool retain; /**< retain flag of the published messages */
+} artik_mqtt_batch_config;
+
+/*!
+ *  \brief MQTT publish batch statistics
+ *
+ *  Byte counts include the PUBLISH packet overhead, bytes_in is what
+ *  would have been sent without batching.
+ */
+typedef struct {
+	unsigned int messages_in; /**< messages added to the batch */
+	unsigned int messages_out; /**< PUBLISH packets sent */
+	unsigned int bytes_in; /**< bytes of the messages added */
+	unsigned int bytes_out; /**< bytes of the packets sent */
+	unsigned int bytes_saved; /**< bytes_in - bytes_out */
+} artik_mqtt_batch_stats;
+
 /*!
  *  \brief MQTT handle type
  *
@@ -72,6 +183,20 @@ typedef struct {
  */
 typedef void *artik_mqtt_handle;
 
+/*!
+ *  \brief MQTT subscription handle type
+ *
+ *  Handle type identifying a callback bound to a topic filter
+ */
+typedef void *artik_mqtt_subscription;
+
+/*!
+ *  \brief MQTT publish batch handle type
+ *
+ *  Handle type used to accumulate messages published on a topic
+ */
+typedef void *artik_mqtt_batch;
+
 /*!
  *  \brief MQTT configuration definition
  *
@@ -309,6 +434,121 @@ typedef struct {
 	artik_error(*publish)(artik_mqtt_handle client, int qos,
 				bool retain, const char *msg_topic,
 				int payload_len, const char *msg_content);
+	/**
+	 * Get the socket servicing statistics of a client.
+	 * The average number of packets handled per wakeup is
+	 * packets_read / wakeups.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[out] stats Filled with the current counters
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*get_stats)(artik_mqtt_handle client,
+				artik_mqtt_stats *stats);
+	/**
+	 * Queue the messages published while the client is not connected.
+	 * The queue is stored in a memory mapped file so that its content
+	 * survives a restart of the application: messages left by a
+	 * previous run are sent on the next connection. Once connected,
+	 * the queue is replayed in order at the configured rate, and
+	 * new messages are queued behind it until it is empty.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[in] config Configuration of the queue
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*enable_offline_queue)(artik_mqtt_handle client,
+				const artik_mqtt_queue_config *config);
+	/**
+	 * Stop queuing messages. Messages still queued are kept in the
+	 * file and replayed when the queue is enabled again.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*disable_offline_queue)(artik_mqtt_handle client);
+	/**
+	 * Get the depth and the counters of the offline queue.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[out] stats Filled with the current counters
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*get_offline_queue_stats)(artik_mqtt_handle client,
+				artik_mqtt_queue_stats *stats);
+	/**
+	 * Subscribe to a topic filter and bind a callback to it.
+	 * The filter may contain the '+' and '#' wildcards. Incoming
+	 * messages are matched against all the filters in a time
+	 * proportional to the number of levels of their topic, and
+	 * passed to every matching callback. The message passed to the
+	 * callback is only valid during the call. The callback set with
+	 * <set_message> keeps receiving all the messages.
+	 * Several callbacks can be bound to the same filter, the broker
+	 * subscription is only made once.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[in] qos the requested Quality of Service for
+	 *            this subscription.
+	 * \param[in] filter the subscription pattern.
+	 * \param[in] cb the callback receiving the matching messages.
+	 * \param[in] user_data the container provided by the user.
+	 * \param[out] subscription Handle to pass to <remove_subscription>
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*add_subscription)(artik_mqtt_handle client, int qos,
+				const char *filter, message_callback cb,
+				void *user_data,
+				artik_mqtt_subscription *subscription);
+	/**
+	 * Remove a callback bound by <add_subscription>. The broker
+	 * subscription is removed along with the last callback of the
+	 * filter. This can be called from a message callback.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[in] subscription Handle returned by <add_subscription>
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*remove_subscription)(artik_mqtt_handle client,
+				artik_mqtt_subscription subscription);
+	/**
+	 * Create a batch accumulating the messages published on a topic.
+	 * Messages are held until the window expires or a size limit is
+	 * reached, then sent according to the batch mode. When the
+	 * offline queue is enabled, flushed messages go through it.
+	 * \param[in] client Pointer of an artik mqtt handle
+	 * \param[in] topic the topic the messages are published on.
+	 * \param[in] config Configuration of the batch
+	 * \param[out] batch Handle of the new batch
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*create_batch)(artik_mqtt_handle client,
+				const char *topic,
+				const artik_mqtt_batch_config *config,
+				artik_mqtt_batch *batch);
+	/**
+	 * Add a message to a batch.
+	 * \param[in] batch Handle returned by <create_batch>
+	 * \param[in] payload_len the size of the payload (bytes).
+	 * \param[in] payload The message content, copied by the batch.
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*batch_publish)(artik_mqtt_batch batch, int payload_len,
+				const char *payload);
+	/**
+	 * Send the messages held by a batch right away.
+	 * \param[in] batch Handle returned by <create_batch>
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*flush_batch)(artik_mqtt_batch batch);
+	/**
+	 * Flush and release a batch.
+	 * \param[in] batch Handle returned by <create_batch>
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*destroy_batch)(artik_mqtt_batch batch);
+	/**
+	 * Get the counters of a batch.
+	 * \param[in] batch Handle returned by <create_batch>
+	 * \param[out] stats Filled with the current counters
+	 * \return S_OK on success, otherwise a negative error value.
+	 */
+	artik_error(*get_batch_stats)(artik_mqtt_batch batch,
+				artik_mqtt_batch_stats *stats);
 } artik_mqtt_module;
 
 extern const artik_mqtt_module mqtt_module;
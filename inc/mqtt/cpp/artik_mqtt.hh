@@ -68,6 +68,21 @@ class Mqtt {
   artik_error unsubscribe(const char *msgtopic);
   artik_error publish(int qos, bool retain, const char *msg_topic,
       int payload_len, const char *msg_content);
+  artik_error get_stats(artik_mqtt_stats *stats);
+  artik_error enable_offline_queue(artik_mqtt_queue_config const &config);
+  artik_error disable_offline_queue(void);
+  artik_error get_offline_queue_stats(artik_mqtt_queue_stats *stats);
+  artik_error add_subscription(int qos, const char *filter,
+      message_callback cb, void *data, artik_mqtt_subscription *subscription);
+  artik_error remove_subscription(artik_mqtt_subscription subscription);
+  artik_error create_batch(const char *topic,
+      artik_mqtt_batch_config const &config, artik_mqtt_batch *batch);
+  artik_error batch_publish(artik_mqtt_batch batch, int payload_len,
+      const char *payload);
+  artik_error flush_batch(artik_mqtt_batch batch);
+  artik_error destroy_batch(artik_mqtt_batch batch);
+  artik_error get_batch_stats(artik_mqtt_batch batch,
+      artik_mqtt_batch_stats *stats);
 };
 
 }  // namespace artik
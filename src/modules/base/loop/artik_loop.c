@@ -20,6 +20,12 @@
 #include "artik_loop.h"
 #include "os_loop.h"
 
+/*
+ * Let the loop statistics know which module registers a source, the
+ * return address of the API call tells which library the caller lives in.
+ */
+#define LOOP_SET_CALLER() os_loop_set_caller(__builtin_return_address(0))
+
 static void		loop_run(void);
 static void		loop_quit(void);
 static artik_error	add_timeout_callback(int *timeout_id, unsigned int msec,
@@ -40,6 +46,27 @@ static artik_error	remove_signal_watch(int signal_id);
 static artik_error	add_idle_callback(int *idle_id, idle_callback func,
 							void *user_data);
 static artik_error	remove_idle_callback(int idle_id);
+static artik_error	start_workers(unsigned int num_workers);
+static artik_error	stop_workers(void);
+static artik_error	add_timeout_callback_on(int affinity, int *timeout_id,
+					unsigned int msec,
+					timeout_callback func,
+					void *user_data);
+static artik_error	add_periodic_callback_on(int affinity,
+					int *periodic_id, unsigned int msec,
+					periodic_callback func,
+					void *user_data);
+static artik_error	add_fd_watch_on(int affinity, int fd,
+					enum watch_io io, watch_callback func,
+					void *user_data, int *watch_id);
+static artik_error	add_idle_callback_on(int affinity, int *idle_id,
+					idle_callback func, void *user_data);
+static artik_error	post_callback(int affinity, timeout_callback func,
+					void *user_data);
+static artik_error	set_timer_slack(unsigned int msec);
+static artik_error	enable_stats(bool enable, int dump_signum);
+static artik_error	get_stats(artik_loop_stats *stats);
+static artik_error	set_stats_tag(const char *tag);
 
 EXPORT_API const artik_loop_module loop_module = {
 	loop_run,
@@ -53,7 +80,18 @@ EXPORT_API const artik_loop_module loop_module = {
 	add_signal_watch,
 	remove_signal_watch,
 	add_idle_callback,
-	remove_idle_callback
+	remove_idle_callback,
+	start_workers,
+	stop_workers,
+	add_timeout_callback_on,
+	add_periodic_callback_on,
+	add_fd_watch_on,
+	add_idle_callback_on,
+	post_callback,
+	set_timer_slack,
+	enable_stats,
+	get_stats,
+	set_stats_tag
 };
 
 void loop_run(void)
@@ -69,6 +107,7 @@ void loop_quit(void)
 artik_error add_timeout_callback(int *timeout_id, unsigned int msec,
 				 timeout_callback func, void *user_data)
 {
+	LOOP_SET_CALLER();
 	return os_add_timeout_callback(timeout_id, msec, func, user_data);
 }
 
@@ -79,6 +118,7 @@ artik_error remove_timeout_callback(int timeout_id)
 artik_error add_periodic_callback(int *periodic_id, unsigned int msec,
 		periodic_callback func, void *user_data)
 {
+	LOOP_SET_CALLER();
 	return os_add_periodic_callback(periodic_id, msec, func, user_data);
 }
 artik_error remove_periodic_callback(int periodic_id)
@@ -89,6 +129,7 @@ artik_error remove_periodic_callback(int periodic_id)
 artik_error add_fd_watch(int fd, enum watch_io io, watch_callback func,
 						void *user_data, int *watch_id)
 {
+	LOOP_SET_CALLER();
 	return os_add_fd_watch(fd, io, func, user_data, watch_id);
 }
 
@@ -110,6 +151,7 @@ artik_error remove_signal_watch(int signal_id)
 
 artik_error add_idle_callback(int *idle_id, idle_callback func, void *user_data)
 {
+	LOOP_SET_CALLER();
 	return os_add_idle_callback(idle_id, func, user_data);
 }
 
@@ -117,3 +159,70 @@ artik_error remove_idle_callback(int idle_id)
 {
 	return os_remove_idle_callback(idle_id);
 }
+
+artik_error start_workers(unsigned int num_workers)
+{
+	return os_start_workers(num_workers);
+}
+
+artik_error stop_workers(void)
+{
+	return os_stop_workers();
+}
+
+artik_error add_timeout_callback_on(int affinity, int *timeout_id,
+		unsigned int msec, timeout_callback func, void *user_data)
+{
+	LOOP_SET_CALLER();
+	return os_add_timeout_callback_on(affinity, timeout_id, msec, func,
+			user_data);
+}
+
+artik_error add_periodic_callback_on(int affinity, int *periodic_id,
+		unsigned int msec, periodic_callback func, void *user_data)
+{
+	LOOP_SET_CALLER();
+	return os_add_periodic_callback_on(affinity, periodic_id, msec, func,
+			user_data);
+}
+
+artik_error add_fd_watch_on(int affinity, int fd, enum watch_io io,
+		watch_callback func, void *user_data, int *watch_id)
+{
+	LOOP_SET_CALLER();
+	return os_add_fd_watch_on(affinity, fd, io, func, user_data, watch_id);
+}
+
+artik_error add_idle_callback_on(int affinity, int *idle_id,
+		idle_callback func, void *user_data)
+{
+	LOOP_SET_CALLER();
+	return os_add_idle_callback_on(affinity, idle_id, func, user_data);
+}
+
+artik_error post_callback(int affinity, timeout_callback func,
+		void *user_data)
+{
+	LOOP_SET_CALLER();
+	return os_post_callback(affinity, func, user_data);
+}
+
+artik_error set_timer_slack(unsigned int msec)
+{
+	return os_set_timer_slack(msec);
+}
+
+artik_error enable_stats(bool enable, int dump_signum)
+{
+	return os_enable_stats(enable, dump_signum);
+}
+
+artik_error get_stats(artik_loop_stats *stats)
+{
+	return os_get_stats(stats);
+}
+
+artik_error set_stats_tag(const char *tag)
+{
+	return os_set_stats_tag(tag);
+}
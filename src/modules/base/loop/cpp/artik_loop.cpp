@@ -94,3 +94,58 @@ artik_error artik::Loop::add_idle_callback(int *idle_id, idle_callback func,
 artik_error artik::Loop::remove_idle_callback(int idle_id) {
   return this->m_module->remove_idle_callback(idle_id);
 }
+
+artik_error artik::Loop::start_workers(unsigned int num_workers) {
+  return this->m_module->start_workers(num_workers);
+}
+
+artik_error artik::Loop::stop_workers(void) {
+  return this->m_module->stop_workers();
+}
+
+artik_error artik::Loop::add_timeout_callback_on(int affinity,
+    int *timeout_id, unsigned int msec, timeout_callback func,
+    void *user_data) {
+  return this->m_module->add_timeout_callback_on(affinity, timeout_id, msec,
+      func, user_data);
+}
+
+artik_error artik::Loop::add_periodic_callback_on(int affinity,
+    int *periodic_id, unsigned int msec, periodic_callback func,
+    void *user_data) {
+  return this->m_module->add_periodic_callback_on(affinity, periodic_id, msec,
+      func, user_data);
+}
+
+artik_error artik::Loop::add_fd_watch_on(int affinity, int fd,
+    enum watch_io io, watch_callback func, void *user_data, int *watch_id) {
+  return this->m_module->add_fd_watch_on(affinity, fd, io, func, user_data,
+      watch_id);
+}
+
+artik_error artik::Loop::add_idle_callback_on(int affinity, int *idle_id,
+    idle_callback func, void *user_data) {
+  return this->m_module->add_idle_callback_on(affinity, idle_id, func,
+      user_data);
+}
+
+artik_error artik::Loop::post_callback(int affinity, timeout_callback func,
+    void *user_data) {
+  return this->m_module->post_callback(affinity, func, user_data);
+}
+
+artik_error artik::Loop::set_timer_slack(unsigned int msec) {
+  return this->m_module->set_timer_slack(msec);
+}
+
+artik_error artik::Loop::enable_stats(bool enable, int dump_signum) {
+  return this->m_module->enable_stats(enable, dump_signum);
+}
+
+artik_error artik::Loop::get_stats(artik_loop_stats *stats) {
+  return this->m_module->get_stats(stats);
+}
+
+artik_error artik::Loop::set_stats_tag(const char *tag) {
+  return this->m_module->set_stats_tag(tag);
+}
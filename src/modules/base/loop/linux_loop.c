@@ -16,9 +16,12 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <link.h>
 #include <glib.h>
 #include <glib-unix.h>
 
@@ -27,155 +30,1133 @@
 
 #include "os_loop.h"
 
-struct _timeout {
-	timeout_callback func;
-	void *user_data;
-	guint id;
+/*
+ * Sources attached to a worker context are registered under an ID
+ * allocated by the loop module, starting at LOOP_WORKER_ID_BASE. Sources
+ * of the default context use the GLib source ID.
+ */
+#define LOOP_WORKER_ID_BASE	0x40000000
+#define LOOP_POST_SLAB_SIZE	64
+
+/*
+ * Timeouts and periodics are kept in a hierarchical timer wheel per
+ * context and use IDs starting at LOOP_TIMER_ID_BASE. The wheel ticks
+ * every millisecond, each level covers WHEEL_SLOTS times the range of
+ * the previous one, which makes 2^24 ms (about 4.6 hours) in total.
+ * Timers further in the future wait in the last level and are cascaded
+ * again until they fit.
+ */
+#define LOOP_TIMER_ID_BASE	0x20000000
+#define LOOP_TIMER_SLAB_SIZE	64
+#define WHEEL_BITS		6
+#define WHEEL_SLOTS		(1 << WHEEL_BITS)
+#define WHEEL_MASK		(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS		4
+#define WHEEL_RANGE		((gint64)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+#define LOOP_STATS_NO_TAG	0xff
+#define LOOP_STATS_MAX_OBJECTS	64
+
+enum source_type {
+	SOURCE_IDLE,
+	SOURCE_WATCH
 };
 
-struct _periodic {
-	periodic_callback func;
+/*
+ * Idles and fd watches are instances of this GSource subclass, so that
+ * registering a callback costs a single allocation. fd watches poll the
+ * file descriptor directly without a GIOChannel.
+ */
+struct _source {
+	GSource base;
+	enum source_type type;
+	union {
+		idle_callback idle;
+		watch_callback watch;
+	} func;
 	void *user_data;
+	gpointer fd_tag;
+	int fd;
 	guint id;
+	gboolean registered;
+	unsigned char tag;
 };
 
-struct _idle {
-	idle_callback func;
+struct _signal {
+	signal_callback func;
 	void *user_data;
 	guint id;
 };
 
-struct _watch {
-	watch_callback func;
+struct _post {
+	struct _post *next;
+	timeout_callback func;
 	void *user_data;
-	guint id;
+	gint64 posted;
+	unsigned char tag;
 };
 
-struct _signal {
-	signal_callback func;
+/*
+ * Persistent source of a context running the callbacks posted to it.
+ * Posting only links a pooled entry and sets the ready time.
+ */
+struct _post_queue {
+	GSource base;
+	GMutex lock;
+	struct _post *head;
+	struct _post *tail;
+};
+
+struct _list {
+	struct _list *next;
+	struct _list *prev;
+};
+
+enum timer_state {
+	TIMER_PENDING,
+	TIMER_EXPIRED,
+	TIMER_RUNNING,
+	TIMER_CANCELLED
+};
+
+struct _wheel;
+
+/* The list node comes first so that timers can be cast from it */
+struct _timer {
+	struct _list node;
+	struct _wheel *wheel;
+	union {
+		timeout_callback timeout;
+		periodic_callback periodic;
+	} func;
 	void *user_data;
+	gint64 expires;
+	unsigned int interval;
+	gboolean periodic;
+	enum timer_state state;
+	unsigned char level;
+	unsigned char slot;
+	unsigned char tag;
 	guint id;
 };
 
-static GMainLoop *mainloop;
+/*
+ * Single source driving all the timers of a context. Its ready time is
+ * set to the earliest tick needing attention, either an expiration or
+ * the cascade of a higher level slot.
+ */
+struct _wheel {
+	GSource base;
+	struct _list slots[WHEEL_LEVELS][WHEEL_SLOTS];
+	guint64 bitmap[WHEEL_LEVELS];
+	struct _list expired;
+	/* Next tick to process, in milliseconds */
+	gint64 now;
+	/* Tick the source is scheduled for, -1 if none */
+	gint64 next;
+	unsigned int pending;
+};
+
+/* Address range of a loaded object and the tag it is accounted to */
+struct _stats_object {
+	uintptr_t start;
+	uintptr_t end;
+	char name[ARTIK_LOOP_STATS_TAG_LEN];
+	int tag;
+};
+
+struct _worker {
+	GMainContext *context;
+	GMainLoop *loop;
+	GThread *thread;
+	struct _post_queue *posts;
+	struct _wheel *wheel;
+};
+
+static gboolean _source_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data);
+static gboolean _post_queue_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data);
+static gboolean _wheel_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data);
+
+static void _source_finalize(GSource *base);
+
+static GSourceFuncs source_funcs = {
+	NULL,
+	NULL,
+	_source_dispatch,
+	_source_finalize
+};
+
+static GSourceFuncs post_queue_funcs = {
+	NULL,
+	NULL,
+	_post_queue_dispatch,
+	NULL
+};
+
+static GSourceFuncs wheel_funcs = {
+	NULL,
+	NULL,
+	_wheel_dispatch,
+	NULL
+};
+
+static GMainLoop *mainloop;
+
+static struct _worker workers[ARTIK_LOOP_MAX_WORKERS];
+static unsigned int num_workers;
+static gboolean workers_busy;
+static gint next_worker;
+static GMutex workers_lock;
+static GHashTable *worker_sources;
+static guint next_worker_id = LOOP_WORKER_ID_BASE;
+
+static struct _post_queue *main_posts;
+static struct _post *post_free_list;
+static GMutex post_lock;
+
+/* Protects all the wheels and the timer registry */
+static GMutex timers_lock;
+static struct _wheel *main_wheel;
+static GHashTable *timers;
+static struct _timer *timer_free_list;
+static guint next_timer_id = LOOP_TIMER_ID_BASE;
+static unsigned int timer_slack = 1;
+
+/* Sources alive per type, maintained even if stats are disabled */
+static gint pending_count[ARTIK_LOOP_SOURCE_TYPES];
+
+static gint stats_enabled;
+static GMutex stats_lock;
+static artik_loop_tag_stats stats_tags[ARTIK_LOOP_STATS_MAX_TAGS];
+static unsigned int stats_num_tags;
+static struct _stats_object stats_objects[LOOP_STATS_MAX_OBJECTS];
+static unsigned int stats_num_objects;
+static guint stats_dump_id;
+
+/* Return address of the module API call being served by this thread */
+static __thread const void *loop_caller;
+/* Tag given by the module for the next registration of this thread */
+static __thread const char *loop_tag;
+
+/*
+ * Statistics are grouped by the shared object which registered the
+ * source, unless the module gave its own tag through os_set_stats_tag
+ * as the connectivity modules do. Objects are found by walking the
+ * loaded objects, which is only done on registrations from an unknown
+ * address while the statistics are enabled.
+ */
+static void _stats_tag_name(const char *path, char *tag, size_t len)
+{
+	const char *name;
+	size_t i;
+
+	if (!path || !path[0]) {
+		strncpy(tag, "app", len);
+		return;
+	}
+
+	name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+	if (!strncmp(name, "lib", 3))
+		name += 3;
+	if (!strncmp(name, "artik-sdk-", 10))
+		name += 10;
+
+	for (i = 0; i < len - 1 && name[i] && name[i] != '.'; i++)
+		tag[i] = name[i];
+	tag[i] = '\0';
+}
+
+static int _stats_tag_index(const char *tag)
+{
+	unsigned int i;
+
+	for (i = 0; i < stats_num_tags; i++)
+		if (!strcmp(stats_tags[i].tag, tag))
+			return i;
+
+	/* The last tag collects everything once the table is full */
+	if (stats_num_tags == ARTIK_LOOP_STATS_MAX_TAGS) {
+		strncpy(stats_tags[i - 1].tag, "other",
+				ARTIK_LOOP_STATS_TAG_LEN);
+		return i - 1;
+	}
+
+	strncpy(stats_tags[i].tag, tag, ARTIK_LOOP_STATS_TAG_LEN - 1);
+	stats_num_tags++;
+
+	return i;
+}
+
+static int _stats_add_object(struct dl_phdr_info *info, size_t size,
+		void *data)
+{
+	struct _stats_object *object;
+	uintptr_t start = UINTPTR_MAX, end = 0;
+	int i;
+
+	if (stats_num_objects == LOOP_STATS_MAX_OBJECTS)
+		return 1;
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+		if (phdr->p_type != PT_LOAD)
+			continue;
+		start = MIN(start, info->dlpi_addr + phdr->p_vaddr);
+		end = MAX(end, info->dlpi_addr + phdr->p_vaddr +
+							phdr->p_memsz);
+	}
+
+	if (start >= end)
+		return 0;
+
+	object = &stats_objects[stats_num_objects++];
+	object->start = start;
+	object->end = end;
+	_stats_tag_name(info->dlpi_name, object->name, sizeof(object->name));
+	object->tag = -1;
+
+	return 0;
+}
+
+static int _stats_find_object(uintptr_t addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < stats_num_objects; i++) {
+		struct _stats_object *object = &stats_objects[i];
+
+		if (addr < object->start || addr >= object->end)
+			continue;
+
+		/* Only objects registering sources take a tag */
+		if (object->tag < 0)
+			object->tag = _stats_tag_index(object->name);
+
+		return object->tag;
+	}
+
+	return -1;
+}
+
+/*
+ * Tag of the caller of the current registration, if stats are enabled.
+ * Registrations call it before checking their arguments, so that the
+ * module tag is consumed even if they fail.
+ */
+static unsigned char _stats_tag(void)
+{
+	uintptr_t addr = (uintptr_t)loop_caller;
+	const char *name = loop_tag;
+	int tag;
+
+	/* A module tag only applies to one registration */
+	loop_tag = NULL;
+
+	if (!g_atomic_int_get(&stats_enabled))
+		return LOOP_STATS_NO_TAG;
+
+	g_mutex_lock(&stats_lock);
+
+	if (name) {
+		tag = _stats_tag_index(name);
+		g_mutex_unlock(&stats_lock);
+		return (unsigned char)tag;
+	}
+
+	tag = _stats_find_object(addr);
+	if (tag < 0) {
+		/* Objects may have been loaded since the last walk */
+		stats_num_objects = 0;
+		dl_iterate_phdr(_stats_add_object, NULL);
+		tag = _stats_find_object(addr);
+		if (tag < 0)
+			tag = _stats_tag_index("other");
+	}
+
+	g_mutex_unlock(&stats_lock);
+
+	return (unsigned char)tag;
+}
+
+static inline gint64 _stats_start(unsigned char tag)
+{
+	if (tag == LOOP_STATS_NO_TAG || !g_atomic_int_get(&stats_enabled))
+		return 0;
+
+	return g_get_monotonic_time();
+}
+
+static unsigned int _stats_bucket(guint64 usec)
+{
+	unsigned int bucket = 0;
+
+	while (usec >= 2 && bucket < ARTIK_LOOP_STATS_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/*
+ * Account for a callback started at 'start' (0 if not measured) which
+ * was due at 'due', both in microseconds of the monotonic clock.
+ */
+static void _stats_record(unsigned char tag, artik_loop_source_type type,
+		gint64 due, gint64 start)
+{
+	artik_loop_tag_stats *stats;
+	guint64 run, latency;
+
+	if (!start)
+		return;
+
+	run = g_get_monotonic_time() - start;
+	latency = (due > 0 && start > due) ? start - due : 0;
+
+	g_mutex_lock(&stats_lock);
+
+	if (!stats_enabled || tag >= stats_num_tags) {
+		g_mutex_unlock(&stats_lock);
+		return;
+	}
+
+	stats = &stats_tags[tag];
+	stats->dispatched[type]++;
+	stats->run_time_us += run;
+	stats->max_run_time_us = MAX(stats->max_run_time_us, run);
+	stats->run_time_hist[_stats_bucket(run)]++;
+	stats->latency_us += latency;
+	stats->max_latency_us = MAX(stats->max_latency_us, latency);
+	stats->latency_hist[_stats_bucket(latency)]++;
+
+	g_mutex_unlock(&stats_lock);
+}
+
+static gpointer _worker_thread(gpointer user_data)
+{
+	struct _worker *worker = user_data;
+
+	g_main_context_push_thread_default(worker->context);
+	g_main_loop_run(worker->loop);
+	g_main_context_pop_thread_default(worker->context);
+
+	return NULL;
+}
+
+/*
+ * Pick the worker a new source is attached to, NULL standing for the
+ * default context. Without running workers everything goes to the
+ * default context. Must be called with workers_lock or timers_lock held
+ * until the source is attached, so that the workers cannot be stopped in
+ * between.
+ */
+static struct _worker *_select_worker(int affinity, int fd)
+{
+	unsigned int count = num_workers;
+	unsigned int index;
+
+	if (!count || affinity == ARTIK_LOOP_AFFINITY_MAIN)
+		return NULL;
+
+	if (affinity >= 0)
+		index = affinity;
+	else if (fd >= 0)
+		index = ((guint)fd * 2654435761u) >> 16;
+	else
+		index = g_atomic_int_add(&next_worker, 1);
+
+	return &workers[index % count];
+}
+
+static inline artik_loop_source_type _source_stats_type(
+		struct _source *source)
+{
+	return source->type == SOURCE_IDLE ? ARTIK_LOOP_SOURCE_IDLE :
+						ARTIK_LOOP_SOURCE_FD_WATCH;
+}
+
+static struct _source *_source_new(enum source_type type, void *user_data,
+		unsigned char tag)
+{
+	struct _source *source;
+
+	source = (struct _source *)g_source_new(&source_funcs,
+						sizeof(struct _source));
+	source->type = type;
+	source->user_data = user_data;
+	source->fd = -1;
+	source->tag = tag;
+
+	g_atomic_int_inc(&pending_count[_source_stats_type(source)]);
+
+	return source;
+}
+
+static void _source_finalize(GSource *base)
+{
+	struct _source *source = (struct _source *)base;
+
+	g_atomic_int_add(&pending_count[_source_stats_type(source)], -1);
+}
+
+/*
+ * Attach a source to the worker picked for the affinity and return its
+ * ID. Worker sources are registered before being attached as they may be
+ * dispatched and destroyed by their thread before g_source_attach
+ * returns. Both happen under workers_lock so that os_stop_workers either
+ * finds the source in the registry or routes it to the default context.
+ * The caller must not touch the source afterwards, except for dropping
+ * its reference.
+ */
+static guint _attach_source(struct _source *source, int affinity, int fd)
+{
+	struct _worker *worker;
+	guint id;
+
+	g_mutex_lock(&workers_lock);
+
+	worker = _select_worker(affinity, fd);
+	if (!worker) {
+		g_mutex_unlock(&workers_lock);
+		id = g_source_attach(&source->base, NULL);
+		source->id = id;
+		return id;
+	}
+
+	do {
+		id = next_worker_id++;
+		if (next_worker_id > G_MAXINT)
+			next_worker_id = LOOP_WORKER_ID_BASE;
+	} while (g_hash_table_contains(worker_sources, GUINT_TO_POINTER(id)));
+
+	g_hash_table_insert(worker_sources, GUINT_TO_POINTER(id), source);
+	source->id = id;
+	source->registered = TRUE;
+
+	g_source_attach(&source->base, worker->context);
+
+	g_mutex_unlock(&workers_lock);
+
+	return id;
+}
+
+/*
+ * Registered sources are unregistered right before being destroyed,
+ * either by their dispatch function or by _remove_source. A source
+ * found in the registry is therefore always alive.
+ */
+static void _unregister_source(struct _source *source)
+{
+	if (!source->registered)
+		return;
+
+	g_mutex_lock(&workers_lock);
+	if (source->registered) {
+		g_hash_table_remove(worker_sources,
+					GUINT_TO_POINTER(source->id));
+		source->registered = FALSE;
+	}
+	g_mutex_unlock(&workers_lock);
+}
+
+static gboolean _remove_source(guint id)
+{
+	struct _source *source = NULL;
+
+	if (id >= LOOP_WORKER_ID_BASE) {
+		g_mutex_lock(&workers_lock);
+		if (worker_sources)
+			source = g_hash_table_lookup(worker_sources,
+						GUINT_TO_POINTER(id));
+		if (source) {
+			g_hash_table_remove(worker_sources,
+						GUINT_TO_POINTER(id));
+			source->registered = FALSE;
+			g_source_ref(&source->base);
+		}
+		g_mutex_unlock(&workers_lock);
+	}
+
+	if (!source)
+		return g_source_remove(id);
+
+	g_source_destroy(&source->base);
+	g_source_unref(&source->base);
+
+	return TRUE;
+}
+
+static enum watch_io _cond_to_io(GIOCondition cond)
+{
+	enum watch_io io = 0;
+
+	if (cond & G_IO_IN)
+		io |= WATCH_IO_IN;
+	if (cond & G_IO_OUT)
+		io |= WATCH_IO_OUT;
+	if (cond & G_IO_PRI)
+		io |= WATCH_IO_PRI;
+	if (cond & G_IO_ERR)
+		io |= WATCH_IO_ERR;
+	if (cond & G_IO_HUP)
+		io |= WATCH_IO_HUP;
+	if (cond & G_IO_NVAL)
+		io |= WATCH_IO_NVAL;
+
+	return io;
+}
+
+static GIOCondition _io_to_cond(enum watch_io io)
+{
+	GIOCondition cond = 0;
+
+	if (io & WATCH_IO_IN)
+		cond |= G_IO_IN;
+	if (io & WATCH_IO_OUT)
+		cond |= G_IO_OUT;
+	if (io & WATCH_IO_PRI)
+		cond |= G_IO_PRI;
+	if (io & WATCH_IO_ERR)
+		cond |= G_IO_ERR;
+	if (io & WATCH_IO_HUP)
+		cond |= G_IO_HUP;
+	if (io & WATCH_IO_NVAL)
+		cond |= G_IO_NVAL;
+
+	return cond;
+}
+
+static gboolean _source_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data)
+{
+	struct _source *source = (struct _source *)base;
+	gint64 start = _stats_start(source->tag);
+	gboolean keep = FALSE;
+	GIOCondition cond;
+
+	switch (source->type) {
+	case SOURCE_IDLE:
+		keep = source->func.idle(source->user_data) == 1;
+		break;
+	case SOURCE_WATCH:
+		cond = g_source_query_unix_fd(base, source->fd_tag);
+		keep = source->func.watch(source->fd, _cond_to_io(cond),
+					source->user_data) == 1;
+		break;
+	}
+
+	_stats_record(source->tag, _source_stats_type(source),
+			g_source_get_time(base), start);
+
+	if (!keep)
+		_unregister_source(source);
+
+	return keep;
+}
+
+static inline void _list_init(struct _list *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static inline gboolean _list_empty(const struct _list *head)
+{
+	return head->next == head;
+}
+
+static inline void _list_add_tail(struct _list *node, struct _list *head)
+{
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+static inline void _list_del(struct _list *node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->next = node->prev = node;
+}
+
+/* Move all the nodes of a list at the end of another one */
+static inline void _list_splice_tail(struct _list *from, struct _list *to)
+{
+	if (_list_empty(from))
+		return;
+
+	from->next->prev = to->prev;
+	to->prev->next = from->next;
+	from->prev->next = to;
+	to->prev = from->prev;
+	_list_init(from);
+}
+
+static inline guint64 _rotr64(guint64 value, unsigned int shift)
+{
+	shift &= 63;
+	if (!shift)
+		return value;
+
+	return (value >> shift) | (value << (64 - shift));
+}
+
+static gint64 _get_time_ms(void)
+{
+	return g_get_monotonic_time() / 1000;
+}
+
+static struct _wheel *_wheel_new(GMainContext *context)
+{
+	struct _wheel *wheel;
+	int i, j;
+
+	wheel = (struct _wheel *)g_source_new(&wheel_funcs,
+						sizeof(struct _wheel));
+	for (i = 0; i < WHEEL_LEVELS; i++)
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			_list_init(&wheel->slots[i][j]);
+	_list_init(&wheel->expired);
+	wheel->now = _get_time_ms();
+	wheel->next = -1;
+
+	g_source_set_priority(&wheel->base, G_PRIORITY_HIGH);
+	g_source_attach(&wheel->base, context);
+
+	return wheel;
+}
+
+/* Must be called with timers_lock held */
+static void _wheel_place(struct _wheel *wheel, struct _timer *timer)
+{
+	gint64 expires = timer->expires;
+	gint64 delta = expires - wheel->now;
+	unsigned int level, slot;
+
+	if (delta < 0) {
+		expires = wheel->now;
+		delta = 0;
+	} else if (delta >= WHEEL_RANGE) {
+		expires = wheel->now + WHEEL_RANGE - 1;
+		delta = WHEEL_RANGE - 1;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < ((gint64)1 << (WHEEL_BITS * (level + 1))))
+			break;
+
+	slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	_list_add_tail(&timer->node, &wheel->slots[level][slot]);
+	wheel->bitmap[level] |= (guint64)1 << slot;
+	timer->level = level;
+	timer->slot = slot;
+	timer->state = TIMER_PENDING;
+}
+
+static void _wheel_unlink(struct _wheel *wheel, struct _timer *timer)
+{
+	_list_del(&timer->node);
+	if (timer->state != TIMER_PENDING)
+		return;
+
+	wheel->pending--;
+	if (_list_empty(&wheel->slots[timer->level][timer->slot]))
+		wheel->bitmap[timer->level] &= ~((guint64)1 << timer->slot);
+}
+
+/*
+ * Return the earliest tick at which a slot has to be processed, -1 if
+ * the wheel is empty. A slot of level N is processed when the lower
+ * WHEEL_BITS * N bits of the current tick are zero and the next bits
+ * match its index.
+ */
+static gint64 _wheel_next_event(struct _wheel *wheel)
+{
+	gint64 next = -1;
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		unsigned int shift = WHEEL_BITS * level;
+		gint64 pos, tick;
+
+		if (!wheel->bitmap[level])
+			continue;
+
+		pos = (wheel->now + ((gint64)1 << shift) - 1) >> shift;
+		pos += __builtin_ctzll(_rotr64(wheel->bitmap[level],
+						pos & WHEEL_MASK));
+		tick = pos << shift;
+		if (next < 0 || tick < next)
+			next = tick;
+	}
+
+	return next;
+}
+
+static void _wheel_schedule(struct _wheel *wheel, gint64 tick)
+{
+	wheel->next = tick;
+	g_source_set_ready_time(&wheel->base, tick < 0 ? -1 : tick * 1000);
+}
+
+/* Insert a timer, must be called with timers_lock held */
+static void _wheel_insert(struct _wheel *wheel, struct _timer *timer)
+{
+	if (!wheel->pending)
+		wheel->now = MAX(wheel->now, _get_time_ms());
+
+	timer->wheel = wheel;
+	_wheel_place(wheel, timer);
+	wheel->pending++;
+
+	/*
+	 * Waking up at the expiration is enough even if the timer sits in
+	 * a higher level, cascades happen on the way.
+	 */
+	if (wheel->next < 0 || timer->expires < wheel->next)
+		_wheel_schedule(wheel, MAX(timer->expires, wheel->now));
+}
+
+static void _wheel_cascade(struct _wheel *wheel, int level, int slot)
+{
+	struct _list list;
+
+	_list_init(&list);
+	_list_splice_tail(&wheel->slots[level][slot], &list);
+	wheel->bitmap[level] &= ~((guint64)1 << slot);
+
+	while (!_list_empty(&list)) {
+		struct _timer *timer = (struct _timer *)list.next;
+
+		_list_del(&timer->node);
+		_wheel_place(wheel, timer);
+	}
+}
+
+/* Move the timers expired at tick 'current' to the expired list */
+static void _wheel_advance(struct _wheel *wheel, gint64 current)
+{
+	while (wheel->now <= current) {
+		gint64 tick = _wheel_next_event(wheel);
+		int level, slot;
+
+		if (tick < 0 || tick > current) {
+			wheel->now = current + 1;
+			break;
+		}
+
+		wheel->now = tick;
+
+		for (level = 1; level < WHEEL_LEVELS; level++) {
+			unsigned int shift = WHEEL_BITS * level;
+
+			if (tick & (((gint64)1 << shift) - 1))
+				break;
+			_wheel_cascade(wheel, level,
+					(tick >> shift) & WHEEL_MASK);
+		}
+
+		slot = tick & WHEEL_MASK;
+		wheel->bitmap[0] &= ~((guint64)1 << slot);
+		while (!_list_empty(&wheel->slots[0][slot])) {
+			struct _timer *timer = (struct _timer *)
+						wheel->slots[0][slot].next;
+
+			_list_del(&timer->node);
+			_list_add_tail(&timer->node, &wheel->expired);
+			timer->state = TIMER_EXPIRED;
+			wheel->pending--;
+		}
+
+		wheel->now = tick + 1;
+	}
+}
+
+static gint64 _timer_expiry(gint64 now, unsigned int msec)
+{
+	gint64 expires = now + msec;
+
+	/* Round up so that timers close to each other expire together */
+	if (timer_slack > 1)
+		expires = ((expires + timer_slack - 1) / timer_slack) *
+								timer_slack;
+
+	return expires;
+}
+
+/*
+ * Timers come from slabs that are never released, like post entries,
+ * chained through their list node while free. Both must be called with
+ * timers_lock held.
+ */
+static struct _timer *_timer_alloc(void)
+{
+	struct _timer *timer;
+
+	if (!timer_free_list) {
+		struct _timer *slab;
+		int i;
+
+		slab = g_try_new0(struct _timer, LOOP_TIMER_SLAB_SIZE);
+		if (!slab)
+			return NULL;
+
+		for (i = 0; i < LOOP_TIMER_SLAB_SIZE - 1; i++)
+			slab[i].node.next = &slab[i + 1].node;
+		timer_free_list = slab;
+	}
+
+	timer = timer_free_list;
+	timer_free_list = (struct _timer *)timer->node.next;
+	timer->node.next = NULL;
+
+	return timer;
+}
+
+static void _timer_free(struct _timer *timer)
+{
+	memset(timer, 0, sizeof(struct _timer));
+	timer->node.next = (struct _list *)timer_free_list;
+	timer_free_list = timer;
+}
+
+static void _timer_release(struct _timer *timer)
+{
+	g_hash_table_remove(timers, GUINT_TO_POINTER(timer->id));
+	_timer_free(timer);
+}
+
+/*
+ * Timers are run one at a time, without holding the lock, so that a
+ * callback can cancel any timer including the ones expired at the same
+ * tick.
+ */
+static gboolean _wheel_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data)
+{
+	struct _wheel *wheel = (struct _wheel *)base;
+	gint64 current = g_source_get_time(base) / 1000;
+
+	g_mutex_lock(&timers_lock);
+
+	_wheel_advance(wheel, current);
+
+	while (!_list_empty(&wheel->expired)) {
+		struct _timer *timer = (struct _timer *)wheel->expired.next;
+		gboolean keep = FALSE;
+		gint64 start;
+
+		_list_del(&timer->node);
+		timer->state = TIMER_RUNNING;
+		g_mutex_unlock(&timers_lock);
+
+		start = _stats_start(timer->tag);
 
-static gboolean _timeout_callback(gpointer user_data)
-{
-	struct _timeout *timeout = user_data;
+		if (timer->periodic)
+			keep = timer->func.periodic(timer->user_data) == 1;
+		else
+			timer->func.timeout(timer->user_data);
 
-	timeout->func(timeout->user_data);
+		_stats_record(timer->tag, ARTIK_LOOP_SOURCE_TIMER,
+				timer->expires * 1000, start);
 
-	return FALSE;
+		g_mutex_lock(&timers_lock);
+
+		if (timer->state == TIMER_CANCELLED) {
+			_timer_free(timer);
+		} else if (keep) {
+			/* Next expiration is based on the time the loop woke up */
+			timer->expires = _timer_expiry(current,
+							timer->interval);
+			_wheel_insert(wheel, timer);
+		} else {
+			_timer_release(timer);
+		}
+	}
+
+	_wheel_schedule(wheel, _wheel_next_event(wheel));
+
+	g_mutex_unlock(&timers_lock);
+
+	return TRUE;
 }
 
-static void _timeout_destroy_callback(gpointer user_data)
+/* Drop all the timers of a wheel whose context is no longer running */
+static void _wheel_destroy(struct _wheel *wheel)
 {
-	struct _timeout *timeout = user_data;
+	int i, j;
 
-	memset(timeout, 0, sizeof(struct _timeout));
-	g_free(timeout);
+	g_source_destroy(&wheel->base);
+
+	g_mutex_lock(&timers_lock);
+
+	for (i = 0; i < WHEEL_LEVELS; i++)
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			_list_splice_tail(&wheel->slots[i][j],
+					&wheel->expired);
+
+	while (!_list_empty(&wheel->expired)) {
+		struct _timer *timer = (struct _timer *)wheel->expired.next;
+
+		_list_del(&timer->node);
+		_timer_release(timer);
+	}
+
+	g_mutex_unlock(&timers_lock);
+
+	g_source_unref(&wheel->base);
 }
 
-artik_error os_add_timeout_callback(int *timeout_id, unsigned int msec,
-				    timeout_callback func, void *user_data)
+static artik_error _add_timer(int affinity, int *timer_id, unsigned int msec,
+		timeout_callback timeout, periodic_callback periodic,
+		void *user_data)
 {
-	struct _timeout *timeout = NULL;
-	GSource *source = NULL;
+	struct _worker *worker;
+	struct _wheel *wheel;
+	struct _timer *timer;
+	unsigned char tag = _stats_tag();
 
-	if (!func || !timeout_id)
+	if ((!timeout && !periodic) || !timer_id)
 		return E_BAD_ARGS;
 
-	timeout = g_try_new0(struct _timeout, 1);
-	if (!timeout)
+	g_mutex_lock(&timers_lock);
+
+	timer = _timer_alloc();
+	if (!timer) {
+		g_mutex_unlock(&timers_lock);
 		return E_NO_MEM;
+	}
 
-	timeout->func = func;
-	timeout->user_data = user_data;
+	_list_init(&timer->node);
+	if (periodic)
+		timer->func.periodic = periodic;
+	else
+		timer->func.timeout = timeout;
+	timer->user_data = user_data;
+	timer->interval = msec;
+	timer->periodic = periodic != NULL;
+	timer->expires = _timer_expiry(_get_time_ms(), msec);
+	timer->tag = tag;
+
+	if (!timers)
+		timers = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	do {
+		timer->id = next_timer_id++;
+		if (next_timer_id >= LOOP_WORKER_ID_BASE)
+			next_timer_id = LOOP_TIMER_ID_BASE;
+	} while (g_hash_table_contains(timers, GUINT_TO_POINTER(timer->id)));
+
+	g_hash_table_insert(timers, GUINT_TO_POINTER(timer->id), timer);
+
+	worker = _select_worker(affinity, -1);
+	if (worker) {
+		wheel = worker->wheel;
+	} else {
+		if (!main_wheel)
+			main_wheel = _wheel_new(NULL);
+		wheel = main_wheel;
+	}
 
-	source = g_timeout_source_new(msec);
-	g_source_set_priority(source, G_PRIORITY_HIGH);
-	g_source_set_callback(source, _timeout_callback, timeout,
-			      _timeout_destroy_callback);
-	timeout->id = g_source_attach(source, NULL);
-	g_source_unref(source);
+	_wheel_insert(wheel, timer);
+	*timer_id = (int)timer->id;
 
-	*timeout_id = timeout->id;
+	g_mutex_unlock(&timers_lock);
 
 	return S_OK;
 }
 
-artik_error os_remove_timeout_callback(int timeout_id)
+static gboolean _remove_timer(guint id)
 {
-	gboolean ret;
+	struct _timer *timer = NULL;
 
-	if (timeout_id <= 0)
-		return E_BAD_ARGS;
+	g_mutex_lock(&timers_lock);
 
-	ret = g_source_remove((guint) timeout_id);
-	if (ret == FALSE)
-		return E_BAD_ARGS;
+	if (timers)
+		timer = g_hash_table_lookup(timers, GUINT_TO_POINTER(id));
+	if (!timer) {
+		g_mutex_unlock(&timers_lock);
+		return FALSE;
+	}
 
-	return S_OK;
-}
+	g_hash_table_remove(timers, GUINT_TO_POINTER(id));
 
+	if (timer->state == TIMER_RUNNING) {
+		/* Freed by the dispatcher once the callback returns */
+		timer->state = TIMER_CANCELLED;
+		g_mutex_unlock(&timers_lock);
+		return TRUE;
+	}
 
-static gboolean _periodic_callback(gpointer user_data)
-{
-	struct _periodic *periodic = user_data;
-	int ret;
+	_wheel_unlink(timer->wheel, timer);
+	_timer_free(timer);
 
-	ret = periodic->func(periodic->user_data);
-	if (ret == 1)
-		return TRUE;
+	g_mutex_unlock(&timers_lock);
 
-	return FALSE;
+	return TRUE;
 }
 
-static void _periodic_destroy_callback(gpointer user_data)
+artik_error os_set_timer_slack(unsigned int msec)
 {
-	struct _periodic *periodic = user_data;
+	g_mutex_lock(&timers_lock);
+	timer_slack = msec ? msec : 1;
+	g_mutex_unlock(&timers_lock);
 
-	memset(periodic, 0, sizeof(struct _periodic));
-	g_free(periodic);
+	return S_OK;
 }
 
-artik_error os_add_periodic_callback(int *periodic_id, unsigned int msec,
-		periodic_callback func, void *user_data)
+artik_error os_add_timeout_callback(int *timeout_id, unsigned int msec,
+				    timeout_callback func, void *user_data)
 {
-	struct _periodic *periodic;
-	GSource *source;
+	return _add_timer(ARTIK_LOOP_AFFINITY_MAIN, timeout_id, msec, func,
+			NULL, user_data);
+}
 
-	if (!func || !periodic_id)
-		return E_BAD_ARGS;
+artik_error os_add_timeout_callback_on(int affinity, int *timeout_id,
+		unsigned int msec, timeout_callback func, void *user_data)
+{
+	return _add_timer(affinity, timeout_id, msec, func, NULL,
+			user_data);
+}
 
-	periodic = g_try_new0(struct _periodic, 1);
-	if (!periodic)
-		return E_NO_MEM;
+artik_error os_remove_timeout_callback(int timeout_id)
+{
+	if (timeout_id <= 0)
+		return E_BAD_ARGS;
 
-	periodic->func = func;
-	periodic->user_data = user_data;
+	if (!_remove_timer((guint) timeout_id))
+		return E_BAD_ARGS;
 
-	source = g_timeout_source_new(msec);
-	g_source_set_priority(source, G_PRIORITY_HIGH);
-	g_source_set_callback(source, _periodic_callback, periodic,
-			_periodic_destroy_callback);
-	periodic->id = g_source_attach(source, NULL);
-	g_source_unref(source);
+	return S_OK;
+}
 
-	*periodic_id = periodic->id;
+artik_error os_add_periodic_callback(int *periodic_id, unsigned int msec,
+		periodic_callback func, void *user_data)
+{
+	return _add_timer(ARTIK_LOOP_AFFINITY_MAIN, periodic_id, msec, NULL,
+			func, user_data);
+}
 
-	return S_OK;
+artik_error os_add_periodic_callback_on(int affinity, int *periodic_id,
+		unsigned int msec, periodic_callback func, void *user_data)
+{
+	return _add_timer(affinity, periodic_id, msec, NULL, func,
+			user_data);
 }
 
 artik_error os_remove_periodic_callback(int periodic_id)
 {
-	gboolean ret;
-
 	if (periodic_id <= 0)
 		return E_BAD_ARGS;
 
-	ret = g_source_remove((guint) periodic_id);
-	if (ret == FALSE)
+	if (!_remove_timer((guint) periodic_id))
 		return E_BAD_ARGS;
 
 	return S_OK;
@@ -197,36 +1178,6 @@ void os_loop_quit(void)
 	g_main_loop_quit(mainloop);
 }
 
-static gboolean _gio_callback(GIOChannel *channel, GIOCondition cond,
-			      gpointer user_data)
-{
-	struct _watch *watch = user_data;
-	int fd;
-	int ret;
-	enum watch_io io = 0;
-
-	if (cond & G_IO_IN)
-		io |= WATCH_IO_IN;
-	if (cond & G_IO_OUT)
-		io |= WATCH_IO_OUT;
-	if (cond & G_IO_PRI)
-		io |= WATCH_IO_PRI;
-	if (cond & G_IO_ERR)
-		io |= WATCH_IO_ERR;
-	if (cond & G_IO_HUP)
-		io |= WATCH_IO_HUP;
-	if (cond & G_IO_NVAL)
-		io |= WATCH_IO_NVAL;
-
-	fd = g_io_channel_unix_get_fd(channel);
-
-	ret = watch->func(fd, io, watch->user_data);
-	if (ret == 1)
-		return TRUE;
-
-	return FALSE;
-}
-
 static gboolean _gsignal_callback(gpointer user_data)
 {
 	struct _signal *signal = user_data;
@@ -247,20 +1198,13 @@ static void _gsignal_destory_callback(gpointer user_data)
 	g_free(signal);
 }
 
-static void _gio_destroy_callback(gpointer user_data)
-{
-	struct _watch *watch = user_data;
-
-	memset(watch, 0, sizeof(struct _watch));
-	g_free(watch);
-}
-
-artik_error os_add_fd_watch(int fd, enum watch_io io, watch_callback func,
-						void *user_data, int *watch_id)
+static artik_error _add_fd_watch(int affinity, int fd,
+		enum watch_io io, watch_callback func, void *user_data,
+		int *watch_id)
 {
-	struct _watch *watch;
-	GIOChannel *channel;
-	GIOCondition cond = 0;
+	struct _source *source;
+	unsigned char tag = _stats_tag();
+	guint id;
 
 	if (fd < 0) {
 		log_err("invalid fd(%d)", fd);
@@ -277,38 +1221,35 @@ artik_error os_add_fd_watch(int fd, enum watch_io io, watch_callback func,
 		return E_BAD_ARGS;
 	}
 
-	watch = g_try_new0(struct _watch, 1);
-	if (!watch)
-		return E_NO_MEM;
-
-	if (io & WATCH_IO_IN)
-		cond |= G_IO_IN;
-	if (io & WATCH_IO_OUT)
-		cond |= G_IO_OUT;
-	if (io & WATCH_IO_PRI)
-		cond |= G_IO_PRI;
-	if (io & WATCH_IO_ERR)
-		cond |= G_IO_ERR;
-	if (io & WATCH_IO_HUP)
-		cond |= G_IO_HUP;
-	if (io & WATCH_IO_NVAL)
-		cond |= G_IO_NVAL;
-
-	watch->func = func;
-	watch->user_data = user_data;
+	source = _source_new(SOURCE_WATCH, user_data, tag);
+	source->func.watch = func;
+	source->fd = fd;
+	source->fd_tag = g_source_add_unix_fd(&source->base, fd,
+						_io_to_cond(io));
 
-	channel = g_io_channel_unix_new(fd);
-	watch->id = g_io_add_watch_full(channel, G_PRIORITY_HIGH, cond,
-			_gio_callback, watch, _gio_destroy_callback);
-	g_io_channel_set_flags(channel, G_IO_FLAG_NONBLOCK, NULL);
-	g_io_channel_unref(channel);
+	g_source_set_priority(&source->base, G_PRIORITY_HIGH);
+	id = _attach_source(source, affinity, fd);
+	g_source_unref(&source->base);
 
 	if (watch_id)
-		*watch_id = (int)watch->id;
+		*watch_id = (int)id;
 
 	return S_OK;
 }
 
+artik_error os_add_fd_watch(int fd, enum watch_io io, watch_callback func,
+						void *user_data, int *watch_id)
+{
+	return _add_fd_watch(ARTIK_LOOP_AFFINITY_MAIN, fd, io, func, user_data,
+			watch_id);
+}
+
+artik_error os_add_fd_watch_on(int affinity, int fd, enum watch_io io,
+		watch_callback func, void *user_data, int *watch_id)
+{
+	return _add_fd_watch(affinity, fd, io, func, user_data, watch_id);
+}
+
 artik_error os_remove_fd_watch(int watch_id)
 {
 	gboolean ret;
@@ -318,7 +1259,7 @@ artik_error os_remove_fd_watch(int watch_id)
 		return -EINVAL;
 	}
 
-	ret = g_source_remove((guint) watch_id);
+	ret = _remove_source((guint) watch_id);
 	if (ret == FALSE) {
 		log_err("invalid watch_id(%d)", watch_id);
 		return -EINVAL;
@@ -370,56 +1311,457 @@ artik_error os_remove_signal_watch(int signal_id)
 	return S_OK;
 }
 
-static gboolean _idle_callback(gpointer user_data)
+static artik_error _add_idle_callback(int affinity, int *idle_id,
+		idle_callback func, void *user_data)
 {
-	struct _idle *idle = user_data;
-	int ret;
+	struct _source *source;
+	unsigned char tag = _stats_tag();
+	guint id;
 
-	ret = idle->func(idle->user_data);
-	if (ret == 1)
-		return TRUE;
+	if (!func)
+		return E_BAD_ARGS;
 
-	return FALSE;
-}
+	source = _source_new(SOURCE_IDLE, user_data, tag);
+	source->func.idle = func;
 
-static void _idle_destroy_callback(gpointer user_data)
-{
-	struct _idle *idle = user_data;
+	/* A null ready time keeps the source ready on every iteration */
+	g_source_set_priority(&source->base, G_PRIORITY_DEFAULT_IDLE);
+	g_source_set_ready_time(&source->base, 0);
+	id = _attach_source(source, affinity, -1);
+	g_source_unref(&source->base);
+
+	if (idle_id)
+		*idle_id = (int)id;
 
-	memset(idle, 0, sizeof(struct _idle));
-	g_free(idle);
+	return S_OK;
 }
 
 artik_error os_add_idle_callback(int *idle_id, idle_callback func,
 				void *user_data)
 {
-	struct _idle *idle;
+	return _add_idle_callback(ARTIK_LOOP_AFFINITY_MAIN, idle_id, func,
+			user_data);
+}
+
+artik_error os_add_idle_callback_on(int affinity, int *idle_id,
+		idle_callback func, void *user_data)
+{
+	return _add_idle_callback(affinity, idle_id, func, user_data);
+}
+
+artik_error os_remove_idle_callback(int idle_id)
+{
+	if (idle_id <= 0)
+		return E_BAD_ARGS;
+
+	if (!_remove_source((guint)idle_id))
+		return E_BAD_ARGS;
+
+	return S_OK;
+}
+
+/*
+ * Post entries come from slabs that are never released, so that the
+ * steady state does not hit the allocator.
+ */
+static struct _post *_post_alloc(void)
+{
+	struct _post *post;
+
+	g_mutex_lock(&post_lock);
+
+	if (!post_free_list) {
+		struct _post *slab;
+		int i;
+
+		slab = g_try_new0(struct _post, LOOP_POST_SLAB_SIZE);
+		if (!slab) {
+			g_mutex_unlock(&post_lock);
+			return NULL;
+		}
+
+		for (i = 0; i < LOOP_POST_SLAB_SIZE - 1; i++)
+			slab[i].next = &slab[i + 1];
+		post_free_list = slab;
+	}
+
+	post = post_free_list;
+	post_free_list = post->next;
+
+	g_mutex_unlock(&post_lock);
+
+	return post;
+}
+
+static void _post_free_list(struct _post *first, struct _post *last)
+{
+	g_mutex_lock(&post_lock);
+	last->next = post_free_list;
+	post_free_list = first;
+	g_mutex_unlock(&post_lock);
+}
+
+static struct _post_queue *_post_queue_new(GMainContext *context)
+{
+	struct _post_queue *queue;
+
+	queue = (struct _post_queue *)g_source_new(&post_queue_funcs,
+						sizeof(struct _post_queue));
+	g_mutex_init(&queue->lock);
+	g_source_set_priority(&queue->base, G_PRIORITY_HIGH);
+	g_source_attach(&queue->base, context);
+
+	return queue;
+}
+
+/* Detach the pending entries, dropping them if run is FALSE */
+static void _post_queue_flush(struct _post_queue *queue, gboolean run)
+{
+	struct _post *first, *last, *post;
+	gint count = 0;
+
+	g_mutex_lock(&queue->lock);
+	first = queue->head;
+	last = queue->tail;
+	queue->head = queue->tail = NULL;
+	g_source_set_ready_time(&queue->base, -1);
+	g_mutex_unlock(&queue->lock);
+
+	if (!first)
+		return;
+
+	for (post = first; post; post = post->next) {
+		if (run) {
+			gint64 start = _stats_start(post->tag);
+
+			post->func(post->user_data);
+			_stats_record(post->tag, ARTIK_LOOP_SOURCE_POST,
+					post->posted, start);
+		}
+		count++;
+	}
+
+	g_atomic_int_add(&pending_count[ARTIK_LOOP_SOURCE_POST], -count);
+	_post_free_list(first, last);
+}
+
+static gboolean _post_queue_dispatch(GSource *base, GSourceFunc callback,
+		gpointer user_data)
+{
+	_post_queue_flush((struct _post_queue *)base, TRUE);
+
+	return TRUE;
+}
+
+static void _post_queue_destroy(struct _post_queue *queue)
+{
+	g_source_destroy(&queue->base);
+	_post_queue_flush(queue, FALSE);
+	g_mutex_clear(&queue->lock);
+	g_source_unref(&queue->base);
+}
+
+artik_error os_post_callback(int affinity, timeout_callback func,
+		void *user_data)
+{
+	struct _worker *worker;
+	struct _post_queue *queue;
+	struct _post *post;
+	unsigned char tag = _stats_tag();
 
 	if (!func)
 		return E_BAD_ARGS;
 
-	idle = g_try_new0(struct _idle, 1);
-	if (!idle)
+	post = _post_alloc();
+	if (!post)
 		return E_NO_MEM;
 
-	idle->func = func;
-	idle->user_data = user_data;
-	idle->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, _idle_callback,
-				idle, _idle_destroy_callback);
+	post->func = func;
+	post->user_data = user_data;
+	post->next = NULL;
+	post->tag = tag;
+	post->posted = _stats_start(post->tag);
+	g_atomic_int_inc(&pending_count[ARTIK_LOOP_SOURCE_POST]);
+
+	g_mutex_lock(&workers_lock);
+
+	worker = _select_worker(affinity, -1);
+	if (worker) {
+		queue = worker->posts;
+	} else {
+		if (!main_posts)
+			main_posts = _post_queue_new(NULL);
+		queue = main_posts;
+	}
 
-	if (idle_id)
-		*idle_id = (int)idle->id;
+	/* Setting the ready time wakes up the context if needed */
+	g_mutex_lock(&queue->lock);
+	if (queue->tail)
+		queue->tail->next = post;
+	else
+		queue->head = post;
+	queue->tail = post;
+	g_source_set_ready_time(&queue->base, 0);
+	g_mutex_unlock(&queue->lock);
+
+	g_mutex_unlock(&workers_lock);
 
 	return S_OK;
 }
 
-artik_error os_remove_idle_callback(int idle_id)
+artik_error os_start_workers(unsigned int count)
 {
-	if (idle_id <= 0)
+	unsigned int i;
+
+	if (!count || count > ARTIK_LOOP_MAX_WORKERS)
+		return E_BAD_ARGS;
+
+	/* The workers array is owned by a single start or stop at a time */
+	g_mutex_lock(&workers_lock);
+	if (num_workers || workers_busy) {
+		g_mutex_unlock(&workers_lock);
+		return E_BUSY;
+	}
+
+	workers_busy = TRUE;
+	if (!worker_sources)
+		worker_sources = g_hash_table_new(g_direct_hash,
+						g_direct_equal);
+	g_mutex_unlock(&workers_lock);
+
+	for (i = 0; i < count; i++) {
+		char name[16];
+
+		workers[i].context = g_main_context_new();
+		workers[i].loop = g_main_loop_new(workers[i].context, FALSE);
+		workers[i].posts = _post_queue_new(workers[i].context);
+		workers[i].wheel = _wheel_new(workers[i].context);
+
+		snprintf(name, sizeof(name), "artik-loop-%u", i);
+		workers[i].thread = g_thread_try_new(name, _worker_thread,
+						&workers[i], NULL);
+		if (!workers[i].thread) {
+			log_err("Failed to start loop worker %u", i);
+			_post_queue_destroy(workers[i].posts);
+			_wheel_destroy(workers[i].wheel);
+			g_main_loop_unref(workers[i].loop);
+			g_main_context_unref(workers[i].context);
+			memset(&workers[i], 0, sizeof(struct _worker));
+			break;
+		}
+	}
+
+	g_mutex_lock(&workers_lock);
+	g_mutex_lock(&timers_lock);
+	num_workers = i;
+	g_mutex_unlock(&timers_lock);
+	workers_busy = FALSE;
+	g_mutex_unlock(&workers_lock);
+
+	if (i < count) {
+		/* Stop the workers started so far */
+		if (i)
+			os_stop_workers();
+		return E_NO_MEM;
+	}
+
+	return S_OK;
+}
+
+static void _collect_source(gpointer key, gpointer value, gpointer user_data)
+{
+	GSList **sources = user_data;
+	struct _source *source = value;
+
+	source->registered = FALSE;
+	*sources = g_slist_prepend(*sources, g_source_ref(&source->base));
+}
+
+artik_error os_stop_workers(void)
+{
+	GSList *sources = NULL, *elem;
+	unsigned int i, count;
+
+	/* Route new sources, timers and posts to the default context */
+	g_mutex_lock(&workers_lock);
+	count = num_workers;
+	if (!count || workers_busy) {
+		g_mutex_unlock(&workers_lock);
+		return count ? E_BUSY : E_NOT_INITIALIZED;
+	}
+
+	workers_busy = TRUE;
+	g_mutex_lock(&timers_lock);
+	num_workers = 0;
+	g_mutex_unlock(&timers_lock);
+	g_mutex_unlock(&workers_lock);
+
+	for (i = 0; i < count; i++) {
+		g_main_loop_quit(workers[i].loop);
+		g_thread_join(workers[i].thread);
+	}
+
+	/* Destroy the sources left behind, their contexts are not running */
+	g_mutex_lock(&workers_lock);
+	g_hash_table_foreach(worker_sources, _collect_source, &sources);
+	g_hash_table_remove_all(worker_sources);
+	g_mutex_unlock(&workers_lock);
+
+	for (elem = sources; elem; elem = elem->next) {
+		g_source_destroy(elem->data);
+		g_source_unref(elem->data);
+	}
+	g_slist_free(sources);
+
+	for (i = 0; i < count; i++) {
+		_post_queue_destroy(workers[i].posts);
+		_wheel_destroy(workers[i].wheel);
+		g_main_loop_unref(workers[i].loop);
+		g_main_context_unref(workers[i].context);
+		memset(&workers[i], 0, sizeof(struct _worker));
+	}
+
+	g_mutex_lock(&workers_lock);
+	workers_busy = FALSE;
+	g_mutex_unlock(&workers_lock);
+
+	return S_OK;
+}
+
+static void _stats_dump(void)
+{
+	static const char * const types[ARTIK_LOOP_SOURCE_TYPES] = {
+		"timer", "fd", "idle", "post"
+	};
+	artik_loop_stats *stats;
+	unsigned int i, j;
+	char hist[ARTIK_LOOP_STATS_BUCKETS * 11 + 1];
+
+	stats = g_try_new0(artik_loop_stats, 1);
+	if (!stats)
+		return;
+
+	os_get_stats(stats);
+
+	log_info("loop stats: pending %s=%u %s=%u %s=%u %s=%u",
+		types[0], stats->pending[0], types[1], stats->pending[1],
+		types[2], stats->pending[2], types[3], stats->pending[3]);
+
+	for (i = 0; i < stats->num_tags; i++) {
+		artik_loop_tag_stats *tag = &stats->tags[i];
+		unsigned int count = 0;
+		int len = 0;
+
+		for (j = 0; j < ARTIK_LOOP_SOURCE_TYPES; j++)
+			count += tag->dispatched[j];
+		if (!count)
+			continue;
+
+		log_info(
+			"loop stats: [%s] %s=%u %s=%u %s=%u %s=%u run avg %llu max %u us, latency avg %llu max %u us",
+			tag->tag, types[0], tag->dispatched[0], types[1],
+			tag->dispatched[1], types[2], tag->dispatched[2],
+			types[3], tag->dispatched[3],
+			tag->run_time_us / count, tag->max_run_time_us,
+			tag->latency_us / count, tag->max_latency_us);
+
+		for (j = 0; j < ARTIK_LOOP_STATS_BUCKETS; j++)
+			len += snprintf(hist + len, sizeof(hist) - len, " %u",
+					tag->run_time_hist[j]);
+		log_info("loop stats: [%s] run histogram%s",
+				tag->tag, hist);
+	}
+
+	g_free(stats);
+}
+
+static gboolean _stats_signal_callback(gpointer user_data)
+{
+	_stats_dump();
+
+	return TRUE;
+}
+
+void os_loop_set_caller(const void *caller)
+{
+	loop_caller = caller;
+}
+
+artik_error os_set_stats_tag(const char *tag)
+{
+	loop_tag = tag;
+
+	return S_OK;
+}
+
+artik_error os_enable_stats(bool enable, int dump_signum)
+{
+	unsigned int i;
+
+	switch (dump_signum) {
+	case 0:
+	case SIGHUP:
+	case SIGINT:
+	case SIGTERM:
+	case SIGUSR1:
+	case SIGUSR2:
+		break;
+	default:
+		log_err("Signal %d is not supported", dump_signum);
 		return E_BAD_ARGS;
+	}
+
+	g_mutex_lock(&stats_lock);
 
-	if (!g_source_remove((guint)idle_id))
+	if (enable && !stats_enabled) {
+		for (i = 0; i < stats_num_tags; i++) {
+			char tag[ARTIK_LOOP_STATS_TAG_LEN];
+
+			memcpy(tag, stats_tags[i].tag, sizeof(tag));
+			memset(&stats_tags[i], 0, sizeof(stats_tags[i]));
+			memcpy(stats_tags[i].tag, tag, sizeof(tag));
+		}
+	}
+	g_atomic_int_set(&stats_enabled, enable);
+
+	g_mutex_unlock(&stats_lock);
+
+	if (stats_dump_id) {
+		g_source_remove(stats_dump_id);
+		stats_dump_id = 0;
+	}
+
+	if (enable && dump_signum)
+		stats_dump_id = g_unix_signal_add_full(G_PRIORITY_DEFAULT,
+				dump_signum, _stats_signal_callback, NULL,
+				NULL);
+
+	return S_OK;
+}
+
+artik_error os_get_stats(artik_loop_stats *stats)
+{
+	unsigned int i;
+
+	if (!stats)
 		return E_BAD_ARGS;
 
+	memset(stats, 0, sizeof(*stats));
+
+	g_mutex_lock(&timers_lock);
+	stats->pending[ARTIK_LOOP_SOURCE_TIMER] =
+				timers ? g_hash_table_size(timers) : 0;
+	g_mutex_unlock(&timers_lock);
+
+	for (i = ARTIK_LOOP_SOURCE_FD_WATCH; i < ARTIK_LOOP_SOURCE_TYPES; i++)
+		stats->pending[i] = g_atomic_int_get(&pending_count[i]);
+
+	g_mutex_lock(&stats_lock);
+	stats->enabled = stats_enabled;
+	stats->num_tags = stats_num_tags;
+	memcpy(stats->tags, stats_tags,
+			stats_num_tags * sizeof(artik_loop_tag_stats));
+	g_mutex_unlock(&stats_lock);
+
 	return S_OK;
 }
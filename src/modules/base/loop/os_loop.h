@@ -38,5 +38,22 @@ artik_error os_remove_signal_watch(int signal_id);
 artik_error os_add_idle_callback(int *idle_id, idle_callback func,
 				void *user_data);
 artik_error os_remove_idle_callback(int idle_id);
+artik_error os_start_workers(unsigned int num_workers);
+artik_error os_stop_workers(void);
+artik_error os_add_timeout_callback_on(int affinity, int *timeout_id,
+		unsigned int msec, timeout_callback func, void *user_data);
+artik_error os_add_periodic_callback_on(int affinity, int *periodic_id,
+		unsigned int msec, periodic_callback func, void *user_data);
+artik_error os_add_fd_watch_on(int affinity, int fd, enum watch_io io,
+		watch_callback func, void *user_data, int *watch_id);
+artik_error os_add_idle_callback_on(int affinity, int *idle_id,
+		idle_callback func, void *user_data);
+artik_error os_post_callback(int affinity, timeout_callback func,
+		void *user_data);
+artik_error os_set_timer_slack(unsigned int msec);
+void os_loop_set_caller(const void *caller);
+artik_error os_enable_stats(bool enable, int dump_signum);
+artik_error os_get_stats(artik_loop_stats *stats);
+artik_error os_set_stats_tag(const char *tag);
 
 #endif /* _OS_LOOP_H_ */
@@ -579,3 +579,68 @@ artik_error os_remove_idle_callback(int idle_id)
 
 	return S_OK;
 }
+
+artik_error os_start_workers(unsigned int num_workers)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_stop_workers(void)
+{
+	return E_NOT_SUPPORTED;
+}
+
+/* Worker contexts are not supported, everything runs in the main loop */
+artik_error os_add_timeout_callback_on(int affinity, int *timeout_id,
+		unsigned int msec, timeout_callback func, void *user_data)
+{
+	return os_add_timeout_callback(timeout_id, msec, func, user_data);
+}
+
+artik_error os_add_periodic_callback_on(int affinity, int *periodic_id,
+		unsigned int msec, periodic_callback func, void *user_data)
+{
+	return os_add_periodic_callback(periodic_id, msec, func, user_data);
+}
+
+artik_error os_add_fd_watch_on(int affinity, int fd, enum watch_io io,
+		watch_callback func, void *user_data, int *watch_id)
+{
+	return os_add_fd_watch(fd, io, func, user_data, watch_id);
+}
+
+artik_error os_add_idle_callback_on(int affinity, int *idle_id,
+		idle_callback func, void *user_data)
+{
+	return os_add_idle_callback(idle_id, func, user_data);
+}
+
+artik_error os_post_callback(int affinity, timeout_callback func,
+		void *user_data)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_set_timer_slack(unsigned int msec)
+{
+	return E_NOT_SUPPORTED;
+}
+
+void os_loop_set_caller(const void *caller)
+{
+}
+
+artik_error os_enable_stats(bool enable, int dump_signum)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_get_stats(artik_loop_stats *stats)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_set_stats_tag(const char *tag)
+{
+	return E_NOT_SUPPORTED;
+}
@@ -34,6 +34,17 @@ EXPORT_API artik_error artik_release_api_module(const artik_module_ops module)
 	return os_release_api_module(module);
 }
 
+EXPORT_API artik_error artik_preload_modules(void)
+{
+	return os_preload_modules();
+}
+
+EXPORT_API artik_error artik_get_modules_load_info(
+				artik_module_load_info *info, int *num)
+{
+	return os_get_modules_load_info(info, num);
+}
+
 EXPORT_API int artik_get_platform(void)
 {
 	return os_get_platform();
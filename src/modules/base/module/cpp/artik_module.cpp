@@ -28,6 +28,15 @@ artik_error artik::Module::get_api_version(
   return artik_get_api_version(version);
 }
 
+artik_error artik::Module::preload_modules(void) {
+  return artik_preload_modules();
+}
+
+artik_error artik::Module::get_modules_load_info(
+  artik_module_load_info *info, int *num) {
+  return artik_get_modules_load_info(info, num);
+}
+
 int artik::Module::get_platform(void) {
   return artik_get_platform();
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <gio/gio.h>
@@ -36,37 +37,39 @@
 #define MAX_STR_LEN 1024
 #define PATH_STRING "libartik-sdk-%s.so.%d.%d.%d"
 #define MODULE_STRING "%s_module"
+#define PRELOAD_ENV "ARTIK_PRELOAD_MODULES"
+#define PRELOAD_MAX_THREADS 4
 
-static pthread_mutex_t lock;
-static bool lock_initialized = false;
-
-static void mutex_lock(void)
-{
-	if (!lock_initialized) {
-		pthread_mutex_init(&lock, NULL);
-		lock_initialized = true;
-	}
-	pthread_mutex_lock(&lock);
-}
-
-static void mutex_unlock(void)
-{
-	pthread_mutex_unlock(&lock);
-}
-
-static artik_list *requested_node = NULL;
-
+/*
+ * One entry per module of the platform. The entries and the table
+ * indexing them by name are built once and never modified afterwards,
+ * so that lookups do not need any lock. Each entry has its own lock
+ * serializing its loading and unloading, so that different modules can
+ * be loaded concurrently.
+ */
 typedef struct artik_module_info_t {
-	char *module_name;
+	const char *module_name;
+	const char *object;
+	pthread_mutex_t lock;
 	void *dl_handle;
 	void *dl_symbol;
+	gint refcount;
+	bool preloaded;
+	unsigned int load_time_us;
 } artik_module_info;
 
-typedef struct artik_module_handle_t {
-	artik_list node;
-	artik_module_info info;
-} artik_module_node;
+static artik_module_info *platform_modules;
+static unsigned int modules_count;
+static GHashTable *modules_by_name;
+
+static pthread_once_t platform_once = PTHREAD_ONCE_INIT;
+static pthread_once_t modules_once = PTHREAD_ONCE_INIT;
+static pthread_once_t preload_once = PTHREAD_ONCE_INIT;
 
+struct preload_context {
+	gint next;
+	gint failures;
+};
 static int artik_platform_id = -1;
 
 /*
@@ -98,173 +101,295 @@ artik_error os_get_api_version(artik_api_version *version)
 	return S_OK;
 }
 
-static void *artik_compare_module_name(void *node, void *target)
+static void modules_init(void)
 {
-	if (strncmp(((artik_module_node *)node)->info.module_name,
-				(char *)target, strlen((char *)target)) == 0) {
-		/* if the modules are same */
-		return node;
+	const artik_api_module *modules;
+	unsigned int i;
+	int platid = os_get_platform();
+
+	if (platid < 0)
+		return;
+
+	modules = artik_api_modules[platid];
+	for (i = 0; modules[i].object != NULL; i++)
+		;
+
+	platform_modules = calloc(i, sizeof(artik_module_info));
+	if (!platform_modules)
+		return;
+
+	modules_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+	modules_count = i;
+
+	for (i = 0; i < modules_count; i++) {
+		platform_modules[i].module_name = modules[i].name;
+		platform_modules[i].object = modules[i].object;
+		pthread_mutex_init(&platform_modules[i].lock, NULL);
+		g_hash_table_insert(modules_by_name, (gpointer)modules[i].name,
+							&platform_modules[i]);
 	}
-	/* if not */
-	return NULL;
 }
 
-static void *artik_compare_module_ops(void *node, artik_module_ops target)
+static void preload_from_env(void)
 {
-	if (memcmp(((artik_module_node *)node)->info.dl_symbol, target,
-							sizeof(void *)) == 0) {
-		/* if the modules are same */
-		return node;
-	}
-	/* if not */
-	return NULL;
+	const char *env = getenv(PRELOAD_ENV);
+
+	if (env && env[0] && strcmp(env, "0"))
+		os_preload_modules();
 }
 
-artik_module_ops os_request_api_module(const char *name)
+static artik_module_info *get_module_info(const char *name)
+{
+	pthread_once(&modules_once, modules_init);
+	pthread_once(&preload_once, preload_from_env);
+
+	if (!modules_by_name)
+		return NULL;
+
+	return g_hash_table_lookup(modules_by_name, name);
+}
+
+/* Must be called with the lock of the module held */
+static bool load_module_locked(artik_module_info *info)
 {
-	artik_list *node = NULL;
-	void *dl_handle = NULL;
-	void *dl_symbol = INVALID_MODULE;
 	char str_buf[MAX_STR_LEN] = {0, };
-	char *module_name = NULL;
+	void *dl_handle = NULL;
+	void *dl_symbol = NULL;
 	char *error_msg;
-	unsigned int i = 0, len = 0;
-	int platid = os_get_platform();
+	gint64 start;
+
+	if (info->dl_handle)
+		return true;
+
+	start = g_get_monotonic_time();
+
+	snprintf(str_buf, MAX_STR_LEN, PATH_STRING, info->object,
+			LIB_VERSION_MAJOR, LIB_VERSION_MINOR,
+			LIB_VERSION_PATCH);
+	dl_handle = dlopen(str_buf, RTLD_NOW|RTLD_GLOBAL);
+	if (!dl_handle) {
+		log_dbg("Failed to load %s: %s", str_buf, dlerror());
+		return false;
+	}
+
+	memset(str_buf, 0, sizeof(str_buf));
+	snprintf(str_buf, MAX_STR_LEN, MODULE_STRING, info->module_name);
+	dlerror();
+	dl_symbol = dlsym(dl_handle, str_buf);
+	error_msg = dlerror();
+	if (error_msg != NULL) {
+		dlclose(dl_handle);
+		return false;
+	}
+
+	info->dl_handle = dl_handle;
+	info->load_time_us = g_get_monotonic_time() - start;
+	g_atomic_pointer_set(&info->dl_symbol, dl_symbol);
+
+	log_dbg("Loaded %s module in %u us", info->module_name,
+			info->load_time_us);
 
-	if (!name || (platid < 0))
+	return true;
+}
+
+artik_module_ops os_request_api_module(const char *name)
+{
+	artik_module_info *info;
+	gint ref;
+
+	if (!name)
 		return INVALID_MODULE;
 
-	while (artik_api_modules[platid][i].object != NULL) {
-		if (!strncmp(artik_api_modules[platid][i].name, name,
-							MAX_MODULE_NAME)) {
-
-			mutex_lock();
-
-			node = artik_list_get_by_check(requested_node,
-				artik_compare_module_name, (void *)name);
-			if (node) {
-				module_name = ((artik_module_node *)
-							node)->info.module_name;
-				dl_symbol = ((artik_module_node *)
-							node)->info.dl_symbol;
-				dl_handle = ((artik_module_node *)
-							node)->info.dl_handle;
-			}
-
-			node = artik_list_add(&requested_node, 0,
-						sizeof(artik_module_node));
-			if (node == NULL) {
-				mutex_unlock();
-				return INVALID_MODULE;
-			} else if (dl_handle) {
-				/* don't need to call DL again */
-				goto exit;
-			}
-
-			memset(str_buf, 0, sizeof(str_buf));
-			snprintf(str_buf, MAX_STR_LEN, PATH_STRING,
-					artik_api_modules[platid][i].object,
-					LIB_VERSION_MAJOR,
-					LIB_VERSION_MINOR, LIB_VERSION_PATCH);
-			dl_handle = (void *)dlopen(str_buf, RTLD_NOW|RTLD_GLOBAL);
-			if (!dl_handle) {
-				mutex_unlock();
-				return INVALID_MODULE;
-			}
-
-			memset(str_buf, 0, sizeof(str_buf));
-			snprintf(str_buf, MAX_STR_LEN, MODULE_STRING, name);
-			dlerror();
-			dl_symbol = dlsym(dl_handle, str_buf);
-			error_msg = dlerror();
-			if (error_msg != NULL) {
-				dlclose(dl_handle);
-				mutex_unlock();
-				return INVALID_MODULE;
-			}
-
-exit:
-			if (module_name == NULL) {
-				len = strlen(name) + 1;
-				module_name = malloc(len);
-				if (module_name == NULL) {
-					dlclose(dl_handle);
-					mutex_unlock();
-					return INVALID_MODULE;
-				}
-				memset(module_name, 0, len);
-				strncpy(module_name, name, len);
-			}
-
-			((artik_module_node *)node)->info.module_name =
-								module_name;
-			((artik_module_node *)node)->info.dl_handle = dl_handle;
-			((artik_module_node *)node)->info.dl_symbol = dl_symbol;
-
-			mutex_unlock();
+	info = get_module_info(name);
+	if (!info)
+		return INVALID_MODULE;
 
-			break;
-		}
-		i++;
+	/*
+	 * Fast path: a module stays loaded as long as it is referenced, so
+	 * taking one more reference on a loaded module needs no lock.
+	 */
+	ref = g_atomic_int_get(&info->refcount);
+	while (ref > 0) {
+		if (g_atomic_int_compare_and_exchange(&info->refcount, ref,
+								ref + 1))
+			return (artik_module_ops)
+				g_atomic_pointer_get(&info->dl_symbol);
+		ref = g_atomic_int_get(&info->refcount);
+	}
+
+	pthread_mutex_lock(&info->lock);
+
+	if (!load_module_locked(info)) {
+		pthread_mutex_unlock(&info->lock);
+		return INVALID_MODULE;
 	}
 
-	return (artik_module_ops)dl_symbol;
+	g_atomic_int_inc(&info->refcount);
+
+	pthread_mutex_unlock(&info->lock);
+
+	return (artik_module_ops)info->dl_symbol;
 }
 
 artik_error os_release_api_module(const artik_module_ops module)
 {
-	artik_list *node = NULL;
-	artik_error ret = S_OK;
-	void *dl_handle = NULL;
-	char *module_name = NULL;
+	artik_module_info *info = NULL;
+	unsigned int i;
+	gint ref;
 
 	if (!module)
 		return E_BAD_ARGS;
 
-	mutex_lock();
+	pthread_once(&modules_once, modules_init);
+
+	for (i = 0; i < modules_count; i++) {
+		if (g_atomic_pointer_get(&platform_modules[i].dl_symbol) ==
+							(void *)module) {
+			info = &platform_modules[i];
+			break;
+		}
+	}
 
-	node = artik_list_get_by_check(requested_node, artik_compare_module_ops,
-									module);
-	if (node == NULL) {
+	if (!info) {
 		log_err("releasing invalid module");
-		ret = E_BAD_ARGS;
-		goto exit;
+		return E_BAD_ARGS;
 	}
 
-	dl_handle = ((artik_module_node *)node)->info.dl_handle;
-	module_name = ((artik_module_node *)node)->info.module_name;
+	/* Dropping a reference other than the last one needs no lock */
+	ref = g_atomic_int_get(&info->refcount);
+	while (ref > 1) {
+		if (g_atomic_int_compare_and_exchange(&info->refcount, ref,
+								ref - 1))
+			return S_OK;
+		ref = g_atomic_int_get(&info->refcount);
+	}
+
+	pthread_mutex_lock(&info->lock);
 
-	ret = artik_list_delete_check(&requested_node, artik_compare_module_ops,
-									module);
-	if (ret != S_OK) {
-		log_err("failed to delete module");
-		goto exit;
+	if (g_atomic_int_get(&info->refcount) <= 0) {
+		pthread_mutex_unlock(&info->lock);
+		log_err("releasing invalid module");
+		return E_BAD_ARGS;
 	}
 
-	node = artik_list_get_by_check(requested_node, artik_compare_module_ops,
-									module);
-	if (node == NULL) {
-		free(module_name);
-		dlclose(dl_handle);
+	/* Once the count reaches 0 the fast path no longer takes references */
+	if (g_atomic_int_dec_and_test(&info->refcount)) {
+		g_atomic_pointer_set(&info->dl_symbol, NULL);
+		dlclose(info->dl_handle);
+		info->dl_handle = NULL;
+	}
+
+	pthread_mutex_unlock(&info->lock);
+
+	return S_OK;
+}
+
+/* Load a module and keep it loaded for the lifetime of the process */
+static bool preload_module(artik_module_info *info)
+{
+	bool ret = true;
+
+	pthread_mutex_lock(&info->lock);
+
+	if (!info->preloaded) {
+		ret = load_module_locked(info);
+		if (ret) {
+			g_atomic_int_inc(&info->refcount);
+			info->preloaded = true;
+		} else {
+			log_err("Failed to preload %s module",
+					info->module_name);
+		}
 	}
 
-exit:
-	mutex_unlock();
+	pthread_mutex_unlock(&info->lock);
 
 	return ret;
 }
 
-int os_get_platform(void)
+static void *preload_thread(void *user_data)
+{
+	struct preload_context *ctx = user_data;
+	gint i;
+
+	while ((i = g_atomic_int_add(&ctx->next, 1)) < (gint)modules_count)
+		if (!preload_module(&platform_modules[i]))
+			g_atomic_int_inc(&ctx->failures);
+
+	return NULL;
+}
+
+artik_error os_preload_modules(void)
+{
+	pthread_t threads[PRELOAD_MAX_THREADS];
+	struct preload_context ctx = { 0, 0 };
+	unsigned int i, num_threads = 0;
+	long cpus;
+	gint64 start;
+
+	pthread_once(&modules_once, modules_init);
+
+	if (!platform_modules)
+		return E_NOT_SUPPORTED;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	start = g_get_monotonic_time();
+
+	/* The calling thread takes its share of the modules as well */
+	for (i = 1; i < MIN(modules_count, PRELOAD_MAX_THREADS) &&
+						i < (unsigned int)cpus; i++) {
+		if (pthread_create(&threads[num_threads], NULL, preload_thread,
+							&ctx))
+			break;
+		num_threads++;
+	}
+
+	preload_thread(&ctx);
+
+	for (i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	log_info("Preloaded %u modules in %lld us with %u threads",
+		modules_count - ctx.failures,
+		(long long)(g_get_monotonic_time() - start), num_threads + 1);
+
+	return ctx.failures ? E_NOT_SUPPORTED : S_OK;
+}
+
+artik_error os_get_modules_load_info(artik_module_load_info *info, int *num)
+{
+	unsigned int i;
+
+	if (!info || !num || *num < 0)
+		return E_BAD_ARGS;
+
+	pthread_once(&modules_once, modules_init);
+
+	for (i = 0; i < modules_count && i < (unsigned int)*num; i++) {
+		artik_module_info *module = &platform_modules[i];
+
+		pthread_mutex_lock(&module->lock);
+		strncpy(info[i].name, module->module_name, MAX_MODULE_NAME - 1);
+		info[i].name[MAX_MODULE_NAME - 1] = '\0';
+		info[i].loaded = module->dl_handle != NULL;
+		info[i].preloaded = module->preloaded;
+		info[i].load_time_us = module->load_time_us;
+		pthread_mutex_unlock(&module->lock);
+	}
+
+	*num = i;
+
+	return S_OK;
+}
+
+static void detect_platform(void)
 {
 	FILE *f = NULL;
 	char line[256];
 
-	if (artik_platform_id >= GENERIC)
-		goto exit;
-
 	f = fopen("/proc/device-tree/model", "re");
 	if (f == NULL)
-		return -1;
+		return;
 
 	if (fgets(line, sizeof(line), f) != NULL) {
 		if (strstr(line, "ARTIK5"))
@@ -283,8 +408,13 @@ int os_get_platform(void)
 			artik_platform_id = GENERIC;
 	}
 	fclose(f);
+}
+
+int os_get_platform(void)
+{
+	/* The model does not change at runtime, read it only once */
+	pthread_once(&platform_once, detect_platform);
 
-exit:
 	return artik_platform_id;
 }
 
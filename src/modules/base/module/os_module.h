@@ -24,6 +24,8 @@
 artik_error os_get_api_version(artik_api_version *version);
 artik_module_ops os_request_api_module(const char *name);
 artik_error os_release_api_module(const artik_module_ops module);
+artik_error os_preload_modules(void);
+artik_error os_get_modules_load_info(artik_module_load_info *info, int *num);
 int os_get_platform(void);
 artik_error os_get_platform_name(char *name);
 artik_error os_get_available_modules(artik_api_module **modules,
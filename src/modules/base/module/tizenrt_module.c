@@ -125,6 +125,17 @@ artik_error os_release_api_module(const artik_module_ops module)
 	return ret;
 }
 
+artik_error os_preload_modules(void)
+{
+	/* Modules are linked statically */
+	return S_OK;
+}
+
+artik_error os_get_modules_load_info(artik_module_load_info *info, int *num)
+{
+	return E_NOT_SUPPORTED;
+}
+
 int os_get_platform(void)
 {
 	/*
@@ -291,6 +291,23 @@ static artik_error unload_openssl_engine(void)
 	return os_security_unload_openssl_engine();
 }
 
+static artik_error get_ssl_credentials(const struct artik_ssl_config *ssl_config,
+		artik_ssl_credentials_handle *handle)
+{
+	return os_security_get_ssl_credentials(ssl_config, handle);
+}
+
+static artik_error apply_ssl_credentials(artik_ssl_credentials_handle handle,
+		void *ssl_ctx)
+{
+	return os_security_apply_ssl_credentials(handle, ssl_ctx);
+}
+
+static artik_error put_ssl_credentials(artik_ssl_credentials_handle handle)
+{
+	return os_security_put_ssl_credentials(handle);
+}
+
 EXPORT_API const artik_security_module security_module = {
 	.request                    = request,
 	.release                    = release,
@@ -328,5 +345,8 @@ EXPORT_API const artik_security_module security_module = {
 	.verify_signature_final     = verify_signature_final,
 	.convert_pem_to_der         = convert_pem_to_der,
 	.load_openssl_engine        = load_openssl_engine,
-	.unload_openssl_engine      = unload_openssl_engine
+	.unload_openssl_engine      = unload_openssl_engine,
+	.get_ssl_credentials        = get_ssl_credentials,
+	.apply_ssl_credentials      = apply_ssl_credentials,
+	.put_ssl_credentials        = put_ssl_credentials
 };
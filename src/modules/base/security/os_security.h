@@ -131,4 +131,11 @@ artik_error os_security_convert_pem_to_der(const char *pem_data,
 		unsigned char **der_data, unsigned int *length);
 artik_error os_security_load_openssl_engine(void);
 artik_error os_security_unload_openssl_engine(void);
+artik_error os_security_get_ssl_credentials(
+		const struct artik_ssl_config *ssl_config,
+		artik_ssl_credentials_handle *handle);
+artik_error os_security_apply_ssl_credentials(
+		artik_ssl_credentials_handle handle, void *ssl_ctx);
+artik_error os_security_put_ssl_credentials(
+		artik_ssl_credentials_handle handle);
 #endif  /* __OS_SECURITY_H__ */
@@ -1393,3 +1393,22 @@ artik_error os_security_unload_openssl_engine(void)
 {
 	return E_NOT_SUPPORTED;
 }
+
+artik_error os_security_get_ssl_credentials(
+		const struct artik_ssl_config *ssl_config,
+		artik_ssl_credentials_handle *handle)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_security_apply_ssl_credentials(
+		artik_ssl_credentials_handle handle, void *ssl_ctx)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_security_put_ssl_credentials(
+		artik_ssl_credentials_handle handle)
+{
+	return E_NOT_SUPPORTED;
+}
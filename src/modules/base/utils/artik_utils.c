@@ -17,6 +17,7 @@
  */
 
 #include "os_utils.h"
+#include "json_tokenizer.h"
 
 static artik_error get_uri_info(artik_uri_info *uri_info, const char *uri);
 static artik_error free_uri_info(artik_uri_info *uri_info);
@@ -24,6 +25,13 @@ static artik_error free_uri_info(artik_uri_info *uri_info);
 EXPORT_API const artik_utils_module utils_module = {
 	get_uri_info,
 	free_uri_info,
+	json_init,
+	json_feed,
+	json_next,
+	json_get_path,
+	json_path_match,
+	json_find,
+	json_copy_string,
 };
 
 artik_error get_uri_info(artik_uri_info *uri_info, const char *uri)
@@ -0,0 +1,744 @@
+/*
+ *
+ * Copyright 2018 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include "json_tokenizer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "artik_log.h"
+
+/*
+ * The tokenizer is a push down automaton: state[0] is the state of the
+ * root value and state[d] the one of the container at depth d. Strings
+ * and primitives are scanned in place; when one of them reaches the end
+ * of a chunk, the part already seen is kept in the scratch buffer and
+ * the scan resumes on the next chunk.
+ *
+ * The path of the current value is maintained in a single buffer,
+ * path_len[d] being the length of the path of the container at depth
+ * d, to which its members and elements are appended.
+ */
+enum json_state {
+	ST_VALUE,		/* Root value expected */
+	ST_DONE,		/* Root value complete */
+	ST_OBJ_FIRST,		/* Key or '}' expected */
+	ST_OBJ_KEY,		/* Key expected */
+	ST_OBJ_COLON,		/* ':' expected */
+	ST_OBJ_VALUE,		/* Member value expected */
+	ST_OBJ_NEXT,		/* ',' or '}' expected */
+	ST_ARR_FIRST,		/* Element or ']' expected */
+	ST_ARR_VALUE,		/* Element expected */
+	ST_ARR_NEXT		/* ',' or ']' expected */
+};
+
+enum json_lex {
+	LEX_NONE,
+	LEX_KEY,
+	LEX_STRING,
+	LEX_PRIMITIVE
+};
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+static bool is_primitive_char(char c)
+{
+	return is_digit(c) || (c >= 'a' && c <= 'z') ||
+		(c >= 'A' && c <= 'Z') || c == '+' || c == '-' || c == '.';
+}
+
+static bool is_number(const char *s, unsigned int len)
+{
+	unsigned int i = 0;
+
+	if (i < len && s[i] == '-')
+		i++;
+
+	if (i < len && s[i] == '0') {
+		i++;
+	} else if (i < len && is_digit(s[i])) {
+		while (i < len && is_digit(s[i]))
+			i++;
+	} else {
+		return false;
+	}
+
+	if (i < len && s[i] == '.') {
+		i++;
+		if (i >= len || !is_digit(s[i]))
+			return false;
+		while (i < len && is_digit(s[i]))
+			i++;
+	}
+
+	if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+		i++;
+		if (i < len && (s[i] == '+' || s[i] == '-'))
+			i++;
+		if (i >= len || !is_digit(s[i]))
+			return false;
+		while (i < len && is_digit(s[i]))
+			i++;
+	}
+
+	return i == len;
+}
+
+static artik_error fail(artik_json_tokenizer *tk, artik_error err)
+{
+	if (err == E_INVALID_VALUE)
+		log_dbg("Malformed JSON at offset %u", tk->pos);
+
+	tk->error = err;
+
+	return err;
+}
+
+static artik_error scratch_append(artik_json_tokenizer *tk, const char *data,
+		unsigned int len)
+{
+	if (tk->scratch_len + len > tk->scratch_size)
+		return fail(tk, E_OVERFLOW);
+
+	memcpy(tk->scratch + tk->scratch_len, data, len);
+	tk->scratch_len += len;
+
+	return S_OK;
+}
+
+static void path_truncate(artik_json_tokenizer *tk, unsigned int len)
+{
+	tk->cur_path_len = len;
+	tk->path[len] = '\0';
+}
+
+static artik_error path_set_index(artik_json_tokenizer *tk)
+{
+	unsigned int base = tk->path_len[tk->depth];
+	int len;
+
+	len = snprintf(tk->path + base, ARTIK_JSON_PATH_MAX - base, "[%u]",
+			tk->index[tk->depth]++);
+	if (len < 0 || base + len >= ARTIK_JSON_PATH_MAX)
+		return fail(tk, E_OVERFLOW);
+
+	tk->cur_path_len = base + len;
+
+	return S_OK;
+}
+
+static artik_error path_set_key(artik_json_tokenizer *tk, const char *key,
+		unsigned int len)
+{
+	unsigned int base = tk->path_len[tk->depth];
+	unsigned int sep = base ? 1 : 0;
+
+	if (base + sep + len >= ARTIK_JSON_PATH_MAX)
+		return fail(tk, E_OVERFLOW);
+
+	if (sep)
+		tk->path[base] = '.';
+	memcpy(tk->path + base + sep, key, len);
+	path_truncate(tk, base + sep + len);
+
+	return S_OK;
+}
+
+/* Move the enclosing container to the state following one of its values */
+static void value_done(artik_json_tokenizer *tk)
+{
+	uint8_t *state = &tk->state[tk->depth];
+
+	if (*state == ST_VALUE)
+		*state = ST_DONE;
+	else if (*state == ST_OBJ_VALUE)
+		*state = ST_OBJ_NEXT;
+	else
+		*state = ST_ARR_NEXT;
+}
+
+static artik_error emit(artik_json_token *token, artik_json_type type,
+		const char *value, unsigned int len, unsigned int depth)
+{
+	token->type = type;
+	token->value = value;
+	token->len = len;
+	token->depth = depth;
+
+	return S_OK;
+}
+
+/*
+ * Scan the string being read from the current position, emitting it
+ * once its closing quote is found.
+ */
+static artik_error scan_string(artik_json_tokenizer *tk,
+		artik_json_token *token)
+{
+	unsigned int start = tk->pos;
+	const char *value;
+	unsigned int len;
+	artik_error ret;
+
+	while (tk->pos < tk->len) {
+		char c = tk->data[tk->pos];
+
+		if (tk->escape == 1) {
+			if (c == 'u')
+				tk->escape = 5;
+			else if (strchr("\"\\/bfnrt", c))
+				tk->escape = 0;
+			else
+				return fail(tk, E_INVALID_VALUE);
+		} else if (tk->escape) {
+			if (hex_value(c) < 0)
+				return fail(tk, E_INVALID_VALUE);
+			if (--tk->escape == 1)
+				tk->escape = 0;
+		} else if (c == '\\') {
+			tk->escape = 1;
+		} else if (c == '"') {
+			break;
+		} else if ((unsigned char)c < 0x20) {
+			return fail(tk, E_INVALID_VALUE);
+		}
+
+		tk->pos++;
+	}
+
+	if (tk->pos == tk->len) {
+		if (tk->last)
+			return fail(tk, E_INVALID_VALUE);
+
+		ret = scratch_append(tk, tk->data + start, tk->pos - start);
+		return ret == S_OK ? E_TRY_AGAIN : ret;
+	}
+
+	if (tk->scratch_len) {
+		ret = scratch_append(tk, tk->data + start, tk->pos - start);
+		if (ret != S_OK)
+			return ret;
+		value = tk->scratch;
+		len = tk->scratch_len;
+	} else {
+		value = tk->data + start;
+		len = tk->pos - start;
+	}
+
+	/* Skip the closing quote */
+	tk->pos++;
+
+	if (tk->lex == LEX_KEY) {
+		tk->lex = LEX_NONE;
+		tk->state[tk->depth] = ST_OBJ_COLON;
+		ret = path_set_key(tk, value, len);
+		if (ret != S_OK)
+			return ret;
+
+		return emit(token, ARTIK_JSON_KEY, value, len, tk->depth);
+	}
+
+	tk->lex = LEX_NONE;
+
+	return emit(token, ARTIK_JSON_STRING, value, len, tk->depth);
+}
+
+/*
+ * Scan the number or literal being read from the current position. As
+ * primitives have no delimiter, one reaching the end of a chunk is only
+ * complete once the next chunk or the end of the document is seen.
+ */
+static artik_error scan_primitive(artik_json_tokenizer *tk,
+		artik_json_token *token)
+{
+	unsigned int start = tk->pos;
+	artik_json_type type;
+	const char *value;
+	unsigned int len;
+	artik_error ret;
+
+	while (tk->pos < tk->len && is_primitive_char(tk->data[tk->pos]))
+		tk->pos++;
+
+	if (tk->pos == tk->len && !tk->last) {
+		ret = scratch_append(tk, tk->data + start, tk->pos - start);
+		return ret == S_OK ? E_TRY_AGAIN : ret;
+	}
+
+	if (tk->scratch_len) {
+		ret = scratch_append(tk, tk->data + start, tk->pos - start);
+		if (ret != S_OK)
+			return ret;
+		value = tk->scratch;
+		len = tk->scratch_len;
+	} else {
+		value = tk->data + start;
+		len = tk->pos - start;
+	}
+
+	if (len == 4 && !memcmp(value, "true", 4))
+		type = ARTIK_JSON_TRUE;
+	else if (len == 5 && !memcmp(value, "false", 5))
+		type = ARTIK_JSON_FALSE;
+	else if (len == 4 && !memcmp(value, "null", 4))
+		type = ARTIK_JSON_NULL;
+	else if (is_number(value, len))
+		type = ARTIK_JSON_NUMBER;
+	else
+		return fail(tk, E_INVALID_VALUE);
+
+	tk->lex = LEX_NONE;
+
+	return emit(token, type, value, len, tk->depth);
+}
+
+static artik_error scan(artik_json_tokenizer *tk, artik_json_token *token)
+{
+	if (tk->lex == LEX_PRIMITIVE)
+		return scan_primitive(tk, token);
+
+	return scan_string(tk, token);
+}
+
+static artik_error begin_value(artik_json_tokenizer *tk,
+		artik_json_token *token)
+{
+	char c = tk->data[tk->pos];
+	uint8_t state = tk->state[tk->depth];
+	artik_error ret;
+
+	if (state == ST_ARR_FIRST || state == ST_ARR_VALUE) {
+		ret = path_set_index(tk);
+		if (ret != S_OK)
+			return ret;
+	} else if (state == ST_VALUE) {
+		path_truncate(tk, 0);
+	}
+
+	value_done(tk);
+
+	if (c == '{' || c == '[') {
+		unsigned int depth = tk->depth;
+
+		if (depth == ARTIK_JSON_MAX_DEPTH)
+			return fail(tk, E_OVERFLOW);
+
+		tk->depth++;
+		tk->state[tk->depth] = c == '{' ? ST_OBJ_FIRST : ST_ARR_FIRST;
+		tk->index[tk->depth] = 0;
+		tk->path_len[tk->depth] = tk->cur_path_len;
+		tk->pos++;
+
+		return emit(token, c == '{' ? ARTIK_JSON_OBJECT_START :
+				ARTIK_JSON_ARRAY_START, tk->data + tk->pos - 1,
+				1, depth);
+	}
+
+	tk->scratch_len = 0;
+	tk->escape = 0;
+
+	if (c == '"') {
+		tk->lex = LEX_STRING;
+		tk->pos++;
+		return scan_string(tk, token);
+	}
+
+	if (c == '-' || is_digit(c) || c == 't' || c == 'f' || c == 'n') {
+		tk->lex = LEX_PRIMITIVE;
+		return scan_primitive(tk, token);
+	}
+
+	return fail(tk, E_INVALID_VALUE);
+}
+
+static artik_error end_container(artik_json_tokenizer *tk,
+		artik_json_token *token)
+{
+	char c = tk->data[tk->pos];
+
+	path_truncate(tk, tk->path_len[tk->depth]);
+	tk->depth--;
+	tk->pos++;
+
+	return emit(token, c == '}' ? ARTIK_JSON_OBJECT_END :
+			ARTIK_JSON_ARRAY_END, tk->data + tk->pos - 1, 1,
+			tk->depth);
+}
+
+artik_error json_init(artik_json_tokenizer *tokenizer, char *scratch,
+		unsigned int scratch_size)
+{
+	if (!tokenizer || (!scratch && scratch_size))
+		return E_BAD_ARGS;
+
+	memset(tokenizer, 0, sizeof(artik_json_tokenizer));
+	tokenizer->scratch = scratch;
+	tokenizer->scratch_size = scratch_size;
+	tokenizer->state[0] = ST_VALUE;
+	tokenizer->lex = LEX_NONE;
+
+	return S_OK;
+}
+
+static artik_error feed(artik_json_tokenizer *tk, const char *data,
+		unsigned int len, bool last)
+{
+	if (tk->last)
+		return E_BAD_ARGS;
+
+	if (tk->pos < tk->len && !tk->error && tk->state[0] != ST_DONE)
+		return E_BUSY;
+
+	tk->data = data;
+	tk->len = len;
+	tk->pos = 0;
+	tk->last = last;
+
+	return S_OK;
+}
+
+artik_error json_feed(artik_json_tokenizer *tokenizer, const char *data,
+		unsigned int len)
+{
+	if (!tokenizer || (!data && len))
+		return E_BAD_ARGS;
+
+	if (!data)
+		return feed(tokenizer, NULL, 0, true);
+
+	return feed(tokenizer, data, len, false);
+}
+
+artik_error json_next(artik_json_tokenizer *tokenizer,
+		artik_json_token *token)
+{
+	artik_json_tokenizer *tk = tokenizer;
+
+	if (!tk || !token)
+		return E_BAD_ARGS;
+
+	if (tk->error)
+		return tk->error;
+
+	if (tk->lex != LEX_NONE)
+		return scan(tk, token);
+
+	while (tk->depth || tk->state[0] != ST_DONE) {
+		char c;
+
+		if (tk->pos == tk->len) {
+			if (tk->last)
+				return fail(tk, E_INVALID_VALUE);
+			return E_TRY_AGAIN;
+		}
+
+		c = tk->data[tk->pos];
+		if (is_space(c)) {
+			tk->pos++;
+			continue;
+		}
+
+		switch (tk->state[tk->depth]) {
+		case ST_OBJ_FIRST:
+			if (c == '}')
+				return end_container(tk, token);
+			/* Fall through */
+		case ST_OBJ_KEY:
+			if (c != '"')
+				return fail(tk, E_INVALID_VALUE);
+			tk->scratch_len = 0;
+			tk->escape = 0;
+			tk->lex = LEX_KEY;
+			tk->pos++;
+			return scan_string(tk, token);
+		case ST_OBJ_COLON:
+			if (c != ':')
+				return fail(tk, E_INVALID_VALUE);
+			tk->state[tk->depth] = ST_OBJ_VALUE;
+			tk->pos++;
+			break;
+		case ST_OBJ_NEXT:
+			if (c == '}')
+				return end_container(tk, token);
+			if (c != ',')
+				return fail(tk, E_INVALID_VALUE);
+			tk->state[tk->depth] = ST_OBJ_KEY;
+			tk->pos++;
+			break;
+		case ST_ARR_FIRST:
+			if (c == ']')
+				return end_container(tk, token);
+			return begin_value(tk, token);
+		case ST_ARR_NEXT:
+			if (c == ']')
+				return end_container(tk, token);
+			if (c != ',')
+				return fail(tk, E_INVALID_VALUE);
+			tk->state[tk->depth] = ST_ARR_VALUE;
+			tk->pos++;
+			break;
+		default:
+			return begin_value(tk, token);
+		}
+	}
+
+	/* Only whitespace may follow the root value */
+	for (;;) {
+		if (tk->pos == tk->len) {
+			if (!tk->last)
+				return E_TRY_AGAIN;
+			break;
+		}
+
+		if (!is_space(tk->data[tk->pos]))
+			return fail(tk, E_INVALID_VALUE);
+		tk->pos++;
+	}
+
+	return emit(token, ARTIK_JSON_END, NULL, 0, 0);
+}
+
+const char *json_get_path(artik_json_tokenizer *tokenizer)
+{
+	if (!tokenizer)
+		return NULL;
+
+	return tokenizer->path;
+}
+
+bool json_path_match(artik_json_tokenizer *tokenizer, const char *pattern)
+{
+	const char *p = pattern;
+	const char *s;
+
+	if (!tokenizer || !pattern)
+		return false;
+
+	s = tokenizer->path;
+
+	while (*p) {
+		if (p[0] == '[' && p[1] == '*' && p[2] == ']') {
+			if (*s != '[')
+				return false;
+			s = strchr(s, ']');
+			if (!s)
+				return false;
+			s++;
+			p += 3;
+		} else if (*p == '*') {
+			while (*s && *s != '.' && *s != '[')
+				s++;
+			p++;
+		} else if (*p++ != *s++) {
+			return false;
+		}
+	}
+
+	return *s == '\0';
+}
+
+artik_error json_find(const char *json, unsigned int len,
+		const char *pattern, artik_json_token *token)
+{
+	artik_json_tokenizer tk;
+	artik_json_token t;
+	artik_error ret;
+
+	if (!json || !pattern || !token)
+		return E_BAD_ARGS;
+
+	json_init(&tk, NULL, 0);
+	feed(&tk, json, len, true);
+
+	while ((ret = json_next(&tk, &t)) == S_OK) {
+		const char *start = t.value;
+		unsigned int depth = t.depth;
+
+		if (t.type == ARTIK_JSON_END)
+			return E_NOT_FOUND;
+
+		if (t.type == ARTIK_JSON_KEY || t.type == ARTIK_JSON_OBJECT_END
+				|| t.type == ARTIK_JSON_ARRAY_END)
+			continue;
+
+		if (!json_path_match(&tk, pattern))
+			continue;
+
+		if (t.type == ARTIK_JSON_OBJECT_START ||
+				t.type == ARTIK_JSON_ARRAY_START) {
+			artik_json_type type = t.type;
+
+			/* Span the whole container */
+			do {
+				ret = json_next(&tk, &t);
+				if (ret != S_OK)
+					return ret;
+			} while (t.depth != depth ||
+					(t.type != ARTIK_JSON_OBJECT_END &&
+					 t.type != ARTIK_JSON_ARRAY_END));
+
+			return emit(token, type, start,
+					t.value + 1 - start, depth);
+		}
+
+		*token = t;
+		return S_OK;
+	}
+
+	return ret;
+}
+
+static unsigned int utf8_encode(unsigned long cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	}
+
+	if (cp < 0x800) {
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	}
+
+	if (cp < 0x10000) {
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+
+	out[0] = 0xf0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3f);
+	out[2] = 0x80 | ((cp >> 6) & 0x3f);
+	out[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+static unsigned long read_hex4(const char *s)
+{
+	return (hex_value(s[0]) << 12) | (hex_value(s[1]) << 8) |
+		(hex_value(s[2]) << 4) | hex_value(s[3]);
+}
+
+artik_error json_copy_string(const artik_json_token *token, char *dst,
+		unsigned int size)
+{
+	const char *s;
+	const char *end;
+	unsigned int len = 0;
+
+	if (!token || !dst || !size || (!token->value && token->len))
+		return E_BAD_ARGS;
+
+	s = token->value;
+	end = s + token->len;
+
+	if (token->type != ARTIK_JSON_STRING && token->type != ARTIK_JSON_KEY) {
+		if (token->len >= size)
+			return E_OVERFLOW;
+		memcpy(dst, s, token->len);
+		dst[token->len] = '\0';
+		return S_OK;
+	}
+
+	while (s < end) {
+		char buf[4];
+		unsigned int n = 1;
+
+		buf[0] = *s++;
+
+		if (buf[0] == '\\' && s < end) {
+			char c = *s++;
+
+			switch (c) {
+			case 'b':
+				buf[0] = '\b';
+				break;
+			case 'f':
+				buf[0] = '\f';
+				break;
+			case 'n':
+				buf[0] = '\n';
+				break;
+			case 'r':
+				buf[0] = '\r';
+				break;
+			case 't':
+				buf[0] = '\t';
+				break;
+			case 'u': {
+				unsigned long cp;
+
+				if (end - s < 4)
+					return E_INVALID_VALUE;
+				cp = read_hex4(s);
+				s += 4;
+
+				/* Combine surrogate pairs */
+				if (cp >= 0xd800 && cp < 0xdc00 && end - s >= 6 &&
+						s[0] == '\\' && s[1] == 'u') {
+					unsigned long low = read_hex4(s + 2);
+
+					if (low >= 0xdc00 && low < 0xe000) {
+						cp = 0x10000 + ((cp - 0xd800) << 10)
+							+ (low - 0xdc00);
+						s += 6;
+					}
+				}
+
+				n = utf8_encode(cp, buf);
+				break;
+			}
+			default:
+				buf[0] = c;
+				break;
+			}
+		}
+
+		if (len + n >= size)
+			return E_OVERFLOW;
+
+		memcpy(dst + len, buf, n);
+		len += n;
+	}
+
+	dst[len] = '\0';
+
+	return S_OK;
+}
@@ -0,0 +1,38 @@
+/*
+ *
+ * Copyright 2018 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef _JSON_TOKENIZER_H_
+#define _JSON_TOKENIZER_H_
+
+#include "artik_utils.h"
+#include "artik_error.h"
+
+artik_error json_init(artik_json_tokenizer *tokenizer, char *scratch,
+		unsigned int scratch_size);
+artik_error json_feed(artik_json_tokenizer *tokenizer, const char *data,
+		unsigned int len);
+artik_error json_next(artik_json_tokenizer *tokenizer,
+		artik_json_token *token);
+const char *json_get_path(artik_json_tokenizer *tokenizer);
+bool json_path_match(artik_json_tokenizer *tokenizer, const char *pattern);
+artik_error json_find(const char *json, unsigned int len,
+		const char *pattern, artik_json_token *token);
+artik_error json_copy_string(const artik_json_token *token, char *dst,
+		unsigned int size);
+
+#endif /* _JSON_TOKENIZER_H_ */
@@ -38,6 +38,7 @@
 #include <coap/pdu.h>
 #include <coap/subscribe.h>
 #include <coap/net.h>
+#include <coap/coap_io.h>
 #include "coap_list.h"
 
 
@@ -69,11 +70,27 @@ static unsigned char prime_256v1[] = {
 	0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07
 };
 
+#define LOOP_MAX_SOCKETS	64
+
+typedef struct {
+	int fd;
+	enum watch_io io;
+	int watch_id;
+} os_coap_watch;
+
 typedef struct {
-	int loop_process_id;
 	coap_context_t *ctx;
+	artik_loop_module *loop;
+	os_coap_watch *watches;
+	unsigned int num_watches;
+	int timeout_id;
+	bool server;
+	bool servicing;
+	bool stopped;
 } os_coap_data;
 
+static void loop_stop(os_coap_data *data);
+
 typedef struct {
 	coap_context_t *ctx;
 	coap_session_t *session;
@@ -1180,8 +1197,6 @@ static void nack_handler(struct coap_context_t *ctx,
 	artik_coap_error error = ARTIK_COAP_ERROR_NONE;
 	coap_node *node = (coap_node *)artik_list_get_by_handle(
 		requested_node, (ARTIK_LIST_HANDLE)ctx);
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
 	os_coap_data *data = NULL;
 
 	log_dbg("");
@@ -1240,15 +1255,9 @@ static void nack_handler(struct coap_context_t *ctx,
 		return;
 
 	if (!node->interface.connected) {
-
-		if (loop->remove_idle_callback(data->loop_process_id)
-								!= S_OK)
-			log_err("Fail to remove callback");
-
-		free(data);
+		loop_stop(data);
+		node->interface.coap_data = NULL;
 	}
-
-	artik_release_api_module(loop);
 }
 
 static void get_resource_handler(coap_context_t *ctx,
@@ -1775,24 +1784,225 @@ static bool init_resources(coap_context_t *ctx, artik_coap_resource *resources,
 	return true;
 }
 
-static int client_loop_handler(void *arg)
+/*
+ * libcoap is driven from the loop: coap_write() reports the sockets it
+ * waits on along with the delay until the next retransmission or DTLS
+ * timeout, those sockets are watched and a timeout is armed for that
+ * delay. A context without traffic nor pending retransmission does not
+ * wake the process up.
+ */
+static void loop_service(os_coap_data *data, int fd, enum watch_io io);
+
+static enum watch_io loop_socket_io(const coap_socket_t *sock)
 {
-	os_coap_data *data = (os_coap_data *)arg;
+	enum watch_io io = 0;
 
-	coap_run_once(data->ctx, 10);
+	if (sock->fd < 0)
+		return 0;
+
+	if (sock->flags & COAP_SOCKET_WANT_DATA)
+		io |= WATCH_IO_IN;
+	if (sock->flags & COAP_SOCKET_WANT_WRITE)
+		io |= WATCH_IO_OUT;
+
+	return io ? io | WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL : 0;
+}
 
+static int loop_watch_callback(int fd, enum watch_io io, void *user_data)
+{
+	loop_service((os_coap_data *)user_data, fd, io);
+
+	/* Watches are removed by loop_sync() when libcoap drops the socket */
 	return 1;
 }
 
-static int server_loop_handler(void *arg)
+static void loop_timeout_callback(void *user_data)
 {
-	os_coap_data *data = (os_coap_data *)arg;
+	os_coap_data *data = (os_coap_data *)user_data;
 
-	coap_run_once(data->ctx, 10);
+	data->timeout_id = 0;
+	loop_service(data, -1, 0);
+}
 
-	coap_check_notify(data->ctx);
+static void loop_unwatch(os_coap_data *data)
+{
+	unsigned int i;
 
-	return 1;
+	for (i = 0; i < data->num_watches; i++)
+		data->loop->remove_fd_watch(data->watches[i].watch_id);
+
+	data->num_watches = 0;
+
+	if (data->timeout_id) {
+		data->loop->remove_timeout_callback(data->timeout_id);
+		data->timeout_id = 0;
+	}
+}
+
+/* Match the watches and the timeout to what libcoap waits for */
+static void loop_sync(os_coap_data *data, coap_socket_t *sockets[],
+		unsigned int num_sockets, unsigned int timeout)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < data->num_watches;) {
+		os_coap_watch *watch = &data->watches[i];
+		enum watch_io io = 0;
+
+		for (j = 0; j < num_sockets; j++)
+			if (sockets[j]->fd == watch->fd)
+				io |= loop_socket_io(sockets[j]);
+
+		if (io == watch->io) {
+			i++;
+			continue;
+		}
+
+		data->loop->remove_fd_watch(watch->watch_id);
+		*watch = data->watches[--data->num_watches];
+	}
+
+	for (i = 0; i < num_sockets; i++) {
+		os_coap_watch *watch;
+		enum watch_io io = 0;
+		int fd = sockets[i]->fd;
+
+		for (j = 0; j < data->num_watches; j++)
+			if (data->watches[j].fd == fd)
+				break;
+
+		if (j < data->num_watches)
+			continue;
+
+		for (j = i; j < num_sockets; j++)
+			if (sockets[j]->fd == fd)
+				io |= loop_socket_io(sockets[j]);
+
+		if (!io)
+			continue;
+
+		watch = realloc(data->watches,
+			(data->num_watches + 1) * sizeof(os_coap_watch));
+		if (!watch) {
+			log_err("Memory problem");
+			break;
+		}
+
+		data->watches = watch;
+		watch = &data->watches[data->num_watches];
+		watch->fd = fd;
+		watch->io = io;
+		if (data->loop->add_fd_watch(fd, io, loop_watch_callback, data,
+				&watch->watch_id) != S_OK) {
+			log_err("Fail to watch CoAP socket");
+			continue;
+		}
+
+		data->num_watches++;
+	}
+
+	if (data->timeout_id) {
+		data->loop->remove_timeout_callback(data->timeout_id);
+		data->timeout_id = 0;
+	}
+
+	if (timeout && data->loop->add_timeout_callback(&data->timeout_id,
+			timeout, loop_timeout_callback, data) != S_OK)
+		log_err("Fail to add timeout callback");
+}
+
+static void loop_service(os_coap_data *data, int fd, enum watch_io io)
+{
+	coap_socket_t *sockets[LOOP_MAX_SOCKETS];
+	unsigned int num_sockets = 0;
+	unsigned int timeout;
+	unsigned int i;
+	coap_tick_t now;
+
+	/* Called back from libcoap, the outer call syncs the watches */
+	if (data->servicing)
+		return;
+
+	data->servicing = true;
+
+	coap_ticks(&now);
+	timeout = coap_write(data->ctx, sockets, LOOP_MAX_SOCKETS, &num_sockets,
+			now);
+
+	if (fd >= 0) {
+		for (i = 0; i < num_sockets; i++) {
+			if (sockets[i]->fd != fd)
+				continue;
+
+			if ((sockets[i]->flags & COAP_SOCKET_WANT_DATA) &&
+				(io & (WATCH_IO_IN | WATCH_IO_ERR | WATCH_IO_HUP)))
+				sockets[i]->flags |= COAP_SOCKET_HAS_DATA;
+			if ((sockets[i]->flags & COAP_SOCKET_WANT_WRITE) &&
+				(io & WATCH_IO_OUT))
+				sockets[i]->flags |= COAP_SOCKET_CAN_WRITE;
+		}
+
+		coap_ticks(&now);
+		coap_read(data->ctx, now);
+	}
+
+	if (data->server && !data->stopped)
+		coap_check_notify(data->ctx);
+
+	/* Reading may have queued responses or released sessions */
+	if (!data->stopped && (fd >= 0 || data->server)) {
+		coap_ticks(&now);
+		timeout = coap_write(data->ctx, sockets, LOOP_MAX_SOCKETS,
+				&num_sockets, now);
+	}
+
+	data->servicing = false;
+
+	if (data->stopped) {
+		free(data->watches);
+		artik_release_api_module(data->loop);
+		free(data);
+		return;
+	}
+
+	loop_sync(data, sockets, num_sockets, timeout);
+}
+
+static os_coap_data *loop_start(coap_context_t *ctx, bool server)
+{
+	os_coap_data *data = (os_coap_data *)malloc(sizeof(os_coap_data));
+
+	if (!data)
+		return NULL;
+
+	memset(data, 0, sizeof(os_coap_data));
+
+	data->loop = (artik_loop_module *)artik_request_api_module("loop");
+	if (!data->loop) {
+		free(data);
+		return NULL;
+	}
+
+	data->ctx = ctx;
+	data->server = server;
+
+	loop_service(data, -1, 0);
+
+	return data;
+}
+
+/* Safe to call from a libcoap handler, the data is then freed on return */
+static void loop_stop(os_coap_data *data)
+{
+	loop_unwatch(data);
+	data->stopped = true;
+
+	if (data->servicing)
+		return;
+
+	free(data->watches);
+	artik_release_api_module(data->loop);
+	free(data);
 }
 
 artik_error os_coap_create_client(artik_coap_handle *client,
@@ -1902,8 +2112,6 @@ exit:
 artik_error os_coap_connect(artik_coap_handle client)
 {
 	artik_error ret = S_OK;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
 	coap_node *node = (coap_node *)artik_list_get_by_handle(
 		requested_node, (ARTIK_LIST_HANDLE)client);
 	artik_coap_config *config = NULL;
@@ -1974,7 +2182,7 @@ artik_error os_coap_connect(artik_coap_handle client)
 	coap_register_response_handler(ctx, message_handler);
 	coap_register_nack_handler(ctx, nack_handler);
 
-	node->interface.coap_data = (os_coap_data *)malloc(sizeof(os_coap_data));
+	node->interface.coap_data = loop_start(ctx, false);
 
 	if (!node->interface.coap_data) {
 		log_err("Memory problem");
@@ -1982,22 +2190,9 @@ artik_error os_coap_connect(artik_coap_handle client)
 		goto exit;
 	}
 
-	memset(node->interface.coap_data, 0, sizeof(os_coap_data));
-
-	node->interface.coap_data->ctx = ctx;
-
-	if (loop->add_idle_callback(&node->interface.coap_data->loop_process_id,
-		client_loop_handler, node->interface.coap_data) != S_OK) {
-		log_err("Fail to add idle callback");
-		ret = E_COAP_ERROR;
-		goto exit;
-	}
-
 	node->interface.connected = true;
 
 exit:
-	artik_release_api_module(loop);
-
 	return ret;
 }
 
@@ -2006,8 +2201,6 @@ artik_error os_coap_disconnect(artik_coap_handle client)
 	artik_error ret = S_OK;
 	coap_node *node = (coap_node *)artik_list_get_by_handle(
 		requested_node, (ARTIK_LIST_HANDLE)client);
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
 	os_coap_data *data = NULL;
 
 	log_dbg("");
@@ -2040,20 +2233,12 @@ artik_error os_coap_disconnect(artik_coap_handle client)
 		goto exit;
 	}
 
-	if (loop->remove_idle_callback(data->loop_process_id) != S_OK) {
-		log_err("Fail to remove callback");
-		ret = E_COAP_ERROR;
-		goto exit;
-	}
-
 	node->interface.connected = false;
 
-	if (node->interface.coap_data)
-		free(node->interface.coap_data);
+	loop_stop(data);
+	node->interface.coap_data = NULL;
 
 exit:
-	artik_release_api_module(loop);
-
 	return ret;
 }
 
@@ -2275,8 +2460,6 @@ artik_error os_coap_start_server(artik_coap_handle server)
 	artik_error ret = S_OK;
 	coap_node *node = (coap_node *)artik_list_get_by_handle(
 		requested_node, (ARTIK_LIST_HANDLE)server);
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
 	artik_coap_config *config = NULL;
 	coap_context_t *ctx = NULL;
 	bool enable_dtls;
@@ -2326,7 +2509,7 @@ artik_error os_coap_start_server(artik_coap_handle server)
 		goto exit;
 	}
 
-	node->interface.coap_data = (os_coap_data *)coap_malloc(sizeof(os_coap_data));
+	node->interface.coap_data = loop_start(ctx, true);
 
 	if (!node->interface.coap_data) {
 		log_err("Memory problem");
@@ -2334,22 +2517,9 @@ artik_error os_coap_start_server(artik_coap_handle server)
 		goto exit;
 	}
 
-	memset(node->interface.coap_data, 0, sizeof(os_coap_data));
-
-	node->interface.coap_data->ctx = ctx;
-
-	if (loop->add_idle_callback(&node->interface.coap_data->loop_process_id,
-		server_loop_handler, node->interface.coap_data) != S_OK) {
-		log_err("Fail to add idle callback");
-		ret = E_COAP_ERROR;
-		goto exit;
-	}
-
 	node->interface.started = true;
 
 exit:
-	artik_release_api_module(loop);
-
 	return ret;
 }
 
@@ -2358,8 +2528,6 @@ artik_error os_coap_stop_server(artik_coap_handle server)
 	artik_error ret = S_OK;
 	coap_node *node = (coap_node *)artik_list_get_by_handle(
 		requested_node, (ARTIK_LIST_HANDLE)server);
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
 	os_coap_data *data = NULL;
 
 	log_dbg("");
@@ -2384,20 +2552,12 @@ artik_error os_coap_stop_server(artik_coap_handle server)
 		goto exit;
 	}
 
-	if (loop->remove_idle_callback(data->loop_process_id) != S_OK) {
-		log_err("Fail to remove callback");
-		ret = E_COAP_ERROR;
-		goto exit;
-	}
-
 	node->interface.started = false;
 
-	if (data)
-		free(data);
+	loop_stop(data);
+	node->interface.coap_data = NULL;
 
 exit:
-	artik_release_api_module(loop);
-
 	return ret;
 }
 
@@ -2511,6 +2671,9 @@ artik_error os_coap_send_message(artik_coap_handle handle,
 	if (coap_send(node->interface.session, pdu) == COAP_INVALID_TID) {
 		log_err("Fail to send CoAP message");
 		ret = E_COAP_ERROR;
+	} else if (node->interface.coap_data) {
+		/* Arm the retransmission timeout */
+		loop_service(node->interface.coap_data, -1, 0);
 	}
 
 exit:
@@ -2634,6 +2797,9 @@ artik_error os_coap_observe(artik_coap_handle handle,
 	if (coap_send(node->interface.session, pdu) == COAP_INVALID_TID) {
 		log_err("Fail to send CoAP message");
 		ret = E_COAP_ERROR;
+	} else if (node->interface.coap_data) {
+		/* Arm the retransmission timeout */
+		loop_service(node->interface.coap_data, -1, 0);
 	}
 
 exit:
@@ -2752,6 +2918,9 @@ artik_error os_coap_cancel_observe(artik_coap_handle handle,
 	if (coap_send(node->interface.session, pdu) == COAP_INVALID_TID) {
 		log_err("Fail to send CoAP message");
 		ret = E_COAP_ERROR;
+	} else if (node->interface.coap_data) {
+		/* Arm the retransmission timeout */
+		loop_service(node->interface.coap_data, -1, 0);
 	}
 
 exit:
@@ -2851,6 +3020,9 @@ artik_error os_coap_notify_resource_changed(artik_coap_handle handle,
 	if (!available_resource) {
 		log_err("This resource does not exist");
 		ret = E_COAP_ERROR;
+	} else if (node->interface.coap_data) {
+		/* Send the notifications now rather than on the next event */
+		loop_service(node->interface.coap_data, -1, 0);
 	}
 
 exit:
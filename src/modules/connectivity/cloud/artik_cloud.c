@@ -29,6 +29,9 @@
 #include <artik_list.h>
 #include <artik_loop.h>
 #include <artik_security.h>
+#include "cloud_batch.h"
+#include "cloud_session.h"
+#include "cloud_devices.h"
 
 #define ARTIK_CLOUD_URL_MAX			256
 #define ARTIK_CLOUD_URL(x)			("https://api.artik.cloud"\
@@ -384,7 +387,23 @@ const artik_cloud_module cloud_module = {
 	websocket_send_message,
 	websocket_set_receive_callback,
 	websocket_set_connection_callback,
-	websocket_close_stream
+	websocket_close_stream,
+	batch_create,
+	batch_send_message,
+	batch_flush,
+	batch_get_stats,
+	batch_destroy,
+	session_create,
+	session_set_token,
+	session_request,
+	session_request_async,
+	session_send_message,
+	session_send_message_async,
+	session_destroy,
+	session_get_json,
+	session_get_json_async,
+	device_iterator_create,
+	device_iterator_destroy
 };
 
 static void http_response_callback(artik_error ret, int status, char *response, void *user_data)
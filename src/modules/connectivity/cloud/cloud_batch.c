@@ -0,0 +1,915 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <artik_module.h>
+#include <artik_http.h>
+#include <artik_loop.h>
+#include <artik_log.h>
+#include <artik_list.h>
+#include "cloud_batch.h"
+
+/*
+ * Messages are queued per device, devices being looked up in a hash
+ * table by their ID. A device has at most one request in flight, so that
+ * its messages reach the Cloud in order, the next batch being flushed
+ * once the request completes.
+ *
+ * Each message is rendered in its final JSON envelope when queued. In
+ * bulk mode the envelopes of a batch are joined in a JSON array, in
+ * burst mode each of them is posted on its own and the batch completes
+ * when all the responses are in.
+ */
+#define BATCH_DEFAULT_MAX_MESSAGES	100
+#define BATCH_DEFAULT_MAX_BYTES		(64 * 1024)
+#define BATCH_DEFAULT_MAX_AGE_MS	1000
+#define BATCH_DEFAULT_MAX_RETRIES	5
+#define BATCH_DEFAULT_RETRY_MIN_MS	500
+#define BATCH_DEFAULT_RETRY_MAX_MS	30000
+#define BATCH_URL_MAX			256
+#define BATCH_BEARER_PREFIX		"Bearer "
+#define BATCH_BASE_URL			"https://api.artik.cloud/v1.1"
+#define BATCH_SECURE_BASE_URL		"https://s-api.artik.cloud/v1.1"
+#define BATCH_MESSAGE_BODY		"{\"type\": \"message\",\"sdid\": "\
+					"\"%s\",\"ts\": %llu,\"data\": %s}"
+
+#define ARRAY_SIZE(a)			(sizeof(a) / sizeof((a)[0]))
+
+enum batch_msg_state {
+	MSG_PENDING,
+	MSG_SENT,
+	MSG_FAILED
+};
+
+struct batch_request;
+
+struct batch_msg {
+	struct batch_msg *next;
+	struct batch_request *request;
+	enum batch_msg_state state;
+	uint64_t queued_ms;
+	size_t len;
+	char body[];
+};
+
+struct batch_device {
+	struct batch_device *next;
+	struct cloud_batch *batch;
+	uint32_t hash;
+	char *device_id;
+	char *bearer;
+	struct batch_msg *head;
+	struct batch_msg *tail;
+	unsigned int count;
+	size_t bytes;
+	struct batch_request *request;
+	int age_id;
+	bool flush;
+};
+
+struct batch_request {
+	struct cloud_batch *batch;
+	struct batch_device *device;
+	struct batch_msg *head;
+	unsigned int count;
+	unsigned int outstanding;
+	unsigned int attempt;
+	artik_error result;
+	int retry_id;
+};
+
+struct cloud_batch {
+	artik_cloud_batch_config config;
+	char *access_token;
+	char url[BATCH_URL_MAX];
+	artik_loop_module *loop;
+	artik_http_module *http;
+	struct batch_device **devices;
+	unsigned int devices_size;
+	unsigned int num_devices;
+	artik_cloud_batch_stats stats;
+	unsigned int refs;
+	bool destroyed;
+};
+
+/* Handles of the senders not destroyed yet */
+static artik_list *requested_batches = NULL;
+
+static uint64_t monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t timestamp_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static uint32_t device_hash(const char *device_id)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*device_id) {
+		hash ^= (unsigned char)*device_id++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void batch_free(struct cloud_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->devices_size; i++) {
+		while (batch->devices[i]) {
+			struct batch_device *device = batch->devices[i];
+
+			batch->devices[i] = device->next;
+			free(device->device_id);
+			free(device->bearer);
+			free(device);
+		}
+	}
+
+	free(batch->devices);
+	free(batch->access_token);
+	artik_release_api_module(batch->http);
+	artik_release_api_module(batch->loop);
+	free(batch);
+}
+
+/*
+ * The sender is referenced by its handle and by each request awaiting an
+ * HTTP response, so that destroying it from a callback is safe.
+ */
+static void batch_unref(struct cloud_batch *batch)
+{
+	if (--batch->refs == 0)
+		batch_free(batch);
+}
+
+static struct batch_device *device_lookup(struct cloud_batch *batch,
+		const char *device_id, uint32_t hash)
+{
+	struct batch_device *device;
+
+	if (!batch->devices_size)
+		return NULL;
+
+	for (device = batch->devices[hash & (batch->devices_size - 1)];
+			device; device = device->next)
+		if (device->hash == hash && !strcmp(device->device_id,
+				device_id))
+			return device;
+
+	return NULL;
+}
+
+static bool device_table_grow(struct cloud_batch *batch)
+{
+	unsigned int size = batch->devices_size ? 2 * batch->devices_size : 64;
+	struct batch_device **table;
+	unsigned int i;
+
+	table = calloc(size, sizeof(struct batch_device *));
+	if (!table)
+		return false;
+
+	for (i = 0; i < batch->devices_size; i++) {
+		while (batch->devices[i]) {
+			struct batch_device *device = batch->devices[i];
+
+			batch->devices[i] = device->next;
+			device->next = table[device->hash & (size - 1)];
+			table[device->hash & (size - 1)] = device;
+		}
+	}
+
+	free(batch->devices);
+	batch->devices = table;
+	batch->devices_size = size;
+
+	return true;
+}
+
+static struct batch_device *device_get(struct cloud_batch *batch,
+		const char *device_id)
+{
+	uint32_t hash = device_hash(device_id);
+	struct batch_device *device = device_lookup(batch, device_id, hash);
+	unsigned int slot;
+
+	if (device)
+		return device;
+
+	if (batch->num_devices >= batch->devices_size &&
+			!device_table_grow(batch))
+		return NULL;
+
+	device = calloc(1, sizeof(struct batch_device));
+	if (!device)
+		return NULL;
+
+	device->device_id = strdup(device_id);
+	if (!device->device_id) {
+		free(device);
+		return NULL;
+	}
+
+	device->batch = batch;
+	device->hash = hash;
+	device->age_id = -1;
+
+	slot = hash & (batch->devices_size - 1);
+	device->next = batch->devices[slot];
+	batch->devices[slot] = device;
+	batch->num_devices++;
+
+	return device;
+}
+
+static void msg_list_free(struct batch_msg *msg)
+{
+	while (msg) {
+		struct batch_msg *next = msg->next;
+
+		free(msg);
+		msg = next;
+	}
+}
+
+static void notify(struct cloud_batch *batch, struct batch_device *device,
+		artik_error result, unsigned int count)
+{
+	if (!count || !batch->config.callback || batch->destroyed)
+		return;
+
+	batch->config.callback(result, device->device_id, count,
+			batch->config.user_data);
+}
+
+static void device_flush(struct cloud_batch *batch,
+		struct batch_device *device);
+
+static void age_callback(void *user_data)
+{
+	struct batch_device *device = (struct batch_device *)user_data;
+
+	device->age_id = -1;
+	device_flush(device->batch, device);
+}
+
+/*
+ * Flush the device if one of the limits is reached, otherwise wait for
+ * its oldest message to expire.
+ */
+static void device_continue(struct cloud_batch *batch,
+		struct batch_device *device)
+{
+	uint64_t age;
+
+	if (device->request || !device->head || batch->destroyed)
+		return;
+
+	age = monotonic_ms() - device->head->queued_ms;
+
+	if (device->flush || device->count >= batch->config.max_messages ||
+			device->bytes >= batch->config.max_bytes ||
+			age >= batch->config.max_age_ms) {
+		device_flush(batch, device);
+		return;
+	}
+
+	if (device->age_id != -1)
+		return;
+
+	batch->loop->set_stats_tag("cloud");
+	if (batch->loop->add_timeout_callback(&device->age_id,
+			batch->config.max_age_ms - (unsigned int)age,
+			age_callback, device) != S_OK) {
+		log_err("Failed to arm batch timer");
+		device->age_id = -1;
+	}
+}
+
+static void request_send(struct batch_request *request);
+
+static void retry_callback(void *user_data)
+{
+	struct batch_request *request = (struct batch_request *)user_data;
+
+	request->retry_id = -1;
+	request_send(request);
+}
+
+static unsigned int retry_delay(struct cloud_batch *batch,
+		unsigned int attempt)
+{
+	unsigned int delay = batch->config.retry_min_ms;
+
+	while (--attempt && delay < batch->config.retry_max_ms)
+		delay *= 2;
+
+	if (delay > batch->config.retry_max_ms)
+		delay = batch->config.retry_max_ms;
+
+	/* Spread the retries of the devices failing together */
+	return delay / 2 + (unsigned int)rand() % (delay / 2 + 1);
+}
+
+/*
+ * Account for the messages of a request once all its responses are in,
+ * then retry the ones which can be or move on to the next batch.
+ */
+static void request_finish(struct batch_request *request)
+{
+	struct cloud_batch *batch = request->batch;
+	struct batch_device *device = request->device;
+	struct batch_msg **pmsg = &request->head;
+	unsigned int sent = 0;
+	unsigned int failed = 0;
+
+	/* Hold the sender, a callback may destroy it */
+	batch->refs++;
+
+	while (*pmsg) {
+		struct batch_msg *msg = *pmsg;
+
+		if (msg->state == MSG_PENDING) {
+			pmsg = &msg->next;
+			continue;
+		}
+
+		if (msg->state == MSG_SENT)
+			sent++;
+		else
+			failed++;
+
+		*pmsg = msg->next;
+		free(msg);
+	}
+
+	request->count -= sent + failed;
+	batch->stats.sent += sent;
+	batch->stats.failed += failed;
+	batch->stats.pending -= sent + failed;
+
+	notify(batch, device, S_OK, sent);
+	notify(batch, device, request->result, failed);
+
+	if (request->count && !batch->destroyed &&
+			request->attempt < batch->config.max_retries) {
+		request->attempt++;
+		batch->stats.retries++;
+
+		batch->loop->set_stats_tag("cloud");
+		if (batch->loop->add_timeout_callback(&request->retry_id,
+				retry_delay(batch, request->attempt),
+				retry_callback, request) == S_OK) {
+			batch_unref(batch);
+			return;
+		}
+
+		log_err("Failed to arm batch retry timer");
+		request->retry_id = -1;
+	}
+
+	if (request->count && !batch->destroyed) {
+		log_err("Giving up %u messages of %s", request->count,
+				device->device_id);
+		batch->stats.failed += request->count;
+		batch->stats.pending -= request->count;
+		notify(batch, device, request->result, request->count);
+	}
+
+	msg_list_free(request->head);
+	device->request = NULL;
+	free(request);
+
+	device_continue(batch, device);
+	batch_unref(batch);
+}
+
+static enum batch_msg_state response_state(artik_error result, int status,
+		artik_error *error)
+{
+	if (result != S_OK) {
+		*error = result;
+		return MSG_PENDING;
+	}
+
+	if (status >= 200 && status < 300)
+		return MSG_SENT;
+
+	log_dbg("HTTP error %d", status);
+	*error = E_HTTP_ERROR;
+
+	/* Only throttling and server side errors are worth a retry */
+	if (status == 408 || status == 429 || status >= 500)
+		return MSG_PENDING;
+
+	return MSG_FAILED;
+}
+
+static void bulk_callback(artik_error result, int status, char *response,
+		unsigned int len, void *user_data)
+{
+	struct batch_request *request = (struct batch_request *)user_data;
+	struct cloud_batch *batch = request->batch;
+	enum batch_msg_state state;
+	struct batch_msg *msg;
+
+	free(response);
+
+	state = response_state(result, status, &request->result);
+	for (msg = request->head; msg; msg = msg->next)
+		msg->state = state;
+
+	request->outstanding--;
+	request_finish(request);
+	batch_unref(batch);
+}
+
+static void burst_callback(artik_error result, int status, char *response,
+		unsigned int len, void *user_data)
+{
+	struct batch_msg *msg = (struct batch_msg *)user_data;
+	struct batch_request *request = msg->request;
+	struct cloud_batch *batch = request->batch;
+
+	free(response);
+
+	msg->state = response_state(result, status, &request->result);
+
+	if (--request->outstanding == 0)
+		request_finish(request);
+	batch_unref(batch);
+}
+
+static artik_error request_post(struct batch_request *request,
+		const char *body, size_t len,
+		artik_http_response_len_callback callback, void *user_data)
+{
+	struct cloud_batch *batch = request->batch;
+	artik_http_headers headers;
+	artik_http_header_field fields[] = {
+		{"Authorization", NULL},
+		{"Content-Type", "application/json"},
+	};
+	artik_error ret;
+
+	headers.fields = fields;
+	headers.num_fields = ARRAY_SIZE(fields);
+	fields[0].data = request->device->bearer;
+
+	ret = batch->http->request_async(ARTIK_HTTP_POST, batch->url,
+			&headers, body, len, callback, user_data,
+			batch->config.ssl);
+	if (ret != S_OK) {
+		log_err("Failed to post batch (err=%d)", ret);
+		request->result = ret;
+		return ret;
+	}
+
+	batch->stats.requests++;
+	batch->refs++;
+	request->outstanding++;
+
+	return S_OK;
+}
+
+static void request_send_bulk(struct batch_request *request)
+{
+	struct batch_msg *msg;
+	size_t len = 2;
+	char *body;
+	char *p;
+
+	/* A single message keeps the regular request format */
+	if (request->count == 1) {
+		request_post(request, request->head->body, request->head->len,
+				bulk_callback, request);
+		return;
+	}
+
+	for (msg = request->head; msg; msg = msg->next)
+		len += msg->len + 1;
+
+	body = malloc(len);
+	if (!body) {
+		log_err("Failed to allocate memory");
+		request->result = E_NO_MEM;
+		return;
+	}
+
+	p = body;
+	*p++ = '[';
+	for (msg = request->head; msg; msg = msg->next) {
+		if (msg != request->head)
+			*p++ = ',';
+		memcpy(p, msg->body, msg->len);
+		p += msg->len;
+	}
+	*p++ = ']';
+
+	request_post(request, body, p - body, bulk_callback, request);
+	free(body);
+}
+
+static void request_send_burst(struct batch_request *request)
+{
+	struct batch_msg *msg;
+
+	/* Hold the request until all the posts are issued */
+	request->outstanding++;
+
+	for (msg = request->head; msg; msg = msg->next) {
+		msg->request = request;
+		if (request_post(request, msg->body, msg->len, burst_callback,
+				msg) != S_OK)
+			msg->state = MSG_PENDING;
+	}
+
+	request->outstanding--;
+}
+
+static void request_send(struct batch_request *request)
+{
+	struct batch_msg *msg;
+
+	for (msg = request->head; msg; msg = msg->next)
+		msg->state = MSG_PENDING;
+
+	if (request->batch->config.mode == ARTIK_CLOUD_BATCH_BURST)
+		request_send_burst(request);
+	else
+		request_send_bulk(request);
+
+	/* Nothing could be posted, go through the retry logic */
+	if (!request->outstanding)
+		request_finish(request);
+}
+
+/* Move the oldest messages of the device to a new request */
+static void device_flush(struct cloud_batch *batch,
+		struct batch_device *device)
+{
+	struct batch_request *request;
+	struct batch_msg **tail;
+	size_t bytes = 0;
+
+	if (device->request || !device->head)
+		return;
+
+	if (device->age_id != -1) {
+		batch->loop->remove_timeout_callback(device->age_id);
+		device->age_id = -1;
+	}
+
+	request = calloc(1, sizeof(struct batch_request));
+	if (!request) {
+		log_err("Failed to allocate memory");
+		return;
+	}
+
+	request->batch = batch;
+	request->device = device;
+	request->retry_id = -1;
+	request->head = device->head;
+
+	tail = &request->head;
+	while (*tail && request->count < batch->config.max_messages &&
+			(!request->count ||
+			bytes + (*tail)->len <= batch->config.max_bytes)) {
+		(*tail)->request = request;
+		bytes += (*tail)->len;
+		request->count++;
+		tail = &(*tail)->next;
+	}
+
+	device->head = *tail;
+	if (!device->head)
+		device->tail = NULL;
+	*tail = NULL;
+	device->count -= request->count;
+	device->bytes -= bytes;
+	device->flush = device->flush && device->head;
+	device->request = request;
+
+	request_send(request);
+}
+
+artik_error batch_create(artik_cloud_batch_handle *handle,
+		const artik_cloud_batch_config *config)
+{
+	struct cloud_batch *batch;
+	const char *base_url;
+	size_t len;
+
+	log_dbg("");
+
+	if (!handle || !config)
+		return E_BAD_ARGS;
+
+	batch = calloc(1, sizeof(struct cloud_batch));
+	if (!batch)
+		return E_NO_MEM;
+
+	batch->config = *config;
+	batch->config.base_url = NULL;
+	batch->config.access_token = NULL;
+
+	if (config->access_token) {
+		batch->access_token = strdup(config->access_token);
+		if (!batch->access_token) {
+			free(batch);
+			return E_NO_MEM;
+		}
+	}
+
+	if (config->base_url)
+		base_url = config->base_url;
+	else if (config->ssl && config->ssl->se_config)
+		base_url = BATCH_SECURE_BASE_URL;
+	else
+		base_url = BATCH_BASE_URL;
+
+	len = strlen(base_url);
+	while (len && base_url[len - 1] == '/')
+		len--;
+
+	if (len + strlen("/messages") >= BATCH_URL_MAX) {
+		log_err("Base URL is too long");
+		free(batch->access_token);
+		free(batch);
+		return E_BAD_ARGS;
+	}
+
+	snprintf(batch->url, BATCH_URL_MAX, "%.*s/messages", (int)len,
+			base_url);
+
+	if (!batch->config.max_messages)
+		batch->config.max_messages = BATCH_DEFAULT_MAX_MESSAGES;
+	if (!batch->config.max_bytes)
+		batch->config.max_bytes = BATCH_DEFAULT_MAX_BYTES;
+	if (!batch->config.max_age_ms)
+		batch->config.max_age_ms = BATCH_DEFAULT_MAX_AGE_MS;
+	if (!batch->config.max_retries)
+		batch->config.max_retries = BATCH_DEFAULT_MAX_RETRIES;
+	if (!batch->config.retry_min_ms)
+		batch->config.retry_min_ms = BATCH_DEFAULT_RETRY_MIN_MS;
+	if (!batch->config.retry_max_ms)
+		batch->config.retry_max_ms = BATCH_DEFAULT_RETRY_MAX_MS;
+	if (batch->config.retry_max_ms < batch->config.retry_min_ms)
+		batch->config.retry_max_ms = batch->config.retry_min_ms;
+
+	batch->loop = (artik_loop_module *)artik_request_api_module("loop");
+	batch->http = (artik_http_module *)artik_request_api_module("http");
+	if (!batch->loop || !batch->http) {
+		log_err("Failed to request loop and http modules");
+		if (batch->loop)
+			artik_release_api_module(batch->loop);
+		if (batch->http)
+			artik_release_api_module(batch->http);
+		free(batch->access_token);
+		free(batch);
+		return E_NOT_SUPPORTED;
+	}
+
+	if (!artik_list_add(&requested_batches, (ARTIK_LIST_HANDLE)batch,
+			sizeof(artik_list))) {
+		artik_release_api_module(batch->loop);
+		artik_release_api_module(batch->http);
+		free(batch->access_token);
+		free(batch);
+		return E_NO_MEM;
+	}
+
+	batch->refs = 1;
+	*handle = (artik_cloud_batch_handle)batch;
+
+	return S_OK;
+}
+
+static struct cloud_batch *batch_from_handle(artik_cloud_batch_handle handle)
+{
+	if (!artik_list_get_by_handle(requested_batches,
+			(ARTIK_LIST_HANDLE)handle))
+		return NULL;
+
+	return (struct cloud_batch *)handle;
+}
+
+artik_error batch_send_message(artik_cloud_batch_handle handle,
+		const char *access_token, const char *device_id,
+		const char *message)
+{
+	struct cloud_batch *batch = batch_from_handle(handle);
+	struct batch_device *device;
+	struct batch_msg *msg;
+	unsigned long long ts = timestamp_ms();
+	unsigned int pending;
+	int len;
+
+	if (!batch || !device_id || !message)
+		return E_BAD_ARGS;
+
+	if (!access_token)
+		access_token = batch->access_token;
+	if (!access_token) {
+		log_err("No access token");
+		return E_BAD_ARGS;
+	}
+
+	device = device_get(batch, device_id);
+	if (!device) {
+		log_err("Failed to allocate memory");
+		return E_NO_MEM;
+	}
+
+	pending = device->count + (device->request ?
+		device->request->count : 0);
+	if (batch->config.max_pending && pending >= batch->config.max_pending) {
+		batch->stats.rejected++;
+		return E_BUSY;
+	}
+
+	len = snprintf(NULL, 0, BATCH_MESSAGE_BODY, device_id, ts, message);
+	msg = malloc(sizeof(struct batch_msg) + len + 1);
+	if (!msg) {
+		log_err("Failed to allocate memory");
+		return E_NO_MEM;
+	}
+
+	snprintf(msg->body, len + 1, BATCH_MESSAGE_BODY, device_id, ts,
+			message);
+	msg->len = len;
+	msg->next = NULL;
+	msg->request = NULL;
+	msg->state = MSG_PENDING;
+	msg->queued_ms = monotonic_ms();
+
+	/* Tokens get refreshed, the latest one is used */
+	if (!device->bearer || strcmp(device->bearer +
+			strlen(BATCH_BEARER_PREFIX), access_token)) {
+		size_t size = strlen(BATCH_BEARER_PREFIX) +
+			strlen(access_token) + 1;
+		char *bearer = malloc(size);
+
+		if (!bearer) {
+			log_err("Failed to allocate memory");
+			free(msg);
+			return E_NO_MEM;
+		}
+
+		snprintf(bearer, size, BATCH_BEARER_PREFIX "%s", access_token);
+		free(device->bearer);
+		device->bearer = bearer;
+	}
+
+	if (device->tail)
+		device->tail->next = msg;
+	else
+		device->head = msg;
+	device->tail = msg;
+	device->count++;
+	device->bytes += len;
+
+	batch->stats.queued++;
+	batch->stats.pending++;
+
+	device_continue(batch, device);
+
+	return S_OK;
+}
+
+artik_error batch_flush(artik_cloud_batch_handle handle)
+{
+	struct cloud_batch *batch = batch_from_handle(handle);
+	struct batch_device **devices;
+	unsigned int count = 0;
+	unsigned int i;
+
+	log_dbg("");
+
+	if (!batch)
+		return E_BAD_ARGS;
+
+	if (!batch->num_devices)
+		return S_OK;
+
+	/* Callbacks may add devices, work on a snapshot of the table */
+	devices = malloc(batch->num_devices * sizeof(struct batch_device *));
+	if (!devices)
+		return E_NO_MEM;
+
+	for (i = 0; i < batch->devices_size; i++) {
+		struct batch_device *device;
+
+		for (device = batch->devices[i]; device; device = device->next)
+			if (device->head)
+				devices[count++] = device;
+	}
+
+	/* Hold the sender, a callback may destroy it */
+	batch->refs++;
+
+	for (i = 0; i < count && !batch->destroyed; i++) {
+		/* Devices with a request in flight flush afterwards */
+		devices[i]->flush = true;
+		device_continue(batch, devices[i]);
+	}
+
+	batch_unref(batch);
+	free(devices);
+
+	return S_OK;
+}
+
+artik_error batch_get_stats(artik_cloud_batch_handle handle,
+		artik_cloud_batch_stats *stats)
+{
+	struct cloud_batch *batch = batch_from_handle(handle);
+
+	if (!batch || !stats)
+		return E_BAD_ARGS;
+
+	*stats = batch->stats;
+
+	return S_OK;
+}
+
+artik_error batch_destroy(artik_cloud_batch_handle handle)
+{
+	struct cloud_batch *batch = batch_from_handle(handle);
+	unsigned int i;
+
+	log_dbg("");
+
+	if (!batch)
+		return E_BAD_ARGS;
+
+	artik_list_delete_handle(&requested_batches, (ARTIK_LIST_HANDLE)batch);
+	batch->destroyed = true;
+
+	for (i = 0; i < batch->devices_size; i++) {
+		struct batch_device *device;
+
+		for (device = batch->devices[i]; device;
+				device = device->next) {
+			struct batch_request *request = device->request;
+
+			if (device->age_id != -1)
+				batch->loop->remove_timeout_callback(
+					device->age_id);
+			device->age_id = -1;
+
+			msg_list_free(device->head);
+			device->head = NULL;
+			device->tail = NULL;
+
+			/* Requests in flight are released on completion */
+			if (request && request->retry_id != -1) {
+				batch->loop->remove_timeout_callback(
+					request->retry_id);
+				msg_list_free(request->head);
+				free(request);
+				device->request = NULL;
+			}
+		}
+	}
+
+	batch_unref(batch);
+
+	return S_OK;
+}
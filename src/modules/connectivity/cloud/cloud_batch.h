@@ -0,0 +1,34 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __CLOUD_BATCH_H__
+#define __CLOUD_BATCH_H__
+
+#include <artik_cloud.h>
+
+artik_error batch_create(artik_cloud_batch_handle *handle,
+		const artik_cloud_batch_config *config);
+artik_error batch_send_message(artik_cloud_batch_handle handle,
+		const char *access_token, const char *device_id,
+		const char *message);
+artik_error batch_flush(artik_cloud_batch_handle handle);
+artik_error batch_get_stats(artik_cloud_batch_handle handle,
+		artik_cloud_batch_stats *stats);
+artik_error batch_destroy(artik_cloud_batch_handle handle);
+
+#endif  /* __CLOUD_BATCH_H__ */
@@ -0,0 +1,410 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <artik_module.h>
+#include <artik_utils.h>
+#include <artik_log.h>
+#include <artik_list.h>
+#include "cloud_devices.h"
+#include "cloud_session.h"
+
+/*
+ * Pages are kept in a ring of 1 + prefetch slots, page p using slot
+ * p % window. Requests may complete out of order, a page is delivered
+ * once all the previous ones are, then its slot is reused for the next
+ * page to fetch.
+ *
+ * The total number of devices is only known once the first page comes
+ * in, so the first page is fetched alone. If the Cloud does not report
+ * it, pages are fetched one after the other until one is not full.
+ */
+#define ITERATOR_DEFAULT_PAGE_SIZE	100
+#define ITERATOR_DEFAULT_PREFETCH	1
+#define ITERATOR_PATH_MAX		256
+#define ITERATOR_DEVICES_PATH		"users/%s/devices?count=%u&"\
+					"includeProperties=%s&offset="
+
+struct device_page {
+	char *response;
+	artik_error result;
+	bool done;
+};
+
+struct device_request {
+	struct cloud_device_iterator *iterator;
+	unsigned int page;
+};
+
+struct cloud_device_iterator {
+	artik_cloud_session_handle session;
+	artik_utils_module *utils;
+	char path[ITERATOR_PATH_MAX];
+	unsigned int page_size;
+	artik_cloud_device_callback callback;
+	void *user_data;
+	struct device_page *pages;
+	unsigned int window;
+	unsigned int next_request;
+	unsigned int next_deliver;
+	unsigned long total;
+	bool total_known;
+	unsigned int refs;
+	bool delivering;
+	bool finished;
+	bool destroyed;
+};
+
+/* Handles of the listings not destroyed yet */
+static artik_list *requested_iterators = NULL;
+
+static void iterator_unref(struct cloud_device_iterator *iterator)
+{
+	unsigned int i;
+
+	if (--iterator->refs)
+		return;
+
+	for (i = 0; i < iterator->window; i++)
+		free(iterator->pages[i].response);
+
+	artik_release_api_module(iterator->utils);
+	free(iterator->pages);
+	free(iterator);
+}
+
+static void iterator_finish(struct cloud_device_iterator *iterator,
+		artik_error result)
+{
+	iterator->finished = true;
+	iterator->callback(result, NULL, 0, iterator->user_data);
+}
+
+static bool read_total(struct cloud_device_iterator *iterator,
+		const char *response)
+{
+	artik_json_token token;
+	char value[32];
+
+	if (iterator->utils->json_find(response, strlen(response), "total",
+			&token) != S_OK || token.type != ARTIK_JSON_NUMBER)
+		return false;
+
+	if (iterator->utils->json_copy_string(&token, value, sizeof(value))
+			!= S_OK)
+		return false;
+
+	iterator->total = strtoul(value, NULL, 10);
+
+	return true;
+}
+
+/*
+ * Pass the devices of a page to the callback, returns the number of
+ * devices found or -1 if the listing was stopped.
+ */
+static int deliver_page(struct cloud_device_iterator *iterator,
+		const char *response)
+{
+	artik_utils_module *utils = iterator->utils;
+	artik_json_tokenizer tokenizer;
+	artik_json_token token;
+	const char *start = NULL;
+	unsigned int depth = 0;
+	artik_error ret;
+	int count = 0;
+
+	utils->json_init(&tokenizer, NULL, 0);
+	utils->json_feed(&tokenizer, response, strlen(response));
+
+	for (;;) {
+		ret = utils->json_next(&tokenizer, &token);
+		if (ret == E_TRY_AGAIN) {
+			utils->json_feed(&tokenizer, NULL, 0);
+			continue;
+		}
+
+		if (ret != S_OK) {
+			log_err("Malformed page of devices");
+			iterator_finish(iterator, ret);
+			return -1;
+		}
+
+		if (token.type == ARTIK_JSON_END)
+			return count;
+
+		if (!start && token.type == ARTIK_JSON_OBJECT_START &&
+				utils->json_path_match(&tokenizer,
+					"data.devices[*]")) {
+			start = token.value;
+			depth = token.depth;
+		} else if (start && token.type == ARTIK_JSON_OBJECT_END &&
+				token.depth == depth) {
+			count++;
+			if (!iterator->callback(S_OK, start,
+					token.value + 1 - start,
+					iterator->user_data)) {
+				iterator->finished = true;
+				return -1;
+			}
+
+			if (iterator->destroyed)
+				return -1;
+
+			start = NULL;
+		}
+	}
+}
+
+static void deliver(struct cloud_device_iterator *iterator)
+{
+	if (iterator->delivering)
+		return;
+
+	iterator->delivering = true;
+
+	while (!iterator->finished && !iterator->destroyed) {
+		unsigned int page = iterator->next_deliver;
+		struct device_page *slot = &iterator->pages[page %
+							iterator->window];
+		char *response;
+		int count;
+
+		if (!slot->done)
+			break;
+
+		if (slot->result != S_OK) {
+			iterator_finish(iterator, slot->result);
+			break;
+		}
+
+		response = slot->response;
+		count = deliver_page(iterator, response ? response : "");
+
+		/* Once destroyed, the slots are released with the iterator */
+		if (iterator->destroyed)
+			break;
+
+		free(response);
+		slot->response = NULL;
+		slot->done = false;
+
+		if (count < 0)
+			break;
+
+		iterator->next_deliver++;
+
+		if ((unsigned int)count < iterator->page_size ||
+				(iterator->total_known &&
+				 (unsigned long)iterator->next_deliver *
+				 iterator->page_size >= iterator->total)) {
+			iterator_finish(iterator, S_OK);
+			break;
+		}
+	}
+
+	iterator->delivering = false;
+}
+
+static void fill(struct cloud_device_iterator *iterator);
+
+static void page_callback(artik_error result, char *response,
+		void *user_data)
+{
+	struct device_request *request = user_data;
+	struct cloud_device_iterator *iterator = request->iterator;
+	struct device_page *slot;
+
+	slot = &iterator->pages[request->page % iterator->window];
+	free(request);
+
+	if (iterator->finished || iterator->destroyed) {
+		free(response);
+		iterator_unref(iterator);
+		return;
+	}
+
+	slot->response = response;
+	slot->result = result;
+	slot->done = true;
+
+	if (result == S_OK && response && !iterator->total_known)
+		iterator->total_known = read_total(iterator, response);
+
+	iterator->refs++;
+	deliver(iterator);
+	fill(iterator);
+	iterator_unref(iterator);
+
+	/* Drop the reference of the request */
+	iterator_unref(iterator);
+}
+
+static artik_error request_page(struct cloud_device_iterator *iterator,
+		unsigned int page)
+{
+	struct device_request *request;
+	char path[ITERATOR_PATH_MAX];
+	artik_error ret;
+	int len;
+
+	len = snprintf(path, sizeof(path), "%s%lu", iterator->path,
+			(unsigned long)page * iterator->page_size);
+	if (len < 0 || len >= (int)sizeof(path))
+		return E_OVERFLOW;
+
+	request = malloc(sizeof(struct device_request));
+	if (!request)
+		return E_NO_MEM;
+
+	request->iterator = iterator;
+	request->page = page;
+
+	ret = session_request_async(iterator->session, ARTIK_HTTP_GET, path,
+			NULL, page_callback, request);
+	if (ret != S_OK) {
+		free(request);
+		return ret;
+	}
+
+	iterator->refs++;
+
+	return S_OK;
+}
+
+/* Request the pages fitting in the window */
+static void fill(struct cloud_device_iterator *iterator)
+{
+	while (!iterator->finished && !iterator->destroyed &&
+			iterator->next_request < iterator->next_deliver +
+			iterator->window) {
+		artik_error ret;
+
+		if (!iterator->total_known &&
+				iterator->next_request > iterator->next_deliver)
+			break;
+
+		if (iterator->total_known &&
+				(unsigned long)iterator->next_request *
+				iterator->page_size >= iterator->total)
+			break;
+
+		ret = request_page(iterator, iterator->next_request);
+		if (ret != S_OK) {
+			log_err("Failed to request a page of devices (err=%d)",
+					ret);
+			iterator_finish(iterator, ret);
+			break;
+		}
+
+		iterator->next_request++;
+	}
+}
+
+artik_error device_iterator_create(artik_cloud_device_iterator *handle,
+		artik_cloud_session_handle session, const char *user_id,
+		const artik_cloud_device_iterator_config *config,
+		artik_cloud_device_callback callback, void *user_data)
+{
+	struct cloud_device_iterator *iterator;
+	unsigned int prefetch = ITERATOR_DEFAULT_PREFETCH;
+	artik_error ret;
+	int len;
+
+	log_dbg("");
+
+	if (!handle || !session || !user_id || !callback)
+		return E_BAD_ARGS;
+
+	iterator = calloc(1, sizeof(struct cloud_device_iterator));
+	if (!iterator)
+		return E_NO_MEM;
+
+	iterator->page_size = ITERATOR_DEFAULT_PAGE_SIZE;
+	if (config && config->page_size)
+		iterator->page_size = config->page_size;
+	if (config && config->prefetch)
+		prefetch = config->prefetch;
+
+	len = snprintf(iterator->path, ITERATOR_PATH_MAX,
+			ITERATOR_DEVICES_PATH, user_id, iterator->page_size,
+			config && config->include_properties ? "true" : "false");
+	if (len < 0 || len >= ITERATOR_PATH_MAX) {
+		log_err("User ID is too long");
+		free(iterator);
+		return E_BAD_ARGS;
+	}
+
+	iterator->window = prefetch + 1;
+	iterator->pages = calloc(iterator->window, sizeof(struct device_page));
+	iterator->utils = (artik_utils_module *)artik_request_api_module(
+			"utils");
+	if (!iterator->pages || !iterator->utils) {
+		ret = iterator->pages ? E_NOT_SUPPORTED : E_NO_MEM;
+		if (iterator->utils)
+			artik_release_api_module(iterator->utils);
+		free(iterator->pages);
+		free(iterator);
+		return ret;
+	}
+
+	iterator->session = session;
+	iterator->callback = callback;
+	iterator->user_data = user_data;
+	iterator->refs = 1;
+
+	if (!artik_list_add(&requested_iterators,
+			(ARTIK_LIST_HANDLE)iterator, sizeof(artik_list))) {
+		iterator_unref(iterator);
+		return E_NO_MEM;
+	}
+
+	ret = request_page(iterator, 0);
+	if (ret != S_OK) {
+		artik_list_delete_handle(&requested_iterators,
+				(ARTIK_LIST_HANDLE)iterator);
+		iterator_unref(iterator);
+		return ret;
+	}
+
+	iterator->next_request = 1;
+	*handle = (artik_cloud_device_iterator)iterator;
+
+	return S_OK;
+}
+
+artik_error device_iterator_destroy(artik_cloud_device_iterator handle)
+{
+	struct cloud_device_iterator *iterator =
+		(struct cloud_device_iterator *)handle;
+
+	log_dbg("");
+
+	if (artik_list_delete_handle(&requested_iterators,
+			(ARTIK_LIST_HANDLE)handle) != S_OK)
+		return E_BAD_ARGS;
+
+	iterator->destroyed = true;
+	iterator_unref(iterator);
+
+	return S_OK;
+}
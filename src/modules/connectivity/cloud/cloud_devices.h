@@ -0,0 +1,30 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __CLOUD_DEVICES_H__
+#define __CLOUD_DEVICES_H__
+
+#include <artik_cloud.h>
+
+artik_error device_iterator_create(artik_cloud_device_iterator *iterator,
+		artik_cloud_session_handle session, const char *user_id,
+		const artik_cloud_device_iterator_config *config,
+		artik_cloud_device_callback callback, void *user_data);
+artik_error device_iterator_destroy(artik_cloud_device_iterator iterator);
+
+#endif  /* __CLOUD_DEVICES_H__ */
@@ -0,0 +1,730 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <artik_module.h>
+#include <artik_http.h>
+#include <artik_utils.h>
+#include <artik_log.h>
+#include <artik_list.h>
+#include "cloud_session.h"
+
+/*
+ * A session keeps everything the requests of a user or device have in
+ * common: the HTTP module, the authorization header and the base URL,
+ * so that a request only appends its path to the URL prefix. The TLS
+ * credentials, sessions and connections are cached by the HTTP pool
+ * matching the SSL configuration of the session.
+ *
+ * JSON requests feed the response to a tokenizer as it is received,
+ * so that values are extracted without holding the whole response.
+ */
+#define SESSION_URL_MAX			256
+#define SESSION_BEARER_PREFIX		"Bearer "
+#define SESSION_BODY_MAX		1024
+#define SESSION_JSON_SCRATCH		512
+#define SESSION_BASE_URL		"https://api.artik.cloud/v1.1/"
+#define SESSION_SECURE_BASE_URL		"https://s-api.artik.cloud/v1.1/"
+#define SESSION_MESSAGE_PREFIX		"{\"type\": \"message\",\"sdid\": \""
+#define SESSION_MESSAGE_DATA		"\",\"data\": "
+#define SESSION_MESSAGE_SUFFIX		"}"
+
+#define ARRAY_SIZE(a)			(sizeof(a) / sizeof((a)[0]))
+
+struct cloud_session {
+	artik_http_module *http;
+	artik_utils_module *utils;
+	artik_ssl_config *ssl;
+	char url[SESSION_URL_MAX];
+	size_t url_len;
+	char *bearer;
+	artik_http_header_field fields[2];
+	artik_http_headers headers;
+	unsigned int refs;
+	bool destroyed;
+};
+
+struct session_request {
+	struct cloud_session *session;
+	artik_cloud_callback callback;
+	void *user_data;
+};
+
+struct session_stream {
+	struct cloud_session *session;
+	artik_json_tokenizer tokenizer;
+	char scratch[SESSION_JSON_SCRATCH];
+	char *pattern;
+	artik_cloud_json_callback callback;
+	artik_cloud_callback done_callback;
+	void *user_data;
+	artik_error result;
+	bool stopped;
+};
+
+/* Handles of the sessions not destroyed yet */
+static artik_list *requested_sessions = NULL;
+
+static struct cloud_session *session_from_handle(
+		artik_cloud_session_handle handle)
+{
+	if (!artik_list_get_by_handle(requested_sessions,
+			(ARTIK_LIST_HANDLE)handle))
+		return NULL;
+
+	return (struct cloud_session *)handle;
+}
+
+static void session_unref(struct cloud_session *session)
+{
+	if (--session->refs)
+		return;
+
+	artik_release_api_module(session->http);
+	artik_release_api_module(session->utils);
+	free(session->bearer);
+	free(session);
+}
+
+/*
+ * Requests copy the headers when they are issued, so the previous
+ * authorization header can be released right away.
+ */
+static artik_error build_bearer(struct cloud_session *session,
+		const char *access_token)
+{
+	size_t size = strlen(SESSION_BEARER_PREFIX) + strlen(access_token) + 1;
+	char *bearer = malloc(size);
+
+	if (!bearer) {
+		log_err("Failed to allocate memory");
+		return E_NO_MEM;
+	}
+
+	snprintf(bearer, size, SESSION_BEARER_PREFIX "%s", access_token);
+	free(session->bearer);
+	session->bearer = bearer;
+	session->fields[0].data = bearer;
+
+	return S_OK;
+}
+
+/*
+ * Append the path to the URL prefix of the session, the buffer must be
+ * SESSION_URL_MAX long.
+ */
+static artik_error build_url(struct cloud_session *session,
+		const char *path, char *url)
+{
+	size_t len;
+
+	while (*path == '/')
+		path++;
+
+	len = strlen(path);
+	if (session->url_len + len >= SESSION_URL_MAX) {
+		log_err("URL is too long");
+		return E_BAD_ARGS;
+	}
+
+	memcpy(url, session->url, session->url_len);
+	memcpy(url + session->url_len, path, len + 1);
+
+	return S_OK;
+}
+
+/*
+ * Render the envelope of a message in the buffer if it fits, in an
+ * allocated one otherwise. The result must be released with
+ * free_message_body.
+ */
+static char *build_message_body(const char *device_id, const char *message,
+		char *buf)
+{
+	size_t prefix_len = strlen(SESSION_MESSAGE_PREFIX);
+	size_t data_len = strlen(SESSION_MESSAGE_DATA);
+	size_t suffix_len = strlen(SESSION_MESSAGE_SUFFIX);
+	size_t id_len = strlen(device_id);
+	size_t message_len = strlen(message);
+	size_t len = prefix_len + id_len + data_len + message_len + suffix_len;
+	char *body = buf;
+	char *p;
+
+	if (len >= SESSION_BODY_MAX) {
+		body = malloc(len + 1);
+		if (!body)
+			return NULL;
+	}
+
+	p = body;
+	memcpy(p, SESSION_MESSAGE_PREFIX, prefix_len);
+	p += prefix_len;
+	memcpy(p, device_id, id_len);
+	p += id_len;
+	memcpy(p, SESSION_MESSAGE_DATA, data_len);
+	p += data_len;
+	memcpy(p, message, message_len);
+	p += message_len;
+	memcpy(p, SESSION_MESSAGE_SUFFIX, suffix_len + 1);
+
+	return body;
+}
+
+static void free_message_body(char *body, char *buf)
+{
+	if (body != buf)
+		free(body);
+}
+
+static artik_error perform(struct cloud_session *session,
+		artik_http_method method, const char *url, const char *body,
+		char **response)
+{
+	artik_http_module *http = session->http;
+	artik_error ret;
+	int status = 0;
+
+	switch (method) {
+	case ARTIK_HTTP_GET:
+		ret = http->get(url, &session->headers, response, &status,
+				session->ssl);
+		break;
+	case ARTIK_HTTP_POST:
+		ret = http->post(url, &session->headers, body ? body : "",
+				response, &status, session->ssl);
+		break;
+	case ARTIK_HTTP_PUT:
+		ret = http->put(url, &session->headers, body ? body : "",
+				response, &status, session->ssl);
+		break;
+	case ARTIK_HTTP_DELETE:
+		ret = http->del(url, &session->headers, response, &status,
+				session->ssl);
+		break;
+	default:
+		return E_BAD_ARGS;
+	}
+
+	if (ret != S_OK)
+		return ret;
+
+	/* Check HTTP status code */
+	if (status < 200 || status >= 300) {
+		log_err("HTTP error %d", status);
+		free(*response);
+		*response = NULL;
+		return E_HTTP_ERROR;
+	}
+
+	return S_OK;
+}
+
+static void response_callback(artik_error result, int status, char *response,
+		void *user_data)
+{
+	struct session_request *request = user_data;
+	struct cloud_session *session = request->session;
+
+	if (result == S_OK && (status < 200 || status >= 300)) {
+		log_dbg("HTTP error %d", status);
+		result = E_HTTP_ERROR;
+	}
+
+	/* Callers may hold resources until their request completes */
+	if (session->destroyed) {
+		free(response);
+		request->callback(E_INTERRUPTED, NULL, request->user_data);
+	} else {
+		request->callback(result, response, request->user_data);
+	}
+
+	free(request);
+	session_unref(session);
+}
+
+static artik_error perform_async(struct cloud_session *session,
+		artik_http_method method, const char *url, const char *body,
+		artik_cloud_callback callback, void *user_data)
+{
+	artik_http_module *http = session->http;
+	struct session_request *request;
+	artik_error ret;
+
+	request = malloc(sizeof(struct session_request));
+	if (!request)
+		return E_NO_MEM;
+
+	request->session = session;
+	request->callback = callback;
+	request->user_data = user_data;
+
+	switch (method) {
+	case ARTIK_HTTP_GET:
+		ret = http->get_async(url, &session->headers,
+				response_callback, request, session->ssl);
+		break;
+	case ARTIK_HTTP_POST:
+		ret = http->post_async(url, &session->headers,
+				body ? body : "", response_callback, request,
+				session->ssl);
+		break;
+	case ARTIK_HTTP_PUT:
+		ret = http->put_async(url, &session->headers,
+				body ? body : "", response_callback, request,
+				session->ssl);
+		break;
+	case ARTIK_HTTP_DELETE:
+		ret = http->del_async(url, &session->headers,
+				response_callback, request, session->ssl);
+		break;
+	default:
+		ret = E_BAD_ARGS;
+		break;
+	}
+
+	if (ret != S_OK) {
+		free(request);
+		return ret;
+	}
+
+	session->refs++;
+
+	return S_OK;
+}
+
+artik_error session_create(artik_cloud_session_handle *handle,
+		const artik_cloud_session_config *config)
+{
+	struct cloud_session *session;
+	const char *base_url;
+	size_t len;
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!handle || !config || !config->access_token)
+		return E_BAD_ARGS;
+
+	session = calloc(1, sizeof(struct cloud_session));
+	if (!session)
+		return E_NO_MEM;
+
+	if (config->base_url)
+		base_url = config->base_url;
+	else if (config->ssl && config->ssl->se_config)
+		base_url = SESSION_SECURE_BASE_URL;
+	else
+		base_url = SESSION_BASE_URL;
+
+	len = strlen(base_url);
+	while (len && base_url[len - 1] == '/')
+		len--;
+
+	if (len + 1 >= SESSION_URL_MAX) {
+		log_err("Base URL is too long");
+		free(session);
+		return E_BAD_ARGS;
+	}
+
+	memcpy(session->url, base_url, len);
+	session->url[len++] = '/';
+	session->url[len] = '\0';
+	session->url_len = len;
+
+	ret = build_bearer(session, config->access_token);
+	if (ret != S_OK) {
+		free(session);
+		return ret;
+	}
+
+	session->fields[0].name = "Authorization";
+	session->fields[1].name = "Content-Type";
+	session->fields[1].data = "application/json";
+	session->headers.fields = session->fields;
+	session->headers.num_fields = ARRAY_SIZE(session->fields);
+
+	session->http = (artik_http_module *)artik_request_api_module("http");
+	session->utils = (artik_utils_module *)artik_request_api_module(
+			"utils");
+	if (!session->http || !session->utils) {
+		log_err("Failed to request http and utils modules");
+		if (session->http)
+			artik_release_api_module(session->http);
+		if (session->utils)
+			artik_release_api_module(session->utils);
+		free(session->bearer);
+		free(session);
+		return E_NOT_SUPPORTED;
+	}
+
+	if (!artik_list_add(&requested_sessions, (ARTIK_LIST_HANDLE)session,
+			sizeof(artik_list))) {
+		artik_release_api_module(session->http);
+		artik_release_api_module(session->utils);
+		free(session->bearer);
+		free(session);
+		return E_NO_MEM;
+	}
+
+	session->ssl = config->ssl;
+	session->refs = 1;
+	*handle = (artik_cloud_session_handle)session;
+
+	return S_OK;
+}
+
+artik_error session_set_token(artik_cloud_session_handle handle,
+		const char *access_token)
+{
+	struct cloud_session *session = session_from_handle(handle);
+
+	log_dbg("");
+
+	if (!session || !access_token)
+		return E_BAD_ARGS;
+
+	return build_bearer(session, access_token);
+}
+
+artik_error session_request(artik_cloud_session_handle handle,
+		artik_http_method method, const char *path, const char *body,
+		char **response)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	char url[SESSION_URL_MAX];
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!session || !path || !response)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, path, url);
+	if (ret != S_OK)
+		return ret;
+
+	return perform(session, method, url, body, response);
+}
+
+artik_error session_request_async(artik_cloud_session_handle handle,
+		artik_http_method method, const char *path, const char *body,
+		artik_cloud_callback callback, void *user_data)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	char url[SESSION_URL_MAX];
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!session || !path || !callback)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, path, url);
+	if (ret != S_OK)
+		return ret;
+
+	return perform_async(session, method, url, body, callback, user_data);
+}
+
+artik_error session_send_message(artik_cloud_session_handle handle,
+		const char *device_id, const char *message, char **response)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	char url[SESSION_URL_MAX];
+	char buf[SESSION_BODY_MAX];
+	char *body;
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!session || !device_id || !message || !response)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, "messages", url);
+	if (ret != S_OK)
+		return ret;
+
+	body = build_message_body(device_id, message, buf);
+	if (!body)
+		return E_NO_MEM;
+
+	ret = perform(session, ARTIK_HTTP_POST, url, body, response);
+
+	free_message_body(body, buf);
+
+	return ret;
+}
+
+artik_error session_send_message_async(artik_cloud_session_handle handle,
+		const char *device_id, const char *message,
+		artik_cloud_callback callback, void *user_data)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	char url[SESSION_URL_MAX];
+	char buf[SESSION_BODY_MAX];
+	char *body;
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!session || !device_id || !message || !callback)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, "messages", url);
+	if (ret != S_OK)
+		return ret;
+
+	body = build_message_body(device_id, message, buf);
+	if (!body)
+		return E_NO_MEM;
+
+	/* The HTTP module copies the body, it can be released right away */
+	ret = perform_async(session, ARTIK_HTTP_POST, url, body, callback,
+			user_data);
+
+	free_message_body(body, buf);
+
+	return ret;
+}
+
+artik_error session_destroy(artik_cloud_session_handle handle)
+{
+	struct cloud_session *session = session_from_handle(handle);
+
+	log_dbg("");
+
+	if (!session)
+		return E_BAD_ARGS;
+
+	artik_list_delete_handle(&requested_sessions,
+			(ARTIK_LIST_HANDLE)session);
+	session->destroyed = true;
+	session_unref(session);
+
+	return S_OK;
+}
+
+/*
+ * Pull the tokens available in the data fed so far, reporting the
+ * values matching the pattern. Returns false once the request must be
+ * stopped.
+ */
+static bool stream_tokens(struct session_stream *stream)
+{
+	artik_utils_module *utils = stream->session->utils;
+	artik_json_tokenizer *tokenizer = &stream->tokenizer;
+	artik_json_token token;
+	artik_error ret;
+
+	while ((ret = utils->json_next(tokenizer, &token)) == S_OK) {
+		if (token.type == ARTIK_JSON_END)
+			return true;
+
+		if (token.type == ARTIK_JSON_KEY ||
+				token.type == ARTIK_JSON_OBJECT_END ||
+				token.type == ARTIK_JSON_ARRAY_END)
+			continue;
+
+		if (!utils->json_path_match(tokenizer, stream->pattern))
+			continue;
+
+		if (!stream->callback(&token, utils->json_get_path(tokenizer),
+				stream->user_data)) {
+			stream->stopped = true;
+			return false;
+		}
+	}
+
+	if (ret != E_TRY_AGAIN) {
+		log_err("Failed to parse the response (err=%d)", ret);
+		stream->result = ret;
+		return false;
+	}
+
+	return true;
+}
+
+static int stream_callback(char *data, unsigned int len, void *user_data)
+{
+	struct session_stream *stream = user_data;
+	artik_utils_module *utils = stream->session->utils;
+	artik_error ret;
+
+	if (stream->stopped || stream->result != S_OK)
+		return 0;
+
+	ret = utils->json_feed(&stream->tokenizer, data, len);
+	if (ret != S_OK) {
+		stream->result = ret;
+		return 0;
+	}
+
+	return stream_tokens(stream) ? (int)len : 0;
+}
+
+/* Compute the result of a JSON request once the transfer is over */
+static artik_error stream_finish(struct session_stream *stream,
+		artik_error result, int status)
+{
+	artik_utils_module *utils = stream->session->utils;
+
+	/* Aborting the transfer makes the HTTP request fail */
+	if (stream->stopped)
+		return S_OK;
+
+	/* Error bodies may not be JSON, report the status first */
+	if (status && (status < 200 || status >= 300)) {
+		log_err("HTTP error %d", status);
+		return E_HTTP_ERROR;
+	}
+
+	if (stream->result != S_OK)
+		return stream->result;
+
+	if (result != S_OK)
+		return result;
+
+	/* Flush a trailing root number and check the document is complete */
+	if (utils->json_feed(&stream->tokenizer, NULL, 0) != S_OK ||
+			!stream_tokens(stream))
+		return stream->stopped ? S_OK : stream->result;
+
+	return S_OK;
+}
+
+static void stream_init(struct session_stream *stream,
+		struct cloud_session *session)
+{
+	stream->session = session;
+	stream->result = S_OK;
+	stream->stopped = false;
+	session->utils->json_init(&stream->tokenizer, stream->scratch,
+			SESSION_JSON_SCRATCH);
+}
+
+artik_error session_get_json(artik_cloud_session_handle handle,
+		const char *path, const char *pattern,
+		artik_cloud_json_callback callback, void *user_data)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	struct session_stream stream;
+	char url[SESSION_URL_MAX];
+	artik_error ret;
+	int status = 0;
+
+	log_dbg("");
+
+	if (!session || !path || !pattern || !callback)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, path, url);
+	if (ret != S_OK)
+		return ret;
+
+	stream_init(&stream, session);
+	stream.pattern = (char *)pattern;
+	stream.callback = callback;
+	stream.done_callback = NULL;
+	stream.user_data = user_data;
+
+	ret = session->http->get_stream(url, &session->headers, &status,
+			stream_callback, &stream, session->ssl);
+
+	return stream_finish(&stream, ret, status);
+}
+
+static void stream_done_callback(artik_error result, int status,
+		char *response, void *user_data)
+{
+	struct session_stream *stream = user_data;
+	struct cloud_session *session = stream->session;
+
+	free(response);
+
+	result = stream_finish(stream, result, status);
+	stream->done_callback(session->destroyed ? E_INTERRUPTED : result,
+			NULL, stream->user_data);
+
+	free(stream->pattern);
+	free(stream);
+	session_unref(session);
+}
+
+static int stream_async_callback(char *data, unsigned int len,
+		void *user_data)
+{
+	struct session_stream *stream = user_data;
+
+	/* Abort the transfer, the completion is silent */
+	if (stream->session->destroyed)
+		return 0;
+
+	return stream_callback(data, len, user_data);
+}
+
+artik_error session_get_json_async(artik_cloud_session_handle handle,
+		const char *path, const char *pattern,
+		artik_cloud_json_callback callback,
+		artik_cloud_callback done_callback, void *user_data)
+{
+	struct cloud_session *session = session_from_handle(handle);
+	struct session_stream *stream;
+	char url[SESSION_URL_MAX];
+	artik_error ret;
+
+	log_dbg("");
+
+	if (!session || !path || !pattern || !callback || !done_callback)
+		return E_BAD_ARGS;
+
+	ret = build_url(session, path, url);
+	if (ret != S_OK)
+		return ret;
+
+	stream = malloc(sizeof(struct session_stream));
+	if (!stream)
+		return E_NO_MEM;
+
+	stream_init(stream, session);
+	stream->pattern = strdup(pattern);
+	if (!stream->pattern) {
+		free(stream);
+		return E_NO_MEM;
+	}
+
+	stream->callback = callback;
+	stream->done_callback = done_callback;
+	stream->user_data = user_data;
+
+	ret = session->http->get_stream_async(url, &session->headers,
+			stream_async_callback, stream_done_callback, stream,
+			session->ssl);
+	if (ret != S_OK) {
+		free(stream->pattern);
+		free(stream);
+		return ret;
+	}
+
+	session->refs++;
+
+	return S_OK;
+}
@@ -0,0 +1,48 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __CLOUD_SESSION_H__
+#define __CLOUD_SESSION_H__
+
+#include <artik_cloud.h>
+
+artik_error session_create(artik_cloud_session_handle *handle,
+		const artik_cloud_session_config *config);
+artik_error session_set_token(artik_cloud_session_handle handle,
+		const char *access_token);
+artik_error session_request(artik_cloud_session_handle handle,
+		artik_http_method method, const char *path, const char *body,
+		char **response);
+artik_error session_request_async(artik_cloud_session_handle handle,
+		artik_http_method method, const char *path, const char *body,
+		artik_cloud_callback callback, void *user_data);
+artik_error session_send_message(artik_cloud_session_handle handle,
+		const char *device_id, const char *message, char **response);
+artik_error session_send_message_async(artik_cloud_session_handle handle,
+		const char *device_id, const char *message,
+		artik_cloud_callback callback, void *user_data);
+artik_error session_destroy(artik_cloud_session_handle handle);
+artik_error session_get_json(artik_cloud_session_handle handle,
+		const char *path, const char *pattern,
+		artik_cloud_json_callback callback, void *user_data);
+artik_error session_get_json_async(artik_cloud_session_handle handle,
+		const char *path, const char *pattern,
+		artik_cloud_json_callback callback,
+		artik_cloud_callback done_callback, void *user_data);
+
+#endif  /* __CLOUD_SESSION_H__ */
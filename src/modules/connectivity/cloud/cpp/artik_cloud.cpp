@@ -27,6 +27,9 @@ artik::Cloud::Cloud(const char* token) {
     m_token = NULL;
 
   m_ws_handle = NULL;
+  m_batch_handle = NULL;
+  m_session_handle = NULL;
+  m_device_iterator = NULL;
 }
 
 artik::Cloud::~Cloud() {
@@ -285,3 +288,118 @@ artik_error artik::Cloud::websocket_close_stream() {
 
   return ret;
 }
+
+artik_error artik::Cloud::batch_create(const artik_cloud_batch_config *config) {
+  artik_cloud_batch_config batch_config;
+
+  if (!config)
+    return E_BAD_ARGS;
+
+  /* Messages are sent with the token of the object by default */
+  batch_config = *config;
+  if (!batch_config.access_token)
+    batch_config.access_token = m_token;
+
+  return m_module->batch_create(&m_batch_handle, &batch_config);
+}
+
+artik_error artik::Cloud::batch_send_message(const char *device_id,
+    const char *message) {
+  return m_module->batch_send_message(m_batch_handle, NULL, device_id,
+      message);
+}
+
+artik_error artik::Cloud::batch_flush() {
+  return m_module->batch_flush(m_batch_handle);
+}
+
+artik_error artik::Cloud::batch_get_stats(artik_cloud_batch_stats *stats) {
+  return m_module->batch_get_stats(m_batch_handle, stats);
+}
+
+artik_error artik::Cloud::batch_destroy() {
+  artik_error ret = S_OK;
+
+  ret = m_module->batch_destroy(m_batch_handle);
+  if (ret == S_OK)
+    m_batch_handle = NULL;
+
+  return ret;
+}
+
+artik_error artik::Cloud::session_create(const char *base_url,
+    artik_ssl_config *ssl) {
+  artik_cloud_session_config config;
+
+  config.base_url = base_url;
+  config.access_token = m_token;
+  config.ssl = ssl;
+
+  return m_module->session_create(&m_session_handle, &config);
+}
+
+artik_error artik::Cloud::session_request(artik_http_method method,
+    const char *path, const char *body, char **response) {
+  return m_module->session_request(m_session_handle, method, path, body,
+      response);
+}
+
+artik_error artik::Cloud::session_request_async(artik_http_method method,
+    const char *path, const char *body, artik_cloud_callback callback,
+    void *user_data) {
+  return m_module->session_request_async(m_session_handle, method, path,
+      body, callback, user_data);
+}
+
+artik_error artik::Cloud::session_send_message(const char *device_id,
+    const char *message, char **response) {
+  return m_module->session_send_message(m_session_handle, device_id,
+      message, response);
+}
+
+artik_error artik::Cloud::session_send_message_async(const char *device_id,
+    const char *message, artik_cloud_callback callback, void *user_data) {
+  return m_module->session_send_message_async(m_session_handle, device_id,
+      message, callback, user_data);
+}
+
+artik_error artik::Cloud::session_destroy() {
+  artik_error ret = S_OK;
+
+  ret = m_module->session_destroy(m_session_handle);
+  if (ret == S_OK)
+    m_session_handle = NULL;
+
+  return ret;
+}
+
+artik_error artik::Cloud::session_get_json(const char *path,
+    const char *pattern, artik_cloud_json_callback callback,
+    void *user_data) {
+  return m_module->session_get_json(m_session_handle, path, pattern,
+      callback, user_data);
+}
+
+artik_error artik::Cloud::session_get_json_async(const char *path,
+    const char *pattern, artik_cloud_json_callback callback,
+    artik_cloud_callback done_callback, void *user_data) {
+  return m_module->session_get_json_async(m_session_handle, path, pattern,
+      callback, done_callback, user_data);
+}
+
+artik_error artik::Cloud::device_iterator_create(const char *user_id,
+    const artik_cloud_device_iterator_config *config,
+    artik_cloud_device_callback callback, void *user_data) {
+  return m_module->device_iterator_create(&m_device_iterator,
+      m_session_handle, user_id, config, callback, user_data);
+}
+
+artik_error artik::Cloud::device_iterator_destroy() {
+  artik_error ret = S_OK;
+
+  ret = m_module->device_iterator_destroy(m_device_iterator);
+  if (ret == S_OK)
+    m_device_iterator = NULL;
+
+  return ret;
+}
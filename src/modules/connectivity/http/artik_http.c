@@ -60,6 +60,19 @@ static artik_error artik_http_delete_async(const char *url,
 			artik_http_headers *headers,
 			artik_http_response_callback callback, void *user_data,
 			artik_ssl_config *ssl);
+static artik_error artik_http_set_pool_config(
+			const artik_http_pool_config *config);
+static artik_error artik_http_get_pool_stats(artik_http_pool_stats *stats);
+static artik_error artik_http_request(artik_http_method method,
+			const char *url, artik_http_headers *headers,
+			const char *body, unsigned int body_len,
+			artik_http_response *response, int *status,
+			artik_ssl_config *ssl);
+static artik_error artik_http_request_async(artik_http_method method,
+			const char *url, artik_http_headers *headers,
+			const char *body, unsigned int body_len,
+			artik_http_response_len_callback callback,
+			void *user_data, artik_ssl_config *ssl);
 
 const artik_http_module http_module = {
 	artik_http_get_stream,
@@ -72,6 +85,10 @@ const artik_http_module http_module = {
 	artik_http_put_async,
 	artik_http_delete,
 	artik_http_delete_async,
+	artik_http_set_pool_config,
+	artik_http_get_pool_stats,
+	artik_http_request,
+	artik_http_request_async
 };
 
 artik_error artik_http_get_stream(const char *url, artik_http_headers *headers,
@@ -147,3 +164,32 @@ artik_error artik_http_delete_async(const char *url,
 {
 	return os_http_delete_async(url, headers, callback, user_data, ssl);
 }
+
+artik_error artik_http_set_pool_config(const artik_http_pool_config *config)
+{
+	return os_http_set_pool_config(config);
+}
+
+artik_error artik_http_get_pool_stats(artik_http_pool_stats *stats)
+{
+	return os_http_get_pool_stats(stats);
+}
+
+artik_error artik_http_request(artik_http_method method, const char *url,
+			artik_http_headers *headers, const char *body,
+			unsigned int body_len, artik_http_response *response,
+			int *status, artik_ssl_config *ssl)
+{
+	return os_http_request(method, url, headers, body, body_len, response,
+								status, ssl);
+}
+
+artik_error artik_http_request_async(artik_http_method method,
+			const char *url, artik_http_headers *headers,
+			const char *body, unsigned int body_len,
+			artik_http_response_len_callback callback,
+			void *user_data, artik_ssl_config *ssl)
+{
+	return os_http_request_async(method, url, headers, body, body_len,
+						callback, user_data, ssl);
+}
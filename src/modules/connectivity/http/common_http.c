@@ -129,3 +129,53 @@ void free_http_headers(artik_http_headers *headers)
 	free(headers->fields);
 	free(headers);
 }
+
+static bool is_same_buffer(const char *a, unsigned int a_len, const char *b,
+	unsigned int b_len)
+{
+	if (!a)
+		a_len = 0;
+	if (!b)
+		b_len = 0;
+
+	if (a_len != b_len)
+		return false;
+
+	return !a_len || !memcmp(a, b, a_len);
+}
+
+/*
+ * Compare the content of two SSL configurations the same way
+ * copy_ssl_config duplicates it.
+ */
+bool is_same_ssl_config(artik_ssl_config *a, artik_ssl_config *b)
+{
+	const char *a_key_id, *b_key_id;
+
+	if (!a || !b)
+		return a == b;
+
+	if (a->verify_cert != b->verify_cert)
+		return false;
+
+	if (!is_same_buffer(a->ca_cert.data, a->ca_cert.len, b->ca_cert.data,
+			b->ca_cert.len))
+		return false;
+
+	if (!is_same_buffer(a->client_cert.data, a->client_cert.len,
+			b->client_cert.data, b->client_cert.len))
+		return false;
+
+	if (!is_same_buffer(a->client_key.data, a->client_key.len,
+			b->client_key.data, b->client_key.len))
+		return false;
+
+	a_key_id = a->se_config ? a->se_config->key_id : NULL;
+	b_key_id = b->se_config ? b->se_config->key_id : NULL;
+
+	if (!a_key_id || !b_key_id)
+		return a_key_id == b_key_id;
+
+	return a->se_config->key_algo == b->se_config->key_algo &&
+		!strcmp(a_key_id, b_key_id);
+}
@@ -26,5 +26,6 @@ artik_ssl_config *copy_ssl_config(artik_ssl_config *from);
 artik_http_headers *copy_http_headers(artik_http_headers *from);
 void free_ssl_config(artik_ssl_config *ssl);
 void free_http_headers(artik_http_headers *headers);
+bool is_same_ssl_config(artik_ssl_config *a, artik_ssl_config *b);
 
 #endif /* HTTP_COMMON_H */
@@ -86,3 +86,27 @@ artik_error artik::Http::del_async(const char *url, artik_http_headers *headers,
     artik_ssl_config *ssl) {
   return m_module->del_async(url, headers, callback, user_data, ssl);
 }
+
+artik_error artik::Http::set_pool_config(
+    const artik_http_pool_config *config) {
+  return m_module->set_pool_config(config);
+}
+
+artik_error artik::Http::get_pool_stats(artik_http_pool_stats *stats) {
+  return m_module->get_pool_stats(stats);
+}
+
+artik_error artik::Http::request(artik_http_method method, const char *url,
+    artik_http_headers *headers, const char *body, unsigned int body_len,
+    artik_http_response *response, int *status, artik_ssl_config *ssl) {
+  return m_module->request(method, url, headers, body, body_len, response,
+      status, ssl);
+}
+
+artik_error artik::Http::request_async(artik_http_method method,
+    const char *url, artik_http_headers *headers, const char *body,
+    unsigned int body_len, artik_http_response_len_callback callback,
+    void *user_data, artik_ssl_config *ssl) {
+  return m_module->request_async(method, url, headers, body, body_len,
+      callback, user_data, ssl);
+}
@@ -19,9 +19,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 #include <curl/curl.h>
-#include <openssl/ssl.h>
-#include <openssl/engine.h>
 #include <artik_log.h>
 #include <pthread.h>
 
@@ -33,17 +32,11 @@
 #include "os_http.h"
 #include "common_http.h"
 
-#define WAIT_CONNECT_POLLING_MS  500
-#define FLAG_EVENT               (0x1 << 0)
-#define MAX(a, b)                ((a > b) ? a : b)
-#define NUM_FDS                  2
-#define FD_CLOSE                 0
-#define FD_CONNECT               1
-#define MAX_QUEUE_NAME           1024
-#define MAX_QUEUE_SIZE           128
-#define MAX_MESSAGE_SIZE         2048
-#define PEM_END_CERTIFICATE_UNIX "-----END CERTIFICATE-----\n"
-#define PEM_END_CERTIFICATE_WIN  "-----END CERTIFICATE-----\r\n"
+#define POOL_MAX_IDLE_HANDLES    4
+#define POOL_MAX_POOLS           16
+#define POOL_IDLE_TIMEOUT_MS     60000
+#define HTTP_BUFFER_MIN_SIZE     1024
+#define HTTP_BUFFER_MAX_HINT     (256 * 1024)
 
 typedef struct {
 	artik_http_stream_callback callback;
@@ -52,21 +45,98 @@ typedef struct {
 
 typedef struct {
 	artik_http_response_callback callback;
+	artik_http_response_len_callback len_callback;
 	void *user_data;
 } response_callback_params;
 
+/*
+ * Response body being received. The buffer grows geometrically unless
+ * it has been provided by the caller, in which case it is filled in
+ * place.
+ */
+typedef struct {
+	CURL *curl;
+	char *data;
+	size_t len;
+	size_t size;
+	bool external;
+	bool overflow;
+} http_buffer;
+
+typedef struct http_pool http_pool;
+
+typedef struct http_pool_handle {
+	struct http_pool_handle *next;
+	http_pool *pool;
+	CURL *curl;
+	unsigned long long last_used;
+} http_pool_handle;
+
+/*
+ * Pool of easy handles targeting the same scheme, host, port and SSL
+ * configuration. All the handles of a pool use the same share object
+ * so that the DNS cache, TLS sessions and connections are reused from
+ * one request to another.
+ */
+struct http_pool {
+	struct http_pool *next;
+	char *key;
+	artik_ssl_config *ssl;
+	artik_ssl_credentials_handle creds;
+	CURLSH *share;
+	pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+	http_pool_handle *idle;
+	unsigned int num_idle;
+	unsigned int num_busy;
+	unsigned long long last_used;
+};
+
 typedef struct {
 	int loop_process_id;
+	http_pool_handle *handle;
+	struct curl_slist *h_list;
 	char *url;
-	artik_http_headers *headers;
 	char *body;
-	char *response;
-	int status;
-	artik_ssl_config *ssl;
+	unsigned int body_len;
+	http_buffer response;
 	stream_callback_params stream_cb_params;
 	response_callback_params response_cb_params;
 } os_http_interface;
 
+/*
+ * State of a socket handed over by curl to the multi engine, attached
+ * to the socket with curl_multi_assign.
+ */
+typedef struct {
+	curl_socket_t fd;
+	int watch_id;
+} http_socket_context;
+
+/*
+ * Process wide engine running all the asynchronous requests. Every
+ * access to the multi handle is done from the loop thread, sockets
+ * are watched through the loop fd watches and curl timers are mapped
+ * on loop timeouts, so that no request ever blocks the loop.
+ */
+typedef struct {
+	CURLM *multi;
+	artik_loop_module *loop;
+	int timeout_id;
+	int running;
+} http_multi_engine;
+
+static http_multi_engine engine;
+
+static http_pool *pools;
+static artik_http_pool_config pool_config = {
+	POOL_MAX_IDLE_HANDLES,
+	POOL_MAX_POOLS,
+	POOL_IDLE_TIMEOUT_MS
+};
+static artik_http_pool_stats pool_stats;
+static bool pool_initialized = false;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static pthread_mutex_t lock;
 static bool lock_initialized = false;
 
@@ -84,532 +154,612 @@ static void mutex_unlock(void)
 	pthread_mutex_unlock(&lock);
 }
 
-static char *create_key_uri(artik_secure_element_config *se_config)
+static artik_error get_ssl_credentials(artik_ssl_config *ssl,
+	artik_ssl_credentials_handle *creds)
 {
-	const char *prefix;
-	char *engine_key_uri;
+	artik_security_module *security = (artik_security_module *)
+		artik_request_api_module("security");
+	artik_error ret;
 
-	switch (se_config->key_algo) {
-	case RSA_1024:
-		prefix = "rsa1024://";
-		break;
-	case RSA_2048:
-		prefix = "rsa2048://";
-		break;
-	case ECC_BRAINPOOL_P256R1:
-		prefix = "bp256://";
-		break;
-	case ECC_SEC_P256R1:
-		prefix = "ec256://";
-		break;
-	case ECC_SEC_P384R1:
-		prefix = "ec384://";
-		break;
-	case ECC_SEC_P521R1:
-		prefix = "ec521://";
-		break;
-	default:
-		log_dbg("algo %d not supported", se_config->key_algo);
-		return NULL;
+	if (!security) {
+		log_err("Failed to request security module");
+		return E_NOT_SUPPORTED;
 	}
 
-	engine_key_uri = malloc(strlen(prefix) + strlen(se_config->key_id) + 1);
-	if (!engine_key_uri)
-		return NULL;
+	ret = security->get_ssl_credentials(ssl, creds);
+	if (ret != S_OK)
+		log_err("Failed to load SSL credentials (err=%d)", ret);
+
+	artik_release_api_module(security);
+
+	return ret;
+}
+
+static void put_ssl_credentials(artik_ssl_credentials_handle creds)
+{
+	artik_security_module *security = (artik_security_module *)
+		artik_request_api_module("security");
+
+	if (!security) {
+		log_err("Failed to request security module");
+		return;
+	}
 
-	strcpy(engine_key_uri, prefix);
-	strcat(engine_key_uri, se_config->key_id);
+	if (security->put_ssl_credentials(creds) != S_OK)
+		log_err("Failed to release SSL credentials");
 
-	return engine_key_uri;
+	artik_release_api_module(security);
 }
 
 static CURLcode ssl_ctx_callback(CURL *curl, void *sslctx, void *parm)
 {
+	http_pool *pool = (http_pool *)parm;
+	artik_security_module *security;
 	CURLcode ret = CURLE_OK;
-	artik_ssl_config *ssl_config = (artik_ssl_config *)parm;
-	artik_security_module *security = NULL;
-	SSL_CTX *ctx = (SSL_CTX *)sslctx;
-	BIO *b64 = NULL;
-	X509 *x509_cert = NULL;
-	EVP_PKEY *pk = NULL;
-	X509_STORE *keystore = NULL;
-	char *start = NULL, *end = NULL;
-	int remain = 0;
-	char *uri = NULL;
 
 	log_dbg("");
 
-	if (ssl_config->se_config) {
-		security = (artik_security_module *)
-			artik_request_api_module("security");
-		if (security->load_openssl_engine() != S_OK) {
-			log_err("Failed to load openssl engine");
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
-	}
+	/* Credentials are parsed once per pool, only share them here */
+	if (!pool->creds)
+		return CURLE_SSL_CERTPROBLEM;
 
-	if (ssl_config->ca_cert.data && ssl_config->ca_cert.len &&
-		ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		/* Create a new keystore */
-		keystore = X509_STORE_new();
-		if (!keystore) {
-			log_err("Failed to create keystore");
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security)
+		return CURLE_SSL_CERTPROBLEM;
 
-		/* CA certs may come as a bundle, parse them all */
-		start = ssl_config->ca_cert.data;
-		end = start;
-		remain = ssl_config->ca_cert.len;
-
-		do {
-			/* Look for UNIX style ending first */
-			end = strstr(start, PEM_END_CERTIFICATE_UNIX);
-			if (end) {
-				end += strlen(PEM_END_CERTIFICATE_UNIX);
-			} else {
-				/* If not found, check for Windows stye ending */
-				end = strstr(start, PEM_END_CERTIFICATE_WIN);
-				if (!end)
-					break;
-				end += strlen(PEM_END_CERTIFICATE_WIN);
-			}
+	if (security->apply_ssl_credentials(pool->creds, sslctx) != S_OK)
+		ret = CURLE_SSL_CERTPROBLEM;
 
-			/* Convert CA certificate string into a BIO */
-			b64 = BIO_new(BIO_s_mem());
-			BIO_write(b64, start, end - start);
-
-			/* Extract X509 cert from the BIO */
-			x509_cert = PEM_read_bio_X509(b64, NULL, NULL, NULL);
-			if (!x509_cert) {
-				log_err("Failed to extract cert from the bio");
-				BIO_free(b64);
-				ret = CURLE_SSL_CERTPROBLEM;
-				goto exit;
-			}
+	artik_release_api_module(security);
 
-			/* Add certificate to keystore */
-			if (!X509_STORE_add_cert(keystore, x509_cert)) {
-				log_err("Failed add certificate to the keystore");
-				BIO_free(b64);
-				X509_free(x509_cert);
-				x509_cert = NULL;
-				ret = CURLE_SSL_CERTPROBLEM;
-				goto exit;
-			}
+	return ret;
+}
 
-			BIO_free(b64);
-			X509_free(x509_cert);
-			x509_cert = NULL;
+static unsigned long long get_time_ms(void)
+{
+	struct timespec ts;
 
-			remain -= end - start;
-			start = end;
-		} while (remain);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-		SSL_CTX_set_cert_store(ctx, keystore);
-	}
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-	log_dbg("");
+/*
+ * Build the "scheme://host:port" part of the URL used to select
+ * the pool serving a request.
+ */
+static char *pool_key_from_url(const char *url)
+{
+	const char *scheme = "http";
+	int scheme_len = 4;
+	const char *host = strstr(url, "://");
+	const char *end, *at, *port = NULL;
+	int host_len, port_num;
+	char *key;
+	int key_len;
+
+	if (host) {
+		scheme = url;
+		scheme_len = host - url;
+		host += 3;
+	} else {
+		host = url;
+	}
 
-	if (ssl_config->client_cert.data && ssl_config->client_cert.len) {
-		/* Convert certificate string into a BIO */
-		b64 = BIO_new(BIO_s_mem());
-		BIO_write(b64, ssl_config->client_cert.data,
-			ssl_config->client_cert.len);
-
-		/* Extract X509 cert from the BIO */
-		x509_cert = PEM_read_bio_X509(b64, NULL, NULL, NULL);
-		if (!x509_cert) {
-			BIO_free(b64);
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+	end = host + strcspn(host, "/?#");
 
-		log_dbg("");
+	/* Skip user info if any */
+	at = memchr(host, '@', end - host);
+	if (at)
+		host = at + 1;
 
-		BIO_free(b64);
+	if (*host == '[') {
+		/* IPv6 literal address */
+		const char *bracket = memchr(host, ']', end - host);
 
-		/* Set certificate to context */
-		if (!SSL_CTX_use_certificate(ctx, x509_cert)) {
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+		if (bracket && bracket + 1 < end && bracket[1] == ':')
+			port = bracket + 1;
+	} else {
+		port = memchr(host, ':', end - host);
 	}
 
-	log_dbg("");
+	host_len = (port ? port : end) - host;
 
-	if (ssl_config->se_config && ssl_config->se_config->key_id) {
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-		ENGINE *engine = ENGINE_get_default_ECDSA();
-#else
-		ENGINE *engine = ENGINE_get_default_EC();
-#endif
-		if (!engine) {
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+	if (port)
+		port_num = atoi(port + 1);
+	else if (scheme_len == 5 && !strncasecmp(scheme, "https", 5))
+		port_num = 443;
+	else
+		port_num = 80;
 
-		uri = create_key_uri(ssl_config->se_config);
-		if (!uri) {
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+	key_len = scheme_len + 3 + host_len + 7;
+	key = malloc(key_len);
+	if (!key)
+		return NULL;
 
-		pk = ENGINE_load_private_key(engine,
-									 uri, NULL, NULL);
-		free(uri);
+	snprintf(key, key_len, "%.*s://%.*s:%d", scheme_len, scheme, host_len,
+							host, port_num);
 
-		if (!pk) {
-			log_dbg("");
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+	return key;
+}
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-		if (ssl_config->se_config)
-			SSL_CTX_set1_curves_list(ctx, "brainpoolP256r1:prime256v1");
-#endif
-		SSL_CTX_set1_sigalgs_list(ctx, "ECDSA+SHA256");
-	} else if (ssl_config->client_key.data && ssl_config->client_key.len) {
-		log_dbg("");
-
-		/* Convert key string into a BIO */
-		b64 = BIO_new(BIO_s_mem());
-		if (!BIO_write(b64, ssl_config->client_key.data,
-				ssl_config->client_key.len)) {
-			BIO_free(b64);
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+static void pool_share_lock(CURL *curl, curl_lock_data data,
+	curl_lock_access access, void *userp)
+{
+	http_pool *pool = (http_pool *)userp;
 
-		/* Extract EVP key from the BIO */
-		pk = PEM_read_bio_PrivateKey(b64, NULL, 0, NULL);
-		BIO_free(b64);
-		if (!pk) {
-			log_dbg("");
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
-	}
+	pthread_mutex_lock(&pool->share_locks[data]);
+}
 
-	/* Set private key to context */
-	if (pk) {
-		if (!SSL_CTX_use_PrivateKey(ctx, pk)) {
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
+static void pool_share_unlock(CURL *curl, curl_lock_data data, void *userp)
+{
+	http_pool *pool = (http_pool *)userp;
 
-		log_dbg("");
+	pthread_mutex_unlock(&pool->share_locks[data]);
+}
 
-	/* Check certificate/key pair validity */
-		if (!SSL_CTX_check_private_key(ctx)) {
-			ret = CURLE_SSL_CERTPROBLEM;
-			goto exit;
-		}
-	}
+static void pool_handle_destroy(http_pool_handle *handle)
+{
+	curl_easy_cleanup(handle->curl);
+	free(handle);
+}
 
-exit:
-	if (security)
-		artik_release_api_module(security);
+static void pool_destroy(http_pool *pool)
+{
+	http_pool_handle *handle = pool->idle;
+	int i;
 
+	while (handle) {
+		http_pool_handle *next = handle->next;
 
-	if (pk)
-		EVP_PKEY_free(pk);
+		pool_handle_destroy(handle);
+		pool_stats.evictions++;
+		handle = next;
+	}
 
-	if (x509_cert)
-		X509_free(x509_cert);
+	if (pool->share)
+		curl_share_cleanup(pool->share);
 
-	return ret;
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_destroy(&pool->share_locks[i]);
+
+	if (pool->creds)
+		put_ssl_credentials(pool->creds);
+
+	if (pool->ssl)
+		free_ssl_config(pool->ssl);
 
+	free(pool->key);
+	free(pool);
 }
 
-static void release_openssl_engine(void)
+static void pool_unlink(http_pool *pool)
 {
-	artik_security_module *security = (artik_security_module *)
-		artik_request_api_module("security");
-
-	if (!security) {
-		log_err("Failed to request security module");
-		return;
-	}
+	http_pool **cur = &pools;
 
-	if (security->unload_openssl_engine() != S_OK)
-		log_err("Failed to unload openssl engine");
+	while (*cur && *cur != pool)
+		cur = &(*cur)->next;
 
-	artik_release_api_module(security);
+	if (*cur)
+		*cur = pool->next;
 
+	pool_stats.pools--;
 }
 
-static size_t response_callback(void *ptr, size_t size, size_t nmemb,
-	void *userp)
+/*
+ * Release the handles and pools that have not been used for longer
+ * than the idle timeout, and the handles exceeding the pool limits.
+ * Must be called with the pool lock held.
+ */
+static void pool_evict_locked(unsigned long long now)
 {
-	char **response = (char **)userp;
-	int len = size * nmemb;
-	const char *rx_data = (const char *)ptr;
+	http_pool *pool = pools;
+
+	while (pool) {
+		http_pool *next = pool->next;
+		http_pool_handle **cur = &pool->idle;
+		unsigned int kept = 0;
+
+		while (*cur) {
+			http_pool_handle *handle = *cur;
+
+			if (kept < pool_config.max_idle_handles &&
+				now - handle->last_used <
+						pool_config.idle_timeout_ms) {
+				kept++;
+				cur = &handle->next;
+				continue;
+			}
 
-	log_dbg("");
+			*cur = handle->next;
+			pool_handle_destroy(handle);
+			pool->num_idle--;
+			pool_stats.idle_handles--;
+			pool_stats.evictions++;
+		}
 
-	if (!*response) {
-		/* first call, allocate the response string */
-		*response = strndup(rx_data, len);
-		if (!*response)
-			return 0;
-	} else {
-		/* not first call, need to realloc memory
-		 * before concatenating
-		 */
-		*response = realloc(*response, strlen(*response) + len + 1);
-		if (!*response)
-			return 0;
+		if (!pool->num_idle && !pool->num_busy &&
+			now - pool->last_used >= pool_config.idle_timeout_ms) {
+			pool_unlink(pool);
+			pool_destroy(pool);
+		}
 
-		strncat(*response, rx_data, len);
+		pool = next;
 	}
-
-	return len;
 }
 
-static size_t stream_callback(void *ptr, size_t size, size_t nmemb,
-	void *userp)
+/*
+ * Drop the least recently used pool that has no pending request.
+ * Must be called with the pool lock held.
+ */
+static void pool_evict_lru_locked(void)
 {
-	stream_callback_params *cb_params = (stream_callback_params *)userp;
-	int len = size * nmemb;
-	char *data = (char *)ptr;
+	http_pool *pool, *lru = NULL;
 
-	log_dbg("");
-
-	return (size_t)(cb_params->callback)(data, len, cb_params->user_data);
-}
+	for (pool = pools; pool; pool = pool->next) {
+		if (pool->num_busy)
+			continue;
 
-static int os_http_process_get_stream(void *user_data)
-{
-	os_http_interface *interface = (os_http_interface *)user_data;
-	artik_error ret;
+		if (!lru || pool->last_used < lru->last_used)
+			lru = pool;
+	}
 
-	ret = os_http_get_stream(interface->url, interface->headers,
-		&interface->status, interface->stream_cb_params.callback,
-		interface->stream_cb_params.user_data, interface->ssl);
+	if (!lru)
+		return;
 
-	log_dbg("");
+	pool_stats.idle_handles -= lru->num_idle;
+	pool_unlink(lru);
+	pool_destroy(lru);
+}
 
-	if (ret != S_OK)
-		log_err("os_http_process_get_stream");
+static http_pool *pool_create_locked(char *key, artik_ssl_config *ssl)
+{
+	http_pool *pool;
+	int i;
 
-	if (interface->response_cb_params.callback)
-		interface->response_cb_params.callback(ret,
-			interface->status,
-			NULL,
-			interface->response_cb_params.user_data);
+	pool = malloc(sizeof(http_pool));
+	if (!pool)
+		return NULL;
 
+	memset(pool, 0, sizeof(http_pool));
 
-	if (interface->url)
-		free((void *)interface->url);
+	if (ssl) {
+		pool->ssl = copy_ssl_config(ssl);
+		if (!pool->ssl) {
+			free(pool);
+			return NULL;
+		}
 
-	if (interface->headers)
-		free(interface->headers);
+		/*
+		 * Parse the certificates and keys once for all the connections
+		 * of the pool. On failure the TLS handshakes report the error.
+		 */
+		if (get_ssl_credentials(pool->ssl, &pool->creds) != S_OK)
+			pool->creds = NULL;
+	}
 
-	if (interface->ssl)
-		free_ssl_config(interface->ssl);
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_init(&pool->share_locks[i], NULL);
+
+	pool->key = key;
+	pool->share = curl_share_init();
+	if (pool->share) {
+		curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC,
+							pool_share_lock);
+		curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC,
+							pool_share_unlock);
+		curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+		curl_share_setopt(pool->share, CURLSHOPT_SHARE,
+							CURL_LOCK_DATA_DNS);
+		curl_share_setopt(pool->share, CURLSHOPT_SHARE,
+							CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(pool->share, CURLSHOPT_SHARE,
+							CURL_LOCK_DATA_CONNECT);
+#endif
+	} else {
+		log_err("Failed to create share, caches won't be shared");
+	}
 
-	free(interface);
+	pool->next = pools;
+	pools = pool;
+	pool_stats.pools++;
 
-	return 0;
+	return pool;
 }
 
-static int os_http_process_get(void *user_data)
+/*
+ * Get a handle ready to perform a request on the given URL, either
+ * from the matching pool or newly created.
+ */
+static http_pool_handle *pool_acquire(const char *url, artik_ssl_config *ssl)
 {
-	os_http_interface *interface = (os_http_interface *)user_data;
-	artik_error ret;
+	http_pool *pool;
+	http_pool_handle *handle = NULL;
+	unsigned long long now = get_time_ms();
+	char *key;
 
-	log_dbg("");
+	key = pool_key_from_url(url);
+	if (!key)
+		return NULL;
 
-	ret = os_http_get(interface->url, interface->headers,
-		&interface->response, &interface->status, interface->ssl);
+	pthread_mutex_lock(&pool_lock);
 
-	if (ret != S_OK)
-		log_err("os_http_process_get");
+	if (!pool_initialized) {
+		/* Pooled handles outlive requests, keep curl initialized */
+		curl_global_init(CURL_GLOBAL_DEFAULT);
+		pool_initialized = true;
+	}
 
-	if (interface->response_cb_params.callback)
-		interface->response_cb_params.callback(ret,
-			interface->status,
-			interface->response,
-			interface->response_cb_params.user_data);
+	pool_evict_locked(now);
 
-	if (interface->url)
-		free((void *)interface->url);
+	for (pool = pools; pool; pool = pool->next) {
+		if (!strcmp(pool->key, key) && is_same_ssl_config(pool->ssl,
+									ssl))
+			break;
+	}
 
-	if (interface->headers)
-		free(interface->headers);
+	if (pool) {
+		free(key);
+	} else {
+		if (pool_stats.pools >= pool_config.max_pools)
+			pool_evict_lru_locked();
 
-	if (interface->ssl)
-		free_ssl_config(interface->ssl);
+		pool = pool_create_locked(key, ssl);
+		if (!pool) {
+			free(key);
+			goto exit;
+		}
+	}
 
-	free(interface);
+	if (pool->idle) {
+		handle = pool->idle;
+		pool->idle = handle->next;
+		pool->num_idle--;
+		pool_stats.idle_handles--;
+		pool_stats.hits++;
 
-	return 0;
-}
+		curl_easy_reset(handle->curl);
+	} else {
+		handle = malloc(sizeof(http_pool_handle));
+		if (!handle)
+			goto exit;
 
-static int os_http_process_post(void *user_data)
-{
-	os_http_interface *interface = (os_http_interface *)user_data;
-	artik_error ret;
+		memset(handle, 0, sizeof(http_pool_handle));
+		handle->pool = pool;
+		handle->curl = curl_easy_init();
+		if (!handle->curl) {
+			log_err("Failed to initialize curl");
+			free(handle);
+			handle = NULL;
+			goto exit;
+		}
 
-	log_dbg("");
+		pool_stats.misses++;
+	}
 
-	ret = os_http_post(interface->url, interface->headers, interface->body,
-		&interface->response, &interface->status, interface->ssl);
+	handle->next = NULL;
+	pool->num_busy++;
+	pool->last_used = now;
+	pool_stats.busy_handles++;
 
-	if (ret != S_OK)
-		log_err("os_http_process_post");
+	if (pool->share)
+		curl_easy_setopt(handle->curl, CURLOPT_SHARE, pool->share);
+	curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPALIVE, 1L);
 
-	if (interface->response_cb_params.callback)
-		interface->response_cb_params.callback(ret,
-			interface->status,
-			interface->response,
-			interface->response_cb_params.user_data);
+exit:
+	pthread_mutex_unlock(&pool_lock);
 
-	if (interface->url)
-		free((void *)interface->url);
+	return handle;
+}
 
-	if (interface->headers)
-		free(interface->headers);
+static void pool_release(http_pool_handle *handle)
+{
+	http_pool *pool = handle->pool;
+	unsigned long long now = get_time_ms();
 
-	if (interface->body)
-		free(interface->body);
+	pthread_mutex_lock(&pool_lock);
 
-	if (interface->ssl)
-		free_ssl_config(interface->ssl);
+	pool->num_busy--;
+	pool_stats.busy_handles--;
 
-	free(interface);
+	handle->last_used = now;
+	handle->next = pool->idle;
+	pool->idle = handle;
+	pool->num_idle++;
+	pool->last_used = now;
+	pool_stats.idle_handles++;
 
-	return 0;
+	pool_evict_locked(now);
+
+	pthread_mutex_unlock(&pool_lock);
 }
 
-static int os_http_process_put(void *user_data)
+artik_error os_http_set_pool_config(const artik_http_pool_config *config)
 {
-	os_http_interface *interface = (os_http_interface *)user_data;
-	artik_error ret;
-
-	log_dbg("");
+	if (!config || !config->max_pools)
+		return E_BAD_ARGS;
 
-	ret = os_http_put(interface->url, interface->headers, interface->body,
-		&interface->response, &interface->status, interface->ssl);
+	pthread_mutex_lock(&pool_lock);
+	memcpy(&pool_config, config, sizeof(artik_http_pool_config));
+	pthread_mutex_unlock(&pool_lock);
 
-	if (ret != S_OK)
-		log_err("os_http_process_put");
+	return S_OK;
+}
 
-	if (interface->response_cb_params.callback)
-		interface->response_cb_params.callback(ret,
-			interface->status,
-			interface->response,
-			interface->response_cb_params.user_data);
+artik_error os_http_get_pool_stats(artik_http_pool_stats *stats)
+{
+	if (!stats)
+		return E_BAD_ARGS;
 
-	if (interface->url)
-		free((void *)interface->url);
+	pthread_mutex_lock(&pool_lock);
+	pool_evict_locked(get_time_ms());
+	memcpy(stats, &pool_stats, sizeof(artik_http_pool_stats));
+	pthread_mutex_unlock(&pool_lock);
 
-	if (interface->headers)
-		free(interface->headers);
+	return S_OK;
+}
 
-	if (interface->body)
-		free(interface->body);
+static size_t content_length_hint(CURL *curl)
+{
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t length = -1;
 
-	if (interface->ssl)
-		free_ssl_config(interface->ssl);
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+					&length) != CURLE_OK || length < 0)
+		return 0;
+#else
+	double length = -1;
 
-	free(interface);
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+					&length) != CURLE_OK || length < 0)
+		return 0;
+#endif
 
-	return 0;
+	/* Leave room for the terminating NUL */
+	return (size_t)length + 1;
 }
 
-static int os_http_process_delete(void *user_data)
+static size_t response_callback(char *ptr, size_t size, size_t nmemb,
+	void *userp)
 {
-	os_http_interface *interface = (os_http_interface *)user_data;
-	artik_error ret;
+	http_buffer *response = (http_buffer *)userp;
+	size_t len = size * nmemb;
 
 	log_dbg("");
 
-	ret = os_http_delete(interface->url, interface->headers,
-		&interface->response, &interface->status, interface->ssl);
+	if (response->external) {
+		/* Caller provided buffer, never reallocated */
+		if (len > response->size - response->len) {
+			log_err("Response does not fit in the provided buffer");
+			response->overflow = true;
+			return 0;
+		}
+	} else if (response->len + len + 1 > response->size) {
+		size_t new_size = response->size;
+		char *data;
+
+		if (!new_size) {
+			/*
+			 * First call, presize from the announced body length.
+			 * The length is not trusted beyond the hint, larger
+			 * bodies grow the buffer as they come in.
+			 */
+			new_size = content_length_hint(response->curl);
+			if (new_size > HTTP_BUFFER_MAX_HINT)
+				new_size = HTTP_BUFFER_MAX_HINT;
+			if (new_size < HTTP_BUFFER_MIN_SIZE)
+				new_size = HTTP_BUFFER_MIN_SIZE;
+		}
 
-	if (ret != S_OK)
-		log_err("os_http_process_delete");
+		while (new_size < response->len + len + 1)
+			new_size *= 2;
 
-	if (interface->response_cb_params.callback)
-		interface->response_cb_params.callback(ret,
-			interface->status,
-			interface->response,
-			interface->response_cb_params.user_data);
+		data = realloc(response->data, new_size);
+		if (!data)
+			return 0;
 
-	if (interface->url)
-		free((void *)interface->url);
+		response->data = data;
+		response->size = new_size;
+	}
 
-	if (interface->headers)
-		free(interface->headers);
+	memcpy(response->data + response->len, ptr, len);
+	response->len += len;
 
-	if (interface->ssl)
-		free_ssl_config(interface->ssl);
+	/* Keep text bodies usable as strings when there is room for it */
+	if (response->len < response->size)
+		response->data[response->len] = '\0';
 
-	free(interface);
+	return len;
+}
 
-	return 0;
+static size_t stream_callback(char *ptr, size_t size, size_t nmemb,
+	void *userp)
+{
+	stream_callback_params *cb_params = (stream_callback_params *)userp;
+	int len = size * nmemb;
+	char *data = (char *)ptr;
+
+	log_dbg("");
+
+	return (size_t)(cb_params->callback)(data, len, cb_params->user_data);
 }
 
-artik_error os_http_get_stream(const char *url, artik_http_headers *headers,
-		int *status, artik_http_stream_callback callback,
-		void *user_data, artik_ssl_config *ssl)
+static struct curl_slist *build_header_list(artik_http_headers *headers)
 {
-	CURL *curl;
-	CURLcode res;
 	struct curl_slist *h_list = NULL;
-	artik_error ret = S_OK;
-	stream_callback_params cb_params = { 0 };
 	int i;
-	long lstatus;
 
-	log_dbg("");
+	if (!headers || !headers->num_fields)
+		return NULL;
 
-	if (!url || !callback)
-		return E_BAD_ARGS;
+	for (i = 0; i < headers->num_fields; i++) {
+		int hdrlen = strlen(headers->fields[i].name) + 2 +
+				strlen(headers->fields[i].data) + 1;
+		char *h = malloc(hdrlen);
 
-	mutex_lock();
+		if (!h)
+			break;
 
-	/* Initialize curl */
-	curl_global_init(CURL_GLOBAL_DEFAULT);
-	curl = curl_easy_init();
-	if (!curl) {
-		log_err("Failed to initialize curl");
-		curl_global_cleanup();
-		mutex_unlock();
-		return E_NOT_SUPPORTED;
+		snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
+					headers->fields[i].data);
+		h_list = curl_slist_append(h_list, h);
+		free(h);
 	}
 
-	/* Build request headers if any */
-	if (headers && headers->num_fields) {
-		for (i = 0; i < headers->num_fields; i++) {
-			int hdrlen = strlen(headers->fields[i].name) + 2 +
-					strlen(headers->fields[i].data) + 1;
-			char *h = malloc(hdrlen);
-
-			snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
-						headers->fields[i].data);
-			h_list = curl_slist_append(h_list, h);
-			free(h);
-		}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
-	}
+	return h_list;
+}
 
-	cb_params.callback = callback;
-	cb_params.user_data = user_data;
+static void setup_request(CURL *curl, artik_http_method method,
+	const char *url, struct curl_slist *h_list, const char *body,
+	unsigned int body_len, http_buffer *response,
+	stream_callback_params *stream, http_pool *pool)
+{
+	artik_ssl_config *ssl = pool->ssl;
+
+	if (h_list)
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
 
-	/* Prepare curl parameters */
 	curl_easy_setopt(curl, CURLOPT_URL, url);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&cb_params);
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+
+	if (stream) {
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_callback);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)stream);
+	} else {
+		response->curl = curl;
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
+							response_callback);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
+	}
+
+	switch (method) {
+	case ARTIK_HTTP_POST:
+		curl_easy_setopt(curl, CURLOPT_POST, 1L);
+		if (body) {
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
+							(long)body_len);
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)body);
+		} else {
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, 0);
+		}
+		break;
+	case ARTIK_HTTP_PUT:
+		curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+		if (body) {
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
+							(long)body_len);
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)body);
+		}
+		break;
+	case ARTIK_HTTP_DELETE:
+		curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+		break;
+	case ARTIK_HTTP_GET:
+	default:
+		break;
+	}
 
 	if (ssl && ssl->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
 		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
@@ -625,31 +775,53 @@ artik_error os_http_get_stream(const char *url, artik_http_headers *headers,
 	if (ssl) {
 		curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION,
 							ssl_ctx_callback);
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ssl);
+		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, pool);
 	}
 
 #ifndef NDEBUG
 	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 #endif
+}
+
+static artik_error http_perform(artik_http_method method, const char *url,
+	artik_http_headers *headers, const char *body, unsigned int body_len,
+	http_buffer *response, stream_callback_params *stream, int *status,
+	artik_ssl_config *ssl)
+{
+	http_pool_handle *handle;
+	CURLcode res;
+	struct curl_slist *h_list = NULL;
+	artik_error ret = S_OK;
+	long lstatus;
+
+	mutex_lock();
+
+	handle = pool_acquire(url, ssl);
+	if (!handle) {
+		log_err("Failed to get a curl handle");
+		mutex_unlock();
+		return E_NOT_SUPPORTED;
+	}
+
+	h_list = build_header_list(headers);
+	setup_request(handle->curl, method, url, h_list, body, body_len,
+				response, stream, handle->pool);
 
 	/* Perform request */
-	res = curl_easy_perform(curl);
+	res = curl_easy_perform(handle->curl);
 	if (res != CURLE_OK) {
-		ret = E_HTTP_ERROR;
-		goto exit;
+		log_err("curl request failed (curl err=%d)", res);
+		ret = (response && response->overflow) ? E_OVERFLOW :
+								E_HTTP_ERROR;
 	}
 
-exit:
 	if (status) {
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
+		curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE,
+								&lstatus);
 		*status = (int)lstatus;
 	}
 
-	curl_easy_cleanup(curl);
-	curl_global_cleanup();
-
-	if (ssl && ssl->se_config)
-		release_openssl_engine();
+	pool_release(handle);
 
 	mutex_unlock();
 
@@ -659,180 +831,238 @@ exit:
 	return ret;
 }
 
-artik_error os_http_get_stream_async(const char *url,
-	artik_http_headers *headers,
-	artik_http_stream_callback stream_callback,
-	artik_http_response_callback response_callback,
-	void *user_data,
-	artik_ssl_config *ssl)
+static void http_interface_release(os_http_interface *interface)
 {
-	os_http_interface *interface;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
+	if (interface->handle)
+		pool_release(interface->handle);
 
-	log_dbg("");
+	if (interface->h_list)
+		curl_slist_free_all(interface->h_list);
 
-	if (!url || !stream_callback || !response_callback) {
-		log_err("Bad arguments");
-		return E_BAD_ARGS;
-	}
+	if (interface->url)
+		free(interface->url);
 
-	interface = malloc(sizeof(os_http_interface));
+	if (interface->body)
+		free(interface->body);
 
-	if (interface == NULL) {
-		log_err("Failed to allocate memory");
-		return E_NO_MEM;
-	}
+	free(interface);
+}
 
-	memset(interface, 0, sizeof(os_http_interface));
+static void http_interface_complete(os_http_interface *interface,
+	artik_error result, int status)
+{
+	response_callback_params *cb_params = &interface->response_cb_params;
+
+	if (result != S_OK)
+		log_err("http request to %s failed", interface->url);
+
+	if (cb_params->len_callback)
+		cb_params->len_callback(result, status,
+			interface->response.data, interface->response.len,
+			cb_params->user_data);
+	else if (cb_params->callback)
+		cb_params->callback(result, status, interface->response.data,
+			cb_params->user_data);
+	else if (interface->response.data)
+		free(interface->response.data);
+
+	http_interface_release(interface);
+}
 
-	interface->url = strdup(url);
-	if (headers) {
-		interface->headers = malloc(sizeof(artik_http_headers));
-		memcpy(interface->headers, headers, sizeof(artik_http_headers));
-	}
-	interface->stream_cb_params.callback = stream_callback;
-	interface->stream_cb_params.user_data = user_data;
-	interface->response_cb_params.callback = response_callback;
-	interface->response_cb_params.user_data = user_data;
+static void multi_check_info(void)
+{
+	CURLMsg *msg;
+	int pending;
 
-	if (ssl) {
-		interface->ssl = copy_ssl_config(ssl);
-		if (!interface->ssl) {
-			if (interface->headers)
-				free(interface->headers);
-			free(interface->url);
-			free(interface);
-			return E_NO_MEM;
-		}
-	}
+	while ((msg = curl_multi_info_read(engine.multi, &pending))) {
+		os_http_interface *interface;
+		CURL *curl = msg->easy_handle;
+		CURLcode res = msg->data.result;
+		long lstatus = 0;
+		char *priv = NULL;
 
-	if (loop->add_idle_callback(&interface->loop_process_id,
-		os_http_process_get_stream, (void *)interface) != S_OK)
-		return E_HTTP_ERROR;
+		if (msg->msg != CURLMSG_DONE)
+			continue;
 
-	return S_OK;
+		curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
+		curl_multi_remove_handle(engine.multi, curl);
+		interface = (os_http_interface *)priv;
+
+		if (res != CURLE_OK)
+			log_err("curl request failed (curl err=%d)", res);
+
+		http_interface_complete(interface,
+			(res == CURLE_OK) ? S_OK : E_HTTP_ERROR, (int)lstatus);
+	}
 }
 
-artik_error os_http_get(const char *url, artik_http_headers *headers,
-	char **response, int *status, artik_ssl_config *ssl)
+static int multi_socket_handler(int fd, enum watch_io io, void *user_data)
 {
-	CURL *curl;
-	CURLcode res;
-	struct curl_slist *h_list = NULL;
-	artik_error ret = S_OK;
-	int i;
-	long lstatus;
-
-	log_dbg("");
+	int mask = 0;
+
+	if (io & WATCH_IO_IN)
+		mask |= CURL_CSELECT_IN;
+	if (io & WATCH_IO_OUT)
+		mask |= CURL_CSELECT_OUT;
+	if (io & (WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL))
+		mask |= CURL_CSELECT_ERR;
+
+	/*
+	 * The socket context may be released from within this call,
+	 * it must not be accessed afterwards.
+	 */
+	curl_multi_socket_action(engine.multi, fd, mask, &engine.running);
+	multi_check_info();
+
+	return 1;
+}
 
-	if (!url || !response)
-		return E_BAD_ARGS;
+static int multi_socket_callback(CURL *curl, curl_socket_t s, int what,
+	void *userp, void *socketp)
+{
+	http_socket_context *ctx = (http_socket_context *)socketp;
+	enum watch_io io = WATCH_IO_ERR | WATCH_IO_HUP;
+
+	if (what == CURL_POLL_REMOVE) {
+		if (ctx) {
+			if (ctx->watch_id)
+				engine.loop->remove_fd_watch(ctx->watch_id);
+			curl_multi_assign(engine.multi, s, NULL);
+			free(ctx);
+		}
+		return 0;
+	}
 
-	mutex_lock();
+	if (!ctx) {
+		ctx = malloc(sizeof(http_socket_context));
+		if (!ctx) {
+			log_err("Failed to allocate memory");
+			return -1;
+		}
 
-	/* Initialize curl */
-	curl_global_init(CURL_GLOBAL_DEFAULT);
-	curl = curl_easy_init();
-	if (!curl) {
-		log_err("Failed to initialize curl");
-		curl_global_cleanup();
-		mutex_unlock();
-		return E_NOT_SUPPORTED;
+		memset(ctx, 0, sizeof(http_socket_context));
+		ctx->fd = s;
+		curl_multi_assign(engine.multi, s, ctx);
+	} else if (ctx->watch_id) {
+		engine.loop->remove_fd_watch(ctx->watch_id);
+		ctx->watch_id = 0;
 	}
 
-	/* Build request headers if any */
-	if (headers && headers->num_fields) {
-		for (i = 0; i < headers->num_fields; i++) {
-			int hdrlen = strlen(headers->fields[i].name) + 2 +
-					strlen(headers->fields[i].data) + 1;
-			char *h = malloc(hdrlen);
-
-			snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
-						headers->fields[i].data);
-			h_list = curl_slist_append(h_list, h);
-			free(h);
-		}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
+	if (what & CURL_POLL_IN)
+		io |= WATCH_IO_IN;
+	if (what & CURL_POLL_OUT)
+		io |= WATCH_IO_OUT;
+
+	engine.loop->set_stats_tag("http");
+	if (engine.loop->add_fd_watch(s, io, multi_socket_handler, ctx,
+					&ctx->watch_id) != S_OK) {
+		log_err("Failed to watch socket %d", s);
+		ctx->watch_id = 0;
+		return -1;
 	}
 
-	/* Initialize response */
-	*response = NULL;
+	return 0;
+}
 
-	/* Prepare curl parameters */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+static void multi_timeout_handler(void *user_data)
+{
+	engine.timeout_id = 0;
 
-	if (ssl && ssl->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-		curl_easy_setopt(curl, CURLOPT_SSLCERTTYPE, "PEM");
-		curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
-		curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
-	} else {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+	curl_multi_socket_action(engine.multi, CURL_SOCKET_TIMEOUT, 0,
+							&engine.running);
+	multi_check_info();
+}
+
+static int multi_timer_callback(CURLM *multi, long timeout_ms, void *userp)
+{
+	if (engine.timeout_id) {
+		engine.loop->remove_timeout_callback(engine.timeout_id);
+		engine.timeout_id = 0;
 	}
 
-	if (ssl) {
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION,
-							ssl_ctx_callback);
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ssl);
+	/* A negative value means curl wants the timer to be deleted */
+	if (timeout_ms < 0)
+		return 0;
+
+	engine.loop->set_stats_tag("http");
+	if (engine.loop->add_timeout_callback(&engine.timeout_id,
+			(unsigned int)timeout_ms, multi_timeout_handler,
+			NULL) != S_OK) {
+		log_err("Failed to arm curl timer");
+		engine.timeout_id = 0;
+		return -1;
 	}
 
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+	return 0;
+}
 
-	/* Perform request */
-	res = curl_easy_perform(curl);
-	if (res != CURLE_OK) {
-		ret = E_HTTP_ERROR;
-		goto exit;
+static artik_error multi_engine_init(void)
+{
+	if (engine.multi)
+		return S_OK;
+
+	engine.loop = (artik_loop_module *)artik_request_api_module("loop");
+	if (!engine.loop) {
+		log_err("Failed to request loop module");
+		return E_NOT_SUPPORTED;
 	}
 
-exit:
-	if (status) {
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
-		*status = (int)lstatus;
+	engine.multi = curl_multi_init();
+	if (!engine.multi) {
+		log_err("Failed to initialize curl multi handle");
+		artik_release_api_module(engine.loop);
+		engine.loop = NULL;
+		return E_NOT_SUPPORTED;
 	}
 
-	curl_easy_cleanup(curl);
-	curl_global_cleanup();
+	curl_multi_setopt(engine.multi, CURLMOPT_SOCKETFUNCTION,
+						multi_socket_callback);
+	curl_multi_setopt(engine.multi, CURLMOPT_TIMERFUNCTION,
+						multi_timer_callback);
 
-	mutex_unlock();
+	return S_OK;
+}
 
-	if (ssl && ssl->se_config)
-		release_openssl_engine();
+static int os_http_process_async(void *user_data)
+{
+	os_http_interface *interface = (os_http_interface *)user_data;
+	artik_error ret;
 
-	if (h_list)
-		curl_slist_free_all(h_list);
+	log_dbg("");
 
-	return ret;
+	ret = multi_engine_init();
+	if (ret != S_OK) {
+		http_interface_complete(interface, ret, 0);
+		return 0;
+	}
+
+	if (curl_multi_add_handle(engine.multi, interface->handle->curl) !=
+								CURLM_OK) {
+		log_err("Failed to add request to the multi handle");
+		http_interface_complete(interface, E_HTTP_ERROR, 0);
+		return 0;
+	}
+
+	return 0;
 }
 
-artik_error os_http_get_async(const char *url, artik_http_headers *headers,
-	artik_http_response_callback callback, void *user_data,
+/*
+ * Prepare the easy handle of an asynchronous request, then hand it over
+ * to the loop thread which owns the multi handle.
+ */
+static artik_error http_perform_async(artik_http_method method,
+	const char *url, artik_http_headers *headers, const char *body,
+	unsigned int body_len, artik_http_stream_callback stream_cb,
+	artik_http_response_callback response_cb,
+	artik_http_response_len_callback response_len_cb, void *user_data,
 	artik_ssl_config *ssl)
 {
 	os_http_interface *interface;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
-
-	log_dbg("");
-
-	if (!url || !callback) {
-		log_err("Bad arguments");
-		return E_BAD_ARGS;
-	}
+	artik_loop_module *loop;
+	artik_error ret = S_OK;
 
 	interface = malloc(sizeof(os_http_interface));
-
 	if (interface == NULL) {
 		log_err("Failed to allocate memory");
 		return E_NO_MEM;
@@ -841,295 +1071,192 @@ artik_error os_http_get_async(const char *url, artik_http_headers *headers,
 	memset(interface, 0, sizeof(os_http_interface));
 
 	interface->url = strdup(url);
-	if (headers) {
-		interface->headers = copy_http_headers(headers);
-		if (!interface->headers) {
-			log_err("Failed to allocate memory");
-			return E_NO_MEM;
-		}
+	if (!interface->url) {
+		ret = E_NO_MEM;
+		goto error;
 	}
 
-	interface->response_cb_params.callback = callback;
-	interface->response_cb_params.user_data = user_data;
-	interface->ssl = copy_ssl_config(ssl);
-
-	if (loop->add_idle_callback(&interface->loop_process_id,
-		os_http_process_get, (void *)interface) != S_OK)
-		return E_HTTP_ERROR;
-
-	return S_OK;
-}
-
-artik_error os_http_post(const char *url, artik_http_headers *headers,
-	const char *body, char **response, int *status, artik_ssl_config *ssl)
-{
-	CURL *curl;
-	CURLcode res;
-	struct curl_slist *h_list = NULL;
-	artik_error ret = S_OK;
-	int i;
-	long lstatus;
-
-	log_dbg("");
+	if (body) {
+		/* Body may be binary, keep it NUL terminated for curl anyway */
+		interface->body = malloc(body_len + 1);
+		if (!interface->body) {
+			ret = E_NO_MEM;
+			goto error;
+		}
 
-	if (!url || !response) {
-		log_err("Bad arguments");
-		return E_BAD_ARGS;
+		memcpy(interface->body, body, body_len);
+		interface->body[body_len] = '\0';
+		interface->body_len = body_len;
 	}
 
-	mutex_lock();
-
-	/* Initialize curl */
-	curl_global_init(CURL_GLOBAL_DEFAULT);
-	curl = curl_easy_init();
-	if (!curl) {
-		log_err("Failed to initialize curl");
-		curl_global_cleanup();
-		mutex_unlock();
-		return E_NOT_SUPPORTED;
-	}
+	interface->stream_cb_params.callback = stream_cb;
+	interface->stream_cb_params.user_data = user_data;
+	interface->response_cb_params.callback = response_cb;
+	interface->response_cb_params.len_callback = response_len_cb;
+	interface->response_cb_params.user_data = user_data;
 
-	/* Build request headers if any */
-	if (headers && headers->num_fields) {
-		for (i = 0; i < headers->num_fields; i++) {
-			int hdrlen = strlen(headers->fields[i].name) + 2 +
-					strlen(headers->fields[i].data) + 1;
-			char *h = malloc(hdrlen);
-
-			snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
-						headers->fields[i].data);
-			h_list = curl_slist_append(h_list, h);
-			free(h);
-		}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
+	interface->handle = pool_acquire(url, ssl);
+	if (!interface->handle) {
+		log_err("Failed to get a curl handle");
+		ret = E_NOT_SUPPORTED;
+		goto error;
 	}
 
-	/* Initialize response */
-	*response = NULL;
-
-	/* Prepare curl parameters */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_POST, 1L);
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
-
-	if (ssl && ssl->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-		curl_easy_setopt(curl, CURLOPT_SSLCERTTYPE, "PEM");
-		curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
-		curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
-	} else {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-	}
+	interface->h_list = build_header_list(headers);
 
-	if (ssl) {
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION,
-							ssl_ctx_callback);
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ssl);
-	}
+	setup_request(interface->handle->curl, method, interface->url,
+		interface->h_list, interface->body, interface->body_len,
+		&interface->response,
+		stream_cb ? &interface->stream_cb_params : NULL,
+		interface->handle->pool);
 
-	if (body)
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)body);
-	else
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, 0);
+	curl_easy_setopt(interface->handle->curl, CURLOPT_PRIVATE,
+							(void *)interface);
 
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+	loop = (artik_loop_module *)artik_request_api_module("loop");
+	loop->set_stats_tag("http");
+	ret = loop->add_idle_callback(&interface->loop_process_id,
+			os_http_process_async, (void *)interface);
+	artik_release_api_module(loop);
 
-	/* Perform request */
-	res = curl_easy_perform(curl);
-	if (res != CURLE_OK) {
-		log_err("curl request failed (curl err=%d)", res);
+	if (ret != S_OK) {
 		ret = E_HTTP_ERROR;
-		goto exit;
+		goto error;
 	}
 
-exit:
-	if (status) {
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
-		*status = (int)lstatus;
-	}
+	return S_OK;
 
-	curl_easy_cleanup(curl);
-	curl_global_cleanup();
+error:
+	log_err("Failed to queue request (err=%d)", ret);
+	http_interface_release(interface);
+	return ret;
+}
 
-	if (ssl && ssl->se_config)
-		release_openssl_engine();
+static artik_error http_perform_string(artik_http_method method,
+	const char *url, artik_http_headers *headers, const char *body,
+	char **response, int *status, artik_ssl_config *ssl)
+{
+	http_buffer buffer;
+	artik_error ret;
 
-	mutex_unlock();
+	memset(&buffer, 0, sizeof(buffer));
 
-	if (h_list)
-		curl_slist_free_all(h_list);
+	ret = http_perform(method, url, headers, body,
+		body ? strlen(body) : 0, &buffer, NULL, status, ssl);
+
+	*response = buffer.data;
 
 	return ret;
 }
 
-artik_error os_http_post_async(const char *url, artik_http_headers *headers,
-	const char *body, artik_http_response_callback callback,
-	void *user_data, artik_ssl_config *ssl)
+artik_error os_http_get_stream(const char *url, artik_http_headers *headers,
+		int *status, artik_http_stream_callback callback,
+		void *user_data, artik_ssl_config *ssl)
 {
-	os_http_interface *interface;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
+	stream_callback_params cb_params = { 0 };
 
 	log_dbg("");
 
-	if (!url || !callback) {
-		log_err("Bad arguments");
+	if (!url || !callback)
 		return E_BAD_ARGS;
-	}
 
-	interface = malloc(sizeof(os_http_interface));
+	cb_params.callback = callback;
+	cb_params.user_data = user_data;
 
-	if (interface == NULL) {
-		log_err("Failed to allocate memory");
-		return E_NO_MEM;
-	}
+	return http_perform(ARTIK_HTTP_GET, url, headers, NULL, 0, NULL,
+		&cb_params, status, ssl);
+}
 
-	memset(interface, 0, sizeof(os_http_interface));
+artik_error os_http_get_stream_async(const char *url,
+	artik_http_headers *headers,
+	artik_http_stream_callback stream_callback,
+	artik_http_response_callback response_callback,
+	void *user_data,
+	artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-	interface->url = strdup(url);
-	if (headers) {
-		interface->headers = copy_http_headers(headers);
-		if (!interface->headers) {
-			log_err("Failed to allocate memory");
-			return E_NO_MEM;
-		}
+	if (!url || !stream_callback || !response_callback) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-	interface->body = body ? strdup(body) : NULL;
-	interface->response_cb_params.callback = callback;
-	interface->response_cb_params.user_data = user_data;
-	interface->ssl = copy_ssl_config(ssl);
-
-	if (loop->add_idle_callback(&interface->loop_process_id,
-		os_http_process_post, (void *)interface) != S_OK)
-		return E_HTTP_ERROR;
-
-	return S_OK;
+	return http_perform_async(ARTIK_HTTP_GET, url, headers, NULL, 0,
+		stream_callback, response_callback, NULL, user_data, ssl);
 }
 
-artik_error os_http_put(const char *url, artik_http_headers *headers,
-	const char *body, char **response, int *status, artik_ssl_config *ssl)
+artik_error os_http_get(const char *url, artik_http_headers *headers,
+	char **response, int *status, artik_ssl_config *ssl)
 {
-	CURL *curl;
-	CURLcode res;
-	struct curl_slist *h_list = NULL;
-	artik_error ret = S_OK;
-	int i;
-	long lstatus;
-
 	log_dbg("");
 
 	if (!url || !response)
 		return E_BAD_ARGS;
 
-	mutex_lock();
+	return http_perform_string(ARTIK_HTTP_GET, url, headers, NULL,
+						response, status, ssl);
+}
 
-	/* Initialize curl */
-	curl_global_init(CURL_GLOBAL_DEFAULT);
-	curl = curl_easy_init();
-	if (!curl) {
-		log_err("Failed to initialize curl");
-		curl_global_cleanup();
-		mutex_unlock();
-		return E_NOT_SUPPORTED;
-	}
+artik_error os_http_get_async(const char *url, artik_http_headers *headers,
+	artik_http_response_callback callback, void *user_data,
+	artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-	/* Build request headers if any */
-	if (headers && headers->num_fields) {
-		for (i = 0; i < headers->num_fields; i++) {
-			int hdrlen = strlen(headers->fields[i].name) + 2 +
-					strlen(headers->fields[i].data) + 1;
-			char *h = malloc(hdrlen);
-
-			snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
-						headers->fields[i].data);
-			h_list = curl_slist_append(h_list, h);
-			free(h);
-		}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
+	if (!url || !callback) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-	/* Initialize response */
-	*response = NULL;
-
-	/* Prepare curl parameters */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+	return http_perform_async(ARTIK_HTTP_GET, url, headers, NULL, 0, NULL,
+		callback, NULL, user_data, ssl);
+}
 
-	if (ssl && ssl->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-		curl_easy_setopt(curl, CURLOPT_SSLCERTTYPE, "PEM");
-		curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
-		curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
-	} else {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-	}
+artik_error os_http_post(const char *url, artik_http_headers *headers,
+	const char *body, char **response, int *status, artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-	if (ssl) {
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION,
-							ssl_ctx_callback);
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ssl);
+	if (!url || !response) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-	if (body)
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)body);
-
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+	return http_perform_string(ARTIK_HTTP_POST, url, headers, body,
+						response, status, ssl);
+}
 
-	/* Perform request */
-	res = curl_easy_perform(curl);
-	if (res != CURLE_OK) {
-		ret = E_HTTP_ERROR;
-		goto exit;
-	}
+artik_error os_http_post_async(const char *url, artik_http_headers *headers,
+	const char *body, artik_http_response_callback callback,
+	void *user_data, artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-exit:
-	if (status) {
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
-		*status = (int)lstatus;
+	if (!url || !callback) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-	curl_easy_cleanup(curl);
-	curl_global_cleanup();
-
-	mutex_unlock();
+	return http_perform_async(ARTIK_HTTP_POST, url, headers, body,
+		body ? strlen(body) : 0, NULL, callback, NULL, user_data, ssl);
+}
 
-	if (ssl && ssl->se_config)
-		release_openssl_engine();
+artik_error os_http_put(const char *url, artik_http_headers *headers,
+	const char *body, char **response, int *status, artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-	if (h_list)
-		curl_slist_free_all(h_list);
+	if (!url || !response)
+		return E_BAD_ARGS;
 
-	return ret;
+	return http_perform_string(ARTIK_HTTP_PUT, url, headers, body,
+						response, status, ssl);
 }
 
 artik_error os_http_put_async(const char *url, artik_http_headers *headers,
 	const char *body, artik_http_response_callback callback,
 	void *user_data, artik_ssl_config *ssl)
 {
-	os_http_interface *interface;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
-
 	log_dbg("");
 
 	if (!url || !callback) {
@@ -1137,178 +1264,81 @@ artik_error os_http_put_async(const char *url, artik_http_headers *headers,
 		return E_BAD_ARGS;
 	}
 
-	interface = malloc(sizeof(os_http_interface));
-
-	if (interface == NULL) {
-		log_err("Failed to allocate memory");
-		return E_NO_MEM;
-	}
-
-	memset(interface, 0, sizeof(os_http_interface));
-
-	interface->url = strdup(url);
-	if (headers) {
-		interface->headers = copy_http_headers(headers);
-		if (!interface->headers) {
-			log_err("Failed to allocate memory");
-			return E_NO_MEM;
-		}
-	}
-
-	interface->body = body ? strdup(body) : NULL;
-	interface->response_cb_params.callback = callback;
-	interface->response_cb_params.user_data = user_data;
-	interface->ssl = copy_ssl_config(ssl);
-
-	if (loop->add_idle_callback(&interface->loop_process_id,
-		os_http_process_put, (void *)interface) != S_OK)
-		return E_HTTP_ERROR;
-
-	return S_OK;
+	return http_perform_async(ARTIK_HTTP_PUT, url, headers, body,
+		body ? strlen(body) : 0, NULL, callback, NULL, user_data, ssl);
 }
 
 artik_error os_http_delete(const char *url, artik_http_headers *headers,
 	char **response, int *status, artik_ssl_config *ssl)
 {
-	CURL *curl;
-	CURLcode res;
-	struct curl_slist *h_list = NULL;
-	artik_error ret = S_OK;
-	int i;
-	long lstatus;
-
 	log_dbg("");
 
 	if (!url || !response)
 		return E_BAD_ARGS;
 
-	mutex_lock();
+	return http_perform_string(ARTIK_HTTP_DELETE, url, headers, NULL,
+						response, status, ssl);
+}
 
-	/* Initialize curl */
-	curl_global_init(CURL_GLOBAL_DEFAULT);
-	curl = curl_easy_init();
-	if (!curl) {
-		log_err("Failed to initialize curl");
-		curl_global_cleanup();
-		mutex_unlock();
-		return E_NOT_SUPPORTED;
-	}
+artik_error os_http_delete_async(const char *url, artik_http_headers *headers,
+	artik_http_response_callback callback, void *user_data,
+	artik_ssl_config *ssl)
+{
+	log_dbg("");
 
-	/* Build request headers if any */
-	if (headers && headers->num_fields) {
-		for (i = 0; i < headers->num_fields; i++) {
-			int hdrlen = strlen(headers->fields[i].name) + 2 +
-					strlen(headers->fields[i].data) + 1;
-			char *h = malloc(hdrlen);
-
-			snprintf(h, hdrlen, "%s: %s", headers->fields[i].name,
-						headers->fields[i].data);
-			h_list = curl_slist_append(h_list, h);
-			free(h);
-		}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, h_list);
+	if (!url || !callback) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-	/* Initialize response */
-	*response = NULL;
+	return http_perform_async(ARTIK_HTTP_DELETE, url, headers, NULL, 0,
+		NULL, callback, NULL, user_data, ssl);
+}
 
-	/* Prepare curl parameters */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_callback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)response);
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+artik_error os_http_request(artik_http_method method, const char *url,
+	artik_http_headers *headers, const char *body, unsigned int body_len,
+	artik_http_response *response, int *status, artik_ssl_config *ssl)
+{
+	http_buffer buffer;
+	artik_error ret;
 
-	if (ssl && ssl->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-		curl_easy_setopt(curl, CURLOPT_SSLCERTTYPE, "PEM");
-		curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
-		curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
-	} else {
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-	}
+	log_dbg("");
 
-	if (ssl) {
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION,
-							ssl_ctx_callback);
-		curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ssl);
+	if (!url || !response || method > ARTIK_HTTP_DELETE ||
+					(response->size && !response->data)) {
+		log_err("Bad arguments");
+		return E_BAD_ARGS;
 	}
 
-#ifndef NDEBUG
-	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-#endif
+	memset(&buffer, 0, sizeof(buffer));
 
-	/* Perform request */
-	res = curl_easy_perform(curl);
-	if (res != CURLE_OK) {
-		ret = E_HTTP_ERROR;
-		goto exit;
-	}
-
-exit:
-	if (status) {
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
-		*status = (int)lstatus;
+	if (response->size) {
+		buffer.data = response->data;
+		buffer.size = response->size;
+		buffer.external = true;
 	}
 
-	curl_easy_cleanup(curl);
-	curl_global_cleanup();
-
-	mutex_unlock();
-
-	if (ssl && ssl->se_config)
-		release_openssl_engine();
+	ret = http_perform(method, url, headers, body, body ? body_len : 0,
+					&buffer, NULL, status, ssl);
 
-	if (h_list)
-		curl_slist_free_all(h_list);
+	response->data = buffer.data;
+	response->len = buffer.len;
 
 	return ret;
 }
 
-artik_error os_http_delete_async(const char *url, artik_http_headers *headers,
-	artik_http_response_callback callback, void *user_data,
+artik_error os_http_request_async(artik_http_method method, const char *url,
+	artik_http_headers *headers, const char *body, unsigned int body_len,
+	artik_http_response_len_callback callback, void *user_data,
 	artik_ssl_config *ssl)
 {
-	os_http_interface *interface;
-	artik_loop_module *loop = (artik_loop_module *)
-					artik_request_api_module("loop");
-
 	log_dbg("");
 
-	if (!url || !callback) {
+	if (!url || !callback || method > ARTIK_HTTP_DELETE) {
 		log_err("Bad arguments");
 		return E_BAD_ARGS;
 	}
 
-	interface = malloc(sizeof(os_http_interface));
-
-	if (interface == NULL) {
-		log_err("Failed to allocate memory");
-		return E_NO_MEM;
-	}
-
-	memset(interface, 0, sizeof(os_http_interface));
-
-	interface->url = strdup(url);
-	if (headers) {
-		interface->headers = copy_http_headers(headers);
-		if (!interface->headers) {
-			log_err("Failed to allocate memory");
-			return E_NO_MEM;
-		}
-	}
-	interface->response_cb_params.callback = callback;
-	interface->response_cb_params.user_data = user_data;
-	interface->ssl = copy_ssl_config(ssl);
-
-	if (loop->add_idle_callback(&interface->loop_process_id,
-		os_http_process_delete, (void *)interface) != S_OK)
-		return E_HTTP_ERROR;
-
-	return S_OK;
+	return http_perform_async(method, url, headers, body,
+		body ? body_len : 0, NULL, NULL, callback, user_data, ssl);
 }
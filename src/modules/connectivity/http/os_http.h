@@ -52,5 +52,16 @@ artik_error os_http_delete(const char *url, artik_http_headers *headers,
 artik_error os_http_delete_async(const char *url, artik_http_headers *headers,
 			artik_http_response_callback callback, void *user_data,
 			artik_ssl_config *ssl);
+artik_error os_http_set_pool_config(const artik_http_pool_config *config);
+artik_error os_http_get_pool_stats(artik_http_pool_stats *stats);
+artik_error os_http_request(artik_http_method method, const char *url,
+			artik_http_headers *headers, const char *body,
+			unsigned int body_len, artik_http_response *response,
+			int *status, artik_ssl_config *ssl);
+artik_error os_http_request_async(artik_http_method method, const char *url,
+			artik_http_headers *headers, const char *body,
+			unsigned int body_len,
+			artik_http_response_len_callback callback,
+			void *user_data, artik_ssl_config *ssl);
 
 #endif	/* OS_HTTP_H_ */
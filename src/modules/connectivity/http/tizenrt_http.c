@@ -772,3 +772,30 @@ artik_error os_http_delete_async(const char *url, artik_http_headers *headers,
 
 	return _http_method_thread(&args);
 }
+
+artik_error os_http_set_pool_config(const artik_http_pool_config *config)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_http_get_pool_stats(artik_http_pool_stats *stats)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_http_request(artik_http_method method, const char *url,
+		artik_http_headers *headers, const char *body,
+		unsigned int body_len, artik_http_response *response,
+		int *status, artik_ssl_config *ssl)
+{
+	return E_NOT_SUPPORTED;
+}
+
+artik_error os_http_request_async(artik_http_method method, const char *url,
+		artik_http_headers *headers, const char *body,
+		unsigned int body_len,
+		artik_http_response_len_callback callback,
+		void *user_data, artik_ssl_config *ssl)
+{
+	return E_NOT_SUPPORTED;
+}
@@ -1485,6 +1485,7 @@ void *dhcpd_start(artik_network_dhcp_server_config *config)
 		return NULL;
 	}
 
+	server->loop->set_stats_tag("network");
 	server->loop->add_fd_watch(server->sockfd,
 			WATCH_IO_IN | WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL,
 			loop_handler, server, &server->watch_id);
@@ -383,6 +383,7 @@ static void notify_online_status_change(watch_online_node_t *node, bool status)
 	node->update_online_status = false;
 
 	loop->remove_timeout_callback(node->timeout_echo_id);
+	loop->set_stats_tag("network");
 	loop->add_timeout_callback(&node->timeout_echo_id, node->config.interval,
 							   timeout_send_echo_callback, node);
 
@@ -406,6 +407,7 @@ static void send_echo_request(watch_online_node_t *node)
 {
 	artik_loop_module *loop = node->loop;
 
+	loop->set_stats_tag("network");
 	loop->add_timeout_callback(&node->timeout_echo_id, node->config.timeout,
 							   timeout_receive_er_callback, node);
 	log_dbg("Send echo request - timeoutid %d", node->timeout_echo_id);
@@ -638,6 +640,7 @@ static artik_error initialize_watch_online_status(void)
 		return E_ACCESS_DENIED;
 	}
 
+	loop->set_stats_tag("network");
 	ret = loop->add_fd_watch(watch_online_status->netlink_sock,
 		(WATCH_IO_IN | WATCH_IO_ERR | WATCH_IO_HUP |
 		WATCH_IO_NVAL),
@@ -655,6 +658,7 @@ static artik_error initialize_watch_online_status(void)
 		return E_ACCESS_DENIED;
 	}
 
+	loop->set_stats_tag("network");
 	ret = loop->add_fd_watch(watch_online_status->icmp_sock,
 		(WATCH_IO_IN | WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL),
 		echo_response_watch,
@@ -18,6 +18,7 @@
 
 
 #include <stdlib.h>
+#include <limits.h>
 
 #include <artik_log.h>
 #include <artik_list.h>
@@ -42,6 +43,17 @@ static artik_error artik_websocket_set_receive_callback(artik_websocket_handle
 					void *user_data);
 static artik_error artik_websocket_close_stream(artik_websocket_handle handle);
 static artik_error artik_websocket_release(artik_websocket_handle handle);
+static artik_error artik_websocket_write_binary_stream(
+					artik_websocket_handle handle,
+					const unsigned char *data,
+					unsigned int len);
+static artik_error artik_websocket_get_queue_stats(
+					artik_websocket_handle handle,
+					artik_websocket_queue_stats *stats);
+static artik_error artik_websocket_set_message_callback(
+					artik_websocket_handle handle,
+					artik_websocket_message_callback callback,
+					void *user_data);
 
 const artik_websocket_module websocket_module = {
 	artik_websocket_request,
@@ -50,7 +62,10 @@ const artik_websocket_module websocket_module = {
 	artik_websocket_set_connection_callback,
 	artik_websocket_set_receive_callback,
 	artik_websocket_close_stream,
-	artik_websocket_release
+	artik_websocket_release,
+	artik_websocket_write_binary_stream,
+	artik_websocket_get_queue_stats,
+	artik_websocket_set_message_callback
 };
 
 typedef struct {
@@ -175,8 +190,29 @@ artik_error artik_websocket_write_stream(artik_websocket_handle handle,
 		return E_BAD_ARGS;
 
 	message_len = strlen(message);
-	ret = os_websocket_write_stream(&node->config, message, message_len);
-	if (ret != S_OK)
+	ret = os_websocket_write_stream(&node->config, message, message_len,
+			false);
+	if (ret != S_OK && ret != E_BUSY)
+		ret = E_WEBSOCKET_ERROR;
+
+	return ret;
+}
+
+artik_error artik_websocket_write_binary_stream(artik_websocket_handle handle,
+				const unsigned char *data, unsigned int len)
+{
+	artik_error ret = S_OK;
+	websocket_node *node = (websocket_node *)artik_list_get_by_handle(
+				requested_node, (ARTIK_LIST_HANDLE) handle);
+
+	log_dbg("");
+
+	if (!node || !data || !len || len > INT_MAX)
+		return E_BAD_ARGS;
+
+	ret = os_websocket_write_stream(&node->config, (const char *)data, len,
+			true);
+	if (ret != S_OK && ret != E_BUSY)
 		ret = E_WEBSOCKET_ERROR;
 
 	return ret;
@@ -223,6 +259,26 @@ artik_error artik_websocket_set_receive_callback(artik_websocket_handle handle,
 	return ret;
 }
 
+artik_error artik_websocket_set_message_callback(artik_websocket_handle handle,
+		artik_websocket_message_callback callback, void *user_data)
+{
+	artik_error ret = S_OK;
+	websocket_node *node = (websocket_node *)artik_list_get_by_handle(
+				requested_node, (ARTIK_LIST_HANDLE) handle);
+
+	log_dbg("");
+
+	if (!node)
+		return E_BAD_ARGS;
+
+	ret = os_websocket_set_message_callback(&node->config, callback,
+								user_data);
+	if (ret != S_OK)
+		log_err("set message callback failed: %d\n", ret);
+
+	return ret;
+}
+
 artik_error artik_websocket_close_stream(artik_websocket_handle handle)
 {
 	artik_error ret = S_OK;
@@ -260,3 +316,17 @@ artik_error artik_websocket_release(artik_websocket_handle handle)
 
 	return S_OK;
 }
+
+artik_error artik_websocket_get_queue_stats(artik_websocket_handle handle,
+				artik_websocket_queue_stats *stats)
+{
+	websocket_node *node = (websocket_node *)artik_list_get_by_handle(
+				requested_node, (ARTIK_LIST_HANDLE) handle);
+
+	log_dbg("");
+
+	if (!node || !stats)
+		return E_BAD_ARGS;
+
+	return os_websocket_get_queue_stats(&node->config, stats);
+}
@@ -19,12 +19,15 @@
 #include "artik_websocket.hh"
 
 artik::Websocket::Websocket(const char* uri, unsigned int ping_period,
-  unsigned int pong_timeout, artik_ssl_config *ssl_config) {
+  unsigned int pong_timeout, artik_ssl_config *ssl_config,
+  unsigned int send_high_watermark) {
   this->m_module = reinterpret_cast<artik_websocket_module*>(
       artik_request_api_module("websocket"));
   this->m_handle = NULL;
+  memset(&this->m_config, 0, sizeof(this->m_config));
   this->m_config.ping_period = ping_period;
   this->m_config.pong_timeout = pong_timeout;
+  this->m_config.send_high_watermark = send_high_watermark;
   this->m_config.uri = strndup(uri, strlen(uri));
   memcpy(&this->m_config.ssl_config, ssl_config,
             sizeof(this->m_config.ssl_config));
@@ -52,12 +55,24 @@ artik_error artik::Websocket::write_stream(char* message) {
   return this->m_module->websocket_write_stream(this->m_handle, message);
 }
 
+artik_error artik::Websocket::write_binary_stream(const unsigned char* data,
+    unsigned int len) {
+  return this->m_module->websocket_write_binary_stream(this->m_handle, data,
+      len);
+}
+
 artik_error artik::Websocket::set_receive_callback(
     artik_websocket_callback callback, void *user_data) {
   return this->m_module->websocket_set_receive_callback(this->m_handle,
       callback, user_data);
 }
 
+artik_error artik::Websocket::set_message_callback(
+    artik_websocket_message_callback callback, void *user_data) {
+  return this->m_module->websocket_set_message_callback(this->m_handle,
+      callback, user_data);
+}
+
 artik_error artik::Websocket::close_stream() {
   return this->m_module->websocket_close_stream(this->m_handle);
 }
@@ -65,3 +80,8 @@ artik_error artik::Websocket::close_stream() {
 artik_error artik::Websocket::release() {
   return this->m_module->websocket_release(this->m_handle);
 }
+
+artik_error artik::Websocket::get_queue_stats(
+    artik_websocket_queue_stats *stats) {
+  return this->m_module->websocket_get_queue_stats(this->m_handle, stats);
+}
@@ -21,10 +21,10 @@
 #include <unistd.h>
 #include <sys/eventfd.h>
 #include <openssl/ssl.h>
-#include <openssl/engine.h>
 #include <libwebsockets.h>
 #include <errno.h>
 #include <regex.h>
+#include <poll.h>
 
 #include <artik_log.h>
 #include <artik_module.h>
@@ -37,15 +37,14 @@
 #define WAIT_CONNECT_POLLING_MS		500
 #define FLAG_EVENT			(0x1 << 0)
 #define MAX(a, b)			((a > b) ? a : b)
-#define CB_CONTAINER			((os_websocket_container *)\
-					lws_get_protocol(wsi)->user)
-#define CB_FDS				(((os_websocket_fds *)\
-					CB_CONTAINER->fds)->fdset)
+#define CB_INTERFACE			((os_websocket_interface *)user)
+#define CB_CONTAINER			(&CB_INTERFACE->container)
+#define EVENT_BIT(e)			(0x1 << (e))
 
-#define MAX_QUEUE_NAME			1024
 #define MAX_QUEUE_SIZE			128
 #define MAX_MESSAGE_SIZE		2048
-#define PROCESS_TIMEOUT_MS		10
+#define MAX_VHOST_NAME			32
+#define HOUSEKEEPING_PERIOD_MS		1000
 
 #define ARTIK_WEBSOCKET_INTERFACE	((os_websocket_interface *)\
 					config->private_data)
@@ -58,27 +57,39 @@
 					(ret), "bad certificate")
 #define HANDSHAKE_FAILURE		!strcmp(SSL_alert_desc_string_long\
 					(ret), "handshake failure")
-#define PEM_END_CERTIFICATE_UNIX "-----END CERTIFICATE-----\n"
-#define PEM_END_CERTIFICATE_WIN  "-----END CERTIFICATE-----\r\n"
-
-enum fd_event {
-	FD_CLOSE,
-	FD_CONNECT,
-	FD_RECEIVE,
-	FD_ERROR,
-	FD_CONNECTION_ERROR,
-	NUM_FDS
+
+enum ws_event {
+	EVENT_CLOSE,
+	EVENT_CONNECT,
+	EVENT_RECEIVE,
+	EVENT_ERROR,
+	EVENT_CONNECTION_ERROR,
+	NUM_EVENTS
 };
 
-typedef struct {
-	int fdset[NUM_FDS];
-} os_websocket_fds;
+/*
+ * Frame waiting to be sent, with the LWS_PRE bytes of headroom
+ * libwebsockets needs to write the frame header in place.
+ */
+typedef struct os_websocket_frame {
+	struct os_websocket_frame *next;
+	enum lws_write_protocol type;
+	size_t len;
+	unsigned char buf[];
+} os_websocket_frame;
 
 typedef struct {
-	char *send_message;
-	int send_message_len;
-	char *receive_message;
-	os_websocket_fds *fds;
+	os_websocket_frame *send_head;
+	os_websocket_frame *send_tail;
+	unsigned int send_high_watermark;
+	artik_websocket_queue_stats send_stats;
+	artik_websocket_message *receive_ring;
+	unsigned int receive_size;
+	unsigned int receive_head;
+	unsigned int receive_count;
+	bool receive_paused;
+	artik_websocket_message receive_partial;
+	size_t receive_alloc;
 	int timeout_id;
 	int periodic_id;
 	unsigned int ping_period;
@@ -86,30 +97,84 @@ typedef struct {
 } os_websocket_container;
 
 typedef struct {
-	int watch_id;
-	enum fd_event fd;
 	artik_websocket_callback callback;
+	artik_websocket_message_callback message_callback;
 	void *user_data;
-	artik_loop_module *loop;
 } os_websocket_data;
 
+/* Socket of a libwebsockets context, watched by the loop */
 typedef struct {
 	struct lws_context *context;
-	struct lws *wsi;
-	struct lws_protocols *protocols;
+	int fd;
+	int events;
+	int watch_id;
+} os_websocket_pollfd;
+
+/*
+ * Connections using the same TLS configuration share a vhost, which
+ * holds the client SSL_CTX and the proxy settings. Without the vhost API
+ * of libwebsockets, each of them gets its own context instead.
+ */
+typedef struct os_websocket_vhost {
+	struct os_websocket_vhost *next;
+	struct lws_context *context;
+#ifdef LIBWEBSOCKETS_VHOST_API
+	struct lws_vhost *vhost;
+	char name[MAX_VHOST_NAME];
+#endif
 	SSL_CTX *ssl_ctx;
-	int loop_process_id;
+	artik_ssl_credentials_handle ssl_creds;
+	artik_ssl_verify_t verify_cert;
+	char *verify_host;
+	bool use_tls;
+} os_websocket_vhost;
+
+typedef struct os_websocket_interface {
+	struct os_websocket_interface *next;
+	struct os_websocket_interface *next_event;
+	os_websocket_vhost *vhost;
+	struct lws *wsi;
 	os_websocket_container container;
-	os_websocket_data data[NUM_FDS];
+	os_websocket_data data[NUM_EVENTS];
+	unsigned int events;
+	bool queued;
+	bool housekeeping;
+	bool closing;
 	bool error_connect;
 } os_websocket_interface;
 
+/*
+ * State shared by all the connections of the process: the libwebsockets
+ * contexts, the watches on their sockets and a single eventfd through
+ * which the events of every connection are reported to the loop.
+ */
 typedef struct {
-	artik_list node;
-	os_websocket_interface interface;
-} websocket_node;
-
-static artik_list *requested_node = NULL;
+	artik_loop_module *loop;
+#ifdef LIBWEBSOCKETS_VHOST_API
+	struct lws_context *context;
+	unsigned int vhost_serial;
+#endif
+	struct lws_protocols protocols[2];
+	os_websocket_vhost *vhosts;
+	os_websocket_interface *interfaces;
+	unsigned int num_streams;
+	os_websocket_pollfd *pollfds;
+	unsigned int num_pollfds;
+	int housekeeping_id;
+	unsigned int housekeeping_users;
+	int pending_id;
+	int event_fd;
+	int event_watch_id;
+	os_websocket_interface *event_head;
+	os_websocket_interface *event_tail;
+	os_websocket_interface *dispatching;
+} os_websocket_shared;
+
+static os_websocket_shared shared = {
+	.housekeeping_id = -1,
+	.pending_id = -1,
+	.event_fd = -1,
+};
 
 static const struct lws_extension exts[] = {
 	{
@@ -133,648 +198,1269 @@ static void ssl_ctx_info_callback(const SSL *ssl, int where, int ret);
 static int ping_periodic_callback(void *user_data);
 static void pong_timeout_callback(void *user_data);
 
-void lws_cleanup(artik_websocket_config *config)
+static int pollfd_set(struct lws_context *context, struct lws_pollargs *args);
+static void pollfd_del(int fd);
+static void service_pending(struct lws_context *context);
+static void set_housekeeping(os_websocket_interface *interface, bool enable);
+
+static void release_ssl_credentials(artik_ssl_credentials_handle creds)
 {
-	void *protocol = (void *)lws_get_protocol(
-					ARTIK_WEBSOCKET_INTERFACE->wsi);
+	artik_security_module *security = (artik_security_module *)
+		artik_request_api_module("security");
 
-	log_dbg("");
+	if (!security) {
+		log_err("Failed to request security module");
+		return;
+	}
 
-	artik_loop_module *loop = (artik_loop_module *)
-		artik_request_api_module("loop");
-
-	loop->remove_fd_watch(
-	  ARTIK_WEBSOCKET_INTERFACE->data[FD_CLOSE].watch_id);
-	loop->remove_fd_watch(
-	  ARTIK_WEBSOCKET_INTERFACE->data[FD_CONNECT].watch_id);
-	loop->remove_fd_watch(
-	  ARTIK_WEBSOCKET_INTERFACE->data[FD_RECEIVE].watch_id);
-	loop->remove_fd_watch(
-	  ARTIK_WEBSOCKET_INTERFACE->data[FD_ERROR].watch_id);
-	loop->remove_fd_watch(
-	  ARTIK_WEBSOCKET_INTERFACE->data[FD_CONNECTION_ERROR].watch_id);
-	loop->remove_idle_callback(ARTIK_WEBSOCKET_INTERFACE->loop_process_id);
-
-	if ((ARTIK_WEBSOCKET_INTERFACE->container.pong_timeout) &&
-		(ARTIK_WEBSOCKET_INTERFACE->container.timeout_id != -1))
-		loop->remove_timeout_callback(
-			ARTIK_WEBSOCKET_INTERFACE->container.timeout_id);
-
-	if ((ARTIK_WEBSOCKET_INTERFACE->container.ping_period) &&
-		(ARTIK_WEBSOCKET_INTERFACE->container.periodic_id != -1))
-		loop->remove_periodic_callback(
-			ARTIK_WEBSOCKET_INTERFACE->container.periodic_id);
-
-	artik_release_api_module(loop);
-
-	/* Destroy context in libwebsockets API */
-	lws_context_destroy(ARTIK_WEBSOCKET_INTERFACE->context);
-
-	/* Free variables in ARTIK API */
-	close(ARTIK_WEBSOCKET_INTERFACE->container.fds->fdset[FD_CLOSE]);
-	close(ARTIK_WEBSOCKET_INTERFACE->container.fds->fdset[FD_CONNECT]);
-	close(ARTIK_WEBSOCKET_INTERFACE->container.fds->fdset[FD_RECEIVE]);
-	close(ARTIK_WEBSOCKET_INTERFACE->container.fds->fdset[FD_ERROR]);
-	close(ARTIK_WEBSOCKET_INTERFACE->container.fds->fdset[FD_CONNECTION_ERROR]);
-	free(ARTIK_WEBSOCKET_INTERFACE->container.fds);
-
-	free(protocol);
-
-	/* Free OpenSSL context */
-	SSL_CTX_free(ARTIK_WEBSOCKET_INTERFACE->ssl_ctx);
-
-	/* Finalize freeing process */
-	free(ARTIK_WEBSOCKET_INTERFACE->protocols);
-	free(config->private_data);
-	config->private_data = NULL;
+	if (security->put_ssl_credentials(creds) != S_OK)
+		log_err("Failed to release SSL credentials");
+
+	artik_release_api_module(security);
 }
 
-int lws_callback(struct lws *wsi, enum lws_callback_reasons reason,
-				void *user, void *in, size_t len)
+static void send_queue_clear(os_websocket_container *container)
 {
-	uint64_t event_setter = FLAG_EVENT;
-	char *received = NULL;
-	artik_error ret = S_OK;
-	artik_loop_module *loop = (artik_loop_module *)
-		artik_request_api_module("loop");
+	while (container->send_head) {
+		os_websocket_frame *frame = container->send_head;
 
-	switch (reason) {
+		container->send_head = frame->next;
+		free(frame);
+	}
 
-	case LWS_CALLBACK_CLIENT_ESTABLISHED:
-		log_dbg("LWS_CALLBACK_CLIENT_ESTABLISHED");
-		if (write(CB_FDS[FD_CONNECT], &event_setter, sizeof(event_setter)) < 0)
-			log_err("Failed to set connect event");
+	container->send_tail = NULL;
+	container->send_stats.pending_messages = 0;
+	container->send_stats.pending_bytes = 0;
+}
 
-		if (CB_CONTAINER->ping_period) {
-			ret = loop->add_periodic_callback(&CB_CONTAINER->periodic_id,
-				CB_CONTAINER->ping_period, ping_periodic_callback, (void *) wsi);
+/*
+ * Send the queued frames until the socket would block, and ask for another
+ * WRITEABLE callback if some are left.
+ */
+static int send_queue_flush(struct lws *wsi, os_websocket_container *container)
+{
+	while (container->send_head) {
+		os_websocket_frame *frame = container->send_head;
 
-			if (ret != S_OK) {
-				log_err("Failed to set ping periodic callback");
-				artik_release_api_module(loop);
-				return -1;
-			}
+		if (lws_write(wsi, frame->buf + LWS_PRE, frame->len,
+				frame->type) < (int)frame->len) {
+			log_err("Failed to write websocket frame");
+			return -1;
 		}
 
-		break;
-
-	case LWS_CALLBACK_CLIENT_WRITEABLE:
-		log_dbg("LWS_CALLBACK_CLIENT_WRITEABLE");
-		if (CB_CONTAINER->send_message) {
-			lws_write(wsi, (unsigned char *) CB_CONTAINER->send_message,
-				CB_CONTAINER->send_message_len, LWS_WRITE_TEXT);
-			free(CB_CONTAINER->send_message -
-				LWS_SEND_BUFFER_PRE_PADDING);
-			CB_CONTAINER->send_message = NULL;
-		}
-		log_dbg("");
-		break;
+		container->send_head = frame->next;
+		if (!container->send_head)
+			container->send_tail = NULL;
+		container->send_stats.pending_messages--;
+		container->send_stats.pending_bytes -= frame->len;
+		container->send_stats.sent_messages++;
+		free(frame);
 
-	case LWS_CALLBACK_CLIENT_RECEIVE:
-		received = strndup((char *)in, strlen((char *)in) + 1);
-		if (!received) {
-			log_err("Failed to allocate memory");
+		if (container->send_head && lws_send_pipe_choked(wsi)) {
+			lws_callback_on_writable(wsi);
 			break;
 		}
-		CB_CONTAINER->receive_message = received;
+	}
 
-		if (write(CB_FDS[FD_RECEIVE], &event_setter, sizeof(event_setter)) < 0)
-			log_err("Failed to set connect event");
-		break;
+	return 0;
+}
 
-	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-		log_dbg("LWS_CALLBACK_CLIENT_CONNECTION_ERROR");
-		if (write(CB_FDS[FD_CONNECTION_ERROR], &event_setter,
-			sizeof(event_setter)) < 0)
-			log_err("Failed to connection error event");
-		break;
+static void receive_queue_clear(os_websocket_container *container)
+{
+	while (container->receive_count) {
+		free(container->receive_ring[container->receive_head].data);
+		container->receive_head = (container->receive_head + 1) %
+			container->receive_size;
+		container->receive_count--;
+	}
 
-	case LWS_CALLBACK_CLOSED:
-		log_dbg("LWS_CALLBACK_CLOSED");
-		if (write(CB_FDS[FD_CLOSE], &event_setter, sizeof(event_setter)) < 0)
-			log_err("Failed to set close event");
-		break;
+	free(container->receive_ring);
+	container->receive_ring = NULL;
+	container->receive_size = 0;
+	container->receive_head = 0;
 
-	case LWS_CALLBACK_WSI_CREATE:
-		log_dbg("LWS_CALLBACK_WSI_CREATE");
-		break;
+	free(container->receive_partial.data);
+	memset(&container->receive_partial, 0,
+		sizeof(container->receive_partial));
+	container->receive_alloc = 0;
+}
 
-	case LWS_CALLBACK_WSI_DESTROY:
-		log_dbg("LWS_CALLBACK_WSI_DESTROY");
-		websocket_node *node = (websocket_node *)artik_list_get_by_handle(
-			requested_node, (ARTIK_LIST_HANDLE)wsi);
+/* Append a chunk of the message being received */
+static int receive_append(struct lws *wsi, os_websocket_container *container,
+		const void *in, size_t len)
+{
+	artik_websocket_message *msg = &container->receive_partial;
+	size_t needed = msg->len + len + 1;
 
-		if (!node) {
-			log_err("Failed to find websocket instance");
-			artik_release_api_module(loop);
-			return -1;
-		}
+	if (!msg->data)
+		msg->binary = lws_frame_is_binary(wsi);
 
-		node->interface.error_connect = true;
-		if (write(CB_FDS[FD_CLOSE], &event_setter,
-			sizeof(event_setter)) < 0)
-			log_err("Failed to set close event");
-		break;
+	if (needed > container->receive_alloc) {
+		size_t alloc = MAX(MAX(needed, 2 * container->receive_alloc),
+			MAX_MESSAGE_SIZE);
+		unsigned char *data = realloc(msg->data, alloc);
 
-	case LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED:
-		log_err("LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED: %s",
-			(const char *)in);
-		break;
+		if (!data)
+			return -1;
 
-	case LWS_CALLBACK_LOCK_POLL:
-		log_dbg("LWS_CALLBACK_LOCK_POLL");
-		break;
+		msg->data = data;
+		container->receive_alloc = alloc;
+	}
 
-	case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
-		log_dbg("LWS_CALLBACK_CHANGE_MODE_POLL_FD");
-		break;
+	memcpy(msg->data + msg->len, in, len);
+	msg->len += len;
+	msg->data[msg->len] = '\0';
 
-	case LWS_CALLBACK_ADD_POLL_FD:
-		log_dbg("LWS_CALLBACK_ADD_POLL_FD");
-		break;
+	return 0;
+}
 
-	case LWS_CALLBACK_UNLOCK_POLL:
-		log_dbg("LWS_CALLBACK_UNLOCK_POLL");
-		break;
+/* Move the message fully received to the ring */
+static int receive_push(os_websocket_container *container)
+{
+	artik_websocket_message *ring = container->receive_ring;
+	unsigned int i;
 
-	case LWS_CALLBACK_DEL_POLL_FD:
-		log_dbg("LWS_CALLBACK_DEL_POLL_FD");
-		break;
+	if (container->receive_count == container->receive_size) {
+		unsigned int size = container->receive_size ?
+			2 * container->receive_size : MAX_QUEUE_SIZE;
 
-	case LWS_CALLBACK_PROTOCOL_INIT:
-		log_dbg("LWS_CALLBACK_PROTOCOL_INIT");
-		break;
+		ring = malloc(size * sizeof(artik_websocket_message));
+		if (!ring)
+			return -1;
 
-	case LWS_CALLBACK_PROTOCOL_DESTROY:
-		log_dbg("LWS_CALLBACK_PROTOCOL_DESTROY");
-		break;
+		for (i = 0; i < container->receive_count; i++)
+			ring[i] = container->receive_ring[
+				(container->receive_head + i) %
+				container->receive_size];
 
-	case LWS_CALLBACK_WS_PEER_INITIATED_CLOSE:
-		log_dbg("LWS_CALLBACK_WS_PEER_INITIATED_CLOSE");
-		break;
+		free(container->receive_ring);
+		container->receive_ring = ring;
+		container->receive_size = size;
+		container->receive_head = 0;
+	}
 
-	case LWS_CALLBACK_GET_THREAD_ID:
-		break;
+	ring[(container->receive_head + container->receive_count) %
+		container->receive_size] = container->receive_partial;
+	container->receive_count++;
 
-	case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
-		log_dbg("LWS_CALLBACK_CLIENT_RECEIVE_PONG");
-		if ((CB_CONTAINER->pong_timeout) && (CB_CONTAINER->timeout_id != -1)) {
-			loop->remove_timeout_callback(CB_CONTAINER->timeout_id);
-			CB_CONTAINER->timeout_id = -1;
-		}
+	memset(&container->receive_partial, 0,
+		sizeof(container->receive_partial));
+	container->receive_alloc = 0;
 
-		break;
+	return 0;
+}
 
-	case LWS_CALLBACK_CLIENT_FILTER_PRE_ESTABLISH:
-		log_dbg("LWS_CALLBACK_CLIENT_FILTER_PRE_ESTABLISH");
-		break;
+/*
+ * Events are recorded in the interface and the interface is queued on the
+ * shared eventfd, which is only written when the queue was empty. All the
+ * events of a connection are then delivered in one go from the loop.
+ */
+static void event_queue(os_websocket_interface *interface)
+{
+	uint64_t event_setter = FLAG_EVENT;
 
-	case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
-		log_dbg("LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER");
-		break;
+	if (interface->queued)
+		return;
 
-	case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS:
-		log_dbg("LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS");
-		break;
-	case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS:
-		log_dbg("LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS");
-		break;
+	interface->queued = true;
+	interface->next_event = NULL;
 
-	default:
-		log_dbg("reason = %d", reason);
-		break;
+	if (shared.event_tail) {
+		shared.event_tail->next_event = interface;
+		shared.event_tail = interface;
+		return;
 	}
 
-	artik_release_api_module(loop);
-
-	return 0;
-}
+	shared.event_head = interface;
+	shared.event_tail = interface;
 
-static int verify_callback(int preverify_ok, X509_STORE_CTX *ctx)
-{
-	return 1;
+	if (write(shared.event_fd, &event_setter, sizeof(event_setter)) < 0)
+		log_err("Failed to set websocket event");
 }
 
-static int verify_cert_cb(X509_STORE_CTX *ctx, void *arg)
+static void event_unqueue(os_websocket_interface *interface)
 {
-	return 1;
-}
+	os_websocket_interface *prev = NULL;
+	os_websocket_interface *cur;
 
-void ssl_ctx_info_callback(const SSL *ssl, int where, int ret)
-{
-	const char *str;
-	int w;
-	uint64_t event_setter = FLAG_EVENT;
-	SSL_CTX *ssl_ctx = SSL_get_SSL_CTX(ssl);
-	struct lws *wsi = (struct lws *)SSL_CTX_get_ex_data(ssl_ctx, 0);
+	if (!interface->queued)
+		return;
 
-	w = where & ~SSL_ST_MASK;
+	for (cur = shared.event_head; cur != interface; cur = cur->next_event)
+		prev = cur;
 
-	if (w & SSL_ST_CONNECT)
-		str = "SSL_connect";
-	else if (w & SSL_ST_ACCEPT)
-		str = "SSL_accept";
+	if (prev)
+		prev->next_event = interface->next_event;
 	else
-		str = "undefined";
+		shared.event_head = interface->next_event;
 
-	if (where & SSL_CB_ALERT) {
-		str = (where & SSL_CB_READ) ? "read" : "write";
-		log_dbg("SSL Alert %s:%s:%s", str, SSL_alert_type_string_long(ret),
-			SSL_alert_desc_string_long(ret));
+	if (shared.event_tail == interface)
+		shared.event_tail = prev;
 
-		if (SSL_ALERT_FATAL && (UNKNOWN_CA || BAD_CERTIFICATE ||
-			HANDSHAKE_FAILURE)) {
-			if (write(CB_FDS[FD_ERROR], &event_setter,
-				sizeof(event_setter)) < 0)
-				log_err("Failed to set close event : %d",
-					errno);
-		}
-	} else if (where & SSL_CB_EXIT) {
-		if (ret == 0)
-			log_err("%s:failed in %s", str, SSL_state_string_long(ssl));
-	} else if (where & SSL_CB_HANDSHAKE_DONE)
-		log_dbg("%s", SSL_state_string_long(ssl));
+	interface->queued = false;
 }
 
-
-static char *create_key_uri(artik_secure_element_config *se_config)
+static void notify(os_websocket_interface *interface, enum ws_event event)
 {
-	const char *prefix;
-	char *engine_key_uri;
-
-	switch (se_config->key_algo) {
-	case RSA_1024:
-		prefix = "rsa1024://";
-		break;
-	case RSA_2048:
-		prefix = "rsa2048://";
-		break;
-	case ECC_BRAINPOOL_P256R1:
-		prefix = "bp256://";
-		break;
-	case ECC_SEC_P256R1:
-		prefix = "ec256://";
-		break;
-	case ECC_SEC_P384R1:
-		prefix = "ec384://";
-		break;
-	case ECC_SEC_P521R1:
-		prefix = "ec521://";
-		break;
-	default:
-		log_dbg("algo %d not supported", se_config->key_algo);
-		return NULL;
-	}
-
-	engine_key_uri = malloc(strlen(prefix) + strlen(se_config->key_id) + 1);
-	if (!engine_key_uri)
-		return NULL;
-
-	strcpy(engine_key_uri, prefix);
-	strcat(engine_key_uri, se_config->key_id);
-
-	return engine_key_uri;
+	interface->events |= EVENT_BIT(event);
+	event_queue(interface);
 }
 
-artik_error setup_ssl_ctx(SSL_CTX **pctx, artik_ssl_config *ssl_config,
-		char *host)
+/*
+ * Deliver the messages received since the last wakeup. Returns false if a
+ * callback closed the stream, which releases the interface.
+ */
+static bool deliver_messages(os_websocket_interface *interface)
 {
-	artik_error ret = S_OK;
-	SSL_CTX *ssl_ctx = NULL;
-
-	const SSL_METHOD *method;
-	artik_security_module *security = NULL;
-	BIO *bio = NULL;
-	X509 *x509_cert = NULL;
-	EVP_PKEY *pk = NULL;
-	X509_VERIFY_PARAM *param = NULL;
-	X509_STORE *keystore = NULL;
-	char *start = NULL, *end = NULL;
-	int remain = 0;
-	char *uri = NULL;
+	os_websocket_container *container = &interface->container;
+	os_websocket_data *data = &interface->data[EVENT_RECEIVE];
 
-	log_dbg("");
+	while (container->receive_count &&
+		(data->callback || data->message_callback)) {
+		artik_websocket_message msg =
+			container->receive_ring[container->receive_head];
 
-	/* Initialize OpenSSL library */
-	SSL_library_init();
-	OpenSSL_add_all_algorithms();
-	SSL_load_error_strings();
+		container->receive_head = (container->receive_head + 1) %
+			container->receive_size;
+		container->receive_count--;
 
-	method = (SSL_METHOD *)SSLv23_client_method();
-	if (method == NULL) {
-		log_err("problem creating ssl method\n");
-		return E_NO_MEM;
-	}
+		if (data->message_callback)
+			data->message_callback(data->user_data, &msg);
+		else
+			data->callback(data->user_data, (void *)msg.data);
 
-	/* Create an SSL Context */
-	ssl_ctx = SSL_CTX_new(method);
-	if (ssl_ctx == NULL) {
-		log_err("problem creating ssl context\n");
-		ret = E_NO_MEM;
-		goto exit;
+		if (shared.dispatching != interface)
+			return false;
 	}
 
-	if (ssl_config->se_config) {
-		security = (artik_security_module *)
-			artik_request_api_module("security");
-		if (security->load_openssl_engine() != S_OK) {
-			log_err("Failed to load openssl engine");
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
-		}
+	if (container->receive_paused && !container->receive_count &&
+		!interface->error_connect) {
+		lws_rx_flow_control(interface->wsi, 1);
+		container->receive_paused = false;
 	}
 
-	/* Set options for TLS */
-	SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_COMPRESSION);
-	SSL_CTX_set_options(ssl_ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
-	SSL_CTX_set_info_callback(ssl_ctx, ssl_ctx_info_callback);
-
-	if (ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		param = SSL_CTX_get0_param(ssl_ctx);
-		X509_VERIFY_PARAM_set1_host(param, host, 0);
-		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
-	} else {
-		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, verify_callback);
-		SSL_CTX_set_default_verify_paths(ssl_ctx);
-		SSL_CTX_load_verify_locations(ssl_ctx, NULL, "/etc/ssl/certs/");
-		SSL_CTX_set_cert_verify_callback(ssl_ctx, verify_cert_cb, NULL);
-	}
+	return true;
+}
 
-	if ((!ssl_config->ca_cert.data || !ssl_config->ca_cert.len)
-		&& ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		log_err("No root CA set");
-		ret = E_BAD_ARGS;
-		goto exit;
-	}
+/*
+ * Events without callback are kept until one is set. The callbacks may
+ * close the stream, in which case the remaining events are dropped.
+ */
+static void dispatch_events(os_websocket_interface *interface)
+{
+	static const enum ws_event order[] = {
+		EVENT_CONNECT,
+		EVENT_RECEIVE,
+		EVENT_ERROR,
+		EVENT_CONNECTION_ERROR,
+		EVENT_CLOSE
+	};
+	static const artik_websocket_connection_state states[NUM_EVENTS] = {
+		[EVENT_CLOSE] = ARTIK_WEBSOCKET_CLOSED,
+		[EVENT_CONNECT] = ARTIK_WEBSOCKET_CONNECTED,
+		[EVENT_ERROR] = ARTIK_WEBSOCKET_HANDSHAKE_ERROR,
+		[EVENT_CONNECTION_ERROR] = ARTIK_WEBSOCKET_CONNECTION_ERROR,
+	};
+	unsigned int i;
 
-	if (ssl_config->ca_cert.data && ssl_config->ca_cert.len &&
-			ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		/* Create a new keystore */
-		keystore = X509_STORE_new();
-		if (!keystore) {
-			log_err("Failed to create keystore");
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
-		}
+	shared.dispatching = interface;
 
-		/* CA certs may come as a bundle, parse them all */
-		start = ssl_config->ca_cert.data;
-		end = start;
-		remain = ssl_config->ca_cert.len;
-
-		do {
-			/* Look for UNIX style ending first */
-			end = strstr(start, PEM_END_CERTIFICATE_UNIX);
-			if (end) {
-				end += strlen(PEM_END_CERTIFICATE_UNIX);
-			} else {
-				/* If not found, check for Windows stye ending */
-				end = strstr(start, PEM_END_CERTIFICATE_WIN);
-				if (!end) {
-					log_dbg("Do not find PEM_END");
-					ret = E_BAD_ARGS;
-					goto exit;
-				}
-				end += strlen(PEM_END_CERTIFICATE_WIN);
-			}
+	for (i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+		enum ws_event event = order[i];
+		os_websocket_data *data = &interface->data[event];
 
-			/* Convert CA certificate string into a BIO */
-			bio = BIO_new(BIO_s_mem());
-			BIO_write(bio, start, end - start);
+		if (!(interface->events & EVENT_BIT(event)))
+			continue;
 
-			/* Extract X509 cert from the BIO */
-			x509_cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
-			if (!x509_cert) {
-				log_err("Failed to extract cert from the bio");
-				BIO_free(bio);
-				ret = E_BAD_ARGS;
-				goto exit;
-			}
+		if (event == EVENT_RECEIVE) {
+			if (!data->callback && !data->message_callback)
+				continue;
 
-			/* Add certificate to keystore */
-			if (!X509_STORE_add_cert(keystore, x509_cert)) {
-				log_err("Failed add certificate to the keystore");
-				BIO_free(bio);
-				X509_free(x509_cert);
-				x509_cert = NULL;
-				ret = E_WEBSOCKET_ERROR;
-				goto exit;
-			}
+			interface->events &= ~EVENT_BIT(event);
+			if (!deliver_messages(interface))
+				return;
+			continue;
+		}
 
-			BIO_free(bio);
-			X509_free(x509_cert);
-			x509_cert = NULL;
+		if (!data->callback)
+			continue;
 
-			remain -= end - start;
-			start = end;
-		} while (remain > 0);
+		interface->events &= ~EVENT_BIT(event);
+		data->callback(data->user_data, (void *)states[event]);
 
-		SSL_CTX_set_cert_store(ssl_ctx, keystore);
+		if (shared.dispatching != interface)
+			return;
 	}
 
-	log_dbg("");
+	shared.dispatching = NULL;
+}
 
-	if (ssl_config->client_cert.data &&
-					ssl_config->client_cert.len) {
-		/* Convert certificate string into a BIO */
-		bio = BIO_new(BIO_s_mem());
-		BIO_write(bio, ssl_config->client_cert.data,
-				ssl_config->client_cert.len);
-
-		/* Extract X509 cert from the BIO */
-		x509_cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
-		if (!x509_cert) {
-			BIO_free(bio);
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
+static int event_callback(int fd, enum watch_io io, void *user_data)
+{
+	uint64_t n = 0;
+
+	log_dbg("");
+
+	if (read(fd, &n, sizeof(uint64_t)) < 0) {
+		log_err("event callback error");
+		return 1;
+	}
+
+	while (shared.event_head) {
+		os_websocket_interface *interface = shared.event_head;
+
+		shared.event_head = interface->next_event;
+		if (!shared.event_head)
+			shared.event_tail = NULL;
+		interface->queued = false;
+
+		dispatch_events(interface);
+	}
+
+	return 1;
+}
+
+/*
+ * libwebsockets is driven through its external poll support: the sockets
+ * it reports are watched by the loop and serviced when they are ready,
+ * so an idle connection does not wake the process up.
+ */
+static os_websocket_pollfd *pollfd_find(int fd)
+{
+	unsigned int i;
+
+	for (i = 0; i < shared.num_pollfds; i++)
+		if (shared.pollfds[i].fd == fd)
+			return &shared.pollfds[i];
+
+	return NULL;
+}
+
+static int pollfd_callback(int fd, enum watch_io io, void *user_data)
+{
+	os_websocket_pollfd *pollfd = pollfd_find(fd);
+	struct lws_context *context;
+	struct pollfd pfd;
+
+	if (!pollfd)
+		return 1;
+
+	context = pollfd->context;
+	pfd.fd = fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+	if (io & WATCH_IO_IN)
+		pfd.revents |= POLLIN;
+	if (io & WATCH_IO_OUT)
+		pfd.revents |= POLLOUT;
+	if (io & WATCH_IO_ERR)
+		pfd.revents |= POLLERR;
+	if (io & WATCH_IO_HUP)
+		pfd.revents |= POLLHUP;
+
+	if (lws_service_fd(context, &pfd) < 0)
+		log_err("Failed to service websocket socket");
+	else
+		service_pending(context);
+
+	/* The watch is removed through DEL_POLL_FD when the socket closes */
+	return 1;
+}
+
+static int pollfd_set(struct lws_context *context, struct lws_pollargs *args)
+{
+	os_websocket_pollfd *pollfd = pollfd_find(args->fd);
+	enum watch_io io = WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL;
+
+	if (pollfd && pollfd->events == args->events)
+		return 0;
+
+	if (!pollfd) {
+		pollfd = realloc(shared.pollfds,
+			(shared.num_pollfds + 1) * sizeof(*pollfd));
+		if (!pollfd) {
+			log_err("Failed to allocate memory");
+			return -1;
+		}
+
+		shared.pollfds = pollfd;
+		pollfd = &shared.pollfds[shared.num_pollfds++];
+		pollfd->fd = args->fd;
+	} else {
+		shared.loop->remove_fd_watch(pollfd->watch_id);
+	}
+
+	if (args->events & POLLIN)
+		io |= WATCH_IO_IN;
+	if (args->events & POLLOUT)
+		io |= WATCH_IO_OUT;
+
+	pollfd->context = context;
+	pollfd->events = args->events;
+	pollfd->watch_id = 0;
+	shared.loop->set_stats_tag("websocket");
+	if (shared.loop->add_fd_watch(args->fd, io, pollfd_callback, NULL,
+			&pollfd->watch_id) != S_OK) {
+		log_err("Failed to watch websocket socket");
+		pollfd_del(args->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void pollfd_del(int fd)
+{
+	os_websocket_pollfd *pollfd = pollfd_find(fd);
+
+	if (!pollfd)
+		return;
+
+	if (pollfd->watch_id)
+		shared.loop->remove_fd_watch(pollfd->watch_id);
+
+	*pollfd = shared.pollfds[--shared.num_pollfds];
+}
+
+/* Run lws_service() or the timeout checks on every context */
+static void service_all(bool timeouts_only)
+{
+#ifdef LIBWEBSOCKETS_VHOST_API
+	if (timeouts_only)
+		lws_service_fd(shared.context, NULL);
+	else
+		lws_service(shared.context, -1);
+#else
+	os_websocket_vhost *vhost;
+
+	for (vhost = shared.vhosts; vhost; vhost = vhost->next) {
+		if (timeouts_only)
+			lws_service_fd(vhost->context, NULL);
+		else
+			lws_service(vhost->context, -1);
+	}
+#endif
+}
+
+static void pending_callback(void *user_data)
+{
+	os_websocket_vhost *vhost;
+
+	shared.pending_id = -1;
+
+	/* Only handles the connections with buffered data, never blocks */
+	service_all(false);
+
+	for (vhost = shared.vhosts; vhost; vhost = vhost->next)
+		service_pending(vhost->context);
+}
+
+/*
+ * Data already read from the socket, e.g. decrypted by OpenSSL, does not
+ * make it readable again. Schedule another pass while there is some.
+ */
+static void service_pending(struct lws_context *context)
+{
+	if (shared.pending_id != -1 ||
+		lws_service_adjust_timeout(context, 1, 0))
+		return;
+
+	shared.loop->set_stats_tag("websocket");
+	shared.loop->add_timeout_callback(&shared.pending_id, 0,
+		pending_callback, NULL);
+}
+
+/*
+ * Connection and handshake timeouts of libwebsockets are checked once per
+ * second, only while some connection is being established or closed.
+ */
+static int housekeeping_callback(void *user_data)
+{
+	service_all(true);
+
+	return 1;
+}
+
+static void set_housekeeping(os_websocket_interface *interface, bool enable)
+{
+	if (interface->housekeeping == enable)
+		return;
+
+	interface->housekeeping = enable;
+
+	if (enable) {
+		if (shared.housekeeping_users++ == 0) {
+			shared.loop->set_stats_tag("websocket");
+			shared.loop->add_periodic_callback(
+				&shared.housekeeping_id,
+				HOUSEKEEPING_PERIOD_MS, housekeeping_callback,
+				NULL);
+		}
+		return;
+	}
+
+	if (--shared.housekeeping_users == 0 &&
+		shared.housekeeping_id != -1) {
+		shared.loop->remove_periodic_callback(shared.housekeeping_id);
+		shared.housekeeping_id = -1;
+	}
+}
+
+static void interface_free(os_websocket_interface *interface)
+{
+	os_websocket_interface **pprev = &shared.interfaces;
+
+	while (*pprev && *pprev != interface)
+		pprev = &(*pprev)->next;
+	if (*pprev)
+		*pprev = interface->next;
+
+	event_unqueue(interface);
+	set_housekeeping(interface, false);
+	send_queue_clear(&interface->container);
+	receive_queue_clear(&interface->container);
+	free(interface);
+}
+
+static void shared_destroy(void)
+{
+	/* Releases the connections left closing through WSI_DESTROY */
+#ifdef LIBWEBSOCKETS_VHOST_API
+	if (shared.context)
+		lws_context_destroy(shared.context);
+#else
+	os_websocket_vhost *vhost;
+
+	for (vhost = shared.vhosts; vhost; vhost = vhost->next)
+		lws_context_destroy(vhost->context);
+#endif
+
+	while (shared.interfaces)
+		interface_free(shared.interfaces);
+
+	while (shared.vhosts) {
+		os_websocket_vhost *next = shared.vhosts->next;
+
+		SSL_CTX_free(shared.vhosts->ssl_ctx);
+		release_ssl_credentials(shared.vhosts->ssl_creds);
+		free(shared.vhosts->verify_host);
+		free(shared.vhosts);
+		shared.vhosts = next;
+	}
+
+	if (shared.housekeeping_id != -1)
+		shared.loop->remove_periodic_callback(shared.housekeeping_id);
+
+	if (shared.pending_id != -1)
+		shared.loop->remove_timeout_callback(shared.pending_id);
+
+	if (shared.event_fd != -1) {
+		shared.loop->remove_fd_watch(shared.event_watch_id);
+		close(shared.event_fd);
+	}
+
+	free(shared.pollfds);
+	artik_release_api_module(shared.loop);
+
+	memset(&shared, 0, sizeof(shared));
+	shared.housekeeping_id = -1;
+	shared.pending_id = -1;
+	shared.event_fd = -1;
+}
+
+static artik_error shared_init(void)
+{
+	artik_error ret = S_OK;
+#ifdef LIBWEBSOCKETS_VHOST_API
+	struct lws_context_creation_info info;
+#endif
+
+	if (shared.loop)
+		return S_OK;
+
+	shared.loop = (artik_loop_module *)artik_request_api_module("loop");
+	if (!shared.loop) {
+		log_err("Failed to request loop module");
+		return E_NOT_SUPPORTED;
+	}
+
+	shared.protocols[0].name = ARTIK_WEBSOCKET_PROTOCOL_NAME;
+	shared.protocols[0].callback = lws_callback;
+	shared.protocols[0].per_session_data_size = 0;
+	shared.protocols[0].rx_buffer_size = 4096;
+
+	shared.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (shared.event_fd < 0) {
+		log_err("Failed to create websocket eventfd");
+		ret = E_WEBSOCKET_ERROR;
+		goto exit;
+	}
+
+	shared.loop->set_stats_tag("websocket");
+	ret = shared.loop->add_fd_watch(shared.event_fd, WATCH_IO_IN,
+		event_callback, NULL, &shared.event_watch_id);
+	if (ret != S_OK) {
+		log_err("Failed to set fd watch event callback");
+		close(shared.event_fd);
+		shared.event_fd = -1;
+		goto exit;
+	}
+
+	lws_set_log_level(0, NULL);
+
+	/* Vhosts are added for each TLS configuration, none by default */
+#ifdef LIBWEBSOCKETS_VHOST_API
+	memset(&info, 0, sizeof(struct lws_context_creation_info));
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.gid = -1;
+	info.uid = -1;
+	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS |
+		LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+
+	shared.context = lws_create_context(&info);
+	if (shared.context == NULL) {
+		log_err("Creating libwebsocket context failed");
+		ret = E_WEBSOCKET_ERROR;
+		goto exit;
+	}
+#endif
+
+exit:
+	if (ret != S_OK)
+		shared_destroy();
+
+	return ret;
+}
+
+static int verify_callback(int preverify_ok, X509_STORE_CTX *ctx)
+{
+	return 1;
+}
+
+static int verify_cert_cb(X509_STORE_CTX *ctx, void *arg)
+{
+	return 1;
+}
+
+/* Connection owning an SSL object, only looked up on alerts */
+static os_websocket_interface *find_ssl_interface(const SSL *ssl)
+{
+	os_websocket_interface *interface;
+
+	for (interface = shared.interfaces; interface;
+			interface = interface->next)
+		if (!interface->error_connect && interface->wsi &&
+				lws_get_ssl(interface->wsi) == ssl)
+			return interface;
+
+	return NULL;
+}
+
+void ssl_ctx_info_callback(const SSL *ssl, int where, int ret)
+{
+	const char *str;
+	int w;
+
+	w = where & ~SSL_ST_MASK;
+
+	if (w & SSL_ST_CONNECT)
+		str = "SSL_connect";
+	else if (w & SSL_ST_ACCEPT)
+		str = "SSL_accept";
+	else
+		str = "undefined";
+
+	if (where & SSL_CB_ALERT) {
+		str = (where & SSL_CB_READ) ? "read" : "write";
+		log_dbg("SSL Alert %s:%s:%s", str, SSL_alert_type_string_long(ret),
+			SSL_alert_desc_string_long(ret));
+
+		if (SSL_ALERT_FATAL && (UNKNOWN_CA || BAD_CERTIFICATE ||
+			HANDSHAKE_FAILURE)) {
+			os_websocket_interface *interface =
+				find_ssl_interface(ssl);
+
+			if (interface)
+				notify(interface, EVENT_ERROR);
+			else
+				log_err("Failed to find websocket instance");
 		}
+	} else if (where & SSL_CB_EXIT) {
+		if (ret == 0)
+			log_err("%s:failed in %s", str, SSL_state_string_long(ssl));
+	} else if (where & SSL_CB_HANDSHAKE_DONE)
+		log_dbg("%s", SSL_state_string_long(ssl));
+}
+
+static artik_error get_ssl_credentials(artik_ssl_config *ssl_config,
+		artik_ssl_credentials_handle *pcreds)
+{
+	artik_error ret = S_OK;
+	artik_security_module *security = NULL;
+
+	if ((!ssl_config->ca_cert.data || !ssl_config->ca_cert.len)
+		&& ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
+		log_err("No root CA set");
+		return E_BAD_ARGS;
+	}
+
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security) {
+		log_err("Failed to request security module");
+		return E_NOT_SUPPORTED;
+	}
+
+	/* Root CAs, client certificate and key are shared between sockets */
+	ret = security->get_ssl_credentials(ssl_config, pcreds);
+	if (ret != S_OK)
+		log_err("Failed to load SSL credentials");
+
+	artik_release_api_module(security);
+
+	return ret;
+}
+
+static artik_error setup_ssl_ctx(SSL_CTX **pctx, artik_ssl_config *ssl_config,
+		char *host, artik_ssl_credentials_handle creds)
+{
+	artik_error ret = S_OK;
+	SSL_CTX *ssl_ctx = NULL;
+
+	const SSL_METHOD *method;
+	artik_security_module *security = NULL;
+	X509_VERIFY_PARAM *param = NULL;
+
+	log_dbg("");
+
+	/* Initialize OpenSSL library */
+	SSL_library_init();
+	OpenSSL_add_all_algorithms();
+	SSL_load_error_strings();
+
+	method = (SSL_METHOD *)SSLv23_client_method();
+	if (method == NULL) {
+		log_err("problem creating ssl method\n");
+		return E_NO_MEM;
+	}
+
+	/* Create an SSL Context */
+	ssl_ctx = SSL_CTX_new(method);
+	if (ssl_ctx == NULL) {
+		log_err("problem creating ssl context\n");
+		ret = E_NO_MEM;
+		goto exit;
+	}
+
+	/* Set options for TLS */
+	SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_COMPRESSION);
+	SSL_CTX_set_options(ssl_ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+	SSL_CTX_set_info_callback(ssl_ctx, ssl_ctx_info_callback);
+
+	if (ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
+		param = SSL_CTX_get0_param(ssl_ctx);
+		X509_VERIFY_PARAM_set1_host(param, host, 0);
+		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
+	} else {
+		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, verify_callback);
+		SSL_CTX_set_default_verify_paths(ssl_ctx);
+		SSL_CTX_load_verify_locations(ssl_ctx, NULL, "/etc/ssl/certs/");
+		SSL_CTX_set_cert_verify_callback(ssl_ctx, verify_cert_cb, NULL);
+	}
+
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security) {
+		log_err("Failed to request security module");
+		ret = E_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	ret = security->apply_ssl_credentials(creds, ssl_ctx);
+	if (ret != S_OK) {
+		ret = E_WEBSOCKET_ERROR;
+		goto exit;
+	}
+
+	if (ssl_config->client_key.data && ssl_config->client_key.len)
+		SSL_CTX_set1_sigalgs_list(ssl_ctx, "ECDSA+SHA256");
+
+	*pctx = ssl_ctx;
+
+exit:
+	if (ret != S_OK && ssl_ctx != NULL)
+		SSL_CTX_free(ssl_ctx);
+
+	if (security)
+		artik_release_api_module(security);
+
+	return ret;
+}
 
-		log_dbg("");
+#ifndef LIBWEBSOCKETS_VHOST_API
+static artik_error set_proxy(struct lws_context *context, artik_uri_info *uri_proxy)
+{
+	artik_error ret = S_OK;
+	char *lws_proxy = NULL;
+	size_t len;
+	int lws_ret;
 
-		BIO_free(bio);
+	/* The max length for lws_proxy is strlen(uri_proxy.hostname) + 6
+	 * 6 = 1 + 5
+	 *    1 for '\0'
+	 *    5 for the max size of the port (the max value for a port is 65 535)
+	 */
+	len = strlen(uri_proxy->hostname) + 6;
+	lws_proxy = malloc(sizeof(char)*len);
+	if (!lws_proxy) {
+		ret = E_NO_MEM;
+		goto exit;
+	}
 
-		/* Set certificate to context */
-		if (!SSL_CTX_use_certificate(ssl_ctx, x509_cert)) {
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
-		}
+	snprintf(lws_proxy, len, "%s:%d", uri_proxy->hostname, uri_proxy->port);
+	lws_ret = lws_set_proxy(context, lws_proxy);
+	if (lws_ret != 0) {
+		ret = E_WEBSOCKET_ERROR;
+		goto exit;
 	}
 
-	log_dbg("");
+exit:
+	if (lws_proxy)
+		free(lws_proxy);
 
-	if (ssl_config->client_key.data && ssl_config->client_key.len) {
-		/* Convert key string into a BIO */
-		bio = BIO_new(BIO_s_mem());
-		if (!BIO_write(bio, ssl_config->client_key.data,
-				ssl_config->client_key.len)) {
-			BIO_free(bio);
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
-		}
+	return ret;
+}
+#endif
 
-		log_dbg("");
-		if (ssl_config->se_config) {
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-			ENGINE *engine = ENGINE_get_default_ECDSA();
-#else
-			ENGINE *engine = ENGINE_get_default_EC();
+static bool vhost_match(os_websocket_vhost *vhost,
+		artik_ssl_credentials_handle creds, artik_ssl_config *ssl_config,
+		const char *host, bool use_tls)
+{
+	if (vhost->ssl_creds != creds || vhost->use_tls != use_tls ||
+			vhost->verify_cert != ssl_config->verify_cert)
+		return false;
+
+	/* The host name is only part of the SSL_CTX when it is verified */
+	if (ssl_config->verify_cert != ARTIK_SSL_VERIFY_REQUIRED)
+		return true;
+
+	return !strcmp(vhost->verify_host, host ? host : "");
+}
+
+static artik_error vhost_create(os_websocket_vhost *vhost,
+		artik_ssl_config *ssl_config, char *host, bool use_tls)
+{
+	artik_error ret = S_OK;
+	struct lws_context_creation_info info;
+	artik_utils_module *utils = artik_request_api_module("utils");
+
+	memset(&info, 0, sizeof(struct lws_context_creation_info));
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.iface = NULL;
+	info.protocols = shared.protocols;
+	info.gid = -1;
+	info.uid = -1;
+#ifdef LIBWEBSOCKETS_VHOST_API
+	info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
 #endif
-			if (!engine) {
-				ret = E_WEBSOCKET_ERROR;
-				goto exit;
-			}
 
-			uri = create_key_uri(ssl_config->se_config);
-			if (!uri) {
+	ret = setup_ssl_ctx(&vhost->ssl_ctx, ssl_config, host,
+			vhost->ssl_creds);
+	if (ret != S_OK)
+		goto exit;
+
+	info.provided_client_ssl_ctx = vhost->ssl_ctx;
+
+	/* Check if there is an enabled proxy */
+	char *http_proxy = getenv("http_proxy");
+	char *https_proxy = getenv("https_proxy");
+	char *uri_proxy = NULL;
+	artik_uri_info lws_proxy;
+
+	if (http_proxy || https_proxy) {
+		int default_port;
+
+		if (use_tls && https_proxy) {
+			uri_proxy = https_proxy;
+			default_port = 443;
+		} else if (!use_tls && http_proxy) {
+			uri_proxy = http_proxy;
+			default_port = 80;
+		}
+
+		if (uri_proxy) {
+			if (utils->get_uri_info(&lws_proxy, uri_proxy) != S_OK) {
+				log_err("Wrong websocket proxy (%s)",  uri_proxy);
 				ret = E_WEBSOCKET_ERROR;
 				goto exit;
 			}
 
-			pk = ENGINE_load_private_key(engine,
-					uri, NULL, NULL);
-			free(uri);
-		} else {
-			/* Extract EVP key from the BIO */
-			pk = PEM_read_bio_PrivateKey(bio, NULL, 0, NULL);
-		}
+			if (lws_proxy.port == -1)
+				lws_proxy.port = default_port;
 
-		if (!pk) {
-			BIO_free(bio);
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
+#ifdef LIBWEBSOCKETS_VHOST_API
+			info.http_proxy_address = lws_proxy.hostname;
+			info.http_proxy_port = lws_proxy.port;
+#endif
 		}
+	}
 
-		BIO_free(bio);
+#ifdef LIBWEBSOCKETS_VHOST_API
+	snprintf(vhost->name, MAX_VHOST_NAME, "artik-websocket-%u",
+		shared.vhost_serial++);
+	info.vhost_name = vhost->name;
+
+	vhost->context = shared.context;
+	vhost->vhost = lws_create_vhost(shared.context, &info);
+	if (vhost->vhost == NULL) {
+		log_err("Creating libwebsocket vhost failed");
+		ret = E_WEBSOCKET_ERROR;
+	}
+#else
+	vhost->context = lws_create_context(&info);
+	if (vhost->context == NULL) {
+		log_err("Creating libwebsocket context failed");
+		ret = E_WEBSOCKET_ERROR;
+	} else if (uri_proxy) {
+		set_proxy(vhost->context, &lws_proxy);
+	}
+#endif
 
-		/* Set private key to context */
-		if (!SSL_CTX_use_PrivateKey(ssl_ctx, pk)) {
-			ret = E_WEBSOCKET_ERROR;
-			goto exit;
+	if (uri_proxy)
+		utils->free_uri_info(&lws_proxy);
+
+exit:
+	if (ret != S_OK && vhost->ssl_ctx) {
+		SSL_CTX_free(vhost->ssl_ctx);
+		vhost->ssl_ctx = NULL;
+	}
+
+	artik_release_api_module(utils);
+
+	return ret;
+}
+
+/*
+ * Find the vhost matching the TLS configuration of a connection, or add
+ * one. Vhosts are kept as long as the shared context.
+ */
+static artik_error vhost_get(os_websocket_vhost **pvhost,
+		artik_ssl_config *ssl_config, char *host, bool use_tls)
+{
+	artik_error ret = S_OK;
+	artik_ssl_credentials_handle creds = NULL;
+	os_websocket_vhost *vhost;
+
+	ret = get_ssl_credentials(ssl_config, &creds);
+	if (ret != S_OK)
+		return ret;
+
+	for (vhost = shared.vhosts; vhost; vhost = vhost->next) {
+		if (vhost_match(vhost, creds, ssl_config, host, use_tls)) {
+			release_ssl_credentials(creds);
+			*pvhost = vhost;
+			return S_OK;
 		}
+	}
+
+	vhost = malloc(sizeof(os_websocket_vhost));
+	if (!vhost) {
+		log_err("Failed to allocate memory");
+		release_ssl_credentials(creds);
+		return E_NO_MEM;
+	}
 
-		log_dbg("");
+	memset(vhost, 0, sizeof(*vhost));
+	vhost->ssl_creds = creds;
+	vhost->verify_cert = ssl_config->verify_cert;
+	vhost->use_tls = use_tls;
 
-		/* Check certificate/key pair validity */
-		if (!SSL_CTX_check_private_key(ssl_ctx)) {
-			ret = E_WEBSOCKET_ERROR;
+	if (ssl_config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
+		vhost->verify_host = strdup(host ? host : "");
+		if (!vhost->verify_host) {
+			log_err("Failed to allocate memory");
+			ret = E_NO_MEM;
 			goto exit;
 		}
-
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-		if (ssl_config->se_config)
-			SSL_CTX_set1_curves_list(ssl_ctx, "brainpoolP256r1:prime256v1");
-#endif
-		SSL_CTX_set1_sigalgs_list(ssl_ctx, "ECDSA+SHA256");
 	}
 
-	*pctx = ssl_ctx;
+	ret = vhost_create(vhost, ssl_config, host, use_tls);
+	if (ret != S_OK)
+		goto exit;
 
-exit:
-	/* Clean up allocated memories and handle */
-	if (security)
-		artik_release_api_module(security);
-	if (pk)
-		EVP_PKEY_free(pk);
-	if (x509_cert)
-		X509_free(x509_cert);
+	vhost->next = shared.vhosts;
+	shared.vhosts = vhost;
+	*pvhost = vhost;
 
-	if (ret != S_OK && ssl_ctx != NULL)
-		SSL_CTX_free(ssl_ctx);
+exit:
+	if (ret != S_OK) {
+		release_ssl_credentials(creds);
+		free(vhost->verify_host);
+		free(vhost);
+	}
 
 	return ret;
 }
 
-static void release_openssl_engine(void)
+/*
+ * Release the resources of a connection. On the shared context, a
+ * connection still alive is only marked as closing and asked to close,
+ * the interface is freed once libwebsockets has destroyed it.
+ */
+static void os_websocket_cleanup(artik_websocket_config *config)
 {
-	artik_security_module *security = (artik_security_module *)
-		artik_request_api_module("security");
+	os_websocket_interface *interface = ARTIK_WEBSOCKET_INTERFACE;
 
-	if (!security) {
-		log_err("Failed to request security module");
+	log_dbg("");
+
+	config->private_data = NULL;
+
+	if ((interface->container.pong_timeout) &&
+		(interface->container.timeout_id != -1))
+		shared.loop->remove_timeout_callback(
+			interface->container.timeout_id);
+
+	if ((interface->container.ping_period) &&
+		(interface->container.periodic_id != -1))
+		shared.loop->remove_periodic_callback(
+			interface->container.periodic_id);
+
+	if (shared.dispatching == interface)
+		shared.dispatching = NULL;
+
+	event_unqueue(interface);
+	send_queue_clear(&interface->container);
+	receive_queue_clear(&interface->container);
+	memset(interface->data, 0, sizeof(interface->data));
+	interface->events = 0;
+	shared.num_streams--;
+
+	if (interface->error_connect) {
+		interface_free(interface);
+		if (!shared.num_streams)
+			shared_destroy();
 		return;
 	}
 
-	if (security->unload_openssl_engine() != S_OK)
-		log_err("Failed to unload openssl engine");
+	interface->closing = true;
+	set_housekeeping(interface, true);
 
+	/* Destroying the contexts releases the connections left */
+	if (!shared.num_streams) {
+		shared_destroy();
+		return;
+	}
 
-	artik_release_api_module(security);
+	lws_callback_on_writable(interface->wsi);
 }
 
+int lws_callback(struct lws *wsi, enum lws_callback_reasons reason,
+				void *user, void *in, size_t len)
+{
+	artik_error ret = S_OK;
+
+	switch (reason) {
+
+	case LWS_CALLBACK_CLIENT_ESTABLISHED:
+		log_dbg("LWS_CALLBACK_CLIENT_ESTABLISHED");
+		if (!CB_INTERFACE)
+			break;
+
+		if (CB_INTERFACE->closing)
+			return -1;
+
+		set_housekeeping(CB_INTERFACE, false);
+		notify(CB_INTERFACE, EVENT_CONNECT);
+
+		/* Flush the messages written while connecting */
+		if (CB_CONTAINER->send_head)
+			lws_callback_on_writable(wsi);
+
+		if (CB_CONTAINER->ping_period) {
+			shared.loop->set_stats_tag("websocket");
+			ret = shared.loop->add_periodic_callback(
+				&CB_CONTAINER->periodic_id,
+				CB_CONTAINER->ping_period,
+				ping_periodic_callback, user);
+
+			if (ret != S_OK) {
+				log_err("Failed to set ping periodic callback");
+				return -1;
+			}
+		}
+
+		break;
+
+	case LWS_CALLBACK_CLIENT_WRITEABLE:
+		log_dbg("LWS_CALLBACK_CLIENT_WRITEABLE");
+		if (!CB_INTERFACE)
+			break;
+
+		if (CB_INTERFACE->closing)
+			return -1;
+
+		if (send_queue_flush(wsi, CB_CONTAINER) < 0)
+			return -1;
+		break;
+
+	case LWS_CALLBACK_CLIENT_RECEIVE:
+		if (!CB_INTERFACE || CB_INTERFACE->closing)
+			break;
+
+		if (receive_append(wsi, CB_CONTAINER, in, len) < 0) {
+			log_err("Failed to allocate memory");
+			return -1;
+		}
+
+		/* Wait for the remaining fragments of the message */
+		if (!lws_is_final_fragment(wsi) ||
+			lws_remaining_packet_payload(wsi))
+			break;
+
+		if (receive_push(CB_CONTAINER) < 0) {
+			log_err("Failed to allocate memory");
+			return -1;
+		}
+
+		/* Stop reading until the application catches up */
+		if (CB_CONTAINER->receive_count >= MAX_QUEUE_SIZE &&
+			!CB_CONTAINER->receive_paused) {
+			lws_rx_flow_control(wsi, 0);
+			CB_CONTAINER->receive_paused = true;
+		}
+
+		notify(CB_INTERFACE, EVENT_RECEIVE);
+		break;
+
+	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+		log_dbg("LWS_CALLBACK_CLIENT_CONNECTION_ERROR");
+		if (CB_INTERFACE && !CB_INTERFACE->closing)
+			notify(CB_INTERFACE, EVENT_CONNECTION_ERROR);
+		break;
+
+	case LWS_CALLBACK_CLOSED:
+		log_dbg("LWS_CALLBACK_CLOSED");
+		if (CB_INTERFACE && !CB_INTERFACE->closing)
+			notify(CB_INTERFACE, EVENT_CLOSE);
+		break;
+
+	case LWS_CALLBACK_WSI_CREATE:
+		log_dbg("LWS_CALLBACK_WSI_CREATE");
+		break;
+
+	case LWS_CALLBACK_WSI_DESTROY:
+		log_dbg("LWS_CALLBACK_WSI_DESTROY");
+		if (!CB_INTERFACE)
+			break;
+
+		if (CB_INTERFACE->closing) {
+			interface_free(CB_INTERFACE);
+			break;
+		}
+
+		CB_INTERFACE->error_connect = true;
+		CB_INTERFACE->wsi = NULL;
+		set_housekeeping(CB_INTERFACE, false);
+		notify(CB_INTERFACE, EVENT_CLOSE);
+		break;
+
+	case LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED:
+		log_err("LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED: %s",
+			(const char *)in);
+		break;
+
+	case LWS_CALLBACK_LOCK_POLL:
+		log_dbg("LWS_CALLBACK_LOCK_POLL");
+		break;
+
+	case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
+	case LWS_CALLBACK_ADD_POLL_FD:
+		log_dbg("LWS_CALLBACK_%s_POLL_FD",
+			reason == LWS_CALLBACK_ADD_POLL_FD ? "ADD" : "CHANGE_MODE");
+		if (pollfd_set(lws_get_context(wsi),
+			(struct lws_pollargs *)in) < 0)
+			return -1;
+		break;
+
+	case LWS_CALLBACK_UNLOCK_POLL:
+		log_dbg("LWS_CALLBACK_UNLOCK_POLL");
+		break;
+
+	case LWS_CALLBACK_DEL_POLL_FD:
+		log_dbg("LWS_CALLBACK_DEL_POLL_FD");
+		pollfd_del(((struct lws_pollargs *)in)->fd);
+		break;
+
+	case LWS_CALLBACK_PROTOCOL_INIT:
+		log_dbg("LWS_CALLBACK_PROTOCOL_INIT");
+		break;
+
+	case LWS_CALLBACK_PROTOCOL_DESTROY:
+		log_dbg("LWS_CALLBACK_PROTOCOL_DESTROY");
+		break;
+
+	case LWS_CALLBACK_WS_PEER_INITIATED_CLOSE:
+		log_dbg("LWS_CALLBACK_WS_PEER_INITIATED_CLOSE");
+		break;
+
+	case LWS_CALLBACK_GET_THREAD_ID:
+		break;
+
+	case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+		log_dbg("LWS_CALLBACK_CLIENT_RECEIVE_PONG");
+		if (!CB_INTERFACE)
+			break;
 
-static int os_websocket_process_stream(void *user_data)
-{
-	os_websocket_interface *interface = (os_websocket_interface *)user_data;
-	int n;
+		if ((CB_CONTAINER->pong_timeout) && (CB_CONTAINER->timeout_id != -1)) {
+			shared.loop->remove_timeout_callback(CB_CONTAINER->timeout_id);
+			CB_CONTAINER->timeout_id = -1;
+		}
 
-	n = lws_service(interface->context, PROCESS_TIMEOUT_MS);
-	if (n < 0) {
-		log_err("os_websocket_process_stream");
-		return 0;
-	}
+		break;
 
-	return 1;
-}
+	case LWS_CALLBACK_CLIENT_FILTER_PRE_ESTABLISH:
+		log_dbg("LWS_CALLBACK_CLIENT_FILTER_PRE_ESTABLISH");
+		break;
 
-#ifndef LIBWEBSOCKETS_VHOST_API
-static artik_error set_proxy(struct lws_context *context, artik_uri_info *uri_proxy)
-{
-	artik_error ret = S_OK;
-	char *lws_proxy = NULL;
-	size_t len;
-	int lws_ret;
+	case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
+		log_dbg("LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER");
+		break;
 
-	/* The max length for lws_proxy is strlen(uri_proxy.hostname) + 6
-	 * 6 = 1 + 5
-	 *    1 for '\0'
-	 *    5 for the max size of the port (the max value for a port is 65 535)
-	 */
-	len = strlen(uri_proxy->hostname) + 6;
-	lws_proxy = malloc(sizeof(char)*len);
-	if (!lws_proxy) {
-		ret = E_NO_MEM;
-		goto exit;
-	}
+	case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS:
+		log_dbg("LWS_CALLBACK_OPENSSL_LOAD_EXTRA_SERVER_VERIFY_CERTS");
+		break;
+	case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS:
+		log_dbg("LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS");
+		break;
 
-	snprintf(lws_proxy, len, "%s:%d", uri_proxy->hostname, uri_proxy->port);
-	lws_ret = lws_set_proxy(context, lws_proxy);
-	if (lws_ret != 0) {
-		ret = E_WEBSOCKET_ERROR;
-		goto exit;
+	default:
+		log_dbg("reason = %d", reason);
+		break;
 	}
 
-exit:
-	if (lws_proxy)
-		free(lws_proxy);
-
-	return ret;
+	return 0;
 }
-#endif
 
 artik_error os_websocket_open_stream(artik_websocket_config *config, char *host,
 		char *path, int port, bool use_tls)
 {
 	artik_error ret = S_OK;
-	os_websocket_fds *fds = NULL;
 	os_websocket_interface *interface = NULL;
-	struct lws_context *context = NULL;
-	struct lws_context_creation_info info;
 	struct lws *wsi = NULL;
-	websocket_node *node = NULL;
 	struct lws_client_connect_info conn_info;
-	artik_loop_module *loop = (artik_loop_module *)
-		artik_request_api_module("loop");
-	artik_utils_module *utils = artik_request_api_module("utils");
 
 	if (config->ping_period < config->pong_timeout) {
 		log_err("The pong_timeout value must be significantly smaller "
 			"than ping_period.");
-		ret = E_BAD_ARGS;
-		goto exit;
+		return E_BAD_ARGS;
 	}
 
 	log_dbg("");
 
+	ret = shared_init();
+	if (ret != S_OK)
+		return ret;
+
 	interface = malloc(sizeof(os_websocket_interface));
 	if (!interface) {
 		log_err("Failed to allocate memory");
@@ -782,88 +1468,27 @@ artik_error os_websocket_open_stream(artik_websocket_config *config, char *host,
 		goto exit;
 	}
 
-	interface->protocols = malloc(2 * sizeof(struct lws_protocols));
-	if (!interface->protocols) {
-		log_err("Failed to allocate memory");
-		ret = E_NO_MEM;
-		goto exit;
-	}
-
-	memset(interface->protocols, 0, 2 * sizeof(struct lws_protocols));
-	interface->protocols[0].name = ARTIK_WEBSOCKET_PROTOCOL_NAME;
-	interface->protocols[0].callback = lws_callback;
-	interface->protocols[0].per_session_data_size = 0;
-	interface->protocols[0].rx_buffer_size = 4096;
-	interface->protocols[0].id = (uintptr_t)config;
-	interface->protocols[0].user = (void *)&interface->container;
+	memset(interface, 0, sizeof(*interface));
+	interface->container.periodic_id = -1;
+	interface->container.timeout_id = -1;
+	interface->container.ping_period = config->ping_period;
+	interface->container.pong_timeout = config->pong_timeout;
+	interface->container.send_high_watermark =
+		config->send_high_watermark;
 
-	memset(&info, 0, sizeof(struct lws_context_creation_info));
-	info.port = CONTEXT_PORT_NO_LISTEN;
-	info.iface = NULL;
-	info.protocols = interface->protocols;
-	info.gid = -1;
-	info.uid = -1;
-#ifdef LIBWEBSOCKETS_VHOST_API
-	info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
-#endif
+	interface->next = shared.interfaces;
+	shared.interfaces = interface;
+	shared.num_streams++;
 
-	ret = setup_ssl_ctx(&info.provided_client_ssl_ctx, &config->ssl_config,
-			host);
+	ret = vhost_get(&interface->vhost, &config->ssl_config, host, use_tls);
 	if (ret != S_OK)
 		goto exit;
 
-	lws_set_log_level(0, NULL);
-
-	/* Check if there is an enabled proxy */
-	char *http_proxy = getenv("http_proxy");
-	char *https_proxy = getenv("https_proxy");
-	char *uri_proxy = NULL;
-	artik_uri_info lws_proxy;
-
-	if (http_proxy || https_proxy) {
-		int default_port;
-
-		if (use_tls && https_proxy) {
-			uri_proxy = https_proxy;
-			default_port = 443;
-		} else if (!use_tls && http_proxy) {
-			uri_proxy = http_proxy;
-			default_port = 80;
-		}
-
-		if (uri_proxy) {
-			if (utils->get_uri_info(&lws_proxy, uri_proxy) != S_OK) {
-				log_err("Wrong websocket proxy (%s)",  uri_proxy);
-				ret = E_WEBSOCKET_ERROR;
-				goto exit;
-			}
-
-			if (lws_proxy.port == -1)
-				lws_proxy.port = default_port;
-
+	memset(&conn_info, 0, sizeof(conn_info));
+	conn_info.context = interface->vhost->context;
 #ifdef LIBWEBSOCKETS_VHOST_API
-			info.http_proxy_address = strdup(lws_proxy.hostname);
-			info.http_proxy_port = lws_proxy.port;
+	conn_info.vhost = interface->vhost->vhost;
 #endif
-		}
-	}
-
-	context = lws_create_context(&info);
-	if (context == NULL) {
-		log_err("Creating libwebsocket context failed");
-		ret = E_WEBSOCKET_ERROR;
-		goto exit;
-	}
-
-#ifndef LIBWEBSOCKETS_VHOST_API
-	if (uri_proxy)
-		set_proxy(context, &lws_proxy);
-#endif
-	if (uri_proxy)
-		utils->free_uri_info(&lws_proxy);
-
-	memset(&conn_info, 0, sizeof(conn_info));
-	conn_info.context = context;
 	conn_info.address = host ? host : "";
 	conn_info.port = port;
 	conn_info.path = path ? path : "";
@@ -872,6 +1497,7 @@ artik_error os_websocket_open_stream(artik_websocket_config *config, char *host,
 	conn_info.protocol = ARTIK_WEBSOCKET_PROTOCOL_NAME;
 	conn_info.ietf_version_or_minus_one = -1;
 	conn_info.client_exts = exts;
+	conn_info.userdata = interface;
 
 	if (use_tls) {
 		switch (config->ssl_config.verify_cert) {
@@ -887,32 +1513,7 @@ artik_error os_websocket_open_stream(artik_websocket_config *config, char *host,
 		conn_info.ssl_connection = 0;
 	}
 
-	fds = malloc(sizeof(*fds));
-	if (fds == NULL) {
-		log_err("Failed to allocate memory");
-		ret = E_NO_MEM;
-		goto exit;
-	}
-	memset(fds, 0, sizeof(*fds));
-
-	fds->fdset[FD_CLOSE] = eventfd(0, 0);
-	fds->fdset[FD_CONNECT] = eventfd(0, 0);
-	fds->fdset[FD_RECEIVE] = eventfd(0, 0);
-	fds->fdset[FD_ERROR] = eventfd(0, 0);
-	fds->fdset[FD_CONNECTION_ERROR] = eventfd(0, 0);
-
-	memset(interface, 0, sizeof(*interface));
-	interface->context = (void *)context;
-	interface->container.fds = (void *)fds;
-	interface->ssl_ctx = info.provided_client_ssl_ctx;
-	interface->error_connect = false;
-	interface->container.periodic_id = -1;
-	interface->container.timeout_id = -1;
-	interface->container.ping_period = config->ping_period;
-	interface->container.pong_timeout = config->pong_timeout;
-
-	loop->add_idle_callback(&interface->loop_process_id,
-		os_websocket_process_stream, (void *)interface);
+	set_housekeeping(interface, true);
 
 	config->private_data = (void *)interface;
 
@@ -923,218 +1524,127 @@ artik_error os_websocket_open_stream(artik_websocket_config *config, char *host,
 		goto exit;
 	}
 
-	interface->wsi = (void *)wsi;
-	SSL_CTX_set_ex_data(interface->ssl_ctx, 0, (void *)wsi);
-
-	node = (websocket_node *)artik_list_add(&requested_node,
-			(ARTIK_LIST_HANDLE)wsi, sizeof(websocket_node));
-	if (!node)
-		return E_NO_MEM;
-
-	memcpy(&node->interface, interface, sizeof(node->interface));
+	interface->wsi = wsi;
 
 exit:
 	if (ret != S_OK) {
+		config->private_data = NULL;
+
 		if (interface) {
-			if (interface->protocols)
-				free(interface->protocols);
-			free(interface);
-			config->private_data = NULL;
+			shared.num_streams--;
+			interface_free(interface);
 		}
-	}
 
-	artik_release_api_module(utils);
+		if (!shared.num_streams)
+			shared_destroy();
+	}
 
 	return ret;
 }
 
 artik_error os_websocket_write_stream(artik_websocket_config *config,
-	char *message, int len)
+	const char *message, int len, bool binary)
 {
 	artik_error ret = S_OK;
-	char *websocket_buf = NULL;
+	os_websocket_container *container;
+	os_websocket_frame *frame = NULL;
 
 	log_dbg("");
 
-	websocket_node *node = (websocket_node *)artik_list_get_by_handle(
-		requested_node, (ARTIK_LIST_HANDLE)
-		ARTIK_WEBSOCKET_INTERFACE->wsi);
-
-	if (!node) {
+	if (!config->private_data) {
 		log_err("Could not find websocket instance");
 		ret = E_WEBSOCKET_ERROR;
 		goto exit;
 	}
 
-	if (node->interface.error_connect) {
+	if (ARTIK_WEBSOCKET_INTERFACE->error_connect) {
 		log_err("Impossible to write, no connection");
 		ret = E_WEBSOCKET_ERROR;
 		goto exit;
 	}
 
-	websocket_buf = malloc(LWS_SEND_BUFFER_PRE_PADDING + len +
-		LWS_SEND_BUFFER_POST_PADDING);
-	if (websocket_buf == NULL) {
+	container = &ARTIK_WEBSOCKET_INTERFACE->container;
+
+	/* A message larger than the watermark still goes on an empty queue */
+	if (container->send_high_watermark && container->send_head &&
+		container->send_stats.pending_bytes + (unsigned int)len >
+		container->send_high_watermark) {
+		log_dbg("Send queue is full (%u bytes pending)",
+			container->send_stats.pending_bytes);
+		container->send_stats.rejected_messages++;
+		ret = E_BUSY;
+		goto exit;
+	}
+
+	frame = malloc(sizeof(os_websocket_frame) + LWS_PRE + len);
+	if (frame == NULL) {
 		log_err("Failed to allocate memory");
 		ret = E_NO_MEM;
 		goto exit;
 	}
 
-	memcpy(websocket_buf + LWS_SEND_BUFFER_PRE_PADDING, message, len);
-	ARTIK_WEBSOCKET_INTERFACE->container.send_message = websocket_buf +
-		LWS_SEND_BUFFER_PRE_PADDING;
-	ARTIK_WEBSOCKET_INTERFACE->container.send_message_len = len;
+	frame->next = NULL;
+	frame->type = binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT;
+	frame->len = len;
+	memcpy(frame->buf + LWS_PRE, message, len);
+
+	if (container->send_tail)
+		container->send_tail->next = frame;
+	else
+		container->send_head = frame;
+	container->send_tail = frame;
+
+	container->send_stats.pending_messages++;
+	container->send_stats.pending_bytes += len;
+	container->send_stats.peak_messages = MAX(
+		container->send_stats.peak_messages,
+		container->send_stats.pending_messages);
+	container->send_stats.peak_bytes = MAX(
+		container->send_stats.peak_bytes,
+		container->send_stats.pending_bytes);
+
 	lws_callback_on_writable(ARTIK_WEBSOCKET_INTERFACE->wsi);
 
 exit:
 	return ret;
 }
 
-int os_websocket_close_callback(int fd, enum watch_io io, void *user_data)
-{
-	uint64_t n = 0;
-	os_websocket_data *data = (os_websocket_data *)user_data;
-
-	log_dbg("");
-
-	if (read(fd, &n, sizeof(uint64_t)) < 0) {
-		log_err("close callback error");
-		return 0;
-	}
-
-	data[FD_CLOSE].callback(data->user_data, (void *)
-		ARTIK_WEBSOCKET_CLOSED);
-
-	return 1;
-}
-
-int os_websocket_connection_callback(int fd, enum watch_io io, void *user_data)
-{
-	uint64_t n = 0;
-	os_websocket_data *data = (os_websocket_data *)user_data;
-
-	log_dbg("");
-
-	if (read(fd, &n, sizeof(uint64_t)) < 0) {
-		log_err("connection callback error");
-		return 0;
-	}
-
-	data[FD_CONNECT].callback(data->user_data, (void *)
-		ARTIK_WEBSOCKET_CONNECTED);
-
-	return 1;
-}
-
-int os_websocket_error_callback(int fd, enum watch_io io, void *user_data)
-{
-	uint64_t n = 0;
-	os_websocket_data *data = (os_websocket_data *)user_data;
-
-	log_dbg("");
-
-	if (read(fd, &n, sizeof(uint64_t)) < 0) {
-		log_err("error callback error");
-		return 0;
-	}
-
-	data[FD_ERROR].callback(data->user_data, (void *)
-		ARTIK_WEBSOCKET_HANDSHAKE_ERROR);
-
-	return 1;
-}
-
-int os_websocket_connection_error_callback(int fd, enum watch_io io,
-	void *user_data)
+artik_error os_websocket_get_queue_stats(artik_websocket_config *config,
+	artik_websocket_queue_stats *stats)
 {
-	uint64_t n = 0;
-	os_websocket_data *data = (os_websocket_data *)user_data;
-
 	log_dbg("");
 
-	if (read(fd, &n, sizeof(uint64_t)) < 0) {
-		log_err("connection error callback error");
-		return 0;
-	}
+	if (config->private_data == NULL)
+		return E_NOT_CONNECTED;
 
-	data[FD_CONNECTION_ERROR].callback(data->user_data, (void *)
-		ARTIK_WEBSOCKET_CONNECTION_ERROR);
+	memcpy(stats, &ARTIK_WEBSOCKET_INTERFACE->container.send_stats,
+		sizeof(*stats));
 
-	return 1;
+	return S_OK;
 }
 
 artik_error os_websocket_set_connection_callback(artik_websocket_config *config,
 	artik_websocket_callback callback, void *user_data)
 {
-	artik_error ret = S_OK;
-	os_websocket_fds *fds = ARTIK_WEBSOCKET_INTERFACE->container.fds;
-	artik_loop_module *loop = (artik_loop_module *)
-								artik_request_api_module("loop");
-	os_websocket_data *data = ((os_websocket_interface *)
-								config->private_data)->data;
+	os_websocket_interface *interface = ARTIK_WEBSOCKET_INTERFACE;
+	os_websocket_data *data = interface->data;
 
 	log_dbg("");
 
-	if (data[FD_CLOSE].callback)
-		loop->remove_fd_watch(data[FD_CLOSE].watch_id);
-
-	if (data[FD_CONNECT].callback)
-		loop->remove_fd_watch(data[FD_CONNECT].watch_id);
-
-	if (data[FD_ERROR].callback)
-		loop->remove_fd_watch(data[FD_ERROR].watch_id);
-
-	data[FD_CLOSE].callback = callback;
-	data[FD_CLOSE].user_data = user_data;
-	data[FD_CONNECT].callback = callback;
-	data[FD_CONNECT].user_data = user_data;
-	data[FD_ERROR].callback = callback;
-	data[FD_ERROR].user_data = user_data;
-	data[FD_CONNECTION_ERROR].callback = callback;
-	data[FD_CONNECTION_ERROR].user_data = user_data;
-
-	if (!callback)
-		return S_OK;
-
-	ret = loop->add_fd_watch(fds->fdset[FD_CLOSE], WATCH_IO_IN,
-		os_websocket_close_callback, (void *)data,
-		&data[FD_CLOSE].watch_id);
+	data[EVENT_CLOSE].callback = callback;
+	data[EVENT_CLOSE].user_data = user_data;
+	data[EVENT_CONNECT].callback = callback;
+	data[EVENT_CONNECT].user_data = user_data;
+	data[EVENT_ERROR].callback = callback;
+	data[EVENT_ERROR].user_data = user_data;
+	data[EVENT_CONNECTION_ERROR].callback = callback;
+	data[EVENT_CONNECTION_ERROR].user_data = user_data;
 
-	if (ret != S_OK) {
-		log_err("Failed to set fd watch close callback");
-		goto exit;
-	}
-
-	ret = loop->add_fd_watch(fds->fdset[FD_CONNECT], WATCH_IO_IN,
-		os_websocket_connection_callback, (void *)data,
-		&data[FD_CONNECT].watch_id);
-
-	if (ret != S_OK) {
-		log_err("Failed to set fd watch connection callback");
-		goto exit;
-	}
-
-	ret = loop->add_fd_watch(fds->fdset[FD_ERROR], WATCH_IO_IN,
-		os_websocket_error_callback, (void *)data,
-		&data[FD_ERROR].watch_id);
-
-	if (ret != S_OK) {
-		log_err("Failed to set fd watch error callback");
-		goto exit;
-	}
-
-	ret = loop->add_fd_watch(fds->fdset[FD_CONNECTION_ERROR], WATCH_IO_IN,
-		os_websocket_connection_error_callback, (void *)data,
-		&data[FD_CONNECTION_ERROR].watch_id);
-
-	if (ret != S_OK) {
-		log_err("Failed to set fd watch connnection error callback");
-		goto exit;
-	}
+	/* Deliver the events which occurred before the callback was set */
+	if (callback && (interface->events & ~EVENT_BIT(EVENT_RECEIVE)))
+		event_queue(interface);
 
-exit:
-	artik_release_api_module(loop);
-	return ret;
+	return S_OK;
 }
 
 static int ping_periodic_callback(void *user_data)
@@ -1146,11 +1656,14 @@ static int ping_periodic_callback(void *user_data)
 		0x4D, 0x51, 0x58
 	};
 	static unsigned int size = sizeof(pingbuf);
-	artik_loop_module *loop = (artik_loop_module *)
-		artik_request_api_module("loop");
-	struct lws *wsi = (struct lws *)user_data;
-	unsigned char *buf = (unsigned char *)malloc(LWS_PRE + size);
+	os_websocket_interface *interface = (os_websocket_interface *)
+		user_data;
+	unsigned char *buf;
 
+	if (interface->error_connect || interface->closing)
+		return 1;
+
+	buf = (unsigned char *)malloc(LWS_PRE + size);
 	if (!buf) {
 		log_err("Failed to allocate buffer");
 		return 0;
@@ -1161,93 +1674,64 @@ static int ping_periodic_callback(void *user_data)
 
 	log_dbg("");
 
-	lws_write(wsi, &buf[LWS_PRE], size, LWS_WRITE_PING);
+	lws_write(interface->wsi, &buf[LWS_PRE], size, LWS_WRITE_PING);
 	free(buf);
 
-	ret = loop->add_timeout_callback(&CB_CONTAINER->timeout_id,
-		CB_CONTAINER->pong_timeout, pong_timeout_callback, (void *) wsi);
+	shared.loop->set_stats_tag("websocket");
+	ret = shared.loop->add_timeout_callback(
+		&interface->container.timeout_id,
+		interface->container.pong_timeout, pong_timeout_callback,
+		user_data);
 
 	if (ret != S_OK) {
 		log_err("Failed to add on_timeout_callback error");
 		return 0;
 	}
 
-	artik_release_api_module(loop);
 	return 1;
 }
 
 static void pong_timeout_callback(void *user_data)
 {
-	uint64_t event_setter = FLAG_EVENT;
-
-	struct lws *wsi = (struct lws *)user_data;
+	os_websocket_interface *interface = (os_websocket_interface *)
+		user_data;
 
 	log_err("Failed to ping websocket server %s error", __func__);
 
-	if (write(CB_FDS[FD_CONNECTION_ERROR], &event_setter,
-		sizeof(event_setter)) < 0)
-		log_err("Failed write connection error event");
-
-	CB_CONTAINER->timeout_id = -1;
+	interface->container.timeout_id = -1;
+	notify(interface, EVENT_CONNECTION_ERROR);
 }
 
-int os_websocket_receive_callback(int fd, enum watch_io io, void *user_data)
+static artik_error set_receive_watch(artik_websocket_config *config,
+	artik_websocket_callback callback,
+	artik_websocket_message_callback message_callback, void *user_data)
 {
-	uint64_t n = 0;
-	artik_websocket_config *config = (artik_websocket_config *)user_data;
-	os_websocket_data *data = ((os_websocket_interface *)
-		config->private_data)->data;
+	os_websocket_interface *interface = ARTIK_WEBSOCKET_INTERFACE;
+	os_websocket_data *data = &interface->data[EVENT_RECEIVE];
 
 	log_dbg("");
 
-	if (read(fd, &n, sizeof(uint64_t)) < 0) {
-		log_err("receive callback error");
-		return 0;
-	}
-
-	if (ARTIK_WEBSOCKET_INTERFACE->container.receive_message == NULL) {
-		log_err("Websocket: receive message failed");
-		return 0;
-	}
+	data->callback = callback;
+	data->message_callback = message_callback;
+	data->user_data = user_data;
 
-	data[FD_RECEIVE].callback(data[FD_RECEIVE].user_data, (void *)
-		ARTIK_WEBSOCKET_INTERFACE->container.receive_message);
+	/* Deliver the messages received before the callback was set */
+	if ((callback || message_callback) && interface->container.receive_count)
+		notify(interface, EVENT_RECEIVE);
 
-	return 1;
+	return S_OK;
 }
 
 artik_error os_websocket_set_receive_callback(artik_websocket_config *config,
 	artik_websocket_callback callback, void *user_data)
 {
-	artik_error ret = S_OK;
-	os_websocket_fds *fds = ARTIK_WEBSOCKET_INTERFACE->container.fds;
-	os_websocket_data *data = ((os_websocket_interface *)
-		config->private_data)->data;
-	artik_loop_module *loop = (artik_loop_module *)
-		artik_request_api_module("loop");
-
-	log_dbg("");
-
-	if (data[FD_RECEIVE].callback)
-		loop->remove_fd_watch(data[FD_RECEIVE].watch_id);
-
-	data[FD_RECEIVE].callback = callback;
-	data[FD_RECEIVE].user_data = user_data;
-
-	if (!callback)
-		return S_OK;
-
-	ret = loop->add_fd_watch(fds->fdset[FD_RECEIVE], WATCH_IO_IN,
-		os_websocket_receive_callback, (void *)config,
-		&data[FD_RECEIVE].watch_id);
-	if (ret != S_OK) {
-		log_err("Failed to set fd watch close callback");
-		goto exit;
-	}
+	return set_receive_watch(config, callback, NULL, user_data);
+}
 
-exit:
-	artik_release_api_module(loop);
-	return ret;
+artik_error os_websocket_set_message_callback(artik_websocket_config *config,
+	artik_websocket_message_callback callback, void *user_data)
+{
+	return set_receive_watch(config, NULL, callback, user_data);
 }
 
 artik_error os_websocket_close_stream(artik_websocket_config *config)
@@ -1258,8 +1742,6 @@ artik_error os_websocket_close_stream(artik_websocket_config *config)
 	if (config->private_data == NULL)
 		return E_NOT_CONNECTED;
 
-	if (config->ssl_config.se_config)
-		release_openssl_engine();
-	lws_cleanup(config);
+	os_websocket_cleanup(config);
 	return ret;
 }
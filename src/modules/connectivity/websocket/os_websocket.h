@@ -24,11 +24,15 @@
 artik_error os_websocket_open_stream(artik_websocket_config * config,
 			char *host, char *path, int port, bool use_tls);
 artik_error os_websocket_write_stream(artik_websocket_config *config,
-					char *message, int len);
+					const char *message, int len, bool binary);
 artik_error os_websocket_set_connection_callback(artik_websocket_config *config,
 			artik_websocket_callback callback, void *user_data);
 artik_error os_websocket_set_receive_callback(artik_websocket_config *config,
 			artik_websocket_callback callback, void *user_data);
+artik_error os_websocket_set_message_callback(artik_websocket_config *config,
+			artik_websocket_message_callback callback, void *user_data);
 artik_error os_websocket_close_stream(artik_websocket_config *config);
+artik_error os_websocket_get_queue_stats(artik_websocket_config *config,
+			artik_websocket_queue_stats *stats);
 
 #endif	/* OS_WEBSOCKET_H_ */
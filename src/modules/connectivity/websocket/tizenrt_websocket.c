@@ -37,6 +37,7 @@
 struct websocket_priv {
 	websocket_t *cli;
 	artik_websocket_callback rx_cb;
+	artik_websocket_message_callback rx_msg_cb;
 	void *rx_user_data;
 	artik_websocket_callback conn_cb;
 	void *conn_user_data;
@@ -219,7 +220,18 @@ void websocket_print_on_msg_cb(websocket_context_ptr ctx,
 		return;
 
 	if (WEBSOCKET_CHECK_NOT_CTRL_FRAME(arg->opcode)) {
-		if (priv->rx_cb) {
+		if (priv->rx_msg_cb) {
+			artik_websocket_message msg;
+
+			msg.data = malloc(arg->msg_length + 1);
+			if (msg.data) {
+				memcpy(msg.data, arg->msg, arg->msg_length);
+				msg.data[arg->msg_length] = '\0';
+				msg.len = arg->msg_length;
+				msg.binary = arg->opcode == WEBSOCKET_BINARY_FRAME;
+				priv->rx_msg_cb(priv->rx_user_data, &msg);
+			}
+		} else if (priv->rx_cb) {
 			char *msg = strndup((const char *)arg->msg,
 							arg->msg_length);
 			if (msg)
@@ -503,7 +515,7 @@ error:
 }
 
 artik_error os_websocket_write_stream(artik_websocket_config *config,
-							char *message, int len)
+					const char *message, int len, bool binary)
 {
 	struct websocket_priv *priv = (struct websocket_priv *)
 							config->private_data;
@@ -515,7 +527,7 @@ artik_error os_websocket_write_stream(artik_websocket_config *config,
 	if (!priv)
 		return E_NOT_INITIALIZED;
 
-	frame.opcode = WEBSOCKET_TEXT_FRAME;
+	frame.opcode = binary ? WEBSOCKET_BINARY_FRAME : WEBSOCKET_TEXT_FRAME;
 	frame.msg = (const uint8_t *)message;
 	frame.msg_length = len;
 
@@ -562,6 +574,25 @@ artik_error os_websocket_set_receive_callback(artik_websocket_config *config,
 		return E_NOT_INITIALIZED;
 
 	priv->rx_cb = callback;
+	priv->rx_msg_cb = NULL;
+	priv->rx_user_data = user_data;
+
+	return S_OK;
+}
+
+artik_error os_websocket_set_message_callback(artik_websocket_config *config,
+		artik_websocket_message_callback callback, void *user_data)
+{
+	struct websocket_priv *priv = (struct websocket_priv *)
+							config->private_data;
+
+	log_dbg("");
+
+	if (!priv)
+		return E_NOT_INITIALIZED;
+
+	priv->rx_cb = NULL;
+	priv->rx_msg_cb = callback;
 	priv->rx_user_data = user_data;
 
 	return S_OK;
@@ -584,3 +615,9 @@ artik_error os_websocket_close_stream(artik_websocket_config *config)
 
 	return S_OK;
 }
+
+artik_error os_websocket_get_queue_stats(artik_websocket_config *config,
+			artik_websocket_queue_stats *stats)
+{
+	return E_NOT_SUPPORTED;
+}
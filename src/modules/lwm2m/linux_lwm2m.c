@@ -22,9 +22,6 @@
 #include <artik_log.h>
 #include <artik_utils.h>
 
-#include <openssl/ssl.h>
-#include <openssl/engine.h>
-
 #include <artik_lwm2m.h>
 #include <artik_list.h>
 #include "os_lwm2m.h"
@@ -39,6 +36,7 @@ typedef struct {
 	void *callbacks_params[ARTIK_LWM2M_EVENT_COUNT];
 	int service_cbk_id;
 	artik_loop_module *loop_module;
+	artik_ssl_credentials_handle ssl_creds;
 	bool connected;
 } lwm2m_node;
 
@@ -46,7 +44,6 @@ typedef struct {
 	lwm2m_node *node;
 	artik_lwm2m_event_t event;
 	void *extra;
-	int id;
 } lwm2m_idle_params;
 
 static artik_list *nodes = NULL;
@@ -98,7 +95,7 @@ static int on_lwm2m_service_callback(void *user_data)
 	return 1;
 }
 
-static int on_idle_callback(void *user_data)
+static void on_posted_event(void *user_data)
 {
 	lwm2m_idle_params *params = (lwm2m_idle_params *)user_data;
 
@@ -107,11 +104,8 @@ static int on_idle_callback(void *user_data)
 			params->node->callbacks[params->event](params->extra,
 					params->node->callbacks_params[
 							params->event]);
-		params->node->loop_module->remove_idle_callback(params->id);
 		free(params);
 	}
-
-	return 0;
 }
 
 static void on_exec_factory_reset(void *user_data, void *extra)
@@ -136,8 +130,8 @@ static void on_exec_factory_reset(void *user_data, void *extra)
 				strlen(LWM2M_URI_DEVICE_FACTORY_RESET));
 		params->extra = (void *)res;
 		params->event = ARTIK_LWM2M_EVENT_RESOURCE_EXECUTE;
-		node->loop_module->add_idle_callback(&params->id,
-					on_idle_callback, (void *)params);
+		node->loop_module->post_callback(ARTIK_LOOP_AFFINITY_MAIN,
+					on_posted_event, (void *)params);
 		free(extra);
 	}
 }
@@ -164,8 +158,8 @@ static void on_exec_device_reboot(void *user_data, void *extra)
 				strlen(LWM2M_URI_DEVICE_REBOOT));
 		params->extra = (void *)res;
 		params->event = ARTIK_LWM2M_EVENT_RESOURCE_EXECUTE;
-		node->loop_module->add_idle_callback(&params->id,
-					on_idle_callback, (void *)params);
+		node->loop_module->post_callback(ARTIK_LOOP_AFFINITY_MAIN,
+					on_posted_event, (void *)params);
 	}
 }
 
@@ -191,8 +185,8 @@ static void on_exec_firmware_update(void *user_data, void *extra)
 				strlen(LWM2M_URI_FIRMWARE_UPDATE));
 		params->extra = (void *)res;
 		params->event = ARTIK_LWM2M_EVENT_RESOURCE_EXECUTE;
-		node->loop_module->add_idle_callback(&params->id,
-					on_idle_callback, (void *)params);
+		node->loop_module->post_callback(ARTIK_LOOP_AFFINITY_MAIN,
+					on_posted_event, (void *)params);
 	}
 }
 
@@ -225,8 +219,8 @@ static void on_resource_changed(void *user_data, void *extra)
 			resource->length = res->length;
 		}
 
-		node->loop_module->add_idle_callback(&params->id,
-					on_idle_callback, (void *)params);
+		node->loop_module->post_callback(ARTIK_LOOP_AFFINITY_MAIN,
+					on_posted_event, (void *)params);
 	}
 }
 
@@ -256,139 +250,70 @@ static bool check_lwm2m_uri(const char *uri)
 	return ret;
 }
 
-static char *create_key_uri(artik_secure_element_config *se_config)
-{
-	const char *prefix;
-	char *engine_key_uri;
-
-	switch (se_config->key_algo) {
-	case RSA_1024:
-		prefix = "rsa1024://";
-		break;
-	case RSA_2048:
-		prefix = "rsa2048://";
-		break;
-	case ECC_BRAINPOOL_P256R1:
-		prefix = "bp256://";
-		break;
-	case ECC_SEC_P256R1:
-		prefix = "ec256://";
-		break;
-	case ECC_SEC_P384R1:
-		prefix = "ec384://";
-		break;
-	case ECC_SEC_P521R1:
-		prefix = "ec521://";
-		break;
-	default:
-		log_dbg("algo %d not supported", se_config->key_algo);
-		return NULL;
-	}
-
-	engine_key_uri = malloc(strlen(prefix) + strlen(se_config->key_id) + 1);
-	if (!engine_key_uri)
-		return NULL;
-
-	strcpy(engine_key_uri, prefix);
-	strcat(engine_key_uri, se_config->key_id);
-
-	return engine_key_uri;
-}
-
 static bool ssl_context_callback(void *ssl_ctx, void *user_data)
 {
-	X509 *cert = NULL;
-	BIO *b64 = NULL;
-	EVP_PKEY *pkey = NULL;
 	artik_security_module *security = NULL;
-	artik_ssl_config *ssl = user_data;
-	SSL_CTX *ctx = (SSL_CTX *)ssl_ctx;
-	bool ret = false;
-	char *uri = NULL;
+	artik_ssl_credentials_handle creds = user_data;
+	bool ret;
 
 	security = (artik_security_module *)
 		artik_request_api_module("security");
 	if (!security) {
 		log_dbg("Failed to request security module.");
-		goto exit;
+		return false;
 	}
 
-	if (security->load_openssl_engine() != S_OK) {
-		log_dbg("Failed to load openssl engine");
-		goto exit;
-	}
+	ret = security->apply_ssl_credentials(creds, ssl_ctx) == S_OK;
+	if (!ret)
+		log_dbg("Failed to set client certificate and key");
 
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-	ENGINE *engine = ENGINE_get_default_ECDSA();
-#else
-	ENGINE *engine = ENGINE_get_default_EC();
-#endif
+	artik_release_api_module(security);
 
-	if (!engine) {
-		log_dbg("Failed to get default engine");
-		goto exit;
-	}
-
-	uri = create_key_uri(ssl->se_config);
-	if (!uri) {
-		log_dbg("Failed to create key uri");
-		goto exit;
-	}
+	return ret;
+}
 
-	pkey = ENGINE_load_private_key(engine,
-								   uri, NULL, NULL);
-			free(uri);
-	if (!pkey) {
-		log_dbg("Failed to load private key from artiksee");
-		goto exit;
-	}
+/*
+ * Only the client certificate and the SE key are installed from the
+ * callback, the server certificate is handled by the LWM2M client.
+ */
+static artik_error get_ssl_credentials(artik_ssl_config *ssl,
+		artik_ssl_credentials_handle *creds)
+{
+	artik_security_module *security = NULL;
+	artik_ssl_config client;
+	artik_error ret;
 
-	b64 = BIO_new(BIO_s_mem());
-	if (!b64) {
-		log_dbg("Failed to allocate memory");
-		goto exit;
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security) {
+		log_dbg("Failed to request security module.");
+		return E_NOT_SUPPORTED;
 	}
 
-	BIO_write(b64, ssl->client_cert.data, ssl->client_cert.len);
+	memset(&client, 0, sizeof(client));
+	client.se_config = ssl->se_config;
+	client.client_cert = ssl->client_cert;
+	client.verify_cert = ssl->verify_cert;
 
-	cert = PEM_read_bio_X509(b64, NULL, NULL, NULL);
-	if (!cert) {
-		log_dbg("Failed to parse client certificate");
-		goto exit;
+	ret = security->get_ssl_credentials(&client, creds);
 
-	}
+	artik_release_api_module(security);
 
-	if (!SSL_CTX_use_certificate(ctx, cert)) {
-		log_dbg("Failed to set client certificate");
-		goto exit;
-	}
+	return ret;
+}
 
-	if (!SSL_CTX_use_PrivateKey(ctx, pkey)) {
-		log_dbg("Failed to set client private key");
-		goto exit;
-	}
+static void put_ssl_credentials(artik_ssl_credentials_handle creds)
+{
+	artik_security_module *security = (artik_security_module *)
+		artik_request_api_module("security");
 
-	if (!SSL_CTX_check_private_key(ctx)) {
-		log_dbg("Failed to check private key");
-		goto exit;
+	if (!security) {
+		log_dbg("Failed to request security module.");
+		return;
 	}
 
-	ret = true;
-
-exit:
-	if (security)
-		artik_release_api_module(security);
-
-	if (pkey)
-		EVP_PKEY_free(pkey);
-
-	if (!cert)
-		X509_free(cert);
-
-	if (b64)
-		BIO_free(b64);
-
-	return ret;
+	security->put_ssl_credentials(creds);
+	artik_release_api_module(security);
 }
 
 artik_error os_lwm2m_client_request(artik_lwm2m_handle *handle,
@@ -535,16 +460,23 @@ artik_error os_lwm2m_client_request(artik_lwm2m_handle *handle,
 	node->container = objects;
 
 	/* Configure the client */
-	if (config->ssl_config && config->ssl_config->se_config)
+	if (config->ssl_config && config->ssl_config->se_config) {
+		ret = get_ssl_credentials(config->ssl_config, &node->ssl_creds);
+		if (ret != S_OK) {
+			log_dbg("Failed to load SSL credentials");
+			goto exit;
+		}
+
 		node->client = lwm2m_client_start(node->container,
 				node->container->server->serverCertificate,
-				ssl_context_callback, config->ssl_config);
-	else
+				ssl_context_callback, node->ssl_creds);
+	} else
 		node->client = lwm2m_client_start(node->container,
 				node->container->server->serverCertificate, NULL, NULL);
 	if (!node->client) {
 		log_dbg("lwm2m_client error");
-		return E_BAD_ARGS;
+		ret = E_BAD_ARGS;
+		goto exit;
 	}
 
 	*handle = (artik_lwm2m_handle)node;
@@ -552,6 +484,10 @@ artik_error os_lwm2m_client_request(artik_lwm2m_handle *handle,
 	return S_OK;
 
 exit:
+	if (node->ssl_creds)
+		put_ssl_credentials(node->ssl_creds);
+
+	artik_release_api_module(node->loop_module);
 	artik_list_delete_node(&nodes, (artik_list *)node);
 	if (server) {
 		if (server->serverCertificate)
@@ -618,6 +554,9 @@ artik_error os_lwm2m_client_release(artik_lwm2m_handle handle)
 		free(node->container);
 	}
 
+	if (node->ssl_creds)
+		put_ssl_credentials(node->ssl_creds);
+
 	artik_release_api_module(node->loop_module);
 	artik_list_delete_node(&nodes, (artik_list *)node);
 	return S_OK;
@@ -49,6 +49,28 @@ static artik_error disconnect(artik_mqtt_handle client);
 static artik_error publish(artik_mqtt_handle client, int qos, bool retain,
 			   const char *msg_topic, int payload_len,
 			   const char *msg_content);
+static artik_error get_stats(artik_mqtt_handle client,
+			   artik_mqtt_stats *stats);
+static artik_error enable_offline_queue(artik_mqtt_handle client,
+			   const artik_mqtt_queue_config *config);
+static artik_error disable_offline_queue(artik_mqtt_handle client);
+static artik_error get_offline_queue_stats(artik_mqtt_handle client,
+			   artik_mqtt_queue_stats *stats);
+static artik_error add_subscription(artik_mqtt_handle client, int qos,
+			   const char *filter, message_callback cb,
+			   void *user_data,
+			   artik_mqtt_subscription *subscription);
+static artik_error remove_subscription(artik_mqtt_handle client,
+			   artik_mqtt_subscription subscription);
+static artik_error create_batch(artik_mqtt_handle client, const char *topic,
+			   const artik_mqtt_batch_config *config,
+			   artik_mqtt_batch *batch);
+static artik_error batch_publish(artik_mqtt_batch batch, int payload_len,
+			   const char *payload);
+static artik_error flush_batch(artik_mqtt_batch batch);
+static artik_error destroy_batch(artik_mqtt_batch batch);
+static artik_error get_batch_stats(artik_mqtt_batch batch,
+			   artik_mqtt_batch_stats *stats);
 
 const artik_mqtt_module mqtt_module = {
 		create_client,
@@ -66,7 +88,18 @@ const artik_mqtt_module mqtt_module = {
 		disconnect,
 		subscribe,
 		unsubscribe,
-		publish
+		publish,
+		get_stats,
+		enable_offline_queue,
+		disable_offline_queue,
+		get_offline_queue_stats,
+		add_subscription,
+		remove_subscription,
+		create_batch,
+		batch_publish,
+		flush_batch,
+		destroy_batch,
+		get_batch_stats
 };
 
 static artik_error create_client(artik_mqtt_handle *client,
@@ -161,3 +194,67 @@ static artik_error publish(artik_mqtt_handle client, int qos, bool retain,
 	return os_mqtt_publish(client, qos, retain, msg_topic, payload_len,
 			msg_content);
 }
+
+static artik_error get_stats(artik_mqtt_handle client, artik_mqtt_stats *stats)
+{
+	return os_mqtt_get_stats(client, stats);
+}
+
+static artik_error enable_offline_queue(artik_mqtt_handle client,
+		const artik_mqtt_queue_config *config)
+{
+	return os_mqtt_enable_offline_queue(client, config);
+}
+
+static artik_error disable_offline_queue(artik_mqtt_handle client)
+{
+	return os_mqtt_disable_offline_queue(client);
+}
+
+static artik_error get_offline_queue_stats(artik_mqtt_handle client,
+		artik_mqtt_queue_stats *stats)
+{
+	return os_mqtt_get_offline_queue_stats(client, stats);
+}
+
+static artik_error add_subscription(artik_mqtt_handle client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription)
+{
+	return os_mqtt_add_subscription(client, qos, filter, cb, user_data,
+			subscription);
+}
+
+static artik_error remove_subscription(artik_mqtt_handle client,
+		artik_mqtt_subscription subscription)
+{
+	return os_mqtt_remove_subscription(client, subscription);
+}
+
+static artik_error create_batch(artik_mqtt_handle client, const char *topic,
+		const artik_mqtt_batch_config *config, artik_mqtt_batch *batch)
+{
+	return os_mqtt_create_batch(client, topic, config, batch);
+}
+
+static artik_error batch_publish(artik_mqtt_batch batch, int payload_len,
+		const char *payload)
+{
+	return os_mqtt_batch_publish(batch, payload_len, payload);
+}
+
+static artik_error flush_batch(artik_mqtt_batch batch)
+{
+	return os_mqtt_flush_batch(batch);
+}
+
+static artik_error destroy_batch(artik_mqtt_batch batch)
+{
+	return os_mqtt_destroy_batch(batch);
+}
+
+static artik_error get_batch_stats(artik_mqtt_batch batch,
+		artik_mqtt_batch_stats *stats)
+{
+	return os_mqtt_get_batch_stats(batch, stats);
+}
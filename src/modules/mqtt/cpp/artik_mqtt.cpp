@@ -106,3 +106,55 @@ artik_error artik::Mqtt::publish(int qos, bool retain, const char *msg_topic,
   return m_module->publish(m_client, qos, retain, msg_topic, payload_len,
       msg_content);
 }
+
+artik_error artik::Mqtt::get_stats(artik_mqtt_stats *stats) {
+  return m_module->get_stats(m_client, stats);
+}
+
+artik_error artik::Mqtt::enable_offline_queue(
+    artik_mqtt_queue_config const &config) {
+  return m_module->enable_offline_queue(m_client, &config);
+}
+
+artik_error artik::Mqtt::disable_offline_queue(void) {
+  return m_module->disable_offline_queue(m_client);
+}
+
+artik_error artik::Mqtt::get_offline_queue_stats(
+    artik_mqtt_queue_stats *stats) {
+  return m_module->get_offline_queue_stats(m_client, stats);
+}
+
+artik_error artik::Mqtt::add_subscription(int qos, const char *filter,
+    message_callback cb, void *data, artik_mqtt_subscription *subscription) {
+  return m_module->add_subscription(m_client, qos, filter, cb, data,
+      subscription);
+}
+
+artik_error artik::Mqtt::remove_subscription(
+    artik_mqtt_subscription subscription) {
+  return m_module->remove_subscription(m_client, subscription);
+}
+
+artik_error artik::Mqtt::create_batch(const char *topic,
+    artik_mqtt_batch_config const &config, artik_mqtt_batch *batch) {
+  return m_module->create_batch(m_client, topic, &config, batch);
+}
+
+artik_error artik::Mqtt::batch_publish(artik_mqtt_batch batch,
+    int payload_len, const char *payload) {
+  return m_module->batch_publish(batch, payload_len, payload);
+}
+
+artik_error artik::Mqtt::flush_batch(artik_mqtt_batch batch) {
+  return m_module->flush_batch(batch);
+}
+
+artik_error artik::Mqtt::destroy_batch(artik_mqtt_batch batch) {
+  return m_module->destroy_batch(batch);
+}
+
+artik_error artik::Mqtt::get_batch_stats(artik_mqtt_batch batch,
+    artik_mqtt_batch_stats *stats) {
+  return m_module->get_batch_stats(batch, stats);
+}
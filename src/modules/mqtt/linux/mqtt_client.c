@@ -21,16 +21,44 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <mosquitto.h>
 #include <artik_log.h>
 #include <artik_loop.h>
 #include <artik_module.h>
 #include "../mqtt_client.h"
+#include "mqtt_queue.h"
+#include "mqtt_topic_tree.h"
+#include "mqtt_tls.h"
 
-#define TLS_CA_FILENAME     "/tmp/mqtt-ca.cert"
-#define TLS_CERT_FILENAME   "/tmp/mqtt-client.cert"
-#define TLS_KEY_FILENAME    "/tmp/mqtt-client.key"
+/*
+ * Starting with libmosquitto 1.5, the SSL_CTX can be provided by the
+ * application. Older versions only load credentials from files, which
+ * are then created in memory and only reachable through their fd.
+ */
+#if LIBMOSQUITTO_VERSION_NUMBER >= 1005000
+#define MQTT_TLS_SHARED_CTX
+#include <openssl/ssl.h>
+#else
+#define TLS_MEMORY_FILE_TEMPLATE	"/dev/shm/artik-mqtt-XXXXXX"
+#define TLS_MEMORY_FILE_PATH_LEN	32
+#endif
+
+/* Period of the timer replaying the offline queue, in ms */
+#define MQTT_QUEUE_REPLAY_PERIOD	100
+
+/* Replay credit needed to send a message, in thousandths of a message */
+#define MQTT_QUEUE_REPLAY_UNIT		1000
+
+/* Size of the length prefixing each message in a batch buffer */
+#define MQTT_BATCH_PREFIX		4
+
+typedef struct mqtt_batch mqtt_batch;
 
 static const char *libname = "libmosquitto";
 
@@ -42,7 +70,21 @@ typedef struct {
 	int version;
 	void *mosq;
 	int watch_id;
+	int write_watch_id;
 	int periodic_id;
+	int replay_id;
+	unsigned long replay_credit;
+	bool connected;
+	mqtt_queue *queue;
+	mqtt_topic_tree *topics;
+	mqtt_batch *batches;
+#ifdef MQTT_TLS_SHARED_CTX
+	artik_ssl_credentials_handle tls_creds;
+	mqtt_tls_ctx *tls_ctx;
+#else
+	int tls_fds[3];
+#endif
+	artik_mqtt_stats stats;
 
 	void *data_cb_connect;
 	void *data_cb_disconnect;
@@ -59,7 +101,122 @@ typedef struct {
 	message_callback on_message;
 } mqtt_handle_client;
 
+struct mqtt_batch {
+	artik_list node;
+	mqtt_batch *next;
+	mqtt_handle_client *client;
+	char *topic;
+	artik_mqtt_batch_config config;
+	unsigned char *buf;
+	size_t len;
+	size_t size;
+	unsigned int count;
+	unsigned int payload_bytes;
+	int timeout_id;
+	artik_mqtt_batch_stats stats;
+};
+
 static artik_list *requested_node = NULL;
+static artik_list *requested_batches = NULL;
+
+static void loop_remove_watches(mqtt_handle_client *client)
+{
+	if (client->watch_id > 0) {
+		client->loop->remove_fd_watch(client->watch_id);
+		client->watch_id = 0;
+	}
+	if (client->write_watch_id > 0) {
+		client->loop->remove_fd_watch(client->write_watch_id);
+		client->write_watch_id = 0;
+	}
+}
+
+static void loop_update_write_watch(mqtt_handle_client *client);
+
+static void queue_stop_replay(mqtt_handle_client *client)
+{
+	if (client->replay_id > 0) {
+		client->loop->remove_periodic_callback(client->replay_id);
+		client->replay_id = 0;
+	}
+}
+
+static int replay_handler(void *handle_client)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	unsigned long rate;
+	mqtt_queue_msg msg;
+	int rc;
+
+	if (!client || !client->mosq || !client->queue)
+		return 0;
+
+	/*
+	 * Every period earns rate * period thousandths of a message and
+	 * the fraction left is carried to the next tick, so that rates
+	 * below one message per period are honored. The credit saved
+	 * while the connection stalls is capped to one message to avoid
+	 * a burst.
+	 */
+	rate = mqtt_queue_replay_rate(client->queue);
+	if (rate) {
+		if (client->replay_credit > MQTT_QUEUE_REPLAY_UNIT)
+			client->replay_credit = MQTT_QUEUE_REPLAY_UNIT;
+		client->replay_credit += rate * MQTT_QUEUE_REPLAY_PERIOD;
+	}
+
+	while ((!rate || client->replay_credit >= MQTT_QUEUE_REPLAY_UNIT) &&
+			mqtt_queue_peek(client->queue, &msg)) {
+		rc = mosquitto_publish(client->mosq, NULL, msg.topic,
+				msg.payload_len, msg.payload, msg.qos,
+				msg.retain);
+		if (rc == MOSQ_ERR_NO_CONN || rc == MOSQ_ERR_CONN_LOST)
+			break;
+
+		if (rate)
+			client->replay_credit -= MQTT_QUEUE_REPLAY_UNIT;
+
+		if (rc != MOSQ_ERR_SUCCESS) {
+			log_err("Dropping queued message on %s (err=%d)",
+					msg.topic, rc);
+			mqtt_queue_discard(client->queue);
+			continue;
+		}
+
+		mqtt_queue_pop(client->queue);
+	}
+
+	loop_update_write_watch(client);
+
+	if (!mqtt_queue_depth(client->queue)) {
+		client->replay_id = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+static void queue_start_replay(mqtt_handle_client *client)
+{
+	if (!client->queue || client->replay_id > 0 ||
+			!mqtt_queue_depth(client->queue))
+		return;
+
+	log_dbg("replaying %u queued messages",
+			mqtt_queue_depth(client->queue));
+
+	/* The first message goes out on the first tick */
+	client->replay_credit = MQTT_QUEUE_REPLAY_UNIT;
+
+	if (client->loop->add_periodic_callback(&client->replay_id,
+			MQTT_QUEUE_REPLAY_PERIOD, replay_handler,
+			client) != S_OK) {
+		log_err("Failed to schedule the replay of the offline queue");
+		client->replay_id = 0;
+	}
+}
 
 static void on_connect_callback(struct mosquitto *client, void *handle_client,
 				int result)
@@ -70,6 +227,11 @@ static void on_connect_callback(struct mosquitto *client, void *handle_client,
 
 	log_dbg("");
 
+	if (client_data && !result) {
+		client_data->connected = true;
+		queue_start_replay(client_data);
+	}
+
 	if (client_data && client_data->on_connect)
 		client_data->on_connect(client_data->config,
 			client_data->data_cb_connect,
@@ -85,6 +247,11 @@ static void on_disconnect_callback(struct mosquitto *client,
 
 	log_dbg("");
 
+	if (client_data) {
+		client_data->connected = false;
+		queue_stop_replay(client_data);
+	}
+
 	if (client_data && client_data->on_disconnect)
 		client_data->on_disconnect(client_data->config,
 				client_data->data_cb_disconnect,
@@ -137,32 +304,29 @@ static void on_publish_callback(struct mosquitto *client, void *handle_client,
 static void on_message_callback(struct mosquitto *client, void *handle_client,
 				const struct mosquitto_message *msg)
 {
-	mqtt_handle_client *client_data = (mqtt_handle_client *)
-		artik_list_get_by_handle(requested_node,
-			(ARTIK_LIST_HANDLE)handle_client);
-	artik_mqtt_msg *received_msg;
+	/* libmosquitto only calls back live clients, no lookup needed */
+	mqtt_handle_client *client_data = (mqtt_handle_client *)handle_client;
+	artik_mqtt_msg received_msg;
 
 	log_dbg("");
 
-	received_msg = (artik_mqtt_msg *) malloc(sizeof(artik_mqtt_msg));
-
-	if (!received_msg) {
-		log_err("received_msg is null!");
+	if (!client_data)
 		return;
-	}
 
-	received_msg->msg_id = msg->mid;
-	received_msg->topic = msg->topic;
-	received_msg->payload = msg->payload;
-	received_msg->payload_len = msg->payloadlen;
-	received_msg->qos = msg->qos;
-	received_msg->retain = msg->retain;
+	received_msg.msg_id = msg->mid;
+	received_msg.topic = msg->topic;
+	received_msg.payload = msg->payload;
+	received_msg.payload_len = msg->payloadlen;
+	received_msg.qos = msg->qos;
+	received_msg.retain = msg->retain;
 
-	if (client_data && client_data->on_message)
-		client_data->on_message(client_data->config,
-			client_data->data_cb_message, received_msg);
+	if (client_data->topics)
+		mqtt_topic_tree_dispatch(client_data->topics,
+			client_data->config, &received_msg);
 
-	free(received_msg);
+	if (client_data->on_message)
+		client_data->on_message(client_data->config,
+			client_data->data_cb_message, &received_msg);
 }
 
 static void my_log_callback(struct mosquitto *mosq, void *obj, int level,
@@ -171,96 +335,179 @@ static void my_log_callback(struct mosquitto *mosq, void *obj, int level,
 	log_dbg("%s\n", str);
 }
 
-static void tls_cleanup_temp_cert_files(void)
+#ifdef MQTT_TLS_SHARED_CTX
+static artik_error tls_setup(mqtt_handle_client *client,
+		const artik_ssl_config *config)
+{
+	/* Parsed once and shared by all the clients with the same config */
+	return mqtt_tls_get_credentials(config, &client->tls_creds);
+}
+
+static artik_error tls_set_ctx(mqtt_handle_client *client, const char *host)
 {
-	if (access(TLS_CA_FILENAME, F_OK) != -1)
-		if (remove(TLS_CA_FILENAME) < 0)
-			log_dbg("Failed to delete %s (err=%d)",
-					TLS_CA_FILENAME, errno);
+	mqtt_tls_ctx *ctx;
+	void *old_ssl_ctx = NULL;
+
+	ctx = mqtt_tls_ctx_get(client->tls_creds,
+			client->config->tls->verify_cert ==
+				ARTIK_SSL_VERIFY_REQUIRED, host);
+	if (!ctx)
+		return E_SECURITY_ERROR;
+
+	if (ctx == client->tls_ctx) {
+		mqtt_tls_ctx_put(ctx);
+		return S_OK;
+	}
 
-	if (access(TLS_CERT_FILENAME, F_OK) != -1)
-		if (remove(TLS_CERT_FILENAME) < 0)
-			log_dbg("Failed to delete %s (err=%d)",
-					TLS_CERT_FILENAME, errno);
+	if (mosquitto_opts_set(client->mosq, MOSQ_OPT_SSL_CTX,
+			mqtt_tls_ctx_ssl(ctx)) != MOSQ_ERR_SUCCESS) {
+		mqtt_tls_ctx_put(ctx);
+		return E_MQTT_ERROR;
+	}
+
+	/*
+	 * libmosquitto takes its own reference on the SSL_CTX, and never
+	 * releases the one it held on a replaced context.
+	 */
+	if (client->tls_ctx) {
+		old_ssl_ctx = mqtt_tls_ctx_ssl(client->tls_ctx);
+		SSL_CTX_free(old_ssl_ctx);
+		mqtt_tls_ctx_put(client->tls_ctx);
+	}
+	client->tls_ctx = ctx;
 
-	if (access(TLS_KEY_FILENAME, F_OK) != -1)
-		if (remove(TLS_KEY_FILENAME) < 0)
-			log_dbg("Failed to delete %s (err=%d)",
-					TLS_KEY_FILENAME, errno);
+	return S_OK;
 }
 
-static artik_error tls_write_temp_cert_files(struct mosquitto *mosq,
-		const artik_ssl_config *config)
+static void tls_cleanup(mqtt_handle_client *client)
 {
-	artik_error ret = S_OK;
-	char *ca_cert = NULL;
-	char *dev_cert = NULL;
-	char *dev_key = NULL;
-	int fd = 0;
-
-	if (config->ca_cert.data && config->ca_cert.len) {
-		ca_cert = TLS_CA_FILENAME;
-		fd = open(ca_cert, O_CREAT | O_WRONLY, 0600);
-		if (fd < 0) {
-			ret = E_ACCESS_DENIED;
-			goto exit;
-		}
+	if (client->tls_ctx) {
+		mqtt_tls_ctx_put(client->tls_ctx);
+		client->tls_ctx = NULL;
+	}
 
-		if (write(fd, config->ca_cert.data, config->ca_cert.len) < 0) {
-			close(fd);
-			ret = E_ACCESS_DENIED;
-			goto exit;
-		}
-		close(fd);
-	} else if (config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED) {
-		/* CA cert is mandatory when requesting verification */
-		ret = E_BAD_ARGS;
-		goto exit;
-	}
-
-	if (config->client_cert.data && config->client_cert.len) {
-		dev_cert = TLS_CERT_FILENAME;
-		fd = open(dev_cert, O_CREAT | O_WRONLY, 0600);
-		if (fd < 0) {
-			ret = E_ACCESS_DENIED;
-			goto exit;
-		}
+	if (client->tls_creds) {
+		mqtt_tls_put_credentials(client->tls_creds);
+		client->tls_creds = NULL;
+	}
+}
+#else
+/*
+ * Write data to an unlinked file on tmpfs and return the path under which
+ * it stays reachable as long as the fd is open.
+ */
+static int tls_memory_file(const char *data, unsigned int len, char *path)
+{
+	char name[] = TLS_MEMORY_FILE_TEMPLATE;
+	unsigned int written = 0;
+	int fd;
+
+	fd = mkstemp(name);
+	if (fd < 0)
+		return -1;
+	unlink(name);
 
-		if (write(fd, config->client_cert.data, config->client_cert.len) < 0) {
+	while (written < len) {
+		ssize_t n = write(fd, data + written, len - written);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
 			close(fd);
-			ret = E_ACCESS_DENIED;
-			goto exit;
+			return -1;
 		}
-		close(fd);
+		written += n;
 	}
 
-	if (config->client_key.data && config->client_key.len) {
-		dev_key = TLS_KEY_FILENAME;
-		fd = open(dev_key, O_CREAT | O_WRONLY, 0600);
-		if (fd < 0) {
-			ret = E_ACCESS_DENIED;
-			goto exit;
-		}
+	snprintf(path, TLS_MEMORY_FILE_PATH_LEN, "/proc/self/fd/%d", fd);
 
-		if (write(fd, config->client_key.data, config->client_key.len) < 0) {
-			close(fd);
-			ret = E_ACCESS_DENIED;
-			goto exit;
+	return fd;
+}
+
+static void tls_cleanup(mqtt_handle_client *client)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (client->tls_fds[i] >= 0)
+			close(client->tls_fds[i]);
+		client->tls_fds[i] = -1;
+	}
+}
+
+static artik_error tls_setup(mqtt_handle_client *client,
+		const artik_ssl_config *config)
+{
+	const char *data[3] = {
+		config->ca_cert.data,
+		config->client_cert.data,
+		config->client_key.data
+	};
+	unsigned int len[3] = {
+		config->ca_cert.len,
+		config->client_cert.len,
+		config->client_key.len
+	};
+	char paths[3][TLS_MEMORY_FILE_PATH_LEN];
+	int i;
+
+	/* CA cert is mandatory when requesting verification */
+	if ((!config->ca_cert.data || !config->ca_cert.len) &&
+			config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED)
+		return E_BAD_ARGS;
+
+	mosquitto_tls_opts_set(client->mosq,
+			config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED ? 1 : 0,
+			"tlsv1.2", NULL);
+
+	for (i = 0; i < 3; i++)
+		client->tls_fds[i] = -1;
+
+	for (i = 0; i < 3; i++) {
+		if (!data[i] || !len[i])
+			continue;
+
+		client->tls_fds[i] = tls_memory_file(data[i], len[i],
+				paths[i]);
+		if (client->tls_fds[i] < 0) {
+			tls_cleanup(client);
+			return E_ACCESS_DENIED;
 		}
-		close(fd);
 	}
 
-	if (mosquitto_tls_set(mosq, ca_cert, NULL, dev_cert, dev_key, NULL) !=
-			MOSQ_ERR_SUCCESS) {
-		ret = E_MQTT_ERROR;
-		goto exit;
+	if (mosquitto_tls_set(client->mosq,
+			client->tls_fds[0] >= 0 ? paths[0] : NULL, NULL,
+			client->tls_fds[1] >= 0 ? paths[1] : NULL,
+			client->tls_fds[2] >= 0 ? paths[2] : NULL,
+			NULL) != MOSQ_ERR_SUCCESS) {
+		tls_cleanup(client);
+		return E_MQTT_ERROR;
 	}
 
-exit:
-	if (ret != S_OK)
-		tls_cleanup_temp_cert_files();
+	return S_OK;
+}
 
-	return ret;
+static artik_error tls_set_ctx(mqtt_handle_client *client, const char *host)
+{
+	return S_OK;
+}
+#endif
+
+static void batch_free(mqtt_batch *batch)
+{
+	mqtt_handle_client *client = batch->client;
+	mqtt_batch **link = &client->batches;
+
+	while (*link != batch)
+		link = &(*link)->next;
+	*link = batch->next;
+
+	if (batch->timeout_id > 0)
+		client->loop->remove_timeout_callback(batch->timeout_id);
+
+	free(batch->buf);
+	free(batch->topic);
+	artik_list_delete_node(&requested_batches, (artik_list *)batch);
 }
 
 artik_mqtt_handle mqtt_create_client(artik_mqtt_config *config)
@@ -348,14 +595,8 @@ artik_mqtt_handle mqtt_create_client(artik_mqtt_config *config)
 
 	/* set security parameters */
 	if (config->tls) {
-		artik_error ret = S_OK;
+		artik_error ret = tls_setup(mqtt_client, config->tls);
 
-		mosquitto_tls_opts_set((struct mosquitto *)mqtt_client->mosq,
-				(config->tls->verify_cert ==
-					ARTIK_SSL_VERIFY_REQUIRED) ? 1 : 0,
-				"tlsv1.2", NULL);
-		ret = tls_write_temp_cert_files((struct mosquitto *)mqtt_client->mosq,
-				config->tls);
 		if (ret != S_OK) {
 			log_err("Failed to process TLS configuration (err=%d)", ret);
 			mqtt_client_destroy_client(mqtt_client);
@@ -390,8 +631,8 @@ void mqtt_client_destroy_client(artik_mqtt_handle handle_client)
 	log_dbg("");
 
 	if (client) {
-		if (client->watch_id > 0)
-			client->loop->remove_fd_watch(client->watch_id);
+		loop_remove_watches(client);
+		queue_stop_replay(client);
 		if (client->periodic_id > 0)
 			client->loop->remove_periodic_callback(client->periodic_id);
 
@@ -400,7 +641,15 @@ void mqtt_client_destroy_client(artik_mqtt_handle handle_client)
 		client->mosq = NULL;
 
 		if (client->config->tls)
-			tls_cleanup_temp_cert_files();
+			tls_cleanup(client);
+
+		if (client->queue)
+			mqtt_queue_close(client->queue);
+
+		mqtt_topic_tree_free(client->topics);
+
+		while (client->batches)
+			batch_free(client->batches);
 
 		if (client->loop)
 			artik_release_api_module(client->loop);
@@ -574,6 +823,10 @@ static void loop_handle_mosquitto_error(mqtt_handle_client *client, int err)
 	switch (err) {
 	case MOSQ_ERR_NO_CONN:
 	case MOSQ_ERR_CONN_LOST:
+		if (client) {
+			client->connected = false;
+			queue_stop_replay(client);
+		}
 		if (client && client->on_connect)
 			client->on_connect(client->config, client->data_cb_connect,
 					E_MQTT_ERROR);
@@ -583,6 +836,101 @@ static void loop_handle_mosquitto_error(mqtt_handle_client *client, int err)
 	}
 }
 
+static int write_handler(int fd, enum watch_io io, void *handle_client);
+
+/*
+ * Only watch for write readiness while libmosquitto has pending output,
+ * otherwise the level triggered watch would fire continuously.
+ */
+static void loop_update_write_watch(mqtt_handle_client *client)
+{
+	int fd;
+
+	if (!client->mosq || client->watch_id <= 0)
+		return;
+
+	if (!mosquitto_want_write(client->mosq)) {
+		if (client->write_watch_id > 0) {
+			client->loop->remove_fd_watch(client->write_watch_id);
+			client->write_watch_id = 0;
+		}
+		return;
+	}
+
+	if (client->write_watch_id > 0)
+		return;
+
+	fd = mosquitto_socket(client->mosq);
+	if (fd == -1)
+		return;
+
+	if (client->loop->add_fd_watch(fd, WATCH_IO_OUT, write_handler,
+			client, &client->write_watch_id) != S_OK) {
+		log_err("Failed to watch MQTT socket for writing");
+		client->write_watch_id = 0;
+	}
+}
+
+static int loop_read_packets(mqtt_handle_client *client)
+{
+	unsigned int packets = 0;
+	int rc = MOSQ_ERR_SUCCESS;
+
+	/*
+	 * libmosquitto reads at most one packet per call and reports an
+	 * exhausted socket by leaving errno set to EAGAIN. Reading must go
+	 * on until then: over TLS, records already decrypted by OpenSSL do
+	 * not make the socket readable again.
+	 */
+	for (;;) {
+		errno = 0;
+		rc = mosquitto_loop_read(client->mosq, 1);
+		if (rc != MOSQ_ERR_SUCCESS)
+			break;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		packets++;
+	}
+
+	client->stats.packets_read += packets;
+	if (packets > client->stats.max_packets_per_wakeup)
+		client->stats.max_packets_per_wakeup = packets;
+
+	return rc;
+}
+
+static int write_handler(int fd, enum watch_io io, void *handle_client)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	int rc = 0;
+
+	log_dbg("");
+
+	if (!client || !client->mosq)
+		return 0;
+
+	client->stats.write_wakeups++;
+
+	/* A single call flushes the whole output queue until EAGAIN */
+	rc = mosquitto_loop_write(client->mosq, 1);
+	if (rc != MOSQ_ERR_SUCCESS) {
+		log_dbg("mosquitto_loop_write returned %d", rc);
+		client->write_watch_id = 0;
+		loop_remove_watches(client);
+		loop_handle_mosquitto_error(client, rc);
+		return 0;
+	}
+
+	if (!mosquitto_want_write(client->mosq)) {
+		client->write_watch_id = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
 static int loop_handler(int fd, enum watch_io io, void *handle_client)
 {
 	mqtt_handle_client *client = (mqtt_handle_client *)
@@ -595,41 +943,46 @@ static int loop_handler(int fd, enum watch_io io, void *handle_client)
 	if (!client || !client->mosq)
 		return 0;
 
+	client->stats.wakeups++;
+
 #if LIBMOSQUITTO_VERSION_NUMBER >= 1004015
 	rc = mosquitto_loop_want_connect(client->mosq);
 	if (rc != MOSQ_ERR_SUCCESS) {
 		log_dbg("mosquitto_loop_want_connect returned %d", rc);
-		loop_handle_mosquitto_error(client, rc);
-		client->watch_id = 0;
-		return 0;
+		goto error;
 	}
 #endif
 
-	rc = mosquitto_loop_read(client->mosq, 1);
+	rc = loop_read_packets(client);
 	if (rc != MOSQ_ERR_SUCCESS) {
 		log_dbg("mosquitto_loop_read returned %d", rc);
-		loop_handle_mosquitto_error(client, rc);
-		client->watch_id = 0;
-		return 0;
+		goto error;
 	}
 
-	rc = mosquitto_loop_write(client->mosq, 1);
-	if (rc != MOSQ_ERR_SUCCESS) {
-		log_dbg("mosquitto_loop_write returned %d", rc);
-		loop_handle_mosquitto_error(client, rc);
-		client->watch_id = 0;
-		return 0;
+	/* Answers to what was just read (PUBACK, PUBREC...) leave right away */
+	if (mosquitto_want_write(client->mosq)) {
+		rc = mosquitto_loop_write(client->mosq, 1);
+		if (rc != MOSQ_ERR_SUCCESS) {
+			log_dbg("mosquitto_loop_write returned %d", rc);
+			goto error;
+		}
 	}
 
 	rc = mosquitto_loop_misc(client->mosq);
 	if (rc != MOSQ_ERR_SUCCESS) {
 		log_dbg("mosquitto_loop_misc returned %d", rc);
-		loop_handle_mosquitto_error(client, rc);
-		client->watch_id = 0;
-		return 0;
+		goto error;
 	}
 
+	loop_update_write_watch(client);
+
 	return 1;
+
+error:
+	client->watch_id = 0;
+	loop_remove_watches(client);
+	loop_handle_mosquitto_error(client, rc);
+	return 0;
 }
 
 static int misc_handler(void *handle_client)
@@ -652,6 +1005,9 @@ static int misc_handler(void *handle_client)
 		return 0;
 	}
 
+	/* Keepalive may have queued a PINGREQ */
+	loop_update_write_watch(client);
+
 	return 1;
 }
 
@@ -669,6 +1025,11 @@ int mqtt_client_connect(artik_mqtt_handle handle_client, const char *host,
 	if (!client)
 		return -MQTT_ERROR_PARAM;
 
+	if (client->config->tls && tls_set_ctx(client, host) != S_OK) {
+		log_err("Failed to set up the TLS context");
+		return -MQTT_ERROR_LIB;
+	}
+
 	if (client->config->block)
 		rc = mosquitto_connect((struct mosquitto *) client->mosq, host,
 				port,
@@ -698,6 +1059,9 @@ int mqtt_client_connect(artik_mqtt_handle handle_client, const char *host,
 	client->loop->add_periodic_callback(&client->periodic_id,
 			client->config->keep_alive_time / 2, misc_handler, client);
 
+	/* The CONNECT packet may still be queued on a non-blocking connect */
+	loop_update_write_watch(client);
+
 	return MQTT_ERROR_SUCCESS;
 }
 
@@ -706,13 +1070,17 @@ int mqtt_client_disconnect(artik_mqtt_handle handle_client)
 	mqtt_handle_client *client = (mqtt_handle_client *)
 		artik_list_get_by_handle(requested_node,
 			(ARTIK_LIST_HANDLE)handle_client);
+	int rc;
 
 	log_dbg("");
 
 	if (!client)
 		return -MQTT_ERROR_PARAM;
 
-	return mosquitto_disconnect((struct mosquitto *) client->mosq);
+	rc = mosquitto_disconnect((struct mosquitto *) client->mosq);
+	loop_update_write_watch(client);
+
+	return rc;
 }
 
 int mqtt_client_subscribe(artik_mqtt_handle handle_client, int qos,
@@ -739,6 +1107,8 @@ int mqtt_client_subscribe(artik_mqtt_handle handle_client, int qos,
 
 	if (err != MOSQ_ERR_SUCCESS)
 		rc = -MQTT_ERROR_LIB;
+	else
+		loop_update_write_watch(client);
 
 	return rc;
 }
@@ -762,8 +1132,47 @@ int mqtt_client_unsubscribe(artik_mqtt_handle handle_client,
 
 	if (err != MOSQ_ERR_SUCCESS)
 		rc = -MQTT_ERROR_LIB;
+	else
+		loop_update_write_watch(client);
+
+	return rc;
+}
+
+static int client_publish(mqtt_handle_client *client, int qos, bool retain,
+		const char *msg_topic, int payload_len, const char *msg_content)
+{
+	int rc = MQTT_ERROR_SUCCESS;
+	int err = MOSQ_ERR_SUCCESS;
+
+	/* Keep ordering with the messages waiting to be replayed */
+	if (client->queue && (!client->connected ||
+			mqtt_queue_depth(client->queue)))
+		goto queue;
+
+	err = mosquitto_publish((struct mosquitto *) client->mosq, NULL,
+			msg_topic,
+			payload_len, msg_content, qos, retain);
+
+	if (client->queue && (err == MOSQ_ERR_NO_CONN ||
+			err == MOSQ_ERR_CONN_LOST))
+		goto queue;
+
+	if (err != MOSQ_ERR_SUCCESS)
+		rc = -MQTT_ERROR_LIB;
+	else
+		loop_update_write_watch(client);
 
 	return rc;
+
+queue:
+	if (!mqtt_queue_push(client->queue, msg_topic, msg_content,
+			payload_len, qos, retain))
+		return -MQTT_ERROR_NOMEM;
+
+	if (client->connected)
+		queue_start_replay(client);
+
+	return MQTT_ERROR_SUCCESS;
 }
 
 int mqtt_client_publish(artik_mqtt_handle handle_client, int qos, bool retain,
@@ -772,8 +1181,6 @@ int mqtt_client_publish(artik_mqtt_handle handle_client, int qos, bool retain,
 	mqtt_handle_client *client = (mqtt_handle_client *)
 		artik_list_get_by_handle(requested_node,
 			(ARTIK_LIST_HANDLE)handle_client);
-	int rc = MQTT_ERROR_SUCCESS;
-	int err = MOSQ_ERR_SUCCESS;
 
 	log_dbg("");
 
@@ -783,12 +1190,404 @@ int mqtt_client_publish(artik_mqtt_handle handle_client, int qos, bool retain,
 	if (!client || !msg_topic || payload_len == 0 || !msg_content)
 		return -MQTT_ERROR_PARAM;
 
-	err = mosquitto_publish((struct mosquitto *) client->mosq, NULL,
-			msg_topic,
-			payload_len, msg_content, qos, retain);
+	return client_publish(client, qos, retain, msg_topic, payload_len,
+			msg_content);
+}
 
-	if (err != MOSQ_ERR_SUCCESS)
-		rc = -MQTT_ERROR_LIB;
+int mqtt_client_get_stats(artik_mqtt_handle handle_client,
+		artik_mqtt_stats *stats)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+
+	if (!client || !stats)
+		return -MQTT_ERROR_PARAM;
+
+	memcpy(stats, &client->stats, sizeof(artik_mqtt_stats));
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_enable_offline_queue(artik_mqtt_handle handle_client,
+		const artik_mqtt_queue_config *config)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	mqtt_queue *queue;
+
+	if (!client || !config)
+		return -MQTT_ERROR_PARAM;
+
+	queue = mqtt_queue_open(config);
+	if (!queue)
+		return -MQTT_ERROR_PARAM;
+
+	queue_stop_replay(client);
+	if (client->queue)
+		mqtt_queue_close(client->queue);
+	client->queue = queue;
+
+	if (client->connected)
+		queue_start_replay(client);
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_disable_offline_queue(artik_mqtt_handle handle_client)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+
+	if (!client || !client->queue)
+		return -MQTT_ERROR_PARAM;
+
+	queue_stop_replay(client);
+	mqtt_queue_close(client->queue);
+	client->queue = NULL;
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_get_offline_queue_stats(artik_mqtt_handle handle_client,
+		artik_mqtt_queue_stats *stats)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+
+	if (!client || !client->queue || !stats)
+		return -MQTT_ERROR_PARAM;
+
+	mqtt_queue_get_stats(client->queue, stats);
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_add_subscription(artik_mqtt_handle handle_client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	mqtt_topic_sub *sub;
+	bool subscribe = false;
+	int err;
+
+	if (!client || !filter || !cb || !subscription || qos < 0 || qos > 2)
+		return -MQTT_ERROR_PARAM;
+
+	if (!mqtt_topic_filter_is_valid(filter))
+		return -MQTT_ERROR_PARAM;
+
+	if (!client->topics) {
+		client->topics = mqtt_topic_tree_new();
+		if (!client->topics)
+			return -MQTT_ERROR_NOMEM;
+	}
+
+	sub = mqtt_topic_tree_add(client->topics, filter, qos, cb, user_data,
+			&subscribe);
+	if (!sub)
+		return -MQTT_ERROR_NOMEM;
+
+	/* Only the first subscription to a filter reaches the broker */
+	if (subscribe) {
+		err = mosquitto_subscribe(client->mosq, NULL, filter, qos);
+		if (err != MOSQ_ERR_SUCCESS) {
+			log_dbg("mosquitto_subscribe returned %d", err);
+			mqtt_topic_tree_cancel(client->topics, sub);
+			return -MQTT_ERROR_LIB;
+		}
+		loop_update_write_watch(client);
+	}
+
+	*subscription = (artik_mqtt_subscription)sub;
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_remove_subscription(artik_mqtt_handle handle_client,
+		artik_mqtt_subscription subscription)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	mqtt_topic_sub *sub = (mqtt_topic_sub *)subscription;
+	int err;
+
+	if (!client || !client->topics ||
+			!mqtt_topic_tree_owns(client->topics, sub))
+		return -MQTT_ERROR_PARAM;
+
+	if (mqtt_topic_sub_is_last(sub)) {
+		err = mosquitto_unsubscribe(client->mosq, NULL,
+				mqtt_topic_sub_filter(sub));
+		if (err != MOSQ_ERR_SUCCESS)
+			log_dbg("mosquitto_unsubscribe returned %d", err);
+		else
+			loop_update_write_watch(client);
+	}
+
+	mqtt_topic_tree_remove(client->topics, sub);
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+/* Size of the PUBLISH packet carrying 'payload_len' bytes on 'topic' */
+static unsigned int batch_packet_size(const mqtt_batch *batch,
+		unsigned int payload_len)
+{
+	unsigned int remaining = 2 + strlen(batch->topic) + payload_len +
+		(batch->config.qos ? 2 : 0);
+	unsigned int header = 2;
+
+	while (remaining >= (1U << (7 * (header - 1))) && header < 5)
+		header++;
+
+	return header + remaining;
+}
+
+static void batch_set_cork(mqtt_handle_client *client, int cork)
+{
+	int fd = mosquitto_socket(client->mosq);
+
+	if (fd != -1 && setsockopt(fd, IPPROTO_TCP, TCP_CORK, &cork,
+			sizeof(cork)) < 0)
+		log_dbg("Failed to set TCP_CORK (err=%d)", errno);
+}
+
+static int batch_flush(mqtt_batch *batch)
+{
+	mqtt_handle_client *client = batch->client;
+	const artik_mqtt_batch_config *config = &batch->config;
+	int rc = MQTT_ERROR_SUCCESS;
+	size_t offset = 0;
+
+	if (batch->timeout_id > 0) {
+		client->loop->remove_timeout_callback(batch->timeout_id);
+		batch->timeout_id = 0;
+	}
+
+	if (!batch->count)
+		return MQTT_ERROR_SUCCESS;
+
+	switch (config->mode) {
+	case ARTIK_MQTT_BATCH_LATEST:
+	case ARTIK_MQTT_BATCH_PACKED:
+		rc = client_publish(client, config->qos, config->retain,
+				batch->topic, batch->len, (char *)batch->buf);
+		batch->stats.messages_out++;
+		batch->stats.bytes_out += batch_packet_size(batch, batch->len);
+		break;
+	case ARTIK_MQTT_BATCH_PIPELINE:
+	default:
+		/*
+		 * libmosquitto writes each packet as soon as it is queued,
+		 * corking the socket lets them leave in as few segments as
+		 * possible.
+		 */
+		if (client->connected && batch->count > 1)
+			batch_set_cork(client, 1);
+
+		while (offset < batch->len) {
+			const unsigned char *rec = batch->buf + offset;
+			uint32_t len = (uint32_t)rec[0] << 24 |
+				(uint32_t)rec[1] << 16 | (uint32_t)rec[2] << 8 |
+				rec[3];
+			int err;
+
+			err = client_publish(client, config->qos,
+					config->retain, batch->topic, len,
+					(const char *)rec + MQTT_BATCH_PREFIX);
+			if (err != MQTT_ERROR_SUCCESS)
+				rc = err;
+
+			batch->stats.messages_out++;
+			batch->stats.bytes_out += batch_packet_size(batch, len);
+			offset += MQTT_BATCH_PREFIX + len;
+		}
+
+		if (client->connected && batch->count > 1)
+			batch_set_cork(client, 0);
+		break;
+	}
+
+	batch->len = 0;
+	batch->count = 0;
+	batch->payload_bytes = 0;
+
+	return rc;
+}
+
+static void batch_timeout(void *user_data)
+{
+	mqtt_batch *batch = (mqtt_batch *)user_data;
+
+	batch->timeout_id = 0;
+	batch_flush(batch);
+}
+
+static bool batch_reserve(mqtt_batch *batch, size_t len)
+{
+	unsigned char *buf;
+	size_t size;
+
+	if (batch->len + len <= batch->size)
+		return true;
+
+	size = batch->size ? batch->size : 256;
+	while (size < batch->len + len)
+		size *= 2;
+
+	buf = realloc(batch->buf, size);
+	if (!buf)
+		return false;
+
+	batch->buf = buf;
+	batch->size = size;
+
+	return true;
+}
+
+int mqtt_client_create_batch(artik_mqtt_handle handle_client,
+		const char *topic, const artik_mqtt_batch_config *config,
+		artik_mqtt_batch *handle)
+{
+	mqtt_handle_client *client = (mqtt_handle_client *)
+		artik_list_get_by_handle(requested_node,
+			(ARTIK_LIST_HANDLE)handle_client);
+	mqtt_batch *batch;
+
+	if (!client || !topic || !config || !handle)
+		return -MQTT_ERROR_PARAM;
+
+	if (config->qos < 0 || config->qos > 2 || (!config->window &&
+			!config->max_messages && !config->max_bytes))
+		return -MQTT_ERROR_PARAM;
+
+	batch = (mqtt_batch *)artik_list_add(&requested_batches, 0,
+			sizeof(mqtt_batch));
+	if (!batch)
+		return -MQTT_ERROR_NOMEM;
+
+	batch->topic = strdup(topic);
+	if (!batch->topic) {
+		artik_list_delete_node(&requested_batches, (artik_list *)batch);
+		return -MQTT_ERROR_NOMEM;
+	}
+
+	batch->client = client;
+	batch->config = *config;
+	batch->next = client->batches;
+	client->batches = batch;
+
+	*handle = (artik_mqtt_batch)batch;
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_batch_publish(artik_mqtt_batch handle, int payload_len,
+		const char *payload)
+{
+	mqtt_batch *batch = (mqtt_batch *)
+		artik_list_get_by_handle(requested_batches,
+			(ARTIK_LIST_HANDLE)handle);
+	const artik_mqtt_batch_config *config;
+
+	if (!batch || payload_len <= 0 || !payload)
+		return -MQTT_ERROR_PARAM;
+
+	config = &batch->config;
+
+	if (config->mode == ARTIK_MQTT_BATCH_LATEST) {
+		/* Only the latest value is kept */
+		batch->len = 0;
+		if (!batch_reserve(batch, payload_len))
+			return -MQTT_ERROR_NOMEM;
+		memcpy(batch->buf, payload, payload_len);
+		batch->len = payload_len;
+	} else {
+		unsigned char *rec;
+
+		if (!batch_reserve(batch, MQTT_BATCH_PREFIX + payload_len))
+			return -MQTT_ERROR_NOMEM;
+
+		rec = batch->buf + batch->len;
+		rec[0] = (uint32_t)payload_len >> 24;
+		rec[1] = (uint32_t)payload_len >> 16;
+		rec[2] = (uint32_t)payload_len >> 8;
+		rec[3] = (uint32_t)payload_len;
+		memcpy(rec + MQTT_BATCH_PREFIX, payload, payload_len);
+		batch->len += MQTT_BATCH_PREFIX + payload_len;
+	}
+
+	batch->count++;
+	batch->payload_bytes += payload_len;
+	batch->stats.messages_in++;
+	batch->stats.bytes_in += batch_packet_size(batch, payload_len);
+
+	if ((config->max_messages && batch->count >= config->max_messages) ||
+			(config->max_bytes &&
+			batch->payload_bytes >= config->max_bytes))
+		return batch_flush(batch);
+
+	if (config->window && batch->timeout_id <= 0) {
+		if (batch->client->loop->add_timeout_callback(
+				&batch->timeout_id, config->window,
+				batch_timeout, batch) != S_OK) {
+			batch->timeout_id = 0;
+			return batch_flush(batch);
+		}
+	}
+
+	return MQTT_ERROR_SUCCESS;
+}
+
+int mqtt_client_flush_batch(artik_mqtt_batch handle)
+{
+	mqtt_batch *batch = (mqtt_batch *)
+		artik_list_get_by_handle(requested_batches,
+			(ARTIK_LIST_HANDLE)handle);
+
+	if (!batch)
+		return -MQTT_ERROR_PARAM;
+
+	return batch_flush(batch);
+}
+
+int mqtt_client_destroy_batch(artik_mqtt_batch handle)
+{
+	mqtt_batch *batch = (mqtt_batch *)
+		artik_list_get_by_handle(requested_batches,
+			(ARTIK_LIST_HANDLE)handle);
+	int rc;
+
+	if (!batch)
+		return -MQTT_ERROR_PARAM;
+
+	rc = batch_flush(batch);
+	batch_free(batch);
 
 	return rc;
 }
+
+int mqtt_client_get_batch_stats(artik_mqtt_batch handle,
+		artik_mqtt_batch_stats *stats)
+{
+	mqtt_batch *batch = (mqtt_batch *)
+		artik_list_get_by_handle(requested_batches,
+			(ARTIK_LIST_HANDLE)handle);
+
+	if (!batch || !stats)
+		return -MQTT_ERROR_PARAM;
+
+	memcpy(stats, &batch->stats, sizeof(artik_mqtt_batch_stats));
+	stats->bytes_saved = stats->bytes_in > stats->bytes_out ?
+		stats->bytes_in - stats->bytes_out : 0;
+
+	return MQTT_ERROR_SUCCESS;
+}
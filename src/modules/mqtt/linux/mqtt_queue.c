@@ -0,0 +1,416 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <artik_log.h>
+#include "mqtt_queue.h"
+
+/*
+ * The queue is a ring of variable sized records stored in a file mapped
+ * with MAP_SHARED. Records are always contiguous: when one does not fit
+ * before the end of the ring, a wrap marker (record of size 0) is left
+ * and the record is stored at the beginning.
+ *
+ * The record is written before the header is updated, so a process crash
+ * never exposes a partial record, and a header left inconsistent is
+ * detected when the file is opened again. Nothing is synced explicitly,
+ * the kernel writes the dirty pages back on its own.
+ */
+#define QUEUE_MAGIC		0x4d515451	/* "MQTQ" */
+#define QUEUE_VERSION		1
+#define QUEUE_ALIGN		8
+#define QUEUE_DATA_OFFSET	64
+#define QUEUE_ALIGN_UP(x)	(((x) + QUEUE_ALIGN - 1) & ~(QUEUE_ALIGN - 1))
+
+struct queue_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t used;
+	uint32_t count;
+	uint32_t dropped;
+};
+
+struct queue_record {
+	uint32_t size;
+	uint32_t payload_len;
+	uint16_t topic_len;
+	uint8_t qos;
+	uint8_t retain;
+	uint32_t reserved;
+	/* Followed by the NUL terminated topic and the payload */
+};
+
+struct mqtt_queue {
+	struct queue_header *header;
+	uint8_t *data;
+	size_t map_len;
+	unsigned int max_messages;
+	unsigned int replay_rate;
+	artik_mqtt_drop_policy policy;
+	unsigned int queued;
+	unsigned int replayed;
+};
+
+static struct queue_record *queue_record_at(mqtt_queue *queue,
+		uint32_t offset)
+{
+	return (struct queue_record *)(queue->data + offset);
+}
+
+static void queue_reset(mqtt_queue *queue, uint32_t capacity)
+{
+	struct queue_header *header = queue->header;
+
+	header->version = QUEUE_VERSION;
+	header->capacity = capacity;
+	header->head = 0;
+	header->tail = 0;
+	header->used = 0;
+	header->count = 0;
+	header->dropped = 0;
+	__sync_synchronize();
+	header->magic = QUEUE_MAGIC;
+}
+
+/* Check that the content left by a previous run is consistent */
+static bool queue_check(mqtt_queue *queue, uint32_t capacity)
+{
+	struct queue_header *header = queue->header;
+	uint32_t offset = header->head;
+	uint32_t used = 0;
+	uint32_t i;
+
+	if (header->magic != QUEUE_MAGIC || header->version != QUEUE_VERSION
+			|| header->capacity != capacity)
+		return false;
+
+	if (header->head >= capacity || header->tail >= capacity ||
+			header->used > capacity ||
+			(header->head % QUEUE_ALIGN) ||
+			(header->tail % QUEUE_ALIGN))
+		return false;
+
+	for (i = 0; i < header->count; i++) {
+		struct queue_record *rec = queue_record_at(queue, offset);
+
+		if (rec->size == 0) {
+			used += capacity - offset;
+			offset = 0;
+			rec = queue_record_at(queue, offset);
+		}
+
+		if (rec->size < sizeof(struct queue_record) ||
+				rec->size > capacity - offset ||
+				rec->size % QUEUE_ALIGN)
+			return false;
+
+		used += rec->size;
+		offset += rec->size;
+		if (offset == capacity)
+			offset = 0;
+	}
+
+	return offset == header->tail && used == header->used;
+}
+
+mqtt_queue *mqtt_queue_open(const artik_mqtt_queue_config *config)
+{
+	mqtt_queue *queue = NULL;
+	uint32_t capacity;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (!config || !config->path || config->max_bytes <
+			2 * sizeof(struct queue_record))
+		return NULL;
+
+	capacity = QUEUE_ALIGN_UP(config->max_bytes);
+
+	fd = open(config->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		log_err("Failed to open %s (err=%d)", config->path, errno);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 ||
+			st.st_size != (off_t)(QUEUE_DATA_OFFSET + capacity)) {
+		if (ftruncate(fd, QUEUE_DATA_OFFSET + capacity) < 0) {
+			log_err("Failed to size %s (err=%d)", config->path,
+					errno);
+			close(fd);
+			return NULL;
+		}
+	}
+
+	map = mmap(NULL, QUEUE_DATA_OFFSET + capacity, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_err("Failed to map %s (err=%d)", config->path, errno);
+		return NULL;
+	}
+
+	queue = malloc(sizeof(mqtt_queue));
+	if (!queue) {
+		munmap(map, QUEUE_DATA_OFFSET + capacity);
+		return NULL;
+	}
+
+	memset(queue, 0, sizeof(mqtt_queue));
+	queue->header = map;
+	queue->data = (uint8_t *)map + QUEUE_DATA_OFFSET;
+	queue->map_len = QUEUE_DATA_OFFSET + capacity;
+	queue->max_messages = config->max_messages;
+	queue->replay_rate = config->replay_rate;
+	queue->policy = config->drop_policy;
+
+	if (!queue_check(queue, capacity)) {
+		if (queue->header->magic == QUEUE_MAGIC)
+			log_err("Discarding invalid content of %s",
+					config->path);
+		queue_reset(queue, capacity);
+	}
+
+	log_dbg("%s: %u messages pending", config->path,
+			queue->header->count);
+
+	return queue;
+}
+
+void mqtt_queue_close(mqtt_queue *queue)
+{
+	if (!queue)
+		return;
+
+	msync(queue->header, queue->map_len, MS_ASYNC);
+	munmap(queue->header, queue->map_len);
+	free(queue);
+}
+
+/*
+ * Return the offset where a record of 'size' bytes would be stored,
+ * or -1 if there is not enough contiguous room.
+ */
+static int64_t queue_find_room(mqtt_queue *queue, uint32_t size)
+{
+	struct queue_header *header = queue->header;
+
+	if (header->count == 0)
+		return size <= header->capacity ? 0 : -1;
+
+	if (header->tail > header->head) {
+		if (size <= header->capacity - header->tail)
+			return header->tail;
+		/* Wrap, the end of the ring is left as padding */
+		return size <= header->head ? 0 : -1;
+	}
+
+	if (size <= header->head - header->tail)
+		return header->tail;
+
+	return -1;
+}
+
+static struct queue_record *queue_head_record(mqtt_queue *queue)
+{
+	struct queue_header *header = queue->header;
+	struct queue_record *rec;
+
+	if (header->count == 0)
+		return NULL;
+
+	rec = queue_record_at(queue, header->head);
+	if (rec->size == 0) {
+		header->used -= header->capacity - header->head;
+		header->head = 0;
+		rec = queue_record_at(queue, 0);
+	}
+
+	return rec;
+}
+
+static void queue_remove_head(mqtt_queue *queue)
+{
+	struct queue_header *header = queue->header;
+	struct queue_record *rec = queue_head_record(queue);
+
+	if (!rec)
+		return;
+
+	header->head += rec->size;
+	if (header->head == header->capacity)
+		header->head = 0;
+	header->used -= rec->size;
+	header->count--;
+}
+
+bool mqtt_queue_push(mqtt_queue *queue, const char *topic,
+		const void *payload, int payload_len, int qos, bool retain)
+{
+	struct queue_header *header = queue->header;
+	struct queue_record *rec;
+	size_t topic_len = strlen(topic);
+	uint32_t size;
+	int64_t offset;
+
+	if (topic_len > UINT16_MAX || payload_len < 0)
+		goto drop;
+
+	size = QUEUE_ALIGN_UP(sizeof(struct queue_record) + topic_len + 1 +
+			(size_t)payload_len);
+	if (size > header->capacity)
+		goto drop;
+
+	for (;;) {
+		bool full = queue->max_messages &&
+			header->count >= queue->max_messages;
+
+		if (!full) {
+			offset = queue_find_room(queue, size);
+			if (offset >= 0)
+				break;
+		}
+
+		switch (queue->policy) {
+		case ARTIK_MQTT_DROP_NEWEST:
+			goto drop;
+		case ARTIK_MQTT_DROP_OLDEST_UNLESS_QOS0:
+			/*
+			 * Records are contiguous in the ring, so room is only
+			 * made at the head: a QoS 0 message does not evict a
+			 * QoS 1 or 2 one, but there is no search for QoS 0
+			 * records further in the queue.
+			 */
+			if (qos == 0 && queue_head_record(queue)->qos > 0)
+				goto drop;
+			queue_remove_head(queue);
+			header->dropped++;
+			break;
+		case ARTIK_MQTT_DROP_OLDEST:
+		default:
+			queue_remove_head(queue);
+			header->dropped++;
+			break;
+		}
+	}
+
+	if (header->count == 0) {
+		header->head = 0;
+		header->tail = 0;
+		header->used = 0;
+	}
+
+	rec = queue_record_at(queue, (uint32_t)offset);
+	rec->size = size;
+	rec->payload_len = payload_len;
+	rec->topic_len = topic_len;
+	rec->qos = qos;
+	rec->retain = retain;
+	rec->reserved = 0;
+	memcpy(rec + 1, topic, topic_len + 1);
+	if (payload_len)
+		memcpy((uint8_t *)(rec + 1) + topic_len + 1, payload,
+				payload_len);
+
+	/* Leave a wrap marker at the end of the ring */
+	if (offset != header->tail)
+		queue_record_at(queue, header->tail)->size = 0;
+
+	/* Publish the record only once its content is in place */
+	__sync_synchronize();
+	if (offset != header->tail)
+		header->used += header->capacity - header->tail;
+	header->tail = (uint32_t)offset + size;
+	if (header->tail == header->capacity)
+		header->tail = 0;
+	header->used += size;
+	header->count++;
+	queue->queued++;
+
+	return true;
+
+drop:
+	header->dropped++;
+	return false;
+}
+
+bool mqtt_queue_peek(mqtt_queue *queue, mqtt_queue_msg *msg)
+{
+	struct queue_record *rec = queue_head_record(queue);
+
+	if (!rec)
+		return false;
+
+	msg->topic = (const char *)(rec + 1);
+	msg->payload = (const uint8_t *)(rec + 1) + rec->topic_len + 1;
+	msg->payload_len = rec->payload_len;
+	msg->qos = rec->qos;
+	msg->retain = rec->retain;
+
+	return true;
+}
+
+void mqtt_queue_pop(mqtt_queue *queue)
+{
+	if (!queue->header->count)
+		return;
+
+	queue_remove_head(queue);
+	queue->replayed++;
+}
+
+void mqtt_queue_discard(mqtt_queue *queue)
+{
+	if (!queue->header->count)
+		return;
+
+	queue_remove_head(queue);
+	queue->header->dropped++;
+}
+
+unsigned int mqtt_queue_depth(mqtt_queue *queue)
+{
+	return queue->header->count;
+}
+
+unsigned int mqtt_queue_replay_rate(mqtt_queue *queue)
+{
+	return queue->replay_rate;
+}
+
+void mqtt_queue_get_stats(mqtt_queue *queue, artik_mqtt_queue_stats *stats)
+{
+	stats->messages = queue->header->count;
+	stats->bytes = queue->header->used;
+	stats->capacity = queue->header->capacity;
+	stats->queued = queue->queued;
+	stats->replayed = queue->replayed;
+	stats->dropped = queue->header->dropped;
+}
@@ -0,0 +1,50 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __MQTT_QUEUE_H__
+#define __MQTT_QUEUE_H__
+
+#include <stdbool.h>
+#include <artik_mqtt.h>
+
+typedef struct mqtt_queue mqtt_queue;
+
+/*
+ * View of the oldest queued message. Topic and payload point into the
+ * mapping and stay valid until the message is popped.
+ */
+typedef struct {
+	const char *topic;
+	const void *payload;
+	int payload_len;
+	int qos;
+	bool retain;
+} mqtt_queue_msg;
+
+mqtt_queue *mqtt_queue_open(const artik_mqtt_queue_config *config);
+void mqtt_queue_close(mqtt_queue *queue);
+bool mqtt_queue_push(mqtt_queue *queue, const char *topic,
+		const void *payload, int payload_len, int qos, bool retain);
+bool mqtt_queue_peek(mqtt_queue *queue, mqtt_queue_msg *msg);
+void mqtt_queue_pop(mqtt_queue *queue);
+void mqtt_queue_discard(mqtt_queue *queue);
+unsigned int mqtt_queue_depth(mqtt_queue *queue);
+unsigned int mqtt_queue_replay_rate(mqtt_queue *queue);
+void mqtt_queue_get_stats(mqtt_queue *queue, artik_mqtt_queue_stats *stats);
+
+#endif  /* __MQTT_QUEUE_H__ */
@@ -0,0 +1,212 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <artik_log.h>
+#include <artik_module.h>
+#include "mqtt_tls.h"
+
+/*
+ * TLS contexts are shared by all the clients using the same credentials,
+ * verification mode and broker host, so that creating many TLS clients
+ * only builds one SSL_CTX. The credentials themselves are parsed once
+ * and cached by the security module.
+ */
+struct mqtt_tls_ctx {
+	struct mqtt_tls_ctx *next;
+	artik_ssl_credentials_handle creds;
+	bool verify;
+	char *host;
+	SSL_CTX *ssl_ctx;
+	unsigned int refcount;
+};
+
+static mqtt_tls_ctx *tls_ctx_cache;
+static pthread_mutex_t tls_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+artik_error mqtt_tls_get_credentials(const artik_ssl_config *config,
+		artik_ssl_credentials_handle *creds)
+{
+	artik_security_module *security;
+	artik_error ret;
+
+	/* CA cert is mandatory when requesting verification */
+	if ((!config->ca_cert.data || !config->ca_cert.len) &&
+			config->verify_cert == ARTIK_SSL_VERIFY_REQUIRED)
+		return E_BAD_ARGS;
+
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security) {
+		log_err("Failed to request security module");
+		return E_NOT_SUPPORTED;
+	}
+
+	ret = security->get_ssl_credentials(config, creds);
+	artik_release_api_module(security);
+
+	return ret;
+}
+
+void mqtt_tls_put_credentials(artik_ssl_credentials_handle creds)
+{
+	artik_security_module *security = (artik_security_module *)
+		artik_request_api_module("security");
+
+	if (!security) {
+		log_err("Failed to request security module");
+		return;
+	}
+
+	security->put_ssl_credentials(creds);
+	artik_release_api_module(security);
+}
+
+static SSL_CTX *tls_ctx_new(artik_ssl_credentials_handle creds, bool verify,
+		const char *host)
+{
+	artik_security_module *security;
+	SSL_CTX *ssl_ctx;
+	artik_error ret;
+
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+	if (!ssl_ctx) {
+		log_err("Failed to create SSL context");
+		return NULL;
+	}
+
+	/* Same protocol restriction as the former "tlsv1.2" option */
+	SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 |
+			SSL_OP_NO_TLSv1 | SSL_OP_NO_TLSv1_1 |
+			SSL_OP_NO_COMPRESSION);
+
+	if (verify) {
+		X509_VERIFY_PARAM_set1_host(SSL_CTX_get0_param(ssl_ctx), host,
+				0);
+		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
+	} else {
+		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, NULL);
+	}
+
+	security = (artik_security_module *)
+		artik_request_api_module("security");
+	if (!security) {
+		log_err("Failed to request security module");
+		SSL_CTX_free(ssl_ctx);
+		return NULL;
+	}
+
+	ret = security->apply_ssl_credentials(creds, ssl_ctx);
+	artik_release_api_module(security);
+	if (ret != S_OK) {
+		log_err("Failed to apply SSL credentials (err=%d)", ret);
+		SSL_CTX_free(ssl_ctx);
+		return NULL;
+	}
+
+	return ssl_ctx;
+}
+
+mqtt_tls_ctx *mqtt_tls_ctx_get(artik_ssl_credentials_handle creds,
+		bool verify, const char *host)
+{
+	mqtt_tls_ctx *ctx;
+
+	/* The host only matters when it is checked against the certificate */
+	if (!verify)
+		host = NULL;
+
+	pthread_mutex_lock(&tls_ctx_lock);
+
+	for (ctx = tls_ctx_cache; ctx; ctx = ctx->next) {
+		if (ctx->creds == creds && ctx->verify == verify &&
+				(ctx->host == host || (ctx->host && host &&
+				!strcmp(ctx->host, host)))) {
+			ctx->refcount++;
+			goto exit;
+		}
+	}
+
+	ctx = calloc(1, sizeof(mqtt_tls_ctx));
+	if (!ctx)
+		goto exit;
+
+	if (host) {
+		ctx->host = strdup(host);
+		if (!ctx->host) {
+			free(ctx);
+			ctx = NULL;
+			goto exit;
+		}
+	}
+
+	ctx->ssl_ctx = tls_ctx_new(creds, verify, host);
+	if (!ctx->ssl_ctx) {
+		free(ctx->host);
+		free(ctx);
+		ctx = NULL;
+		goto exit;
+	}
+
+	ctx->creds = creds;
+	ctx->verify = verify;
+	ctx->refcount = 1;
+	ctx->next = tls_ctx_cache;
+	tls_ctx_cache = ctx;
+
+exit:
+	pthread_mutex_unlock(&tls_ctx_lock);
+
+	return ctx;
+}
+
+void *mqtt_tls_ctx_ssl(mqtt_tls_ctx *ctx)
+{
+	return ctx->ssl_ctx;
+}
+
+void mqtt_tls_ctx_put(mqtt_tls_ctx *ctx)
+{
+	mqtt_tls_ctx **cur;
+
+	pthread_mutex_lock(&tls_ctx_lock);
+
+	if (--ctx->refcount) {
+		pthread_mutex_unlock(&tls_ctx_lock);
+		return;
+	}
+
+	for (cur = &tls_ctx_cache; *cur != ctx; cur = &(*cur)->next)
+		;
+	*cur = ctx->next;
+
+	pthread_mutex_unlock(&tls_ctx_lock);
+
+	SSL_CTX_free(ctx->ssl_ctx);
+	free(ctx->host);
+	free(ctx);
+}
@@ -0,0 +1,36 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __MQTT_TLS_H__
+#define __MQTT_TLS_H__
+
+#include <stdbool.h>
+#include <artik_ssl.h>
+#include <artik_security.h>
+
+typedef struct mqtt_tls_ctx mqtt_tls_ctx;
+
+artik_error mqtt_tls_get_credentials(const artik_ssl_config *config,
+		artik_ssl_credentials_handle *creds);
+void mqtt_tls_put_credentials(artik_ssl_credentials_handle creds);
+mqtt_tls_ctx *mqtt_tls_ctx_get(artik_ssl_credentials_handle creds,
+		bool verify, const char *host);
+void *mqtt_tls_ctx_ssl(mqtt_tls_ctx *ctx);
+void mqtt_tls_ctx_put(mqtt_tls_ctx *ctx);
+
+#endif  /* __MQTT_TLS_H__ */
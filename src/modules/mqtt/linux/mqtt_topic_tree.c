@@ -0,0 +1,595 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mqtt_topic_tree.h"
+
+/*
+ * Subscriptions are stored in a trie with one node per topic level.
+ * Children are kept in an open addressing table keyed by the level
+ * string, except for the '+' and '#' wildcards which have dedicated
+ * links. Matching a topic walks it level by level, following the exact
+ * child and the '+' child, and collects the '#' children on the way, so
+ * it never copies the topic nor allocates memory.
+ *
+ * Subscriptions removed from a callback are only marked, and unlinked
+ * once the dispatch is over.
+ *
+ * The handles given out to the user are registered in an open addressing
+ * set keyed by address, so that a stale one is rejected in constant time
+ * without reading the memory it points to.
+ */
+
+struct topic_node {
+	struct topic_node *parent;
+	char *level;
+	size_t level_len;
+	uint32_t level_hash;
+	struct topic_node **children;
+	unsigned int children_size;
+	unsigned int children_count;
+	struct topic_node *plus;
+	struct topic_node *hash;
+	mqtt_topic_sub *subs;
+	unsigned int num_subs;
+	int qos;
+	char *filter;
+};
+
+struct mqtt_topic_sub {
+	struct topic_node *node;
+	mqtt_topic_sub *prev;
+	mqtt_topic_sub *next;
+	mqtt_topic_sub *next_removed;
+	message_callback cb;
+	void *data;
+	int prev_qos;
+};
+
+struct mqtt_topic_tree {
+	struct topic_node root;
+	unsigned int dispatching;
+	mqtt_topic_sub *removed;
+	mqtt_topic_sub **handles;
+	unsigned int handles_size;
+	unsigned int handles_count;
+};
+
+static uint32_t level_hash(const char *level, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)level[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t handle_hash(const mqtt_topic_sub *sub)
+{
+	uint64_t addr = (uintptr_t)sub;
+
+	return (uint32_t)((addr >> 4) ^ (addr >> 32)) * 2654435761u;
+}
+
+static bool handle_find(mqtt_topic_tree *tree, const mqtt_topic_sub *sub,
+		unsigned int *index)
+{
+	unsigned int mask;
+	unsigned int i;
+
+	if (!tree->handles_count)
+		return false;
+
+	mask = tree->handles_size - 1;
+	for (i = handle_hash(sub) & mask; tree->handles[i];
+			i = (i + 1) & mask) {
+		if (tree->handles[i] == sub) {
+			*index = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void handle_table_put(mqtt_topic_sub **table, unsigned int size,
+		mqtt_topic_sub *sub)
+{
+	unsigned int mask = size - 1;
+	unsigned int i;
+
+	for (i = handle_hash(sub) & mask; table[i]; i = (i + 1) & mask)
+		;
+	table[i] = sub;
+}
+
+static bool handle_insert(mqtt_topic_tree *tree, mqtt_topic_sub *sub)
+{
+	if ((tree->handles_count + 1) * 4 > tree->handles_size * 3) {
+		unsigned int size = tree->handles_size ?
+			tree->handles_size * 2 : 16;
+		mqtt_topic_sub **table = calloc(size, sizeof(mqtt_topic_sub *));
+		unsigned int i;
+
+		if (!table)
+			return false;
+
+		for (i = 0; i < tree->handles_size; i++)
+			if (tree->handles[i])
+				handle_table_put(table, size, tree->handles[i]);
+
+		free(tree->handles);
+		tree->handles = table;
+		tree->handles_size = size;
+	}
+
+	handle_table_put(tree->handles, tree->handles_size, sub);
+	tree->handles_count++;
+
+	return true;
+}
+
+/* Shift back the entries following the hole so that no probe breaks */
+static void handle_erase(mqtt_topic_tree *tree, const mqtt_topic_sub *sub)
+{
+	unsigned int mask = tree->handles_size - 1;
+	unsigned int i, j;
+
+	if (!handle_find(tree, sub, &i))
+		return;
+
+	for (j = (i + 1) & mask; tree->handles[j]; j = (j + 1) & mask) {
+		unsigned int home = handle_hash(tree->handles[j]) & mask;
+
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			tree->handles[i] = tree->handles[j];
+			i = j;
+		}
+	}
+
+	tree->handles[i] = NULL;
+	tree->handles_count--;
+}
+
+static struct topic_node *node_lookup(struct topic_node *node,
+		const char *level, size_t len, uint32_t hash)
+{
+	unsigned int mask;
+	unsigned int i;
+
+	if (!node->children_count)
+		return NULL;
+
+	mask = node->children_size - 1;
+	for (i = hash & mask; node->children[i]; i = (i + 1) & mask) {
+		struct topic_node *child = node->children[i];
+
+		if (child->level_hash == hash && child->level_len == len &&
+				!memcmp(child->level, level, len))
+			return child;
+	}
+
+	return NULL;
+}
+
+static void node_table_put(struct topic_node **table, unsigned int size,
+		struct topic_node *child)
+{
+	unsigned int mask = size - 1;
+	unsigned int i;
+
+	for (i = child->level_hash & mask; table[i]; i = (i + 1) & mask)
+		;
+	table[i] = child;
+}
+
+static bool node_insert(struct topic_node *node, struct topic_node *child)
+{
+	if ((node->children_count + 1) * 4 > node->children_size * 3) {
+		unsigned int size = node->children_size ?
+			node->children_size * 2 : 4;
+		struct topic_node **table;
+		unsigned int i;
+
+		table = calloc(size, sizeof(struct topic_node *));
+		if (!table)
+			return false;
+
+		for (i = 0; i < node->children_size; i++)
+			if (node->children[i])
+				node_table_put(table, size,
+						node->children[i]);
+
+		free(node->children);
+		node->children = table;
+		node->children_size = size;
+	}
+
+	node_table_put(node->children, node->children_size, child);
+	node->children_count++;
+
+	return true;
+}
+
+static void node_erase(struct topic_node *node, struct topic_node *child)
+{
+	unsigned int mask = node->children_size - 1;
+	unsigned int i = child->level_hash & mask;
+	unsigned int j;
+
+	while (node->children[i] != child)
+		i = (i + 1) & mask;
+
+	/* Backward shift deletion keeps the probe sequences intact */
+	node->children[i] = NULL;
+	for (j = (i + 1) & mask; node->children[j]; j = (j + 1) & mask) {
+		unsigned int k = node->children[j]->level_hash & mask;
+
+		if ((j > i && (k <= i || k > j)) ||
+				(j < i && (k <= i && k > j))) {
+			node->children[i] = node->children[j];
+			node->children[j] = NULL;
+			i = j;
+		}
+	}
+
+	node->children_count--;
+}
+
+static struct topic_node *node_get_child(struct topic_node *node,
+		const char *level, size_t len)
+{
+	uint32_t hash = level_hash(level, len);
+	struct topic_node *child;
+
+	if (len == 1 && level[0] == '+' && node->plus)
+		return node->plus;
+	if (len == 1 && level[0] == '#' && node->hash)
+		return node->hash;
+
+	child = node_lookup(node, level, len, hash);
+	if (child)
+		return child;
+
+	child = calloc(1, sizeof(struct topic_node));
+	if (!child)
+		return NULL;
+
+	child->level = strndup(level, len);
+	if (!child->level) {
+		free(child);
+		return NULL;
+	}
+	child->level_len = len;
+	child->level_hash = hash;
+	child->parent = node;
+	child->qos = -1;
+
+	if (len == 1 && level[0] == '+') {
+		node->plus = child;
+	} else if (len == 1 && level[0] == '#') {
+		node->hash = child;
+	} else if (!node_insert(node, child)) {
+		free(child->level);
+		free(child);
+		return NULL;
+	}
+
+	return child;
+}
+
+static void node_free(struct topic_node *node)
+{
+	free(node->children);
+	free(node->filter);
+	free(node->level);
+	free(node);
+}
+
+/* Release the nodes left without subscriptions nor children */
+static void node_prune(struct topic_node *node)
+{
+	while (node->parent && !node->num_subs && !node->subs &&
+			!node->children_count && !node->plus && !node->hash) {
+		struct topic_node *parent = node->parent;
+
+		if (parent->plus == node)
+			parent->plus = NULL;
+		else if (parent->hash == node)
+			parent->hash = NULL;
+		else
+			node_erase(parent, node);
+
+		node_free(node);
+		node = parent;
+	}
+}
+
+static void node_free_all(struct topic_node *node)
+{
+	mqtt_topic_sub *sub = node->subs;
+	unsigned int i;
+
+	while (sub) {
+		mqtt_topic_sub *next = sub->next;
+
+		free(sub);
+		sub = next;
+	}
+
+	for (i = 0; i < node->children_size; i++)
+		if (node->children[i])
+			node_free_all(node->children[i]);
+	if (node->plus)
+		node_free_all(node->plus);
+	if (node->hash)
+		node_free_all(node->hash);
+
+	if (node->parent)
+		node_free(node);
+	else
+		free(node->children);
+}
+
+mqtt_topic_tree *mqtt_topic_tree_new(void)
+{
+	mqtt_topic_tree *tree = calloc(1, sizeof(mqtt_topic_tree));
+
+	if (tree)
+		tree->root.qos = -1;
+
+	return tree;
+}
+
+void mqtt_topic_tree_free(mqtt_topic_tree *tree)
+{
+	if (!tree)
+		return;
+
+	node_free_all(&tree->root);
+	free(tree->handles);
+	free(tree);
+}
+
+bool mqtt_topic_filter_is_valid(const char *filter)
+{
+	const char *level = filter;
+
+	if (!filter || !*filter)
+		return false;
+
+	for (;;) {
+		const char *end = strchr(level, '/');
+		size_t len = end ? (size_t)(end - level) : strlen(level);
+
+		if (memchr(level, '#', len) && (len != 1 || end))
+			return false;
+		if (memchr(level, '+', len) && len != 1)
+			return false;
+
+		if (!end)
+			return true;
+		level = end + 1;
+	}
+}
+
+mqtt_topic_sub *mqtt_topic_tree_add(mqtt_topic_tree *tree,
+		const char *filter, int qos, message_callback cb, void *data,
+		bool *subscribe)
+{
+	struct topic_node *node = &tree->root;
+	const char *level = filter;
+	mqtt_topic_sub *sub;
+
+	if (!mqtt_topic_filter_is_valid(filter) || !cb)
+		return NULL;
+
+	sub = calloc(1, sizeof(mqtt_topic_sub));
+	if (!sub)
+		return NULL;
+
+	if (!handle_insert(tree, sub)) {
+		free(sub);
+		return NULL;
+	}
+
+	for (;;) {
+		const char *end = strchr(level, '/');
+		size_t len = end ? (size_t)(end - level) : strlen(level);
+		struct topic_node *child = node_get_child(node, level, len);
+
+		if (!child) {
+			node_prune(node);
+			handle_erase(tree, sub);
+			free(sub);
+			return NULL;
+		}
+
+		node = child;
+		if (!end)
+			break;
+		level = end + 1;
+	}
+
+	if (!node->filter) {
+		node->filter = strdup(filter);
+		if (!node->filter) {
+			node_prune(node);
+			handle_erase(tree, sub);
+			free(sub);
+			return NULL;
+		}
+	}
+
+	sub->node = node;
+	sub->cb = cb;
+	sub->data = data;
+	sub->next = node->subs;
+	if (node->subs)
+		node->subs->prev = sub;
+	node->subs = sub;
+	node->num_subs++;
+
+	/* The broker subscription must have the highest requested QoS */
+	sub->prev_qos = node->qos;
+	*subscribe = qos > node->qos;
+	if (qos > node->qos)
+		node->qos = qos;
+
+	return sub;
+}
+
+bool mqtt_topic_tree_owns(mqtt_topic_tree *tree, mqtt_topic_sub *sub)
+{
+	unsigned int index;
+
+	return tree && sub && handle_find(tree, sub, &index);
+}
+
+const char *mqtt_topic_sub_filter(mqtt_topic_sub *sub)
+{
+	return sub->node->filter;
+}
+
+bool mqtt_topic_sub_is_last(mqtt_topic_sub *sub)
+{
+	return sub->node->num_subs == 1;
+}
+
+static void sub_unlink(mqtt_topic_sub *sub)
+{
+	struct topic_node *node = sub->node;
+
+	if (sub->prev)
+		sub->prev->next = sub->next;
+	else
+		node->subs = sub->next;
+	if (sub->next)
+		sub->next->prev = sub->prev;
+
+	free(sub);
+
+	if (!node->subs) {
+		free(node->filter);
+		node->filter = NULL;
+		node->qos = -1;
+		node_prune(node);
+	}
+}
+
+void mqtt_topic_tree_remove(mqtt_topic_tree *tree, mqtt_topic_sub *sub)
+{
+	handle_erase(tree, sub);
+	sub->cb = NULL;
+	sub->node->num_subs--;
+
+	if (tree->dispatching) {
+		sub->next_removed = tree->removed;
+		tree->removed = sub;
+		return;
+	}
+
+	sub_unlink(sub);
+}
+
+void mqtt_topic_tree_cancel(mqtt_topic_tree *tree, mqtt_topic_sub *sub)
+{
+	/* Restore the QoS the broker subscription still has */
+	sub->node->qos = sub->prev_qos;
+	mqtt_topic_tree_remove(tree, sub);
+}
+
+static unsigned int node_deliver(struct topic_node *node,
+		artik_mqtt_config *config, artik_mqtt_msg *msg)
+{
+	unsigned int count = 0;
+	mqtt_topic_sub *sub;
+
+	for (sub = node->subs; sub; sub = sub->next) {
+		if (!sub->cb)
+			continue;
+		sub->cb(config, sub->data, msg);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * 'level' is the remaining part of the topic, or NULL once all its
+ * levels have been consumed.
+ */
+static unsigned int node_match(struct topic_node *node, const char *level,
+		bool first, artik_mqtt_config *config, artik_mqtt_msg *msg)
+{
+	/* Wildcards do not match topics starting with '$' */
+	bool wildcards = !(first && msg->topic[0] == '$');
+	unsigned int count = 0;
+	struct topic_node *child;
+	const char *end;
+	const char *next;
+	size_t len;
+
+	/* '#' also matches the parent level, "a/#" matches "a" */
+	if (node->hash && wildcards)
+		count += node_deliver(node->hash, config, msg);
+
+	if (!level)
+		return count + node_deliver(node, config, msg);
+
+	end = strchr(level, '/');
+	len = end ? (size_t)(end - level) : strlen(level);
+	next = end ? end + 1 : NULL;
+
+	child = node_lookup(node, level, len, level_hash(level, len));
+	if (child)
+		count += node_match(child, next, false, config, msg);
+
+	if (node->plus && wildcards)
+		count += node_match(node->plus, next, false, config, msg);
+
+	return count;
+}
+
+unsigned int mqtt_topic_tree_dispatch(mqtt_topic_tree *tree,
+		artik_mqtt_config *config, artik_mqtt_msg *msg)
+{
+	unsigned int count;
+
+	tree->dispatching++;
+	count = node_match(&tree->root, msg->topic, true, config, msg);
+	tree->dispatching--;
+
+	if (!tree->dispatching) {
+		while (tree->removed) {
+			mqtt_topic_sub *sub = tree->removed;
+
+			tree->removed = sub->next_removed;
+			sub_unlink(sub);
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,42 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef __MQTT_TOPIC_TREE_H__
+#define __MQTT_TOPIC_TREE_H__
+
+#include <stdbool.h>
+#include <artik_mqtt.h>
+
+typedef struct mqtt_topic_tree mqtt_topic_tree;
+typedef struct mqtt_topic_sub mqtt_topic_sub;
+
+mqtt_topic_tree *mqtt_topic_tree_new(void);
+void mqtt_topic_tree_free(mqtt_topic_tree *tree);
+bool mqtt_topic_filter_is_valid(const char *filter);
+mqtt_topic_sub *mqtt_topic_tree_add(mqtt_topic_tree *tree,
+		const char *filter, int qos, message_callback cb, void *data,
+		bool *subscribe);
+bool mqtt_topic_tree_owns(mqtt_topic_tree *tree, mqtt_topic_sub *sub);
+const char *mqtt_topic_sub_filter(mqtt_topic_sub *sub);
+bool mqtt_topic_sub_is_last(mqtt_topic_sub *sub);
+void mqtt_topic_tree_remove(mqtt_topic_tree *tree, mqtt_topic_sub *sub);
+void mqtt_topic_tree_cancel(mqtt_topic_tree *tree, mqtt_topic_sub *sub);
+unsigned int mqtt_topic_tree_dispatch(mqtt_topic_tree *tree,
+		artik_mqtt_config *config, artik_mqtt_msg *msg);
+
+#endif  /* __MQTT_TOPIC_TREE_H__ */
@@ -25,7 +25,8 @@ enum MQTT_ERROR_CODE {
 	MQTT_ERROR_SUCCESS = 0,
 	MQTT_ERROR_PARAM,
 	MQTT_ERROR_NOMEM,
-	MQTT_ERROR_LIB
+	MQTT_ERROR_LIB,
+	MQTT_ERROR_NOT_SUPPORTED
 };
 
 artik_mqtt_handle mqtt_create_client(artik_mqtt_config *config);
@@ -53,5 +54,24 @@ int mqtt_client_subscribe(artik_mqtt_handle client, int qos,
 int mqtt_client_unsubscribe(artik_mqtt_handle client, const char *msgtopic);
 int mqtt_client_publish(artik_mqtt_handle client, int qos, bool retain,
 		const char *msg_topic, int payload_len, const char *msg_content);
+int mqtt_client_get_stats(artik_mqtt_handle client, artik_mqtt_stats *stats);
+int mqtt_client_enable_offline_queue(artik_mqtt_handle client,
+		const artik_mqtt_queue_config *config);
+int mqtt_client_disable_offline_queue(artik_mqtt_handle client);
+int mqtt_client_get_offline_queue_stats(artik_mqtt_handle client,
+		artik_mqtt_queue_stats *stats);
+int mqtt_client_add_subscription(artik_mqtt_handle client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription);
+int mqtt_client_remove_subscription(artik_mqtt_handle client,
+		artik_mqtt_subscription subscription);
+int mqtt_client_create_batch(artik_mqtt_handle client, const char *topic,
+		const artik_mqtt_batch_config *config, artik_mqtt_batch *batch);
+int mqtt_client_batch_publish(artik_mqtt_batch batch, int payload_len,
+		const char *payload);
+int mqtt_client_flush_batch(artik_mqtt_batch batch);
+int mqtt_client_destroy_batch(artik_mqtt_batch batch);
+int mqtt_client_get_batch_stats(artik_mqtt_batch batch,
+		artik_mqtt_batch_stats *stats);
 
 #endif
@@ -196,3 +196,171 @@ artik_error os_mqtt_publish(artik_mqtt_handle client, int qos, bool retain,
 
 	return S_OK;
 }
+
+artik_error os_mqtt_get_stats(artik_mqtt_handle client,
+		artik_mqtt_stats *stats)
+{
+	int ret;
+
+	if (!client || !stats)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_get_stats(client, stats);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_MQTT_ERROR;
+
+	return S_OK;
+}
+
+artik_error os_mqtt_enable_offline_queue(artik_mqtt_handle client,
+		const artik_mqtt_queue_config *config)
+{
+	int ret;
+
+	if (!client || !config || !config->path)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_enable_offline_queue(client, config);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_MQTT_ERROR;
+
+	return S_OK;
+}
+
+artik_error os_mqtt_disable_offline_queue(artik_mqtt_handle client)
+{
+	int ret;
+
+	if (!client)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_disable_offline_queue(client);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_MQTT_ERROR;
+
+	return S_OK;
+}
+
+artik_error os_mqtt_get_offline_queue_stats(artik_mqtt_handle client,
+		artik_mqtt_queue_stats *stats)
+{
+	int ret;
+
+	if (!client || !stats)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_get_offline_queue_stats(client, stats);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_MQTT_ERROR;
+
+	return S_OK;
+}
+
+artik_error os_mqtt_add_subscription(artik_mqtt_handle client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription)
+{
+	int ret;
+
+	if (!client || !filter || !cb || !subscription)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_add_subscription(client, qos, filter, cb, user_data,
+			subscription);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret == -MQTT_ERROR_PARAM)
+		return E_BAD_ARGS;
+	if (ret == -MQTT_ERROR_NOMEM)
+		return E_NO_MEM;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_MQTT_ERROR;
+
+	return S_OK;
+}
+
+artik_error os_mqtt_remove_subscription(artik_mqtt_handle client,
+		artik_mqtt_subscription subscription)
+{
+	int ret;
+
+	if (!client || !subscription)
+		return E_BAD_ARGS;
+
+	ret = mqtt_client_remove_subscription(client, subscription);
+	if (ret == -MQTT_ERROR_NOT_SUPPORTED)
+		return E_NOT_SUPPORTED;
+	if (ret != MQTT_ERROR_SUCCESS)
+		return E_BAD_ARGS;
+
+	return S_OK;
+}
+
+static artik_error os_mqtt_batch_error(int ret)
+{
+	switch (ret) {
+	case MQTT_ERROR_SUCCESS:
+		return S_OK;
+	case -MQTT_ERROR_PARAM:
+		return E_BAD_ARGS;
+	case -MQTT_ERROR_NOMEM:
+		return E_NO_MEM;
+	case -MQTT_ERROR_NOT_SUPPORTED:
+		return E_NOT_SUPPORTED;
+	default:
+		return E_MQTT_ERROR;
+	}
+}
+
+artik_error os_mqtt_create_batch(artik_mqtt_handle client, const char *topic,
+		const artik_mqtt_batch_config *config, artik_mqtt_batch *batch)
+{
+	if (!client || !topic || !config || !batch)
+		return E_BAD_ARGS;
+
+	return os_mqtt_batch_error(mqtt_client_create_batch(client, topic,
+			config, batch));
+}
+
+artik_error os_mqtt_batch_publish(artik_mqtt_batch batch, int payload_len,
+		const char *payload)
+{
+	if (!batch || !payload)
+		return E_BAD_ARGS;
+
+	return os_mqtt_batch_error(mqtt_client_batch_publish(batch,
+			payload_len, payload));
+}
+
+artik_error os_mqtt_flush_batch(artik_mqtt_batch batch)
+{
+	if (!batch)
+		return E_BAD_ARGS;
+
+	return os_mqtt_batch_error(mqtt_client_flush_batch(batch));
+}
+
+artik_error os_mqtt_destroy_batch(artik_mqtt_batch batch)
+{
+	if (!batch)
+		return E_BAD_ARGS;
+
+	return os_mqtt_batch_error(mqtt_client_destroy_batch(batch));
+}
+
+artik_error os_mqtt_get_batch_stats(artik_mqtt_batch batch,
+		artik_mqtt_batch_stats *stats)
+{
+	if (!batch || !stats)
+		return E_BAD_ARGS;
+
+	return os_mqtt_batch_error(mqtt_client_get_batch_stats(batch, stats));
+}
@@ -67,4 +67,35 @@ artik_error os_mqtt_publish(artik_mqtt_handle client, int qos, bool retain,
 		const char *msg_topic, int payload_len,
 		const char *msg_content);
 
+artik_error os_mqtt_get_stats(artik_mqtt_handle client,
+		artik_mqtt_stats *stats);
+
+artik_error os_mqtt_enable_offline_queue(artik_mqtt_handle client,
+		const artik_mqtt_queue_config *config);
+
+artik_error os_mqtt_disable_offline_queue(artik_mqtt_handle client);
+
+artik_error os_mqtt_get_offline_queue_stats(artik_mqtt_handle client,
+		artik_mqtt_queue_stats *stats);
+
+artik_error os_mqtt_add_subscription(artik_mqtt_handle client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription);
+
+artik_error os_mqtt_remove_subscription(artik_mqtt_handle client,
+		artik_mqtt_subscription subscription);
+
+artik_error os_mqtt_create_batch(artik_mqtt_handle client, const char *topic,
+		const artik_mqtt_batch_config *config, artik_mqtt_batch *batch);
+
+artik_error os_mqtt_batch_publish(artik_mqtt_batch batch, int payload_len,
+		const char *payload);
+
+artik_error os_mqtt_flush_batch(artik_mqtt_batch batch);
+
+artik_error os_mqtt_destroy_batch(artik_mqtt_batch batch);
+
+artik_error os_mqtt_get_batch_stats(artik_mqtt_batch batch,
+		artik_mqtt_batch_stats *stats);
+
 #endif  /* __OS_MQTT_H__ */
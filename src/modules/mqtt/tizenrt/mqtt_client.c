@@ -465,3 +465,68 @@ int mqtt_client_publish(artik_mqtt_handle handle_client, int qos, bool retain,
 
 	return rc ? -MQTT_ERROR_LIB : MQTT_ERROR_SUCCESS;
 }
+
+int mqtt_client_get_stats(artik_mqtt_handle handle_client,
+		artik_mqtt_stats *stats)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_enable_offline_queue(artik_mqtt_handle handle_client,
+		const artik_mqtt_queue_config *config)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_disable_offline_queue(artik_mqtt_handle handle_client)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_get_offline_queue_stats(artik_mqtt_handle handle_client,
+		artik_mqtt_queue_stats *stats)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_add_subscription(artik_mqtt_handle handle_client, int qos,
+		const char *filter, message_callback cb, void *user_data,
+		artik_mqtt_subscription *subscription)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_remove_subscription(artik_mqtt_handle handle_client,
+		artik_mqtt_subscription subscription)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_create_batch(artik_mqtt_handle handle_client,
+		const char *topic, const artik_mqtt_batch_config *config,
+		artik_mqtt_batch *batch)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_batch_publish(artik_mqtt_batch batch, int payload_len,
+		const char *payload)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_flush_batch(artik_mqtt_batch batch)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_destroy_batch(artik_mqtt_batch batch)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
+
+int mqtt_client_get_batch_stats(artik_mqtt_batch batch,
+		artik_mqtt_batch_stats *stats)
+{
+	return -MQTT_ERROR_NOT_SUPPORTED;
+}
@@ -0,0 +1,376 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+/*
+ * Load test of the batching message sender of the Cloud module. Devices
+ * each queue messages, which are posted to a local HTTP server run by
+ * the test itself unless another base URL is given. The server can be
+ * told to fail a share of the requests to exercise the retries.
+ *
+ * Results are printed as a single JSON object on stdout, logs go to
+ * stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <artik_module.h>
+#include <artik_loop.h>
+#include <artik_cloud.h>
+#include <artik_log.h>
+#include "cloud_test_server.h"
+
+#define BATCH_TOKEN		"00000000000000000000000000000000"
+
+struct batch_params {
+	const char *base_url;
+	unsigned int devices;
+	unsigned int messages;
+	artik_cloud_batch_mode mode;
+	unsigned int max_messages;
+	unsigned int max_age_ms;
+	unsigned int failure_rate;
+	unsigned int timeout;
+};
+
+static struct batch_params params = {
+	.base_url = NULL,
+	.devices = 10,
+	.messages = 1000,
+	.mode = ARTIK_CLOUD_BATCH_BULK,
+	.max_messages = 100,
+	.max_age_ms = 100,
+	.failure_rate = 0,
+	.timeout = 60
+};
+
+static artik_cloud_module *cloud;
+static artik_loop_module *loop;
+static artik_cloud_batch_handle batch;
+
+static uint64_t server_requests;
+static uint64_t server_failures;
+static uint64_t server_messages;
+
+static uint64_t expected;
+static uint64_t accepted;
+static uint64_t given_up;
+static uint64_t send_errors;
+
+static uint64_t start_time;
+static uint64_t end_time;
+static int timeout_id;
+static bool finished;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int count_messages(const char *body, size_t len)
+{
+	const char *pattern = "\"type\": \"message\"";
+	size_t pattern_len = strlen(pattern);
+	unsigned int count = 0;
+	size_t i;
+
+	if (len < pattern_len)
+		return 0;
+
+	for (i = 0; i <= len - pattern_len; i++) {
+		if (!memcmp(body + i, pattern, pattern_len)) {
+			count++;
+			i += pattern_len - 1;
+		}
+	}
+
+	return count;
+}
+
+static void on_request(struct test_request *request, void *user_data)
+{
+	bool failure;
+
+	server_requests++;
+	failure = params.failure_rate &&
+		(unsigned int)(rand() % 100) < params.failure_rate;
+	if (failure)
+		server_failures++;
+	else
+		server_messages += count_messages(request->body,
+				request->body_len);
+
+	test_request_reply(request, failure ? 503 : 200, "{}");
+}
+
+static void batch_finish(void)
+{
+	if (finished)
+		return;
+
+	finished = true;
+	end_time = now_ns();
+
+	if (timeout_id) {
+		loop->remove_timeout_callback(timeout_id);
+		timeout_id = 0;
+	}
+
+	loop->quit();
+}
+
+static void on_batch_done(artik_error result, const char *device_id,
+		unsigned int num_messages, void *user_data)
+{
+	if (result == S_OK) {
+		accepted += num_messages;
+	} else {
+		fprintf(stderr, "%u messages of %s given up: %s\n",
+				num_messages, device_id, error_msg(result));
+		given_up += num_messages;
+	}
+
+	if (accepted + given_up + send_errors >= expected)
+		batch_finish();
+}
+
+static void batch_timeout(void *user_data)
+{
+	timeout_id = 0;
+	fprintf(stderr, "Timeout, %llu of %llu messages done\n",
+			(unsigned long long)(accepted + given_up),
+			(unsigned long long)expected);
+	batch_finish();
+}
+
+static void batch_start(void)
+{
+	char device_id[64];
+	char message[128];
+	unsigned int i, j;
+
+	start_time = now_ns();
+	loop->add_timeout_callback(&timeout_id, params.timeout * 1000,
+			batch_timeout, NULL);
+
+	for (i = 0; i < params.messages; i++) {
+		for (j = 0; j < params.devices; j++) {
+			artik_error ret;
+
+			snprintf(device_id, sizeof(device_id),
+					"bench%08x%08x", getpid(), j);
+			snprintf(message, sizeof(message),
+					"{\"seq\": %u, \"value\": %u}", i,
+					j);
+
+			ret = cloud->batch_send_message(batch, NULL,
+					device_id, message);
+			if (ret != S_OK) {
+				fprintf(stderr, "Failed to queue message: "
+						"%s\n", error_msg(ret));
+				send_errors++;
+			}
+		}
+	}
+
+	cloud->batch_flush(batch);
+
+	if (send_errors >= expected)
+		batch_finish();
+}
+
+static void batch_report(void)
+{
+	double duration = (end_time - start_time) / 1e9;
+	artik_cloud_batch_stats stats;
+
+	memset(&stats, 0, sizeof(stats));
+	cloud->batch_get_stats(batch, &stats);
+
+	printf("{\"devices\": %u, \"messages\": %u, \"mode\": \"%s\", "
+		"\"max_messages\": %u, \"max_age_ms\": %u, "
+		"\"failure_rate\": %u, \"expected\": %llu, "
+		"\"accepted\": %llu, \"given_up\": %llu, "
+		"\"send_errors\": %llu, \"requests\": %lu, "
+		"\"retries\": %lu, \"server_requests\": %llu, "
+		"\"server_failures\": %llu, \"server_messages\": %llu, "
+		"\"duration_s\": %.3f, \"msgs_per_s\": %.1f, "
+		"\"msgs_per_request\": %.1f}\n",
+		params.devices, params.messages,
+		params.mode == ARTIK_CLOUD_BATCH_BULK ? "bulk" : "burst",
+		params.max_messages, params.max_age_ms, params.failure_rate,
+		(unsigned long long)expected, (unsigned long long)accepted,
+		(unsigned long long)given_up,
+		(unsigned long long)send_errors, stats.requests,
+		stats.retries, (unsigned long long)server_requests,
+		(unsigned long long)server_failures,
+		(unsigned long long)server_messages, duration,
+		duration > 0 ? accepted / duration : 0,
+		stats.requests ? (double)accepted / stats.requests : 0);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  -u <url>      base URL of the Cloud API, a local server is "
+		"started if not set\n"
+		"  -d <count>    devices (default %u)\n"
+		"  -n <count>    messages per device (default %u)\n"
+		"  -m <mode>     bulk or burst (default bulk)\n"
+		"  -b <count>    messages per batch (default %u)\n"
+		"  -a <ms>       max age of a queued message (default %u)\n"
+		"  -f <percent>  requests failed by the local server "
+		"(default %u)\n"
+		"  -t <seconds>  give up after this time (default %u)\n",
+		name, params.devices, params.messages, params.max_messages,
+		params.max_age_ms, params.failure_rate, params.timeout);
+}
+
+static bool parse_args(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "u:d:n:m:b:a:f:t:h")) != -1) {
+		switch (opt) {
+		case 'u':
+			params.base_url = optarg;
+			break;
+		case 'd':
+			params.devices = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			params.messages = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			if (!strcmp(optarg, "bulk"))
+				params.mode = ARTIK_CLOUD_BATCH_BULK;
+			else if (!strcmp(optarg, "burst"))
+				params.mode = ARTIK_CLOUD_BATCH_BURST;
+			else
+				return false;
+			break;
+		case 'b':
+			params.max_messages = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			params.max_age_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			params.failure_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			params.timeout = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return params.devices > 0 && params.messages > 0 &&
+		params.max_messages > 0 && params.failure_rate < 100 &&
+		params.timeout > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	artik_cloud_batch_config config;
+	char base_url[64];
+	artik_error err;
+	int ret = -1;
+
+	if (!parse_args(argc, argv)) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_CLOUD)) {
+		fprintf(stdout,
+			"TEST: Cloud module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_LOOP)) {
+		fprintf(stdout,
+			"TEST: LOOP module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	cloud = (artik_cloud_module *)artik_request_api_module("cloud");
+	loop = (artik_loop_module *)artik_request_api_module("loop");
+
+	if (!params.base_url) {
+		int port = test_server_start(loop, on_request, NULL);
+
+		if (port < 0) {
+			fprintf(stderr, "Failed to start the local server\n");
+			goto exit;
+		}
+
+		snprintf(base_url, sizeof(base_url),
+				"http://127.0.0.1:%d/v1.1", port);
+		params.base_url = base_url;
+	}
+
+	fprintf(stderr, "Sending %u messages of %u devices to %s\n",
+			params.messages, params.devices, params.base_url);
+
+	memset(&config, 0, sizeof(config));
+	config.base_url = params.base_url;
+	config.access_token = BATCH_TOKEN;
+	config.mode = params.mode;
+	config.max_messages = params.max_messages;
+	config.max_age_ms = params.max_age_ms;
+	config.retry_min_ms = 10;
+	config.retry_max_ms = 1000;
+	config.callback = on_batch_done;
+
+	err = cloud->batch_create(&batch, &config);
+	if (err != S_OK) {
+		fprintf(stderr, "Failed to create the batch: %s\n",
+				error_msg(err));
+		goto exit;
+	}
+
+	expected = (uint64_t)params.devices * params.messages;
+	batch_start();
+	if (!finished)
+		loop->run();
+
+	batch_report();
+	ret = accepted == expected ? 0 : -1;
+
+	cloud->batch_destroy(batch);
+
+exit:
+	test_server_stop();
+	artik_release_api_module(cloud);
+	artik_release_api_module(loop);
+
+	return ret;
+}
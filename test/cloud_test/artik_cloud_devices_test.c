@@ -0,0 +1,445 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+/*
+ * Exercise the device listings against a local server run from the loop
+ * of the test, serving the pages of a user owning a given number of
+ * devices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <artik_module.h>
+#include <artik_loop.h>
+#include <artik_cloud.h>
+#include <artik_log.h>
+#include "cloud_test_server.h"
+
+#define TEST_TIMEOUT_MS		5000
+#define TEST_SETTLE_MS		200
+#define TEST_MAX_HELD		8
+#define TEST_PAGE_MAX		2048
+
+struct devices_server {
+	/* Devices owned by the user */
+	unsigned int devices;
+	/* Total reported in the pages, omitted if not set */
+	bool report_total;
+	unsigned int total;
+	/* Pages after the first one held, then replied in reverse order */
+	unsigned int hold;
+	struct test_request *held[TEST_MAX_HELD];
+	unsigned int held_count;
+	unsigned int requests;
+};
+
+struct listing {
+	artik_cloud_device_iterator iterator;
+	unsigned int devices;
+	/* Device for which the callback stops or destroys the listing */
+	unsigned int stop_at;
+	unsigned int destroy_at;
+	bool finished;
+	artik_error result;
+	bool error;
+};
+
+static artik_cloud_module *cloud;
+static artik_loop_module *loop;
+static artik_cloud_session_handle session;
+static struct devices_server server;
+static bool timed_out;
+
+static unsigned int query_param(const char *path, const char *name)
+{
+	const char *value = strstr(path, name);
+
+	return value ? strtoul(value + strlen(name), NULL, 10) : 0;
+}
+
+static void reply_page(struct test_request *request)
+{
+	unsigned int offset = query_param(request->path, "offset=");
+	unsigned int count = query_param(request->path, "count=");
+	char page[TEST_PAGE_MAX];
+	size_t len;
+	unsigned int i;
+
+	len = snprintf(page, sizeof(page), "{\"data\": {\"devices\": [");
+	for (i = offset; i < offset + count && i < server.devices; i++)
+		len += snprintf(page + len, sizeof(page) - len,
+				"%s{\"id\": \"dev%u\", \"name\": \"device\"}",
+				i > offset ? ", " : "", i);
+	len += snprintf(page + len, sizeof(page) - len, "]}");
+	if (server.report_total)
+		len += snprintf(page + len, sizeof(page) - len,
+				", \"total\": %u", server.total);
+	snprintf(page + len, sizeof(page) - len, ", \"offset\": %u}",
+			offset);
+
+	test_request_reply(request, 200, page);
+}
+
+static void on_request(struct test_request *request, void *user_data)
+{
+	server.requests++;
+
+	if (!server.hold || !query_param(request->path, "offset=")) {
+		reply_page(request);
+		return;
+	}
+
+	server.held[server.held_count++] = request;
+	if (server.held_count < server.hold)
+		return;
+
+	while (server.held_count)
+		reply_page(server.held[--server.held_count]);
+}
+
+static void server_reset(unsigned int devices, bool report_total,
+		unsigned int total, unsigned int hold)
+{
+	memset(&server, 0, sizeof(server));
+	server.devices = devices;
+	server.report_total = report_total;
+	server.total = total;
+	server.hold = hold;
+}
+
+static void on_timeout(void *user_data)
+{
+	timed_out = true;
+	loop->quit();
+}
+
+/* Run the loop for a while, or until a callback quits it */
+static void run_loop(unsigned int msec)
+{
+	int timeout_id;
+
+	timed_out = false;
+	if (loop->add_timeout_callback(&timeout_id, msec, on_timeout,
+			NULL) != S_OK)
+		return;
+
+	loop->run();
+
+	if (!timed_out)
+		loop->remove_timeout_callback(timeout_id);
+}
+
+/* Let the requests in flight complete before the next test */
+static void settle(void)
+{
+	run_loop(TEST_SETTLE_MS);
+
+	while (server.held_count)
+		test_request_reply(server.held[--server.held_count], 500,
+				NULL);
+}
+
+static int on_device(artik_error result, const char *device,
+		unsigned int len, void *user_data)
+{
+	struct listing *listing = user_data;
+	char expected[32];
+	int expected_len;
+
+	if (listing->finished || (!listing->iterator && device)) {
+		fprintf(stdout, "TEST: callback called after the end\n");
+		listing->error = true;
+		return 0;
+	}
+
+	if (!device) {
+		listing->finished = true;
+		listing->result = result;
+		loop->quit();
+		return 0;
+	}
+
+	/* Devices are delivered in order whatever the pages completion */
+	expected_len = snprintf(expected, sizeof(expected),
+			"{\"id\": \"dev%u\",", listing->devices);
+	if (len < (unsigned int)expected_len ||
+			memcmp(device, expected, expected_len)) {
+		fprintf(stdout, "TEST: unexpected device %.*s\n", (int)len,
+				device);
+		listing->error = true;
+	}
+
+	listing->devices++;
+
+	if (listing->devices == listing->destroy_at) {
+		cloud->device_iterator_destroy(listing->iterator);
+		listing->iterator = NULL;
+		loop->quit();
+	}
+
+	if (listing->devices == listing->stop_at) {
+		loop->quit();
+		return 0;
+	}
+
+	return 1;
+}
+
+static artik_error start_listing(struct listing *listing,
+		unsigned int page_size, unsigned int prefetch)
+{
+	artik_cloud_device_iterator_config config;
+
+	memset(&config, 0, sizeof(config));
+	config.page_size = page_size;
+	config.prefetch = prefetch;
+
+	return cloud->device_iterator_create(&listing->iterator, session,
+			"user", &config, on_device, listing);
+}
+
+static artik_error end_listing(struct listing *listing)
+{
+	artik_error ret = S_OK;
+
+	settle();
+
+	if (listing->iterator)
+		ret = cloud->device_iterator_destroy(listing->iterator);
+
+	return listing->error ? E_BAD_ARGS : ret;
+}
+
+static artik_error test_out_of_order(void)
+{
+	struct listing listing;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	/* Pages 1 to 3 are fetched at once, then replied 3, 2, 1 */
+	server_reset(10, true, 10, 3);
+	memset(&listing, 0, sizeof(listing));
+
+	if (start_listing(&listing, 3, 2) != S_OK)
+		goto exit;
+
+	run_loop(TEST_TIMEOUT_MS);
+
+	if (listing.finished && listing.result == S_OK &&
+			listing.devices == 10 && server.requests == 4)
+		ret = S_OK;
+
+	if (end_listing(&listing) != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static artik_error test_stop(void)
+{
+	struct listing listing;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_reset(10, true, 10, 0);
+	memset(&listing, 0, sizeof(listing));
+	listing.stop_at = 5;
+
+	if (start_listing(&listing, 3, 1) != S_OK)
+		goto exit;
+
+	run_loop(TEST_TIMEOUT_MS);
+
+	/* Wait for the pages prefetched meanwhile to be dropped */
+	settle();
+
+	if (!listing.finished && listing.devices == 5)
+		ret = S_OK;
+
+	if (end_listing(&listing) != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static artik_error test_destroy_in_callback(void)
+{
+	struct listing listing;
+	artik_cloud_device_iterator iterator;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_reset(10, true, 10, 0);
+	memset(&listing, 0, sizeof(listing));
+	listing.destroy_at = 4;
+
+	if (start_listing(&listing, 3, 1) != S_OK)
+		goto exit;
+
+	iterator = listing.iterator;
+	run_loop(TEST_TIMEOUT_MS);
+	settle();
+
+	/* The handle is gone once destroyed */
+	if (!listing.finished && listing.devices == 4 && !listing.iterator &&
+			cloud->device_iterator_destroy(iterator) == E_BAD_ARGS)
+		ret = S_OK;
+
+	if (end_listing(&listing) != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static artik_error test_missing_total(void)
+{
+	struct listing listing;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	/* Pages are fetched one after the other until one is not full */
+	server_reset(7, false, 0, 0);
+	memset(&listing, 0, sizeof(listing));
+
+	if (start_listing(&listing, 3, 2) != S_OK)
+		goto exit;
+
+	run_loop(TEST_TIMEOUT_MS);
+
+	if (listing.finished && listing.result == S_OK &&
+			listing.devices == 7 && server.requests == 3)
+		ret = S_OK;
+
+	if (end_listing(&listing) != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static artik_error test_short_last_page(void)
+{
+	struct listing listing;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	/* Devices were removed since the total was computed */
+	server_reset(10, true, 12, 0);
+	memset(&listing, 0, sizeof(listing));
+
+	if (start_listing(&listing, 3, 1) != S_OK)
+		goto exit;
+
+	run_loop(TEST_TIMEOUT_MS);
+
+	if (listing.finished && listing.result == S_OK &&
+			listing.devices == 10 && server.requests == 4)
+		ret = S_OK;
+
+	if (end_listing(&listing) != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+int main(void)
+{
+	artik_cloud_session_config config;
+	artik_error ret = S_OK;
+	char base_url[64];
+	int port;
+
+	if (!artik_is_module_available(ARTIK_MODULE_CLOUD)) {
+		fprintf(stdout,
+			"TEST: Cloud module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_LOOP)) {
+		fprintf(stdout,
+			"TEST: LOOP module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	cloud = (artik_cloud_module *)artik_request_api_module("cloud");
+	loop = (artik_loop_module *)artik_request_api_module("loop");
+
+	port = test_server_start(loop, on_request, NULL);
+	if (port < 0) {
+		fprintf(stderr, "Failed to start the local server\n");
+		ret = E_NOT_CONNECTED;
+		goto exit;
+	}
+
+	snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d/v1.1",
+			port);
+
+	memset(&config, 0, sizeof(config));
+	config.base_url = base_url;
+	config.access_token = "token";
+
+	ret = cloud->session_create(&session, &config);
+	if (ret != S_OK) {
+		fprintf(stderr, "Failed to create the session: %s\n",
+				error_msg(ret));
+		goto exit;
+	}
+
+	if (test_out_of_order() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_stop() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_destroy_in_callback() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_missing_total() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_short_last_page() != S_OK)
+		ret = E_BAD_ARGS;
+
+	cloud->session_destroy(session);
+
+exit:
+	test_server_stop();
+	artik_release_api_module(cloud);
+	artik_release_api_module(loop);
+
+	return (ret == S_OK) ? 0 : -1;
+}
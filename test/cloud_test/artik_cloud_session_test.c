@@ -0,0 +1,453 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+/*
+ * Exercise the Cloud sessions against a local server run from the loop
+ * of the test. Requests are issued asynchronously only, a synchronous
+ * one would block the loop serving it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <artik_module.h>
+#include <artik_loop.h>
+#include <artik_cloud.h>
+#include <artik_log.h>
+#include "cloud_test_server.h"
+
+#define TEST_TIMEOUT_MS		5000
+#define TEST_TOKEN_LEN		300
+#define TEST_DEVICE_ID		"0123456789abcdef0123456789abcdef"
+#define TEST_MESSAGE		"{\"state\": true}"
+
+struct test_result {
+	bool done;
+	artik_error result;
+	char *response;
+	unsigned int values;
+};
+
+static artik_cloud_module *cloud;
+static artik_loop_module *loop;
+static char base_url[64];
+
+/* Handler of the server for the test being run */
+static test_request_handler server_handler;
+
+/* Authorization expected by the server, a failed check is reported */
+static char expected_auth[TEST_TOKEN_LEN + 16];
+static bool server_error;
+
+/* Request held by the server until the test replies to it */
+static struct test_request *held_request;
+
+static bool timed_out;
+
+static void on_request(struct test_request *request, void *user_data)
+{
+	size_t len;
+	const char *auth = test_request_header(request, "Authorization",
+			&len);
+
+	if (!auth || len != strlen(expected_auth) ||
+			strncmp(auth, expected_auth, len)) {
+		fprintf(stdout, "TEST: unexpected authorization for %s\n",
+				request->path);
+		server_error = true;
+	}
+
+	server_handler(request, user_data);
+}
+
+static void on_timeout(void *user_data)
+{
+	timed_out = true;
+	loop->quit();
+}
+
+/* Run the loop until a callback quits it, false on timeout */
+static bool run_loop(void)
+{
+	int timeout_id;
+
+	timed_out = false;
+	if (loop->add_timeout_callback(&timeout_id, TEST_TIMEOUT_MS,
+			on_timeout, NULL) != S_OK)
+		return false;
+
+	loop->run();
+
+	if (!timed_out)
+		loop->remove_timeout_callback(timeout_id);
+
+	return !timed_out;
+}
+
+static void on_response(artik_error result, char *response, void *user_data)
+{
+	struct test_result *res = user_data;
+
+	res->done = true;
+	res->result = result;
+	res->response = response;
+	loop->quit();
+}
+
+static artik_error create_session(artik_cloud_session_handle *session,
+		const char *token)
+{
+	artik_cloud_session_config config;
+
+	memset(&config, 0, sizeof(config));
+	config.base_url = base_url;
+	config.access_token = token;
+
+	snprintf(expected_auth, sizeof(expected_auth), "Bearer %s", token);
+	server_error = false;
+
+	return cloud->session_create(session, &config);
+}
+
+static void reply_user(struct test_request *request, void *user_data)
+{
+	if (strcmp(request->method, "GET") ||
+			strcmp(request->path, "/v1.1/users/self")) {
+		fprintf(stdout, "TEST: unexpected request %s %s\n",
+				request->method, request->path);
+		server_error = true;
+	}
+
+	test_request_reply(request, 200, "{\"data\": {\"id\": \"user\"}}");
+}
+
+static bool request_user(artik_cloud_session_handle session,
+		struct test_result *res)
+{
+	memset(res, 0, sizeof(*res));
+
+	if (cloud->session_request_async(session, ARTIK_HTTP_GET,
+			"users/self", NULL, on_response, res) != S_OK)
+		return false;
+
+	return run_loop() && res->result == S_OK && res->response &&
+		strstr(res->response, "\"user\"") && !server_error;
+}
+
+static artik_error test_long_token(void)
+{
+	artik_cloud_session_handle session;
+	char token[TEST_TOKEN_LEN + 1];
+	struct test_result res;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_handler = reply_user;
+
+	/* Longer than any fixed size authorization header */
+	memset(token, 'a', TEST_TOKEN_LEN / 2);
+	token[TEST_TOKEN_LEN / 2] = '\0';
+
+	if (create_session(&session, token) != S_OK)
+		goto exit;
+
+	if (!request_user(session, &res))
+		goto destroy;
+	free(res.response);
+
+	memset(token, 'b', TEST_TOKEN_LEN);
+	token[TEST_TOKEN_LEN] = '\0';
+	snprintf(expected_auth, sizeof(expected_auth), "Bearer %s", token);
+
+	if (cloud->session_set_token(session, token) != S_OK)
+		goto destroy;
+
+	/* The session must not rely on the caller keeping the token */
+	memset(token, 'c', TEST_TOKEN_LEN);
+
+	if (!request_user(session, &res))
+		goto destroy;
+	free(res.response);
+
+	ret = S_OK;
+
+destroy:
+	cloud->session_destroy(session);
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static void reply_message(struct test_request *request, void *user_data)
+{
+	const char *expected = "{\"type\": \"message\",\"sdid\": \""
+		TEST_DEVICE_ID "\",\"data\": " TEST_MESSAGE "}";
+
+	if (strcmp(request->method, "POST") ||
+			strcmp(request->path, "/v1.1/messages") ||
+			request->body_len != strlen(expected) ||
+			memcmp(request->body, expected, request->body_len)) {
+		fprintf(stdout, "TEST: unexpected message %s %s %.*s\n",
+				request->method, request->path,
+				(int)request->body_len, request->body);
+		server_error = true;
+	}
+
+	test_request_reply(request, 200, "{\"data\": {\"mid\": \"1\"}}");
+}
+
+static artik_error test_send_message(void)
+{
+	artik_cloud_session_handle session;
+	struct test_result res;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_handler = reply_message;
+
+	if (create_session(&session, "token") != S_OK)
+		goto exit;
+
+	memset(&res, 0, sizeof(res));
+	if (cloud->session_send_message_async(session, TEST_DEVICE_ID,
+			TEST_MESSAGE, on_response, &res) != S_OK)
+		goto destroy;
+
+	if (run_loop() && res.result == S_OK && res.response &&
+			strstr(res.response, "\"mid\"") && !server_error)
+		ret = S_OK;
+	free(res.response);
+
+destroy:
+	cloud->session_destroy(session);
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static void reply_devices(struct test_request *request, void *user_data)
+{
+	test_request_reply(request, 200, "{\"data\": {\"devices\": ["
+			"{\"id\": \"dev0\", \"name\": \"a\"}, "
+			"{\"id\": \"dev1\", \"name\": \"b\"}, "
+			"{\"id\": \"dev2\", \"name\": \"c\"}]}, \"total\": 3}");
+}
+
+static int on_device_id(const artik_json_token *token, const char *path,
+		void *user_data)
+{
+	struct test_result *res = user_data;
+	char expected[8];
+
+	snprintf(expected, sizeof(expected), "dev%u", res->values);
+	if (token->type != ARTIK_JSON_STRING ||
+			token->len != strlen(expected) ||
+			memcmp(token->value, expected, token->len))
+		res->result = E_INVALID_VALUE;
+
+	res->values++;
+
+	/* Stop once the first two devices are received */
+	return res->values < 2;
+}
+
+static void on_json_done(artik_error result, char *response, void *user_data)
+{
+	struct test_result *res = user_data;
+
+	res->done = true;
+	if (res->result == S_OK)
+		res->result = result;
+	free(response);
+	loop->quit();
+}
+
+static artik_error test_get_json(void)
+{
+	artik_cloud_session_handle session;
+	struct test_result res;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_handler = reply_devices;
+
+	if (create_session(&session, "token") != S_OK)
+		goto exit;
+
+	memset(&res, 0, sizeof(res));
+	if (cloud->session_get_json_async(session, "users/user/devices",
+			"data.devices[*].id", on_device_id, on_json_done,
+			&res) != S_OK)
+		goto destroy;
+
+	if (run_loop() && res.result == S_OK && res.values == 2 &&
+			!server_error)
+		ret = S_OK;
+
+destroy:
+	cloud->session_destroy(session);
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static void reply_not_found(struct test_request *request, void *user_data)
+{
+	test_request_reply(request, 404,
+			"{\"error\": {\"code\": 404, \"message\": \"none\"}}");
+}
+
+static artik_error test_http_error(void)
+{
+	artik_cloud_session_handle session;
+	struct test_result res;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_handler = reply_not_found;
+
+	if (create_session(&session, "token") != S_OK)
+		goto exit;
+
+	memset(&res, 0, sizeof(res));
+	if (cloud->session_request_async(session, ARTIK_HTTP_DELETE,
+			"devices/none", NULL, on_response, &res) != S_OK)
+		goto destroy;
+
+	if (run_loop() && res.result == E_HTTP_ERROR && !server_error)
+		ret = S_OK;
+	free(res.response);
+
+destroy:
+	cloud->session_destroy(session);
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+static void hold_request(struct test_request *request, void *user_data)
+{
+	held_request = request;
+	loop->quit();
+}
+
+static artik_error test_destroy_pending(void)
+{
+	artik_cloud_session_handle session;
+	struct test_result res;
+	artik_error ret = E_BAD_ARGS;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	server_handler = hold_request;
+	held_request = NULL;
+
+	if (create_session(&session, "token") != S_OK)
+		goto exit;
+
+	memset(&res, 0, sizeof(res));
+	if (cloud->session_request_async(session, ARTIK_HTTP_GET,
+			"users/self", NULL, on_response, &res) != S_OK) {
+		cloud->session_destroy(session);
+		goto exit;
+	}
+
+	if (!run_loop() || !held_request) {
+		cloud->session_destroy(session);
+		goto exit;
+	}
+
+	/* The request completes after the session is gone */
+	cloud->session_destroy(session);
+	test_request_reply(held_request, 200, "{}");
+	held_request = NULL;
+
+	if (run_loop() && res.done && res.result == E_INTERRUPTED &&
+			!res.response)
+		ret = S_OK;
+	free(res.response);
+
+exit:
+	if (held_request) {
+		test_request_reply(held_request, 500, NULL);
+		held_request = NULL;
+	}
+	fprintf(stdout, "TEST: %s %s\n", __func__,
+			ret == S_OK ? "succeeded" : "failed");
+	return ret;
+}
+
+int main(void)
+{
+	artik_error ret = S_OK;
+	int port;
+
+	if (!artik_is_module_available(ARTIK_MODULE_CLOUD)) {
+		fprintf(stdout,
+			"TEST: Cloud module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_LOOP)) {
+		fprintf(stdout,
+			"TEST: LOOP module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	cloud = (artik_cloud_module *)artik_request_api_module("cloud");
+	loop = (artik_loop_module *)artik_request_api_module("loop");
+
+	port = test_server_start(loop, on_request, NULL);
+	if (port < 0) {
+		fprintf(stderr, "Failed to start the local server\n");
+		ret = E_NOT_CONNECTED;
+		goto exit;
+	}
+
+	snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d/v1.1",
+			port);
+
+	if (test_long_token() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_send_message() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_get_json() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_http_error() != S_OK)
+		ret = E_BAD_ARGS;
+	if (test_destroy_pending() != S_OK)
+		ret = E_BAD_ARGS;
+
+exit:
+	test_server_stop();
+	artik_release_api_module(cloud);
+	artik_release_api_module(loop);
+
+	return (ret == S_OK) ? 0 : -1;
+}
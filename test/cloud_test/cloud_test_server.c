@@ -0,0 +1,368 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "cloud_test_server.h"
+
+#define SERVER_BACKLOG		128
+#define SERVER_BUF_SIZE		(256 * 1024)
+#define SERVER_HEADER_MAX	256
+
+struct server_conn {
+	struct server_conn *next;
+	int fd;
+	int watch_id;
+	char *buf;
+	size_t len;
+	struct test_request *request;
+	bool processing;
+	bool failed;
+};
+
+static artik_loop_module *loop;
+static test_request_handler handler;
+static void *handler_data;
+
+static int server_fd = -1;
+static int server_watch_id;
+static struct server_conn *server_conns;
+
+static void server_conn_close(struct server_conn *conn)
+{
+	struct server_conn **prev = &server_conns;
+
+	while (*prev && *prev != conn)
+		prev = &(*prev)->next;
+	if (*prev)
+		*prev = conn->next;
+
+	/* A request not replied to yet is released by the reply */
+	if (conn->request)
+		conn->request->conn = NULL;
+
+	if (conn->watch_id)
+		loop->remove_fd_watch(conn->watch_id);
+	close(conn->fd);
+	free(conn->buf);
+	free(conn);
+}
+
+static bool server_send(int fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t ret = send(fd, data, len, MSG_NOSIGNAL);
+
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return false;
+		}
+		data += ret;
+		len -= ret;
+	}
+
+	return true;
+}
+
+/* Copy the request line, headers and body into a request */
+static struct test_request *request_new(struct server_conn *conn,
+		size_t header_len, size_t body_len)
+{
+	struct test_request *request;
+	char *data;
+	char *sep;
+
+	request = calloc(1, sizeof(struct test_request) + header_len +
+			body_len + 1);
+	if (!request)
+		return NULL;
+
+	data = (char *)(request + 1);
+	memcpy(data, conn->buf, header_len + body_len);
+	data[header_len + body_len] = '\0';
+
+	/* Terminate the headers before the empty line */
+	data[header_len - 4] = '\0';
+	request->body = data + header_len;
+	request->body_len = body_len;
+
+	sep = strchr(data, ' ');
+	if (!sep || sep - data >= (int)sizeof(request->method))
+		goto error;
+	memcpy(request->method, data, sep - data);
+
+	request->path = sep + 1;
+	sep = strchr(request->path, ' ');
+	if (!sep)
+		goto error;
+	*sep = '\0';
+
+	sep = strstr(sep + 1, "\r\n");
+	request->headers = sep ? sep + 2 : data + header_len - 4;
+	request->conn = conn;
+
+	return request;
+
+error:
+	free(request);
+	return NULL;
+}
+
+/*
+ * Hand the complete requests available in the connection buffer, one at
+ * a time. Returns false if the connection must be closed.
+ */
+static bool server_process(struct server_conn *conn)
+{
+	while (!conn->request && !conn->failed) {
+		struct test_request *request;
+		char *end;
+		char *header;
+		size_t header_len;
+		size_t body_len = 0;
+
+		conn->buf[conn->len] = '\0';
+		end = strstr(conn->buf, "\r\n\r\n");
+		if (!end)
+			return conn->len < SERVER_BUF_SIZE;
+
+		header_len = end + 4 - conn->buf;
+		for (header = conn->buf; header < end; header++) {
+			if (!strncasecmp(header, "\r\nContent-Length:", 17)) {
+				body_len = strtoul(header + 17, NULL, 10);
+				break;
+			}
+		}
+
+		if (header_len + body_len > SERVER_BUF_SIZE)
+			return false;
+		if (conn->len < header_len + body_len)
+			return true;
+
+		request = request_new(conn, header_len, body_len);
+		if (!request)
+			return false;
+
+		conn->len -= header_len + body_len;
+		memmove(conn->buf, conn->buf + header_len + body_len,
+				conn->len);
+
+		conn->request = request;
+		handler(request, handler_data);
+	}
+
+	return !conn->failed;
+}
+
+static int on_server_conn(int fd, enum watch_io io, void *user_data)
+{
+	struct server_conn *conn = user_data;
+	bool keep;
+	ssize_t ret;
+
+	if (io & (WATCH_IO_ERR | WATCH_IO_HUP | WATCH_IO_NVAL))
+		goto close;
+
+	ret = recv(fd, conn->buf + conn->len, SERVER_BUF_SIZE - conn->len,
+			0);
+	if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+		return 1;
+	if (ret <= 0)
+		goto close;
+
+	conn->len += ret;
+
+	conn->processing = true;
+	keep = server_process(conn);
+	conn->processing = false;
+	if (keep)
+		return 1;
+
+close:
+	conn->watch_id = 0;
+	server_conn_close(conn);
+	return 0;
+}
+
+static int on_server_accept(int fd, enum watch_io io, void *user_data)
+{
+	struct server_conn *conn;
+	int client;
+
+	client = accept(fd, NULL, NULL);
+	if (client < 0)
+		return 1;
+
+	conn = calloc(1, sizeof(struct server_conn));
+	if (conn)
+		conn->buf = malloc(SERVER_BUF_SIZE + 1);
+	if (!conn || !conn->buf) {
+		free(conn);
+		close(client);
+		return 1;
+	}
+
+	conn->fd = client;
+	if (loop->add_fd_watch(client, WATCH_IO_IN | WATCH_IO_ERR |
+			WATCH_IO_HUP | WATCH_IO_NVAL, on_server_conn, conn,
+			&conn->watch_id) != S_OK) {
+		free(conn->buf);
+		free(conn);
+		close(client);
+		return 1;
+	}
+
+	conn->next = server_conns;
+	server_conns = conn;
+
+	return 1;
+}
+
+int test_server_start(artik_loop_module *loop_module,
+		test_request_handler request_handler, void *user_data)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int one = 1;
+
+	loop = loop_module;
+	handler = request_handler;
+	handler_data = user_data;
+
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (server_fd < 0)
+		return -1;
+
+	setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(server_fd, SERVER_BACKLOG) < 0 ||
+			getsockname(server_fd, (struct sockaddr *)&addr,
+				&addr_len) < 0)
+		goto error;
+
+	if (loop->add_fd_watch(server_fd, WATCH_IO_IN, on_server_accept,
+			NULL, &server_watch_id) != S_OK)
+		goto error;
+
+	return ntohs(addr.sin_port);
+
+error:
+	close(server_fd);
+	server_fd = -1;
+	return -1;
+}
+
+void test_server_stop(void)
+{
+	while (server_conns)
+		server_conn_close(server_conns);
+
+	if (server_fd < 0)
+		return;
+
+	loop->remove_fd_watch(server_watch_id);
+	close(server_fd);
+	server_fd = -1;
+}
+
+const char *test_request_header(const struct test_request *request,
+		const char *name, size_t *len)
+{
+	size_t name_len = strlen(name);
+	const char *line = request->headers;
+
+	while (*line) {
+		const char *end = strstr(line, "\r\n");
+
+		if (!end)
+			end = line + strlen(line);
+
+		if (!strncasecmp(line, name, name_len) &&
+				line[name_len] == ':') {
+			const char *value = line + name_len + 1;
+
+			while (*value == ' ')
+				value++;
+			if (len)
+				*len = end - value;
+			return value;
+		}
+
+		line = *end ? end + 2 : end;
+	}
+
+	return NULL;
+}
+
+bool test_request_reply(struct test_request *request, int status,
+		const char *body)
+{
+	struct server_conn *conn = request->conn;
+	char header[SERVER_HEADER_MAX];
+	size_t body_len = body ? strlen(body) : 0;
+	bool sent;
+	int len;
+
+	free(request);
+
+	/* The client went away */
+	if (!conn)
+		return false;
+
+	conn->request = NULL;
+
+	len = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n"
+			"Content-Type: application/json\r\n"
+			"Content-Length: %zu\r\n\r\n", status,
+			status >= 200 && status < 300 ? "OK" : "Error",
+			body_len);
+
+	if (!server_send(conn->fd, header, len) ||
+			!server_send(conn->fd, body, body_len))
+		conn->failed = true;
+	sent = !conn->failed;
+
+	/* Deferred replies resume the requests buffered meanwhile */
+	if (!conn->processing) {
+		bool keep;
+
+		conn->processing = true;
+		keep = server_process(conn);
+		conn->processing = false;
+		if (!keep)
+			server_conn_close(conn);
+	}
+
+	return sent;
+}
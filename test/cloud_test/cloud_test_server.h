@@ -0,0 +1,58 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+#ifndef CLOUD_TEST_SERVER_H_
+#define CLOUD_TEST_SERVER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <artik_loop.h>
+
+/*
+ * HTTP server run from the loop of a test on the loopback interface,
+ * standing for the Cloud API. The requests of a connection are handed
+ * to the test one at a time, the next one waiting until the current one
+ * is replied to, which the test may defer to reorder the responses.
+ */
+struct test_request {
+	char method[8];
+	char *path;
+	char *headers;
+	char *body;
+	size_t body_len;
+	void *conn;
+};
+
+typedef void (*test_request_handler)(struct test_request *request,
+		void *user_data);
+
+/* Returns the port the server listens on, -1 on error */
+int test_server_start(artik_loop_module *loop,
+		test_request_handler handler, void *user_data);
+void test_server_stop(void);
+
+/* Value of a header of the request, NULL if not present */
+const char *test_request_header(const struct test_request *request,
+		const char *name, size_t *len);
+
+/* Reply to a request and release it, the body can be NULL */
+bool test_request_reply(struct test_request *request, int status,
+		const char *body);
+
+#endif /* CLOUD_TEST_SERVER_H_ */
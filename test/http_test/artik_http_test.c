@@ -451,6 +451,127 @@ artik_error test_http_del(bool verify, bool secure)
 	return ret;
 }
 
+artik_error test_http_request(bool verify, bool secure)
+{
+	artik_http_module *http = (artik_http_module *)
+					artik_request_api_module("http");
+	artik_error ret = S_OK;
+	artik_ssl_config ssl_config = { 0 };
+	artik_http_response response = { 0 };
+	char buffer[2048];
+	int status = 0;
+	const char *url = secure ? "https://httpbin.org/bytes/1024" :
+						"http://httpbin.org/bytes/1024";
+
+	ssl_config.ca_cert.data = (char *)httpbin_root_ca;
+	ssl_config.ca_cert.len = strlen(httpbin_root_ca);
+
+	if (verify)
+		ssl_config.verify_cert = ARTIK_SSL_VERIFY_REQUIRED;
+	else
+		ssl_config.verify_cert = ARTIK_SSL_VERIFY_NONE;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	/* Binary body received in a buffer allocated by the module */
+	ret = http->request(ARTIK_HTTP_GET, url, NULL, NULL, 0, &response,
+			&status, secure ? &ssl_config : NULL);
+	if (ret != S_OK || response.len != 1024) {
+		fprintf(stdout, "TEST: %s failed (len=%u, err=%d)\n", __func__,
+							response.len, ret);
+		ret = (ret != S_OK) ? ret : E_HTTP_ERROR;
+		free(response.data);
+		goto exit;
+	}
+
+	free(response.data);
+
+	/* Binary body received in place in a caller provided buffer */
+	response.data = buffer;
+	response.size = sizeof(buffer);
+	response.len = 0;
+
+	ret = http->request(ARTIK_HTTP_GET, url, NULL, NULL, 0, &response,
+			&status, secure ? &ssl_config : NULL);
+	if (ret != S_OK || response.len != 1024 || response.data != buffer) {
+		fprintf(stdout, "TEST: %s failed (buffer) (len=%u, err=%d)\n",
+						__func__, response.len, ret);
+		ret = (ret != S_OK) ? ret : E_HTTP_ERROR;
+		goto exit;
+	}
+
+	fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+exit:
+	artik_release_api_module(http);
+
+	return ret;
+}
+
+artik_error test_http_pool(bool verify, bool secure)
+{
+	artik_http_module *http = (artik_http_module *)
+					artik_request_api_module("http");
+	artik_error ret = S_OK;
+	char *response = NULL;
+	artik_ssl_config ssl_config = { 0 };
+	artik_http_pool_stats before, after;
+	const char *url = secure ? "https://httpbin.org/get" :
+						"http://httpbin.org/get";
+	int i;
+
+	ssl_config.ca_cert.data = (char *)httpbin_root_ca;
+	ssl_config.ca_cert.len = strlen(httpbin_root_ca);
+
+	if (verify)
+		ssl_config.verify_cert = ARTIK_SSL_VERIFY_REQUIRED;
+	else
+		ssl_config.verify_cert = ARTIK_SSL_VERIFY_NONE;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	ret = http->get_pool_stats(&before);
+	if (ret != S_OK) {
+		fprintf(stdout, "TEST: %s failed (stats) (err=%d)\n", __func__,
+									ret);
+		goto exit;
+	}
+
+	for (i = 0; i < 2; i++) {
+		ret = http->get(url, NULL, &response, NULL,
+					secure ? &ssl_config : NULL);
+		if (ret != S_OK) {
+			fprintf(stdout, "TEST: %s failed (err=%d)\n", __func__,
+									ret);
+			goto exit;
+		}
+
+		free(response);
+		response = NULL;
+	}
+
+	http->get_pool_stats(&after);
+
+	fprintf(stdout, "TEST: %s hits=%lu misses=%lu pools=%u idle=%u\n",
+		__func__, after.hits, after.misses, after.pools,
+		after.idle_handles);
+
+	/* The second request must have been served by the pooled handle */
+	if (after.hits <= before.hits) {
+		fprintf(stdout, "TEST: %s failed (handle not reused)\n",
+								__func__);
+		ret = E_HTTP_ERROR;
+		goto exit;
+	}
+
+	fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+exit:
+	artik_release_api_module(http);
+
+	return ret;
+}
+
 artik_error test_http_async(bool verify, bool secure)
 {
 	artik_http_module *http = (artik_http_module *)
@@ -623,6 +744,14 @@ int main(int argc, char *argv[])
 	if (ret != S_OK)
 		goto exit;
 
+	ret = test_http_request(verify, secure);
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_http_pool(verify, secure);
+	if (ret != S_OK)
+		goto exit;
+
 	ret = test_http_async(verify, secure);
 
 exit:
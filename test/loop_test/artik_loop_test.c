@@ -17,6 +17,8 @@
  */
 
 #include <stdio.h>
+#include <signal.h>
+#include <string.h>
 
 #include <artik_module.h>
 #include <artik_platform.h>
@@ -90,6 +92,175 @@ exit:
 	return ret;
 }
 
+static int workers_done = 0;
+
+static void on_worker_done(void *user_data)
+{
+	artik_loop_module *loop = (artik_loop_module *) user_data;
+
+	/* Runs in the main context */
+	workers_done++;
+	if (workers_done == 2) {
+		fprintf(stdout, "TEST: %s triggered, exiting loop\n", __func__);
+		loop->quit();
+	}
+}
+
+static void on_worker_timeout(void *user_data)
+{
+	artik_loop_module *loop = (artik_loop_module *) user_data;
+
+	/* Runs in a worker thread, hand over to the main context */
+	loop->post_callback(ARTIK_LOOP_AFFINITY_MAIN, on_worker_done, loop);
+}
+
+artik_error test_loop_workers(void)
+{
+	artik_loop_module *loop = (artik_loop_module *)
+					artik_request_api_module("loop");
+	artik_error ret = S_OK;
+	int id = 0;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+	ret = loop->start_workers(2);
+	if (ret != S_OK)
+		goto exit;
+
+	ret = loop->add_timeout_callback_on(0, &id, 500, on_worker_timeout,
+				   (void *)loop);
+	if (ret != S_OK)
+		goto stop;
+
+	ret = loop->add_timeout_callback_on(1, &id, 1000, on_worker_timeout,
+				   (void *)loop);
+	if (ret != S_OK)
+		goto stop;
+
+	loop->run();
+
+stop:
+	loop->stop_workers();
+exit:
+	fprintf(stdout, "TEST: %s %s\n", __func__, (ret == S_OK) ?
+			"succeeded" : "failed");
+	artik_release_api_module(loop);
+	return ret;
+}
+
+#define TEST_TIMERS_COUNT	1000
+
+static int timers_fired = 0;
+
+static void on_timer_fired(void *user_data)
+{
+	timers_fired++;
+}
+
+static void on_timers_done(void *user_data)
+{
+	artik_loop_module *loop = (artik_loop_module *) user_data;
+
+	fprintf(stdout, "TEST: %s triggered with %d timers fired\n", __func__,
+			timers_fired);
+	loop->quit();
+}
+
+artik_error test_loop_timers(void)
+{
+	artik_loop_module *loop = (artik_loop_module *)
+					artik_request_api_module("loop");
+	artik_error ret = S_OK;
+	int ids[TEST_TIMERS_COUNT];
+	int i, id = 0;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	ret = loop->set_timer_slack(10);
+	if (ret != S_OK)
+		goto exit;
+
+	for (i = 0; i < TEST_TIMERS_COUNT; i++) {
+		ret = loop->add_timeout_callback(&ids[i], 100 + i,
+				on_timer_fired, NULL);
+		if (ret != S_OK)
+			goto exit;
+	}
+
+	/* Cancel every other timer */
+	for (i = 0; i < TEST_TIMERS_COUNT; i += 2) {
+		ret = loop->remove_timeout_callback(ids[i]);
+		if (ret != S_OK)
+			goto exit;
+	}
+
+	ret = loop->add_timeout_callback(&id, 200 + TEST_TIMERS_COUNT,
+				on_timers_done, (void *)loop);
+	if (ret != S_OK)
+		goto exit;
+
+	loop->run();
+
+	if (timers_fired != TEST_TIMERS_COUNT / 2)
+		ret = E_BAD_ARGS;
+
+exit:
+	loop->set_timer_slack(0);
+	fprintf(stdout, "TEST: %s %s\n", __func__, (ret == S_OK) ?
+			"succeeded" : "failed");
+	artik_release_api_module(loop);
+	return ret;
+}
+
+artik_error test_loop_stats(void)
+{
+	artik_loop_module *loop = (artik_loop_module *)
+					artik_request_api_module("loop");
+	artik_loop_stats stats;
+	artik_error ret = S_OK;
+	unsigned int i, dispatched = 0;
+	int id = 0;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	ret = loop->enable_stats(true, SIGUSR1);
+	if (ret != S_OK)
+		goto exit;
+
+	/* Recorded under the given tag rather than the executable's */
+	loop->set_stats_tag("test");
+	ret = loop->add_timeout_callback(&id, 100, on_timeout_callback,
+				   (void *)loop);
+	if (ret != S_OK)
+		goto exit;
+
+	loop->run();
+
+	ret = loop->get_stats(&stats);
+	if (ret != S_OK)
+		goto exit;
+
+	for (i = 0; i < stats.num_tags; i++) {
+		fprintf(stdout, "TEST: %s [%s] %u timers, max run %u us, max latency %u us\n",
+			__func__, stats.tags[i].tag,
+			stats.tags[i].dispatched[ARTIK_LOOP_SOURCE_TIMER],
+			stats.tags[i].max_run_time_us,
+			stats.tags[i].max_latency_us);
+		if (!strcmp(stats.tags[i].tag, "test"))
+			dispatched += stats.tags[i].dispatched[
+						ARTIK_LOOP_SOURCE_TIMER];
+	}
+
+	if (dispatched != 1)
+		ret = E_BAD_ARGS;
+
+exit:
+	loop->enable_stats(false, 0);
+	fprintf(stdout, "TEST: %s %s\n", __func__, (ret == S_OK) ?
+			"succeeded" : "failed");
+	artik_release_api_module(loop);
+	return ret;
+}
+
 int main(void)
 {
 	artik_error ret = S_OK;
@@ -106,6 +277,18 @@ int main(void)
 		goto exit;
 
 	ret = test_loop_periodic();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_loop_workers();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_loop_timers();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_loop_stats();
 
 exit:
 	return ((ret == S_OK) ? 0 : -1);
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <artik_module.h>
 #include <artik_platform.h>
@@ -193,6 +194,76 @@ artik_error test_device_information(void)
 	return S_OK;
 }
 
+artik_error test_preload_modules(void)
+{
+	artik_api_module *modules = NULL;
+	artik_module_load_info *info = NULL;
+	int i, num = 0;
+	artik_error ret = S_OK;
+
+	fprintf(stdout, "TEST: %s\n", __func__);
+
+	ret = artik_get_available_modules(&modules, &num);
+	if (ret != S_OK)
+		return ret;
+
+	info = malloc(num * sizeof(artik_module_load_info));
+	if (!info)
+		return E_NO_MEM;
+
+	ret = artik_preload_modules();
+	if (ret != S_OK)
+		fprintf(stdout, "Some modules could not be preloaded\n");
+
+	ret = artik_get_modules_load_info(info, &num);
+	if (ret != S_OK)
+		goto exit;
+
+	for (i = 0; i < num; i++)
+		fprintf(stdout, "\t%s: %s in %u us\n", info[i].name,
+			info[i].loaded ? "loaded" : "not loaded",
+			info[i].load_time_us);
+
+exit:
+	free(info);
+	return ret;
+}
+
+#define TEST_REQUEST_COUNT	100000
+
+artik_error test_request_module(void)
+{
+	artik_module_ops loop, ops;
+	struct timespec start, end;
+	long long elapsed;
+	int i;
+
+	fprintf(stdout, "TEST: %s\n", __func__);
+
+	/* Keep the module loaded so that requests hit the fast path */
+	loop = artik_request_api_module("loop");
+	if (loop == INVALID_MODULE)
+		return E_NOT_SUPPORTED;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < TEST_REQUEST_COUNT; i++) {
+		ops = artik_request_api_module("loop");
+		if (ops != loop) {
+			artik_release_api_module(loop);
+			return E_BAD_ARGS;
+		}
+		artik_release_api_module(ops);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) * 1000000000LL +
+						end.tv_nsec - start.tv_nsec;
+	fprintf(stdout, "Request/release of a loaded module: %lld ns\n",
+			elapsed / TEST_REQUEST_COUNT);
+
+	return artik_release_api_module(loop);
+}
+
 int main(void)
 {
 	artik_error ret = S_OK;
@@ -239,6 +310,14 @@ int main(void)
 	if (ret != S_OK)
 		goto exit;
 
+	ret = test_request_module();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_preload_modules();
+	if (ret != S_OK)
+		goto exit;
+
 exit:
 	return (ret == S_OK) ? 0 : -1;
 }
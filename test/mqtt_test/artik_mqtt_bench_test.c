@@ -0,0 +1,738 @@
+/*
+ *
+ * Copyright 2017 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+/*
+ * Load test of the MQTT module. Publishers each send messages on their
+ * own topic, and every subscriber receives the messages of all of them,
+ * so each message is delivered 'subscribers' times. The publish time is
+ * carried in the payload to measure the publish to receive latency.
+ *
+ * Results are printed as a single JSON object on stdout, logs go to
+ * stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <artik_module.h>
+#include <artik_platform.h>
+#include <artik_loop.h>
+#include <artik_mqtt.h>
+#include <artik_log.h>
+
+#define BROKER_PORT		1883
+#define BENCH_TOPIC_PREFIX	"artik/bench/"
+#define BENCH_TOPIC_FILTER	BENCH_TOPIC_PREFIX "+"
+#define BENCH_PUMP_PERIOD	10	/* ms */
+#define BENCH_BROKER_RETRIES	50
+#define BENCH_BROKER_DELAY	100000	/* us */
+
+struct bench_header {
+	uint64_t timestamp;
+	uint32_t seq;
+	uint32_t publisher;
+};
+
+struct bench_client {
+	artik_mqtt_handle handle;
+	artik_mqtt_config config;
+	artik_mqtt_batch batch;
+	char id[64];
+	char topic[64];
+	bool publisher;
+	unsigned int index;
+	unsigned int sent;
+};
+
+struct bench_params {
+	const char *host;
+	int port;
+	const char *broker;
+	unsigned int publishers;
+	unsigned int subscribers;
+	unsigned int messages;
+	int qos;
+	unsigned int payload_len;
+	unsigned int rate;
+	unsigned int window;
+	unsigned int batch_window;
+	unsigned int timeout;
+};
+
+static struct bench_params params = {
+	.host = "127.0.0.1",
+	.port = BROKER_PORT,
+	.broker = NULL,
+	.publishers = 1,
+	.subscribers = 1,
+	.messages = 1000,
+	.qos = 0,
+	.payload_len = 64,
+	.rate = 0,
+	.window = 1000,
+	.batch_window = 0,
+	.timeout = 60
+};
+
+static artik_mqtt_module *mqtt;
+static artik_loop_module *loop;
+static struct bench_client *clients;
+static unsigned int num_clients;
+static unsigned int num_ready;
+static char *payload;
+
+static uint64_t *latencies;
+static uint64_t expected;
+static uint64_t received;
+static uint64_t sent;
+static uint64_t publish_errors;
+
+static uint64_t start_time;
+static uint64_t end_time;
+static struct rusage start_usage;
+static struct rusage end_usage;
+static uint64_t broker_start_cpu;
+static uint64_t broker_end_cpu;
+static long rss_before_clients;
+static long rss_after_clients;
+static pid_t broker_pid;
+
+static int pump_id;
+static int idle_id;
+static int timeout_id;
+static bool finished;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t timeval_us(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+/* Resident set size of the process in kB, -1 if unknown */
+static long read_rss_kb(void)
+{
+	FILE *f = fopen("/proc/self/status", "r");
+	char line[128];
+	long rss = -1;
+
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+			break;
+	}
+
+	fclose(f);
+
+	return rss;
+}
+
+/* User and system CPU time used by a process in us, 0 if unknown */
+static uint64_t read_process_cpu_us(pid_t pid)
+{
+	unsigned long utime = 0, stime = 0;
+	char path[64];
+	char buf[1024];
+	char *p;
+	FILE *f;
+	size_t len;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = '\0';
+
+	/* Fields 14 and 15, counted after the command name */
+	p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+			"%lu %lu", &utime, &stime) != 2)
+		return 0;
+
+	return (uint64_t)(utime + stime) * 1000000ULL / sysconf(_SC_CLK_TCK);
+}
+
+static bool broker_reachable(void)
+{
+	struct sockaddr_in addr;
+	int ret;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(params.port);
+	addr.sin_addr.s_addr = inet_addr(params.host);
+
+	ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+	close(fd);
+
+	return ret == 0;
+}
+
+static bool broker_start(void)
+{
+	char port[16];
+	int i;
+
+	snprintf(port, sizeof(port), "%d", params.port);
+
+	broker_pid = fork();
+	if (broker_pid < 0) {
+		fprintf(stderr, "Failed to fork the broker (err=%d)\n", errno);
+		return false;
+	}
+
+	if (broker_pid == 0) {
+		execlp(params.broker, params.broker, "-p", port, (char *)NULL);
+		fprintf(stderr, "Failed to run %s (err=%d)\n", params.broker,
+				errno);
+		_exit(1);
+	}
+
+	for (i = 0; i < BENCH_BROKER_RETRIES; i++) {
+		if (broker_reachable())
+			return true;
+		if (waitpid(broker_pid, NULL, WNOHANG) == broker_pid) {
+			broker_pid = 0;
+			break;
+		}
+		usleep(BENCH_BROKER_DELAY);
+	}
+
+	fprintf(stderr, "Broker %s is not reachable on port %d\n",
+			params.broker, params.port);
+
+	return false;
+}
+
+static void broker_stop(void)
+{
+	if (broker_pid <= 0)
+		return;
+
+	kill(broker_pid, SIGTERM);
+	waitpid(broker_pid, NULL, 0);
+	broker_pid = 0;
+}
+
+static void bench_finish(void)
+{
+	if (finished)
+		return;
+
+	finished = true;
+	end_time = now_ns();
+	getrusage(RUSAGE_SELF, &end_usage);
+	if (broker_pid > 0)
+		broker_end_cpu = read_process_cpu_us(broker_pid);
+
+	if (pump_id)
+		loop->remove_periodic_callback(pump_id);
+	if (idle_id)
+		loop->remove_idle_callback(idle_id);
+	if (timeout_id)
+		loop->remove_timeout_callback(timeout_id);
+
+	loop->quit();
+}
+
+static bool bench_publish(struct bench_client *client)
+{
+	struct bench_header *header = (struct bench_header *)payload;
+	artik_error ret;
+
+	header->timestamp = now_ns();
+	header->seq = client->sent;
+	header->publisher = client->index;
+
+	if (client->batch)
+		ret = mqtt->batch_publish(client->batch, params.payload_len,
+				payload);
+	else
+		ret = mqtt->publish(client->handle, params.qos, false,
+				client->topic, params.payload_len, payload);
+
+	if (ret != S_OK) {
+		publish_errors++;
+		return false;
+	}
+
+	client->sent++;
+	sent++;
+
+	return true;
+}
+
+/*
+ * Publish round robin over the publishers, within the rate limit and
+ * while less than 'window' deliveries are pending. Return true once all
+ * the messages are sent.
+ */
+static bool bench_pump(void)
+{
+	uint64_t budget = UINT64_MAX;
+	uint64_t total = (uint64_t)params.publishers * params.messages;
+	unsigned int i;
+	bool progress = true;
+
+	if (params.rate) {
+		uint64_t allowed = (now_ns() - start_time) * params.rate /
+			1000000000ULL;
+
+		budget = allowed > sent ? allowed - sent : 0;
+	}
+
+	while (sent < total && budget && progress) {
+		progress = false;
+
+		for (i = 0; i < num_clients && sent < total && budget; i++) {
+			struct bench_client *client = &clients[i];
+
+			if (!client->publisher ||
+					client->sent >= params.messages)
+				continue;
+
+			if (sent * params.subscribers - received >=
+					params.window)
+				return false;
+
+			if (!bench_publish(client))
+				return false;
+
+			budget--;
+			progress = true;
+		}
+	}
+
+	if (sent < total)
+		return false;
+
+	for (i = 0; i < num_clients; i++)
+		if (clients[i].batch)
+			mqtt->flush_batch(clients[i].batch);
+
+	return true;
+}
+
+static int bench_pump_periodic(void *user_data)
+{
+	if (!bench_pump())
+		return 1;
+
+	pump_id = 0;
+	if (!expected)
+		bench_finish();
+
+	return 0;
+}
+
+/* Refill the window as soon as deliveries complete */
+static int bench_pump_idle(void *user_data)
+{
+	idle_id = 0;
+
+	if (pump_id && bench_pump()) {
+		loop->remove_periodic_callback(pump_id);
+		pump_id = 0;
+	}
+
+	return 0;
+}
+
+static void bench_timeout(void *user_data)
+{
+	timeout_id = 0;
+	fprintf(stderr, "Timeout, %llu of %llu messages received\n",
+			(unsigned long long)received,
+			(unsigned long long)expected);
+	bench_finish();
+}
+
+static void bench_start(void)
+{
+	rss_after_clients = read_rss_kb();
+
+	fprintf(stderr, "%u clients ready, starting\n", num_clients);
+
+	start_time = now_ns();
+	getrusage(RUSAGE_SELF, &start_usage);
+	if (broker_pid > 0)
+		broker_start_cpu = read_process_cpu_us(broker_pid);
+
+	loop->add_timeout_callback(&timeout_id, params.timeout * 1000,
+			bench_timeout, NULL);
+	if (bench_pump()) {
+		if (!expected)
+			bench_finish();
+		return;
+	}
+
+	loop->add_periodic_callback(&pump_id, BENCH_PUMP_PERIOD,
+			bench_pump_periodic, NULL);
+}
+
+static void client_ready(void)
+{
+	if (++num_ready == num_clients)
+		bench_start();
+}
+
+static void on_bench_message(artik_mqtt_config *client_config,
+		void *user_data, artik_mqtt_msg *msg)
+{
+	struct bench_header header;
+	uint64_t now = now_ns();
+
+	if (finished || msg->payload_len < (int)sizeof(header))
+		return;
+
+	memcpy(&header, msg->payload, sizeof(header));
+
+	if (received < expected)
+		latencies[received] = now - header.timestamp;
+	received++;
+
+	if (received >= expected)
+		bench_finish();
+	else if (pump_id && !idle_id && !params.rate)
+		loop->add_idle_callback(&idle_id, bench_pump_idle, NULL);
+}
+
+static void on_bench_subscribe(artik_mqtt_config *client_config,
+		void *user_data, int mid, int qos_count, const int *granted_qos)
+{
+	client_ready();
+}
+
+static void on_bench_connect(artik_mqtt_config *client_config,
+		void *user_data, int result)
+{
+	struct bench_client *client = (struct bench_client *)user_data;
+
+	if (result != S_OK) {
+		fprintf(stderr, "%s failed to connect (err=%d)\n", client->id,
+				result);
+		bench_finish();
+		return;
+	}
+
+	if (client->publisher) {
+		client_ready();
+		return;
+	}
+
+	if (mqtt->subscribe(client->handle, params.qos,
+			BENCH_TOPIC_FILTER) != S_OK) {
+		fprintf(stderr, "%s failed to subscribe\n", client->id);
+		bench_finish();
+	}
+}
+
+static bool bench_create_client(struct bench_client *client)
+{
+	artik_mqtt_batch_config batch_config;
+
+	memset(&client->config, 0, sizeof(artik_mqtt_config));
+	client->config.client_id = client->id;
+	client->config.clean_session = true;
+	client->config.block = true;
+	client->config.keep_alive_time = 60000;
+
+	if (mqtt->create_client(&client->handle, &client->config) != S_OK) {
+		fprintf(stderr, "Failed to create %s\n", client->id);
+		return false;
+	}
+
+	mqtt->set_connect(client->handle, on_bench_connect, client);
+	if (!client->publisher) {
+		mqtt->set_subscribe(client->handle, on_bench_subscribe, client);
+		mqtt->set_message(client->handle, on_bench_message, client);
+	}
+
+	if (client->publisher && params.batch_window) {
+		memset(&batch_config, 0, sizeof(batch_config));
+		batch_config.mode = ARTIK_MQTT_BATCH_PIPELINE;
+		batch_config.window = params.batch_window;
+		batch_config.qos = params.qos;
+
+		if (mqtt->create_batch(client->handle, client->topic,
+				&batch_config, &client->batch) != S_OK) {
+			fprintf(stderr, "Failed to create the batch of %s\n",
+					client->id);
+			return false;
+		}
+	}
+
+	if (mqtt->connect(client->handle, params.host, params.port) != S_OK) {
+		fprintf(stderr, "%s failed to connect to %s:%d\n", client->id,
+				params.host, params.port);
+		return false;
+	}
+
+	return true;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(uint64_t count, unsigned int percent)
+{
+	uint64_t index;
+
+	if (!count)
+		return 0;
+
+	index = (count * percent + 99) / 100;
+	if (index)
+		index--;
+
+	return latencies[index] / 1000.0;
+}
+
+static void bench_report(void)
+{
+	uint64_t samples = received < expected ? received : expected;
+	double duration = (end_time - start_time) / 1e9;
+	uint64_t cpu_us = timeval_us(&end_usage.ru_utime) +
+		timeval_us(&end_usage.ru_stime) -
+		timeval_us(&start_usage.ru_utime) -
+		timeval_us(&start_usage.ru_stime);
+	uint64_t messages = received ? received : 1;
+
+	qsort(latencies, samples, sizeof(uint64_t), compare_u64);
+
+	printf("{\"publishers\": %u, \"subscribers\": %u, \"qos\": %d, "
+		"\"payload_bytes\": %u, \"rate\": %u, \"batch_window_ms\": %u, "
+		"\"sent\": %llu, \"expected\": %llu, \"received\": %llu, "
+		"\"publish_errors\": %llu, \"duration_s\": %.3f, "
+		"\"msgs_per_s\": %.1f, \"latency_p50_us\": %.1f, "
+		"\"latency_p99_us\": %.1f, \"latency_max_us\": %.1f, "
+		"\"cpu_us_per_msg\": %.3f, \"broker_cpu_us_per_msg\": %.3f, "
+		"\"rss_kb_per_client\": %.1f}\n",
+		params.publishers, params.subscribers, params.qos,
+		params.payload_len, params.rate, params.batch_window,
+		(unsigned long long)sent, (unsigned long long)expected,
+		(unsigned long long)received,
+		(unsigned long long)publish_errors, duration,
+		duration > 0 ? received / duration : 0,
+		percentile_us(samples, 50), percentile_us(samples, 99),
+		samples ? latencies[samples - 1] / 1000.0 : 0,
+		(double)cpu_us / messages,
+		(double)(broker_end_cpu - broker_start_cpu) / messages,
+		rss_before_clients >= 0 && rss_after_clients >= 0 ?
+			(double)(rss_after_clients - rss_before_clients) /
+				num_clients : -1.0);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  -H <host>     broker address (default %s)\n"
+		"  -P <port>     broker port (default %d)\n"
+		"  -B <path>     start the mosquitto broker at <path> on the "
+		"port\n"
+		"  -p <count>    publishing clients (default %u)\n"
+		"  -s <count>    subscribing clients, i.e. fan-out "
+		"(default %u)\n"
+		"  -n <count>    messages per publisher (default %u)\n"
+		"  -q <qos>      QoS of the messages (default %d)\n"
+		"  -l <bytes>    payload size, at least %zu (default %u)\n"
+		"  -r <rate>     total publish rate in msg/s, 0 for no limit "
+		"(default %u)\n"
+		"  -w <count>    max pending deliveries (default %u)\n"
+		"  -b <ms>       publish through batches with this window\n"
+		"  -t <seconds>  give up after this time (default %u)\n",
+		name, params.host, params.port, params.publishers,
+		params.subscribers, params.messages, params.qos,
+		sizeof(struct bench_header), params.payload_len, params.rate,
+		params.window, params.timeout);
+}
+
+static bool parse_args(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "H:P:B:p:s:n:q:l:r:w:b:t:h")) != -1) {
+		switch (opt) {
+		case 'H':
+			params.host = optarg;
+			break;
+		case 'P':
+			params.port = atoi(optarg);
+			break;
+		case 'B':
+			params.broker = optarg;
+			break;
+		case 'p':
+			params.publishers = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			params.subscribers = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			params.messages = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			params.qos = atoi(optarg);
+			break;
+		case 'l':
+			params.payload_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			params.rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			params.window = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			params.batch_window = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			params.timeout = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return params.publishers > 0 && params.qos >= 0 && params.qos <= 2 &&
+		params.payload_len >= sizeof(struct bench_header) &&
+		params.window > 0 && params.timeout > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+	int ret = -1;
+
+	if (!parse_args(argc, argv)) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_MQTT)) {
+		fprintf(stdout,
+			"TEST: MQTT module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	if (!artik_is_module_available(ARTIK_MODULE_LOOP)) {
+		fprintf(stdout,
+			"TEST: LOOP module is not available,"\
+			" skipping test...\n");
+		return -1;
+	}
+
+	if (params.broker && !broker_start())
+		goto exit;
+
+	num_clients = params.publishers + params.subscribers;
+	expected = (uint64_t)params.publishers * params.messages *
+		params.subscribers;
+
+	clients = calloc(num_clients, sizeof(struct bench_client));
+	latencies = calloc(expected ? expected : 1, sizeof(uint64_t));
+	payload = calloc(1, params.payload_len);
+	if (!clients || !latencies || !payload) {
+		fprintf(stderr, "Not enough memory\n");
+		goto exit;
+	}
+
+	mqtt = (artik_mqtt_module *)artik_request_api_module("mqtt");
+	loop = (artik_loop_module *)artik_request_api_module("loop");
+
+	rss_before_clients = read_rss_kb();
+
+	for (i = 0; i < num_clients; i++) {
+		struct bench_client *client = &clients[i];
+
+		client->publisher = i >= params.subscribers;
+		client->index = client->publisher ? i - params.subscribers : i;
+		snprintf(client->id, sizeof(client->id), "bench-%s-%d-%u",
+				client->publisher ? "pub" : "sub", getpid(),
+				client->index);
+		snprintf(client->topic, sizeof(client->topic), "%s%u",
+				BENCH_TOPIC_PREFIX, client->index);
+
+		if (!bench_create_client(client))
+			goto cleanup;
+	}
+
+	loop->run();
+
+	if (num_ready == num_clients) {
+		bench_report();
+		ret = received == expected ? 0 : -1;
+	}
+
+cleanup:
+	for (i = 0; i < num_clients; i++) {
+		if (clients[i].batch)
+			mqtt->destroy_batch(clients[i].batch);
+		if (clients[i].handle) {
+			mqtt->disconnect(clients[i].handle);
+			mqtt->destroy_client(clients[i].handle);
+		}
+	}
+
+	artik_release_api_module(mqtt);
+	artik_release_api_module(loop);
+
+exit:
+	broker_stop();
+	free(clients);
+	free(latencies);
+	free(payload);
+
+	return ret;
+}
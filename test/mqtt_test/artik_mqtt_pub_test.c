@@ -67,10 +67,17 @@ void on_disconnect(artik_mqtt_config *client_config, void *user_data,
 	artik_mqtt_handle *client_data = (artik_mqtt_handle *)
 							client_config->handle;
 	artik_mqtt_module *user_mqtt = (artik_mqtt_module *) user_data;
+	artik_mqtt_queue_stats stats;
 
 	if (result == S_OK) {
 		log_dbg("disconnected\n");
 		if (client_data) {
+			if (user_mqtt->get_offline_queue_stats(client_data,
+					&stats) == S_OK)
+				fprintf(stdout, "queue: %u pending, %u queued, "
+					"%u replayed, %u dropped\n",
+					stats.messages, stats.queued,
+					stats.replayed, stats.dropped);
 			user_mqtt->destroy_client(client_data);
 			client_data = NULL;
 			loop->quit();
@@ -89,8 +96,8 @@ int main(int argc, char *argv[])
 	artik_mqtt_handle client;
 
 	if (argc < 4) {
-		printf("Usage: %s <hostname or ip> <topic> <message>\n",
-								argv[0]);
+		printf("Usage: %s <hostname or ip> <topic> <message> "
+				"[offline queue file]\n", argv[0]);
 		return 0;
 	}
 
@@ -131,6 +138,19 @@ int main(int argc, char *argv[])
 	mqtt->set_disconnect(client, on_disconnect, mqtt);
 	mqtt->set_publish(client, on_publish_disconnect, mqtt);
 
+	if (argc > 4) {
+		artik_mqtt_queue_config queue_config;
+
+		memset(&queue_config, 0, sizeof(queue_config));
+		queue_config.path = argv[4];
+		queue_config.max_bytes = 64 * 1024;
+		queue_config.drop_policy = ARTIK_MQTT_DROP_OLDEST;
+		queue_config.replay_rate = 50;
+
+		if (mqtt->enable_offline_queue(client, &queue_config) != S_OK)
+			fprintf(stdout, "Failed to enable the offline queue\n");
+	}
+
 
 	mqtt->connect(client, host, BROKER_PORT);
 	loop = artik_request_api_module("loop");
@@ -26,6 +26,15 @@
 
 artik_mqtt_module *mqtt;
 artik_loop_module *loop;
+char **filters;
+int num_filters;
+
+void on_filter_message(artik_mqtt_config *client_config, void *data_user,
+							artik_mqtt_msg *msg)
+{
+	fprintf(stdout, "filter %s matched topic %s\n", (char *)data_user,
+			msg->topic);
+}
 
 void on_connect_subscribe(artik_mqtt_config *client_config, void *data_user,
 								int result)
@@ -34,13 +43,24 @@ void on_connect_subscribe(artik_mqtt_config *client_config, void *data_user,
 							client_config->handle;
 
 	artik_mqtt_msg *msg;
+	artik_mqtt_subscription subscription;
 	int rc;
+	int i;
 
 	if (result == S_OK && client_data) {
 		msg = (artik_mqtt_msg *) data_user;
 		rc = mqtt->subscribe(client_data, msg->qos, msg->topic);
 		if (rc == 0)
 			log_dbg("subscribe success");
+
+		for (i = 0; i < num_filters; i++) {
+			rc = mqtt->add_subscription(client_data, msg->qos,
+					filters[i], on_filter_message,
+					filters[i], &subscription);
+			if (rc != S_OK)
+				fprintf(stdout, "Failed to subscribe to %s\n",
+						filters[i]);
+		}
 	}
 }
 
@@ -64,10 +84,17 @@ void on_disconnect(artik_mqtt_config *client_config, void *data_user,
 	artik_mqtt_handle *client_data = (artik_mqtt_handle *)
 							client_config->handle;
 	artik_mqtt_module *user_mqtt = (artik_mqtt_module *) data_user;
+	artik_mqtt_stats stats;
 
 	if (result == S_OK) {
 		log_dbg("disconnected\n");
 		if (client_data) {
+			if (user_mqtt->get_stats(client_data, &stats) == S_OK)
+				fprintf(stdout, "%u packets in %u wakeups "
+					"(max %u), %u write wakeups\n",
+					stats.packets_read, stats.wakeups,
+					stats.max_packets_per_wakeup,
+					stats.write_wakeups);
 			user_mqtt->destroy_client(client_data);
 			client_data = NULL;
 			loop->quit();
@@ -85,12 +112,15 @@ int main(int argc, char *argv[])
 	artik_mqtt_handle client;
 
 	if (argc < 3) {
-		printf("Usage: %s <hostname or ip> <topic>\n", argv[0]);
+		printf("Usage: %s <hostname or ip> <topic> [filter...]\n",
+								argv[0]);
 		return 0;
 	}
 
 	host = argv[1];
 	sub_topic = argv[2];
+	filters = &argv[3];
+	num_filters = argc - 3;
 
 	memset(&config, 0, sizeof(artik_mqtt_config));
 	config.client_id = "sub_client";
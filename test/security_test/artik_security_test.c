@@ -64,6 +64,7 @@
 
 #include <artik_module.h>
 #include <artik_security.h>
+#include <artik_ssl.h>
 
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof((a)[0]))
 
@@ -2901,6 +2902,86 @@ exit:
 	return test_result;
 }
 
+static int security_ssl_credentials(void)
+{
+	artik_security_module *security = NULL;
+	artik_ssl_credentials_handle first = NULL, second = NULL, other = NULL;
+	artik_ssl_config ssl;
+	artik_error ret = S_OK;
+	int test_result = 0;
+	char ca_cert[] =
+			"-----BEGIN CERTIFICATE-----\n"
+			"MIICNzCCAd2gAwIBAgIJAKMtfXi0W6ioMAoGCCqGSM49BAMCMH8xCzAJBgNVBAYT\n"
+			"AktSMRAwDgYDVQQIDAdFbmdsYW5kMSQwIgYDVQQKDBtTYW1zdW5nIFNlbWljb25k\n"
+			"dWN0b3IgQVJUSUsxGzAZBgNVBAsMEkFSVElLIFJvb3QgQ0EgVGVzdDEbMBkGA1UE\n"
+			"AwwSQVJUSUsgUm9vdCBDQSBUZXN0MB4XDTE3MDMxNDA3NTQyMloXDTMyMDMxMDA3\n"
+			"NTQyMlowfzELMAkGA1UEBhMCS1IxEDAOBgNVBAgMB0VuZ2xhbmQxJDAiBgNVBAoM\n"
+			"G1NhbXN1bmcgU2VtaWNvbmR1Y3RvciBBUlRJSzEbMBkGA1UECwwSQVJUSUsgUm9v\n"
+			"dCBDQSBUZXN0MRswGQYDVQQDDBJBUlRJSyBSb290IENBIFRlc3QwWTATBgcqhkjO\n"
+			"PQIBBggqhkjOPQMBBwNCAAS9eeiVxAIIstHpInEhbIhNGNtqvZ3Qr1h1NXbvJeC3\n"
+			"BgCY5LUhOphwb32PjgjvHo+m0BRbdf5Vhq9rMtpP9Uk4o0IwQDAdBgNVHQ4EFgQU\n"
+			"B9ReEry47MDB6Ql+N7TJf/JxGhAwDwYDVR0TAQH/BAUwAwEB/zAOBgNVHQ8BAf8E\n"
+			"BAMCAQYwCgYIKoZIzj0EAwIDSAAwRQIgV2iTYlR/hyWmzxcMf/wU4kOhRCRB2LD2\n"
+			"ICpARpmuz7ECIQCLiRlB9EWS810OrPmcDXYhf2vRJyesqrMJiPTL2SNl0g==\n"
+			"-----END CERTIFICATE-----\n";
+
+	fprintf(stderr, "------------------------------------------------\n");
+	fprintf(stderr, "  SECURITY SDK TESTCASE : ssl credentials cache\n");
+	fprintf(stderr, "------------------------------------------------\n");
+
+	security = (artik_security_module *) artik_request_api_module("security");
+	if (!security) {
+		fprintf(stderr, "Security module is not available\n");
+		return 1;
+	}
+
+	memset(&ssl, 0, sizeof(ssl));
+	ssl.ca_cert.data = ca_cert;
+	ssl.ca_cert.len = strlen(ca_cert);
+	ssl.verify_cert = ARTIK_SSL_VERIFY_REQUIRED;
+
+	ret = security->get_ssl_credentials(&ssl, &first);
+	if (ret != S_OK) {
+		fprintf(stderr, "Failed to get ssl credentials (err=%d)\n", ret);
+		test_result++;
+		goto exit;
+	}
+
+	/* Same bytes from another buffer must hit the cache */
+	ssl.ca_cert.data = strdup(ca_cert);
+	ret = security->get_ssl_credentials(&ssl, &second);
+	free(ssl.ca_cert.data);
+	if (ret != S_OK || second != first) {
+		fprintf(stderr, "Identical configuration was not shared (err=%d)\n",
+			ret);
+		test_result++;
+		goto exit;
+	}
+
+	/* Changing the configuration must select another entry */
+	ssl.ca_cert.data = ca_cert;
+	ssl.verify_cert = ARTIK_SSL_VERIFY_NONE;
+	ret = security->get_ssl_credentials(&ssl, &other);
+	if (ret != S_OK || other == first) {
+		fprintf(stderr, "Modified configuration was shared (err=%d)\n",
+			ret);
+		test_result++;
+		goto exit;
+	}
+
+exit:
+	if (first)
+		security->put_ssl_credentials(first);
+	if (second)
+		security->put_ssl_credentials(second);
+	if (other)
+		security->put_ssl_credentials(other);
+
+	artik_release_api_module(security);
+
+	return test_result;
+}
+
 int main(int argc, char **argv)
 {
 	int i;
@@ -2937,7 +3018,8 @@ int main(int argc, char **argv)
 		"security_set_compute_dhm_params",
 		"security_set_compute_ecdh_params",
 		"security_get_publickey",
-		"security_cert_chain"
+		"security_cert_chain",
+		"security_ssl_credentials"
 	};
 
 	printf("\n\n");
@@ -3010,6 +3092,10 @@ int main(int argc, char **argv)
 		if (security_cert_chain())
 			test_result |= 0x10000;
 
+	if (test_select & 0x20000)
+		if (security_ssl_credentials())
+			test_result |= 0x20000;
+
 	for (i = 0; i < ARRAY_SIZE(test_name); i++) {
 		if (!(test_select & 0x1))
 			printf("%40s not tested\n", test_name[i]);
@@ -0,0 +1,250 @@
+/*
+ *
+ * Copyright 2018 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ */
+
+/*! \file artik_json_test.c
+ *
+ *  \brief JSON tokenizer test in C
+ *
+ *  Tokenizes documents fed at once and in chunks of every size, and
+ *  checks the values extracted by path.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <artik_module.h>
+#include <artik_utils.h>
+
+#define DUMP_MAX	4096
+
+static artik_utils_module *utils;
+
+static const char *devices_json =
+	"{\"data\": {\"devices\": [\n"
+	"  {\"id\": \"d1\", \"name\": \"caf\\u00e9 \\\"1\\\"\", \"eid\": null,\n"
+	"   \"connected\": true, \"createdOn\": 1501234567890},\n"
+	"  {\"id\": \"d2\", \"name\": \"two\", \"eid\": \"x\", \"connected\": false,\n"
+	"   \"props\": {\"list\": [1, -2.5e-3, [], {}]}}\n"
+	"]}, \"total\": 2, \"offset\": 0, \"count\": 2}";
+
+static const char * const bad_json[] = {
+	"{\"a\": }",
+	"[1, ]",
+	"{\"a\" 1}",
+	"[01]",
+	"[1 2]",
+	"{\"a\": 1",
+	"[tru]",
+	"\"\\x\"",
+	"{1: 2}",
+	"[1]x",
+	"{\"a\":1} garbage",
+	"\"a\" \"b\""
+};
+
+/*
+ * Render the tokens of a document fed in chunks of the given size, 0
+ * to feed it at once, along with their paths.
+ */
+static artik_error dump_tokens(const char *json, unsigned int chunk,
+		char *out, unsigned int size)
+{
+	artik_json_tokenizer tokenizer;
+	artik_json_token token;
+	char scratch[64];
+	unsigned int len = strlen(json);
+	unsigned int pos = 0;
+	unsigned int out_len = 0;
+	artik_error ret;
+
+	ret = utils->json_init(&tokenizer, scratch, sizeof(scratch));
+	if (ret != S_OK)
+		return ret;
+
+	for (;;) {
+		ret = utils->json_next(&tokenizer, &token);
+		if (ret == E_TRY_AGAIN) {
+			unsigned int n = len - pos;
+
+			if (!n) {
+				utils->json_feed(&tokenizer, NULL, 0);
+				continue;
+			}
+
+			if (chunk && chunk < n)
+				n = chunk;
+			utils->json_feed(&tokenizer, json + pos, n);
+			pos += n;
+			continue;
+		}
+
+		if (ret != S_OK)
+			return ret;
+
+		out_len += snprintf(out + out_len, size - out_len,
+				"%d:%.*s@%s/%u ", token.type, (int)token.len,
+				token.value ? token.value : "",
+				utils->json_get_path(&tokenizer), token.depth);
+		if (out_len >= size)
+			return E_OVERFLOW;
+
+		if (token.type == ARTIK_JSON_END)
+			return S_OK;
+	}
+}
+
+static artik_error test_json_chunks(void)
+{
+	char reference[DUMP_MAX];
+	char output[DUMP_MAX];
+	unsigned int chunk;
+	artik_error ret;
+
+	fprintf(stdout, "TEST: %s started\n", __func__);
+
+	ret = dump_tokens(devices_json, 0, reference, sizeof(reference));
+	if (ret != S_OK) {
+		fprintf(stderr, "TEST: %s failed: ERROR(%d)\n", __func__, ret);
+		return ret;
+	}
+
+	for (chunk = 1; chunk <= 32; chunk++) {
+		ret = dump_tokens(devices_json, chunk, output, sizeof(output));
+		if (ret != S_OK || strcmp(reference, output)) {
+			fprintf(stderr, "TEST: %s failed with chunks of %u bytes\n",
+					__func__, chunk);
+			return ret != S_OK ? ret : E_INVALID_VALUE;
+		}
+	}
+
+	fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+	return S_OK;
+}
+
+static artik_error test_json_malformed(void)
+{
+	char output[DUMP_MAX];
+	unsigned int i;
+	artik_error ret;
+
+	fprintf(stdout, "TEST: %s started\n", __func__);
+
+	for (i = 0; i < sizeof(bad_json) / sizeof(bad_json[0]); i++) {
+		ret = dump_tokens(bad_json[i], 1, output, sizeof(output));
+		if (ret != E_INVALID_VALUE) {
+			fprintf(stderr, "TEST: %s failed on %s: ERROR(%d)\n",
+					__func__, bad_json[i], ret);
+			return E_INVALID_VALUE;
+		}
+	}
+
+	fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+	return S_OK;
+}
+
+static artik_error check_find(const char *pattern, const char *expected)
+{
+	artik_json_token token;
+	char value[128];
+	artik_error ret;
+
+	ret = utils->json_find(devices_json, strlen(devices_json), pattern,
+			&token);
+	if (ret != S_OK) {
+		fprintf(stderr, "'%s' not found: ERROR(%d)\n", pattern, ret);
+		return ret;
+	}
+
+	ret = utils->json_copy_string(&token, value, sizeof(value));
+	if (ret != S_OK)
+		return ret;
+
+	if (strcmp(value, expected)) {
+		fprintf(stderr, "'%s' is '%s' instead of '%s'\n", pattern,
+				value, expected);
+		return E_INVALID_VALUE;
+	}
+
+	return S_OK;
+}
+
+static artik_error test_json_find(void)
+{
+	artik_json_token token;
+	artik_error ret;
+
+	fprintf(stdout, "TEST: %s started\n", __func__);
+
+	ret = check_find("data.devices[*].id", "d1");
+	if (ret == S_OK)
+		ret = check_find("data.devices[1].id", "d2");
+	if (ret == S_OK)
+		ret = check_find("data.devices[0].name", "caf\xc3\xa9 \"1\"");
+	if (ret == S_OK)
+		ret = check_find("data.*[1].props.list[1]", "-2.5e-3");
+	if (ret == S_OK)
+		ret = check_find("data.devices[1].props", "{\"list\": [1, "
+				"-2.5e-3, [], {}]}");
+	if (ret == S_OK)
+		ret = check_find("total", "2");
+
+	if (ret == S_OK && utils->json_find(devices_json,
+			strlen(devices_json), "data.devices[2]", &token) !=
+			E_NOT_FOUND)
+		ret = E_INVALID_VALUE;
+
+	if (ret != S_OK) {
+		fprintf(stderr, "TEST: %s failed: ERROR(%d)\n", __func__, ret);
+		return ret;
+	}
+
+	fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+	return S_OK;
+}
+
+int main(void)
+{
+	artik_error ret;
+
+	utils = (artik_utils_module *)artik_request_api_module("utils");
+	if (!utils) {
+		fprintf(stdout, "TEST: Utils module is not available,"
+				" skipping test...\n");
+		return -1;
+	}
+
+	ret = test_json_chunks();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_json_malformed();
+	if (ret != S_OK)
+		goto exit;
+
+	ret = test_json_find();
+
+exit:
+	artik_release_api_module(utils);
+
+	return (ret == S_OK) ? 0 : -1;
+}
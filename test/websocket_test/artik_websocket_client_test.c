@@ -43,6 +43,7 @@ static void connection_callback(void *user_data, void *result)
 {
 
 	intptr_t connected = (intptr_t)result;
+	artik_websocket_queue_stats stats;
 
 	if (connected == ARTIK_WEBSOCKET_CONNECTED) {
 		fprintf(stdout, "Websocket connected\n");
@@ -54,6 +55,11 @@ static void connection_callback(void *user_data, void *result)
 
 		websocket->websocket_write_stream((artik_websocket_handle)
 						user_data, test_message);
+		if (websocket->websocket_get_queue_stats((artik_websocket_handle)
+						user_data, &stats) == S_OK)
+			fprintf(stdout, "Send queue: %u messages, %u bytes "
+				"pending\n", stats.pending_messages,
+				stats.pending_bytes);
 		artik_release_api_module(websocket);
 	} else if (connected == ARTIK_WEBSOCKET_CLOSED) {
 		fprintf(stdout, "Websocket closed\n");
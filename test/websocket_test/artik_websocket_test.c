@@ -192,6 +192,107 @@ exit:
 	return ret;
 }
 
+static int pending_connections;
+
+static void two_streams_callback(void *user_data, void *result)
+{
+	intptr_t *status = (intptr_t *)user_data;
+
+	/* Only the first notification of each stream is waited for */
+	if (*status != -1)
+		return;
+
+	*status = (intptr_t)result;
+
+	if (--pending_connections == 0) {
+		artik_loop_module *loop = (artik_loop_module *)
+					artik_request_api_module("loop");
+		loop->quit();
+		artik_release_api_module(loop);
+	}
+}
+
+/*
+ * Open a stream to the server and another one to a closed port, then
+ * clean up the failed stream while the other one is still alive.
+ */
+static artik_error test_websocket_connect_failure(char *uri)
+{
+	artik_error ret = S_OK;
+	artik_websocket_module *websocket = (artik_websocket_module *)
+					artik_request_api_module("websocket");
+	artik_loop_module *loop = (artik_loop_module *)
+					artik_request_api_module("loop");
+	artik_websocket_handle good = NULL, bad = NULL;
+	artik_websocket_config good_config, bad_config;
+	intptr_t good_status = -1, bad_status = -1;
+
+	memset(&good_config, 0, sizeof(artik_websocket_config));
+	memset(&bad_config, 0, sizeof(artik_websocket_config));
+
+	good_config.uri = uri;
+	good_config.ssl_config.verify_cert = ARTIK_SSL_VERIFY_NONE;
+	bad_config.uri = "ws://127.0.0.1:1/";
+	bad_config.ssl_config.verify_cert = ARTIK_SSL_VERIFY_NONE;
+
+	fprintf(stdout, "TEST: %s starting\n", __func__);
+
+	ret = websocket->websocket_request(&good, &good_config);
+	if (ret != S_OK) {
+		good = NULL;
+		goto exit;
+	}
+
+	ret = websocket->websocket_request(&bad, &bad_config);
+	if (ret != S_OK) {
+		bad = NULL;
+		goto exit;
+	}
+
+	ret = websocket->websocket_open_stream(good);
+	if (ret != S_OK)
+		goto exit;
+
+	ret = websocket->websocket_open_stream(bad);
+	if (ret != S_OK) {
+		websocket->websocket_close_stream(good);
+		goto exit;
+	}
+
+	websocket->websocket_set_connection_callback(good,
+					two_streams_callback, &good_status);
+	websocket->websocket_set_connection_callback(bad,
+					two_streams_callback, &bad_status);
+
+	pending_connections = 2;
+	loop->add_signal_watch(SIGINT, quit_loop, (void *)loop, NULL);
+	loop->run();
+
+	if (good_status != ARTIK_WEBSOCKET_CONNECTED ||
+			bad_status != ARTIK_WEBSOCKET_CONNECTION_ERROR)
+		ret = E_WEBSOCKET_ERROR;
+
+	/* The failed stream goes first, the other one is still open */
+	websocket->websocket_close_stream(bad);
+	websocket->websocket_close_stream(good);
+
+exit:
+	if (bad)
+		websocket->websocket_release(bad);
+	if (good)
+		websocket->websocket_release(good);
+
+	if (ret != S_OK)
+		fprintf(stdout, "TEST: %s failed (err=%d)\n", __func__, ret);
+	else
+		fprintf(stdout, "TEST: %s succeeded\n", __func__);
+
+	artik_release_api_module(websocket);
+	artik_release_api_module(loop);
+
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -222,6 +323,8 @@ int main(int argc, char *argv[])
 		test_message = strndup("ping", 5);
 
 	ret = test_websocket_write(uri, verify);
+	if (ret == S_OK)
+		ret = test_websocket_connect_failure(uri);
 
 	if (test_message)
 		free(test_message);